@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""End-to-end benchmarks of the krfiles CLI against bench/mockserver.py.
+
+Each case runs the CLI as a subprocess several times and reports the mean
+wall time, so process start-up and loading libkrfiles are included. Results
+are printed as JSON, one object per case:
+
+  {"target": "cli", "benchmark": "get", "param": 1048576, "runs": 5,
+   "mean_seconds": 0.012, "ops_per_sec": 83.3, "mb_per_sec": 87.4}
+
+With --daemon, small commands are also timed against a running
+`krfiles daemon` and reported with "target": "cli-daemon", for a per-command
+comparison of warm and cold start-up. These cases run at least 20 times and
+also report "p50_seconds" and "p95_seconds".
+
+Usage: python3 bench/cli_bench.py [--bin cli/target/release/krfiles]
+           [--runs 5] [--quick] [--daemon] [--output results.json]
+"""
+
+import argparse
+import json
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import mockserver  # noqa: E402
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+KIB = 1024
+MIB = 1024 * KIB
+GIB = 1024 * MIB
+
+ENTRIES = [1000, 10_000, 100_000, 1_000_000]
+SIZES = [KIB, MIB, 64 * MIB, 4 * GIB]
+BATCH_OPS = [100, 1000]
+
+
+def time_runs(command, runs, env):
+    """Run `command` `runs` times; return the mean wall time in seconds."""
+    return statistics.fmean(sample_runs(command, runs, env))
+
+
+def sample_runs(command, runs, env):
+    """Run `command` `runs` times; return each run's wall time in seconds."""
+    samples = []
+    for _ in range(runs):
+        start = time.perf_counter()
+        subprocess.run(command, env=env, check=True, stdout=subprocess.DEVNULL)
+        samples.append(time.perf_counter() - start)
+    return samples
+
+
+def record(benchmark, param, runs, mean, size=None):
+    result = {
+        "target": "cli",
+        "benchmark": benchmark,
+        "param": param,
+        "runs": runs,
+        "mean_seconds": round(mean, 6),
+        "ops_per_sec": round(1 / mean, 3),
+    }
+    if size is not None:
+        result["mb_per_sec"] = round(size / MIB / mean, 3)
+    return result
+
+
+def daemon_latency(cli, env, tmp, runs, results):
+    """Time small commands with and without a warm `krfiles daemon`."""
+    local = os.path.join(tmp, "small.bin")
+    cases = [
+        ("info", 0, ["info", "/blob-1024.bin"]),
+        ("ls", 1000, ["ls", "/tree-1000"]),
+        ("get", KIB, ["get", f"/blob-{KIB}.bin", local]),
+        ("mkdir", 0, ["mkdir", "/new"]),
+    ]
+    warm_env = dict(env, KRFILES_DAEMON_SOCKET=os.path.join(tmp, "krfiles.sock"))
+    del warm_env["KRFILES_NO_DAEMON"]
+    daemon = subprocess.Popen([cli[0], "daemon"], env=warm_env, stderr=subprocess.PIPE)
+    daemon.stderr.readline()  # "Listening on ..."
+    try:
+        for benchmark, param, command in cases:
+            for target, case_env in (("cli", env), ("cli-daemon", warm_env)):
+                time_runs(cli + command, 1, case_env)  # warm up the daemon's client
+                samples = sample_runs(cli + command, runs, case_env)
+                result = record(benchmark, param, runs, statistics.fmean(samples))
+                result["target"] = target
+                # Start-up latency has a long tail; the percentiles show it.
+                cuts = statistics.quantiles(samples, n=100, method="inclusive")
+                result["p50_seconds"] = round(cuts[49], 6)
+                result["p95_seconds"] = round(cuts[94], 6)
+                results.append(result)
+                print(json.dumps(result), file=sys.stderr)
+    finally:
+        subprocess.run([cli[0], "daemon", "--stop"], env=warm_env, stdout=subprocess.DEVNULL)
+        daemon.wait()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--bin", default=os.path.join(ROOT, "cli/target/release/krfiles"))
+    parser.add_argument("--runs", type=int, default=5)
+    parser.add_argument("--quick", action="store_true", help="only the smallest sizes")
+    parser.add_argument("--daemon", action="store_true", help="compare small commands with a warm daemon")
+    parser.add_argument("--output", help="write results here instead of stdout")
+    args = parser.parse_args()
+
+    entries = ENTRIES[:1] if args.quick else ENTRIES
+    sizes = SIZES[:2] if args.quick else SIZES
+    batch_ops = BATCH_OPS[:1] if args.quick else BATCH_OPS
+
+    server = mockserver.start()
+    url = f"http://127.0.0.1:{server.server_port}"
+    env = dict(os.environ, KRFILES_TOKEN=mockserver.TOKEN, KRFILES_CACHE_TTL="0", KRFILES_NO_DAEMON="1")
+    cli = [args.bin, "--server", url]
+    results = []
+
+    def run(benchmark, param, command, size=None):
+        # Larger transfers get a single run so 4 GiB doesn't take all day.
+        runs = args.runs if size is None or size <= 64 * MIB else 1
+        mean = time_runs(cli + command, runs, env)
+        results.append(record(benchmark, param, runs, mean, size))
+        print(json.dumps(results[-1]), file=sys.stderr)
+
+    with tempfile.TemporaryDirectory() as tmp:
+        for n in entries:
+            mockserver.listing(n)  # build the JSON before timing
+            run("ls", n, ["ls", f"/tree-{n}"])
+        for size in sizes:
+            local = os.path.join(tmp, "blob.bin")
+            run("get", size, ["get", f"/blob-{size}.bin", local], size)
+            os.remove(local)
+            # Sparse file: reading it costs no disk I/O.
+            with open(local, "wb") as f:
+                f.truncate(size)
+            run("put", size, ["put", "-f", local, "/upload.bin"], size)
+            os.remove(local)
+        for n in entries:
+            run("search", n, ["search", "file", f"/tree-{n}"])
+        for n in batch_ops:
+            ops = os.path.join(tmp, "ops.jsonl")
+            with open(ops, "w") as f:
+                for i in range(n):
+                    f.write(json.dumps({"op": "rename", "path": f"/a-{i}", "destination": f"/b-{i}"}) + "\n")
+            run("batch", n, ["batch", ops, "-j", "8"])
+
+        if args.daemon:
+            daemon_latency(cli, env, tmp, max(args.runs, 20), results)
+
+    server.shutdown()
+    output = json.dumps(results, indent=2)
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(output + "\n")
+    else:
+        print(output)
+
+
+if __name__ == "__main__":
+    main()
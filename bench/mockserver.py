@@ -0,0 +1,263 @@
+#!/usr/bin/env python3
+"""Stand-in Filebrowser server for benchmarks.
+
+Serves synthetic content sized by the path, so nothing is stored on disk:
+
+  /tree-<N>         directory of N files named file-<i>.bin
+  /blob-<BYTES>.bin file of BYTES bytes, streamed from a repeating pattern
+
+Uploads (plain and tus) are read and discarded, and deletes, renames,
+copies and mkdirs always succeed. Searching /tree-<N> returns N results,
+anywhere else 100. Any token is accepted. With `--gzip`, JSON responses are
+gzip-compressed for clients that accept it, like behind a compressing proxy.
+
+Run standalone with `python3 bench/mockserver.py [--port 8765]`, or import
+it and call `start()` to get a server running in a background thread.
+"""
+
+import argparse
+import functools
+import gzip
+import json
+import re
+import threading
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, unquote, urlsplit
+
+DEFAULT_PORT = 8765
+TOKEN = "bench-token"
+
+# 1 MiB of a repeating byte pattern; downloads are sliced out of it.
+PATTERN = bytes(range(251)) * (1024 * 1024 // 251 + 1)
+PATTERN_SIZE = 1024 * 1024
+
+TREE = re.compile(r"^/tree-(\d+)/?$")
+BLOB = re.compile(r"^/blob-(\d+)\.bin$")
+RANGE = re.compile(r"^bytes=(\d+)-(\d*)$")
+MODIFIED = "2024-01-01T00:00:00Z"
+
+
+def file_resource(path, size):
+    name = path.rsplit("/", 1)[-1]
+    return {
+        "name": name,
+        "size": size,
+        "extension": ".bin",
+        "modified": MODIFIED,
+        "mode": 420,
+        "isDir": False,
+        "isSymlink": False,
+        "type": "blob",
+        "path": path,
+    }
+
+
+@functools.lru_cache(maxsize=8)
+def listing(entries):
+    """JSON for /tree-<entries>, built once per size."""
+    path = f"/tree-{entries}"
+    items = [file_resource(f"{path}/file-{i}.bin", i) for i in range(entries)]
+    return json.dumps(
+        {
+            "name": path[1:],
+            "isDir": True,
+            "modified": MODIFIED,
+            "mode": 2147484141,
+            "path": path,
+            "items": items,
+            "numDirs": 0,
+            "numFiles": entries,
+            "sorting": {"by": "name", "asc": True},
+        }
+    ).encode()
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    # Offsets of tus uploads in progress, keyed by path.
+    uploads = {}
+    uploads_lock = threading.Lock()
+
+    def log_message(self, format, *args):
+        pass
+
+    # --- Helpers ---
+
+    def route(self):
+        url = urlsplit(self.path)
+        for prefix in ("/api/resources", "/api/raw", "/api/search", "/api/tus"):
+            if url.path.startswith(prefix):
+                path = unquote(url.path[len(prefix):]) or "/"
+                return prefix, path, parse_qs(url.query)
+        return url.path, "", parse_qs(url.query)
+
+    def send(self, status, body=b"", content_type="application/json", headers=None):
+        self.send_response(status)
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(body)))
+        for name, value in (headers or {}).items():
+            self.send_header(name, value)
+        self.end_headers()
+        if self.command != "HEAD":
+            self.wfile.write(body)
+
+    def send_json(self, value, status=200):
+        body = value if isinstance(value, bytes) else json.dumps(value).encode()
+        if self.server.gzip_json and "gzip" in self.headers.get("Accept-Encoding", ""):
+            self.send(status, compress(body), headers={"Content-Encoding": "gzip"})
+        else:
+            self.send(status, body)
+
+    def drain(self):
+        """Read and discard the request body; return its length."""
+        if self.headers.get("Transfer-Encoding", "").lower() == "chunked":
+            total = 0
+            while True:
+                size = int(self.rfile.readline().split(b";")[0], 16)
+                if size == 0:
+                    self.rfile.readline()
+                    return total
+                total += size
+                self.discard(size)
+                self.rfile.readline()
+        length = int(self.headers.get("Content-Length") or 0)
+        self.discard(length)
+        return length
+
+    def discard(self, length):
+        while length > 0:
+            chunk = self.rfile.read(min(length, PATTERN_SIZE))
+            if not chunk:
+                break
+            length -= len(chunk)
+
+    def stream(self, start, end):
+        """Write bytes [start, end) of the synthetic file."""
+        position = start
+        while position < end:
+            offset = position % PATTERN_SIZE
+            count = min(end - position, PATTERN_SIZE - offset)
+            self.wfile.write(PATTERN[offset:offset + count])
+            position += count
+
+    # --- Methods ---
+
+    def do_GET(self):
+        prefix, path, query = self.route()
+        if prefix == "/api/resources":
+            tree = TREE.match(path)
+            blob = BLOB.match(path)
+            if tree:
+                self.send_json(listing(int(tree.group(1))))
+            elif blob:
+                self.send_json(file_resource(path, int(blob.group(1))))
+            else:
+                self.send_json(file_resource(path, 0))
+        elif prefix == "/api/raw":
+            self.get_raw(path)
+        elif prefix == "/api/search":
+            tree = TREE.match(path)
+            count = int(tree.group(1)) if tree else 100
+            base = path.rstrip("/")
+            term = query.get("query", [""])[0]
+            results = [{"path": f"{base}/{term}-{i}.bin", "dir": False} for i in range(count)]
+            self.send_json(results)
+        else:
+            self.send(404, b"not found", "text/plain")
+
+    def do_HEAD(self):
+        prefix, path, _ = self.route()
+        if prefix == "/api/tus":
+            with self.uploads_lock:
+                offset = self.uploads.get(path, 0)
+            self.send(200, headers={"Upload-Offset": str(offset), "Tus-Resumable": "1.0.0"})
+        else:
+            self.send(200)
+
+    def get_raw(self, path):
+        blob = BLOB.match(path)
+        if not blob:
+            self.send(404, b"not found", "text/plain")
+            return
+        size = int(blob.group(1))
+        start, end, status = 0, size, 200
+        match = RANGE.match(self.headers.get("Range", ""))
+        if match:
+            start = int(match.group(1))
+            end = min(int(match.group(2)) + 1, size) if match.group(2) else size
+            if start >= size:
+                self.send(416, headers={"Content-Range": f"bytes */{size}"})
+                return
+            status = 206
+        self.send_response(status)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(end - start))
+        self.send_header("Accept-Ranges", "bytes")
+        if status == 206:
+            self.send_header("Content-Range", f"bytes {start}-{end - 1}/{size}")
+        self.end_headers()
+        self.stream(start, end)
+
+    def do_POST(self):
+        prefix, path, _ = self.route()
+        self.drain()
+        if self.path == "/api/login":
+            self.send(200, TOKEN.encode(), "text/plain")
+        elif prefix == "/api/tus":
+            with self.uploads_lock:
+                self.uploads[path] = 0
+            self.send(201, headers={"Tus-Resumable": "1.0.0"})
+        else:
+            self.send(200)
+
+    def do_PATCH(self):
+        prefix, path, _ = self.route()
+        received = self.drain()
+        if prefix == "/api/tus":
+            offset = int(self.headers.get("Upload-Offset") or 0) + received
+            with self.uploads_lock:
+                self.uploads[path] = offset
+            self.send(204, headers={"Upload-Offset": str(offset), "Tus-Resumable": "1.0.0"})
+        else:
+            self.send(200)
+
+    def do_PUT(self):
+        self.drain()
+        self.send(200)
+
+    def do_DELETE(self):
+        self.drain()
+        self.send(200)
+
+
+@functools.lru_cache(maxsize=8)
+def compress(body):
+    return gzip.compress(body, compresslevel=6)
+
+
+def start(port=0, gzip_json=False):
+    """Start a server on 127.0.0.1 in a daemon thread; return it (see `server_port`)."""
+    server = ThreadingHTTPServer(("127.0.0.1", port), Handler)
+    server.daemon_threads = True
+    server.gzip_json = gzip_json
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    return server
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=DEFAULT_PORT)
+    parser.add_argument("--gzip", action="store_true", help="gzip JSON responses")
+    args = parser.parse_args()
+    server = ThreadingHTTPServer(("127.0.0.1", args.port), Handler)
+    server.daemon_threads = True
+    server.gzip_json = args.gzip
+    print(f"Serving on http://127.0.0.1:{server.server_port}", flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -78,6 +78,7 @@ fn main() {
 
     // Step 3: Rerun this build script if these files change.
     println!("cargo:rerun-if-changed=native/krfiles_shim.c");
+    println!("cargo:rerun-if-changed=native/krfiles.h");
     println!("cargo:rerun-if-changed=native/libkrfiles_api.h");
     println!("cargo:rerun-if-env-changed=KRFILES_NATIVE_LIB_DIR");
 }
@@ -0,0 +1,449 @@
+/**
+ * Flat C API for libkrfiles.
+ *
+ * Declares the functions implemented in krfiles_shim.c. C, Go (cgo) and other
+ * FFI consumers include this header and link against the shim + libkrfiles.
+ *
+ * Threading: every function may be called concurrently from any thread, on the
+ * same client or different ones. Errors are reported per thread: when a call
+ * fails (returns NULL/false), krfiles_get_last_error() on the same thread returns
+ * the message. A client must not be used after, or concurrently with,
+ * krfiles_client_free().
+ *
+ * Ownership: every `const char*` returned by a blocking call is allocated by the
+ * library and must be released with krfiles_free_string(), including the result
+ * of krfiles_get_last_error(). Byte buffers the library allocates (see
+ * krfiles_download_to_memory) are released with krfiles_free(). Buffers the
+ * caller passes in are only borrowed until the call (or, for *_async calls, its
+ * completion callback) returns.
+ */
+
+#ifndef KRFILES_H
+#define KRFILES_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Opaque client handle. One per server; share it freely between threads. */
+typedef struct krfiles_client krfiles_client;
+
+/* Opaque iterator over a directory listing; see krfiles_list_open(). */
+typedef struct krfiles_listing krfiles_listing;
+
+/*
+ * Progress callback for transfers. `total` is -1 when the size is unknown.
+ * Invoked after every chunk: on the calling thread for blocking calls, on a
+ * library thread for the *_async variants.
+ */
+typedef void (*krfiles_progress_cb)(long long transferred, long long total, void* user_data);
+
+/*
+ * Completion callback for the *_async functions. Invoked exactly once, on a
+ * library-owned thread. On success `ok` is true and `result` holds the value the
+ * blocking call would return (NULL for operations without one); on failure `ok`
+ * is false and `error` holds the message. Both strings are only valid for the
+ * duration of the callback.
+ */
+typedef void (*krfiles_completion_cb)(void* user_data, bool ok, const char* result,
+                                      const char* error);
+
+/*
+ * Per-entry callback for krfiles_walk. `entry_json` is one Resource object with
+ * its full path, valid only during the call. Return false to stop the walk.
+ */
+typedef bool (*krfiles_walk_cb)(void* user_data, const char* entry_json);
+
+/*
+ * Per-result callback for krfiles_search_stream. `result_json` is one
+ * SearchResult object (path, dir), valid only during the call. Return false to
+ * stop the search.
+ */
+typedef bool (*krfiles_search_cb)(void* user_data, const char* result_json);
+
+/*
+ * Per-step callback for krfiles_sync. `action_json` is one SyncAction object
+ * (kind, path, size, reason, error), valid only during the call.
+ */
+typedef void (*krfiles_sync_cb)(void* user_data, const char* action_json);
+
+/*
+ * Per-operation callback for krfiles_batch. `result_json` is one BatchResult
+ * object (index, ok, error, status), valid only during the call.
+ */
+typedef void (*krfiles_batch_cb)(void* user_data, const char* result_json);
+
+/*
+ * Per-request callback for krfiles_set_trace_callback. `trace_json` is one
+ * RequestTrace object (endpoint, path, status, bytesSent, bytesReceived,
+ * headersMillis, totalMillis, error), valid only during the call.
+ */
+typedef void (*krfiles_trace_cb)(void* user_data, const char* trace_json);
+
+/* Flags for krfiles_sync; the default (0) pushes local changes to the server. */
+#define KRFILES_SYNC_PULL    1  /* make the local tree match the remote one */
+#define KRFILES_SYNC_DRY_RUN 2  /* only plan; the report lists what would be done */
+#define KRFILES_SYNC_RESCAN  4  /* ignore the manifest and list every remote directory */
+
+/* Flags for krfiles_download_file_ex and krfiles_upload_file_ex. */
+#define KRFILES_TRANSFER_RESUME         1  /* download: continue an existing local file */
+#define KRFILES_TRANSFER_VERIFY         2  /* download: check the file against the server's SHA-256 */
+#define KRFILES_TRANSFER_OVERRIDE       4  /* upload: replace an existing remote file */
+#define KRFILES_TRANSFER_SKIP_IDENTICAL 8  /* upload: send nothing if the remote file has the same SHA-256 */
+
+/* --- Lifecycle --- */
+
+krfiles_client* krfiles_client_new(const char* base_url);
+/*
+ * Like krfiles_client_new, with a metadata cache for krfiles_get_resource and
+ * krfiles_list_directory: up to `max_entries` paths, each served for `ttl_ms`
+ * before the server is asked again. With `persistent` set the cache is
+ * loaded from and saved to ~/.config/krfiles/metadata.json. Returns NULL on
+ * invalid arguments.
+ */
+krfiles_client* krfiles_client_new_cached(const char* base_url, int max_entries, long long ttl_ms,
+                                          bool persistent);
+/*
+ * Like krfiles_client_new, configured by `config_json`: a JSON object with
+ * any of connectTimeoutMillis (default 30000), requestTimeoutMillis,
+ * socketTimeoutMillis, maxConnections, maxConnectionsPerHost,
+ * keepAliveMillis, compressResponses (default true: gzip/deflate API
+ * responses, inflated as they arrive) and compressTransfers (default false:
+ * also accept compressed file downloads), plus cacheEntries, cacheTtlMillis
+ * and persistentCache as in krfiles_client_new_cached. A null timeout disables it; NULL config_json
+ * keeps every default. Settings the HTTP engine lacks are ignored: on Linux
+ * and macOS libcurl applies only the connect and request timeouts.
+ *
+ * The request scheduler reads maxBytesPerSecond (all transfers together) and
+ * maxTransferBytesPerSecond (each transfer), both 0 for no cap, and the
+ * adaptive concurrency bounds initialConcurrency (16), minConcurrency (1),
+ * maxConcurrency (64), interactiveReserve (4) and latencyThresholdMillis
+ * (2000).
+ *
+ * Resource lookups, listings and searches are retried on network errors and
+ * 408/429/5xx up to maxAttempts (3) times in all, after a random delay of up
+ * to retryBaseDelayMillis (100) doubling to retryMaxDelayMillis (5000); every
+ * retry spends a token from a budget of retryBudgetMax (10) that refills by
+ * retryBudgetRatio (0.1) per call. hedgeAfterMillis (null: off) sends a second
+ * request for a call still unanswered after that long and keeps the first
+ * answer. Returns NULL on invalid JSON or values.
+ */
+krfiles_client* krfiles_client_new_ex(const char* base_url, const char* config_json);
+void krfiles_client_free(krfiles_client* client);
+const char* krfiles_get_last_error(void);
+/* Cache counters as a CacheStats JSON object, or NULL if the client has no cache. */
+const char* krfiles_cache_stats(krfiles_client* client);
+
+/* --- Metrics --- */
+
+/*
+ * Request metrics as a ClientStats JSON object: per endpoint ("GET /api/raw"),
+ * counts, errors, bytes and latency histograms of the headers, body, total
+ * and decode phases, plus the time spent encoding JSON for this API and
+ * "compression": responses inflated, compressedBytes, decompressedBytes and
+ * inflateMillis, and "scheduler": concurrencyLimit, running, queuedInteractive,
+ * queuedNormal, queuedBulk, bytesTransferred, throughputBytesPerSecond,
+ * throttledMillis, congestionSignals and backoffs, and "retry": calls,
+ * retries, hedges, hedgeWins, budgetExhausted and budget.
+ */
+const char* krfiles_get_stats(krfiles_client* client);
+bool krfiles_reset_stats(krfiles_client* client);
+/*
+ * Call `callback` as each request finishes, from the thread that finished it.
+ * NULL stops tracing. `user_data` must stay valid until tracing is stopped.
+ */
+bool krfiles_set_trace_callback(krfiles_client* client, krfiles_trace_cb callback, void* user_data);
+
+/* --- Memory --- */
+
+/* Release a string returned by the library. NULL is ignored. */
+void krfiles_free_string(const char* string);
+/* Release a byte buffer allocated by the library. NULL is ignored. */
+void krfiles_free(void* data);
+
+/* --- Auth --- */
+
+const char* krfiles_login(krfiles_client* client, const char* username, const char* password);
+bool krfiles_set_token(krfiles_client* client, const char* token);
+bool krfiles_logout(krfiles_client* client);
+bool krfiles_is_authenticated(krfiles_client* client);
+
+/*
+ * --- Resources (return JSON strings, NULL on error) ---
+ *
+ * The JSON is the server's response body, passed through without being decoded
+ * and re-encoded (unless the client has a metadata cache), so fields the server
+ * omits are absent rather than defaulted. krfiles_list_next() entries likewise.
+ */
+
+const char* krfiles_get_resource(krfiles_client* client, const char* path);
+const char* krfiles_list_directory(krfiles_client* client, const char* path);
+const char* krfiles_search(krfiles_client* client, const char* query, const char* path);
+/*
+ * Like krfiles_search, delivering each result to `on_result` as soon as it is
+ * decoded instead of collecting them. After `max_results` results (0 = all),
+ * or when `on_result` returns false, the request is cancelled and the call
+ * returns true.
+ */
+bool krfiles_search_stream(krfiles_client* client, const char* query, const char* path,
+                           int max_results, krfiles_search_cb on_result, void* user_data);
+
+/*
+ * Streaming listing: entries are decoded while the response is still arriving,
+ * so memory stays bounded for huge directories. krfiles_list_next() blocks for
+ * the next entry's Resource JSON and returns NULL at the end; if the listing
+ * failed (or `path` is not a directory), krfiles_get_last_error() is non-NULL.
+ * Always release the iterator with krfiles_list_close(), which also cancels a
+ * listing that is still running. One iterator is not to be shared between
+ * threads.
+ */
+krfiles_listing* krfiles_list_open(krfiles_client* client, const char* path);
+const char* krfiles_list_next(krfiles_listing* listing);
+void krfiles_list_close(krfiles_listing* listing);
+
+/* --- File operations --- */
+
+bool krfiles_download_to_file(krfiles_client* client, const char* remote_path,
+                              const char* local_path, krfiles_progress_cb progress,
+                              void* user_data);
+/*
+ * Like krfiles_download_to_file, using HTTP range requests. With `segments` > 1
+ * the file is preallocated and fetched as that many parallel ranges (fewer for
+ * small files). With `resume`, an existing local file is continued from its
+ * current size, and on failure it is kept up to its last complete byte so the
+ * call can simply be repeated. Falls back to one stream if the server ignores
+ * Range.
+ */
+bool krfiles_download_to_file_ranged(krfiles_client* client, const char* remote_path,
+                                     const char* local_path, int segments, bool resume,
+                                     krfiles_progress_cb progress, void* user_data);
+/* chunk_size is the tus PATCH size in bytes; 0 selects the library default. */
+bool krfiles_upload_from_file(krfiles_client* client, const char* remote_path,
+                              const char* local_path, bool override_, int chunk_size,
+                              krfiles_progress_cb progress, void* user_data);
+/*
+ * Like krfiles_download_to_file_ranged, with `flags` from KRFILES_TRANSFER_*.
+ * With KRFILES_TRANSFER_VERIFY a fresh download is hashed as it is written and
+ * fetched as one stream regardless of `segments`; a resumed one is hashed from
+ * disk once complete. A file failing verification is removed and the call fails.
+ */
+bool krfiles_download_file_ex(krfiles_client* client, const char* remote_path,
+                              const char* local_path, int segments, int flags,
+                              krfiles_progress_cb progress, void* user_data);
+/*
+ * Like krfiles_upload_from_file, with `flags` from KRFILES_TRANSFER_*. Returns
+ * {"skipped": bool}, true when KRFILES_TRANSFER_SKIP_IDENTICAL found the same
+ * size and SHA-256 on the server; NULL on failure.
+ */
+const char* krfiles_upload_file_ex(krfiles_client* client, const char* remote_path,
+                                   const char* local_path, int flags, int chunk_size,
+                                   krfiles_progress_cb progress, void* user_data);
+/* The server's SHA-256 of a file as lowercase hex; it reads the whole file to compute it. */
+const char* krfiles_checksum(krfiles_client* client, const char* path);
+bool krfiles_create_directory(krfiles_client* client, const char* path);
+bool krfiles_delete(krfiles_client* client, const char* path);
+bool krfiles_rename(krfiles_client* client, const char* source, const char* destination,
+                    bool override_);
+bool krfiles_copy(krfiles_client* client, const char* source, const char* destination,
+                  bool override_);
+
+/* --- In-memory transfers --- */
+
+/*
+ * Download into the caller's `buffer` of `capacity` bytes. `*out_length` receives
+ * the bytes written, or -1 if the file did not fit (the call then fails).
+ */
+bool krfiles_download_to_buffer(krfiles_client* client, const char* remote_path, void* buffer,
+                                long long capacity, long long* out_length,
+                                krfiles_progress_cb progress, void* user_data);
+/*
+ * Download into a buffer the library allocates. On success `*out_data` points at
+ * `*out_length` bytes (NULL for an empty file); release it with krfiles_free().
+ */
+bool krfiles_download_to_memory(krfiles_client* client, const char* remote_path,
+                                void** out_data, long long* out_length,
+                                krfiles_progress_cb progress, void* user_data);
+/* Upload `length` bytes at `data` in resumable chunks; chunk_size 0 = default. */
+bool krfiles_upload_from_buffer(krfiles_client* client, const char* remote_path,
+                                const void* data, long long length, bool override_,
+                                int chunk_size, krfiles_progress_cb progress, void* user_data);
+
+/* --- Descriptor transfers --- */
+
+/*
+ * For pipes such as stdin and stdout: the descriptor is read or written in order,
+ * never seeked, and never closed. Download writes each chunk to `fd` as it arrives.
+ */
+bool krfiles_download_to_fd(krfiles_client* client, const char* remote_path, int fd,
+                            krfiles_progress_cb progress, void* user_data);
+/*
+ * Upload exactly `size` bytes read from `fd` in resumable chunks, holding only
+ * the read-ahead in memory; chunk_size 0 = default. Fails if `fd` ends early or
+ * has more than `size` bytes.
+ */
+bool krfiles_upload_from_fd(krfiles_client* client, const char* remote_path, int fd,
+                            long long size, bool override_, int chunk_size,
+                            krfiles_progress_cb progress, void* user_data);
+
+/* --- Tree walking --- */
+
+/*
+ * Recursively walk the tree under `root`, listing up to `concurrency` directories
+ * in parallel (0 = library default). `on_entry` is called once per entry, never
+ * concurrently, in discovery order. Returns false on the first listing error.
+ */
+bool krfiles_walk(krfiles_client* client, const char* root, int concurrency,
+                  krfiles_walk_cb on_entry, void* user_data);
+
+/* --- Directory sync --- */
+
+/*
+ * Transfer files that differ (by size, or newer mtime on the source side) between
+ * `local_root` and `remote_root`, up to `concurrency` at a time (0 = default).
+ * Remote state is cached in `.krfiles-sync.json` under `local_root`, so
+ * directories whose timestamp is unchanged are not listed again. `on_action`
+ * (may be NULL) is called after each step, never concurrently. Returns the
+ * SyncReport JSON (free with krfiles_free_string), or NULL if the sync could not
+ * run; failed steps are reported in the JSON and do not fail the call.
+ */
+const char* krfiles_sync(krfiles_client* client, const char* local_root, const char* remote_root,
+                         int flags, int concurrency, krfiles_sync_cb on_action, void* user_data);
+
+/* --- Directory archives --- */
+
+/*
+ * Download `remote_path` (usually a directory) as a single archive into
+ * `local_path`. `format` is "zip", "tar" or "targz"; the server builds the
+ * archive on the fly, so `progress` gets -1 as the total.
+ */
+bool krfiles_download_archive(krfiles_client* client, const char* remote_path,
+                              const char* local_path, const char* format,
+                              krfiles_progress_cb progress, void* user_data);
+/*
+ * Download the directory `remote_path` as a tar stream and unpack it into
+ * `local_dir` (created if missing) as it arrives, without storing the archive;
+ * one request replaces one per file. Entries are placed relative to
+ * `remote_path`. `filter_json` (may be NULL) is an ArchiveFilter object such as
+ * {"include": ["*.jpg"], "exclude": ["thumbs"]}. `progress` counts bytes
+ * written. Returns the ExtractReport JSON, or NULL on failure.
+ */
+const char* krfiles_extract_archive(krfiles_client* client, const char* remote_path,
+                                    const char* local_dir, const char* filter_json,
+                                    krfiles_progress_cb progress, void* user_data);
+
+/* --- Batch operations --- */
+
+/*
+ * Run a JSON array of operations such as
+ * `[{"op":"delete","path":"/a"},{"op":"rename","path":"/b","destination":"/c"}]`
+ * (ops: delete, rename, copy, mkdir; optional "override") with up to
+ * `concurrency` requests in flight (0 = default). Operations may finish in any
+ * order unless `concurrency` is 1. With `stop_on_error`, operations not yet
+ * started when one fails are skipped. `on_result` (may be NULL) is called as
+ * each finishes, never concurrently. Returns the BatchReport JSON (free with
+ * krfiles_free_string), or NULL if the batch could not run; failed operations
+ * are reported in the JSON and do not fail the call.
+ */
+const char* krfiles_batch(krfiles_client* client, const char* operations_json, int concurrency,
+                          bool stop_on_error, krfiles_batch_cb on_result, void* user_data);
+
+/*
+ * --- Async variants ---
+ *
+ * Non-blocking versions of the calls above. They submit the operation to the
+ * library's coroutine dispatcher and return immediately; the outcome arrives via
+ * `done`. They return false only if the operation could not be submitted (see
+ * krfiles_get_last_error()), in which case `done` is never called. Transfer
+ * progress callbacks run on the library thread with the same `user_data`,
+ * always before `done`.
+ */
+
+bool krfiles_login_async(krfiles_client* client, const char* username, const char* password,
+                         krfiles_completion_cb done, void* user_data);
+bool krfiles_get_resource_async(krfiles_client* client, const char* path,
+                                krfiles_completion_cb done, void* user_data);
+bool krfiles_list_directory_async(krfiles_client* client, const char* path,
+                                  krfiles_completion_cb done, void* user_data);
+bool krfiles_search_async(krfiles_client* client, const char* query, const char* path,
+                          krfiles_completion_cb done, void* user_data);
+/* `on_result` runs on a library thread, always before `done`. */
+bool krfiles_search_stream_async(krfiles_client* client, const char* query, const char* path,
+                                 int max_results, krfiles_search_cb on_result,
+                                 krfiles_completion_cb done, void* user_data);
+bool krfiles_download_to_file_async(krfiles_client* client, const char* remote_path,
+                                    const char* local_path, krfiles_progress_cb progress,
+                                    krfiles_completion_cb done, void* user_data);
+bool krfiles_download_to_file_ranged_async(krfiles_client* client, const char* remote_path,
+                                           const char* local_path, int segments, bool resume,
+                                           krfiles_progress_cb progress,
+                                           krfiles_completion_cb done, void* user_data);
+bool krfiles_upload_from_file_async(krfiles_client* client, const char* remote_path,
+                                    const char* local_path, bool override_, int chunk_size,
+                                    krfiles_progress_cb progress, krfiles_completion_cb done,
+                                    void* user_data);
+bool krfiles_download_file_ex_async(krfiles_client* client, const char* remote_path,
+                                    const char* local_path, int segments, int flags,
+                                    krfiles_progress_cb progress, krfiles_completion_cb done,
+                                    void* user_data);
+bool krfiles_upload_file_ex_async(krfiles_client* client, const char* remote_path,
+                                  const char* local_path, int flags, int chunk_size,
+                                  krfiles_progress_cb progress, krfiles_completion_cb done,
+                                  void* user_data);
+bool krfiles_checksum_async(krfiles_client* client, const char* path, krfiles_completion_cb done,
+                            void* user_data);
+bool krfiles_create_directory_async(krfiles_client* client, const char* path,
+                                    krfiles_completion_cb done, void* user_data);
+bool krfiles_delete_async(krfiles_client* client, const char* path, krfiles_completion_cb done,
+                          void* user_data);
+bool krfiles_rename_async(krfiles_client* client, const char* source, const char* destination,
+                          bool override_, krfiles_completion_cb done, void* user_data);
+bool krfiles_copy_async(krfiles_client* client, const char* source, const char* destination,
+                        bool override_, krfiles_completion_cb done, void* user_data);
+/* Buffers and out-pointers must stay valid until `done` has been called. */
+bool krfiles_download_to_buffer_async(krfiles_client* client, const char* remote_path,
+                                      void* buffer, long long capacity, long long* out_length,
+                                      krfiles_progress_cb progress, krfiles_completion_cb done,
+                                      void* user_data);
+bool krfiles_download_to_memory_async(krfiles_client* client, const char* remote_path,
+                                      void** out_data, long long* out_length,
+                                      krfiles_progress_cb progress, krfiles_completion_cb done,
+                                      void* user_data);
+bool krfiles_upload_from_buffer_async(krfiles_client* client, const char* remote_path,
+                                      const void* data, long long length, bool override_,
+                                      int chunk_size, krfiles_progress_cb progress,
+                                      krfiles_completion_cb done, void* user_data);
+/* `fd` must stay open until `done` has been called. */
+bool krfiles_download_to_fd_async(krfiles_client* client, const char* remote_path, int fd,
+                                  krfiles_progress_cb progress, krfiles_completion_cb done,
+                                  void* user_data);
+bool krfiles_upload_from_fd_async(krfiles_client* client, const char* remote_path, int fd,
+                                  long long size, bool override_, int chunk_size,
+                                  krfiles_progress_cb progress, krfiles_completion_cb done,
+                                  void* user_data);
+/* `on_entry` runs on a library thread, always before `done`. */
+bool krfiles_walk_async(krfiles_client* client, const char* root, int concurrency,
+                        krfiles_walk_cb on_entry, krfiles_completion_cb done, void* user_data);
+/* `on_action` runs on a library thread, always before `done`. */
+bool krfiles_sync_async(krfiles_client* client, const char* local_root, const char* remote_root,
+                        int flags, int concurrency, krfiles_sync_cb on_action,
+                        krfiles_completion_cb done, void* user_data);
+bool krfiles_download_archive_async(krfiles_client* client, const char* remote_path,
+                                    const char* local_path, const char* format,
+                                    krfiles_progress_cb progress, krfiles_completion_cb done,
+                                    void* user_data);
+bool krfiles_extract_archive_async(krfiles_client* client, const char* remote_path,
+                                   const char* local_dir, const char* filter_json,
+                                   krfiles_progress_cb progress, krfiles_completion_cb done,
+                                   void* user_data);
+/* `on_result` runs on a library thread, always before `done`. */
+bool krfiles_batch_async(krfiles_client* client, const char* operations_json, int concurrency,
+                         bool stop_on_error, krfiles_batch_cb on_result,
+                         krfiles_completion_cb done, void* user_data);
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif  /* KRFILES_H */
@@ -4,22 +4,27 @@
  * Kotlin/Native exports all symbols through a single vtable struct accessed
  * via libkrfiles_symbols(). This shim provides flat C functions that Rust
  * can call directly with extern "C", avoiding the need to replicate the
- * deeply nested vtable layout in Rust.
+ * deeply nested vtable layout in Rust. The functions are declared in krfiles.h.
  *
  * Each function here simply forwards to the corresponding vtable entry.
  */
 
+#include "krfiles.h"
 #include "libkrfiles_api.h"
-#include <stdbool.h>
+#include <pthread.h>
 #include <stddef.h>
+#include <stdlib.h>
 
-/* Cached pointer to the vtable — initialized on first use. */
+/* Pointer to the vtable, initialized exactly once even under concurrent first calls. */
 static libkrfiles_ExportedSymbols* sym = NULL;
+static pthread_once_t sym_once = PTHREAD_ONCE_INIT;
+
+static void init_symbols(void) {
+    sym = libkrfiles_symbols();
+}
 
 static void ensure_init(void) {
-    if (!sym) {
-        sym = libkrfiles_symbols();
-    }
+    pthread_once(&sym_once, init_symbols);
 }
 
 /* Shorthand for the deeply nested path to our functions. */
@@ -27,14 +32,30 @@ static void ensure_init(void) {
 
 /* --- Lifecycle --- */
 
-void krfiles_create_client(const char* base_url) {
+krfiles_client* krfiles_client_new(const char* base_url) {
+    ensure_init();
+    return (krfiles_client*)KR.nativeClientNew(base_url);
+}
+
+krfiles_client* krfiles_client_new_cached(const char* base_url, int max_entries, long long ttl_ms,
+                                          bool persistent) {
+    ensure_init();
+    return (krfiles_client*)KR.nativeClientNewCached(base_url, max_entries, ttl_ms, persistent);
+}
+
+krfiles_client* krfiles_client_new_ex(const char* base_url, const char* config_json) {
+    ensure_init();
+    return (krfiles_client*)KR.nativeClientNewEx(base_url, config_json);
+}
+
+void krfiles_client_free(krfiles_client* client) {
     ensure_init();
-    KR.nativeCreateClient(base_url);
+    KR.nativeClientFree(client);
 }
 
-void krfiles_destroy_client(void) {
+const char* krfiles_cache_stats(krfiles_client* client) {
     ensure_init();
-    KR.nativeDestroyClient();
+    return KR.nativeCacheStats(client);
 }
 
 const char* krfiles_get_last_error(void) {
@@ -42,73 +63,440 @@ const char* krfiles_get_last_error(void) {
     return KR.nativeGetLastError();
 }
 
+/* --- Metrics --- */
+
+const char* krfiles_get_stats(krfiles_client* client) {
+    ensure_init();
+    return KR.nativeGetStats(client);
+}
+
+bool krfiles_reset_stats(krfiles_client* client) {
+    ensure_init();
+    return KR.nativeResetStats(client);
+}
+
+bool krfiles_set_trace_callback(krfiles_client* client, krfiles_trace_cb callback, void* user_data) {
+    ensure_init();
+    return KR.nativeSetTraceCallback(client, (void*)callback, user_data);
+}
+
+/* --- Memory --- */
+
+void krfiles_free_string(const char* string) {
+    if (string == NULL) return;
+    ensure_init();
+    sym->DisposeString(string);
+}
+
+/* Library buffers come from Kotlin's platform.posix.malloc, i.e. this libc. */
+void krfiles_free(void* data) {
+    free(data);
+}
+
 /* --- Auth --- */
 
-const char* krfiles_login(const char* username, const char* password) {
+const char* krfiles_login(krfiles_client* client, const char* username, const char* password) {
     ensure_init();
-    return KR.nativeLogin(username, password);
+    return KR.nativeLogin(client, username, password);
 }
 
-bool krfiles_set_token(const char* token) {
+bool krfiles_set_token(krfiles_client* client, const char* token) {
     ensure_init();
-    return KR.nativeSetToken(token);
+    return KR.nativeSetToken(client, token);
 }
 
-bool krfiles_logout(void) {
+bool krfiles_logout(krfiles_client* client) {
     ensure_init();
-    return KR.nativeLogout();
+    return KR.nativeLogout(client);
 }
 
-bool krfiles_is_authenticated(void) {
+bool krfiles_is_authenticated(krfiles_client* client) {
     ensure_init();
-    return KR.nativeIsAuthenticated();
+    return KR.nativeIsAuthenticated(client);
 }
 
 /* --- Resources (return JSON strings) --- */
 
-const char* krfiles_get_resource(const char* path) {
+const char* krfiles_get_resource(krfiles_client* client, const char* path) {
+    ensure_init();
+    return KR.nativeGetResource(client, path);
+}
+
+const char* krfiles_list_directory(krfiles_client* client, const char* path) {
+    ensure_init();
+    return KR.nativeListDirectory(client, path);
+}
+
+const char* krfiles_search(krfiles_client* client, const char* query, const char* path) {
+    ensure_init();
+    return KR.nativeSearch(client, query, path);
+}
+
+bool krfiles_search_stream(krfiles_client* client, const char* query, const char* path,
+                           int max_results, krfiles_search_cb on_result, void* user_data) {
     ensure_init();
-    return KR.nativeGetResource(path);
+    return KR.nativeSearchStream(client, query, path, max_results, (void*)on_result, user_data);
 }
 
-const char* krfiles_list_directory(const char* path) {
+krfiles_listing* krfiles_list_open(krfiles_client* client, const char* path) {
     ensure_init();
-    return KR.nativeListDirectory(path);
+    return KR.nativeListOpen(client, path);
 }
 
-const char* krfiles_search(const char* query, const char* path) {
+const char* krfiles_list_next(krfiles_listing* listing) {
     ensure_init();
-    return KR.nativeSearch(query, path);
+    return KR.nativeListNext(listing);
+}
+
+void krfiles_list_close(krfiles_listing* listing) {
+    ensure_init();
+    KR.nativeListClose(listing);
 }
 
 /* --- File operations --- */
 
-bool krfiles_download_to_file(const char* remote_path, const char* local_path) {
+bool krfiles_download_to_file(krfiles_client* client, const char* remote_path,
+                              const char* local_path, krfiles_progress_cb progress,
+                              void* user_data) {
+    ensure_init();
+    return KR.nativeDownloadToFile(client, remote_path, local_path, 1, false, (void*)progress,
+                                   user_data);
+}
+
+bool krfiles_download_to_file_ranged(krfiles_client* client, const char* remote_path,
+                                     const char* local_path, int segments, bool resume,
+                                     krfiles_progress_cb progress, void* user_data) {
+    ensure_init();
+    return KR.nativeDownloadToFile(client, remote_path, local_path, segments, resume,
+                                   (void*)progress, user_data);
+}
+
+bool krfiles_upload_from_file(krfiles_client* client, const char* remote_path,
+                              const char* local_path, bool override_, int chunk_size,
+                              krfiles_progress_cb progress, void* user_data) {
+    ensure_init();
+    return KR.nativeUploadFromFile(client, remote_path, local_path, override_, chunk_size,
+                                   (void*)progress, user_data);
+}
+
+bool krfiles_download_file_ex(krfiles_client* client, const char* remote_path,
+                              const char* local_path, int segments, int flags,
+                              krfiles_progress_cb progress, void* user_data) {
+    ensure_init();
+    return KR.nativeDownloadFileEx(client, remote_path, local_path, segments, flags,
+                                   (void*)progress, user_data);
+}
+
+const char* krfiles_upload_file_ex(krfiles_client* client, const char* remote_path,
+                                   const char* local_path, int flags, int chunk_size,
+                                   krfiles_progress_cb progress, void* user_data) {
+    ensure_init();
+    return KR.nativeUploadFileEx(client, remote_path, local_path, flags, chunk_size,
+                                 (void*)progress, user_data);
+}
+
+const char* krfiles_checksum(krfiles_client* client, const char* path) {
+    ensure_init();
+    return KR.nativeChecksum(client, path);
+}
+
+bool krfiles_create_directory(krfiles_client* client, const char* path) {
+    ensure_init();
+    return KR.nativeCreateDirectory(client, path);
+}
+
+bool krfiles_delete(krfiles_client* client, const char* path) {
+    ensure_init();
+    return KR.nativeDelete(client, path);
+}
+
+bool krfiles_rename(krfiles_client* client, const char* source, const char* destination,
+                    bool override_) {
+    ensure_init();
+    return KR.nativeRename(client, source, destination, override_);
+}
+
+bool krfiles_copy(krfiles_client* client, const char* source, const char* destination,
+                  bool override_) {
+    ensure_init();
+    return KR.nativeCopy(client, source, destination, override_);
+}
+
+/* --- In-memory transfers --- */
+
+bool krfiles_download_to_buffer(krfiles_client* client, const char* remote_path, void* buffer,
+                                long long capacity, long long* out_length,
+                                krfiles_progress_cb progress, void* user_data) {
+    ensure_init();
+    return KR.nativeDownloadToBuffer(client, remote_path, buffer, capacity, out_length,
+                                     (void*)progress, user_data);
+}
+
+bool krfiles_download_to_memory(krfiles_client* client, const char* remote_path,
+                                void** out_data, long long* out_length,
+                                krfiles_progress_cb progress, void* user_data) {
+    ensure_init();
+    return KR.nativeDownloadToMemory(client, remote_path, out_data, out_length, (void*)progress,
+                                     user_data);
+}
+
+bool krfiles_upload_from_buffer(krfiles_client* client, const char* remote_path,
+                                const void* data, long long length, bool override_,
+                                int chunk_size, krfiles_progress_cb progress, void* user_data) {
+    ensure_init();
+    /* The library only reads through `data`; the cast drops const for the vtable. */
+    return KR.nativeUploadFromBuffer(client, remote_path, (void*)data, length, override_,
+                                     chunk_size, (void*)progress, user_data);
+}
+
+/* --- Descriptor transfers --- */
+
+bool krfiles_download_to_fd(krfiles_client* client, const char* remote_path, int fd,
+                            krfiles_progress_cb progress, void* user_data) {
+    ensure_init();
+    return KR.nativeDownloadToFd(client, remote_path, fd, (void*)progress, user_data);
+}
+
+bool krfiles_upload_from_fd(krfiles_client* client, const char* remote_path, int fd,
+                            long long size, bool override_, int chunk_size,
+                            krfiles_progress_cb progress, void* user_data) {
+    ensure_init();
+    return KR.nativeUploadFromFd(client, remote_path, fd, size, override_, chunk_size,
+                                 (void*)progress, user_data);
+}
+
+/* --- Tree walking --- */
+
+bool krfiles_walk(krfiles_client* client, const char* root, int concurrency,
+                  krfiles_walk_cb on_entry, void* user_data) {
+    ensure_init();
+    return KR.nativeWalk(client, root, concurrency, (void*)on_entry, user_data);
+}
+
+/* --- Directory sync --- */
+
+const char* krfiles_sync(krfiles_client* client, const char* local_root, const char* remote_root,
+                         int flags, int concurrency, krfiles_sync_cb on_action, void* user_data) {
+    ensure_init();
+    return KR.nativeSync(client, local_root, remote_root, flags, concurrency, (void*)on_action,
+                         user_data);
+}
+
+/* --- Directory archives --- */
+
+bool krfiles_download_archive(krfiles_client* client, const char* remote_path,
+                              const char* local_path, const char* format,
+                              krfiles_progress_cb progress, void* user_data) {
+    ensure_init();
+    return KR.nativeDownloadArchive(client, remote_path, local_path, format, (void*)progress,
+                                    user_data);
+}
+
+const char* krfiles_extract_archive(krfiles_client* client, const char* remote_path,
+                                    const char* local_dir, const char* filter_json,
+                                    krfiles_progress_cb progress, void* user_data) {
+    ensure_init();
+    return KR.nativeExtractArchive(client, remote_path, local_dir, filter_json, (void*)progress,
+                                   user_data);
+}
+
+/* --- Batch operations --- */
+
+const char* krfiles_batch(krfiles_client* client, const char* operations_json, int concurrency,
+                          bool stop_on_error, krfiles_batch_cb on_result, void* user_data) {
+    ensure_init();
+    return KR.nativeBatch(client, operations_json, concurrency, stop_on_error, (void*)on_result,
+                          user_data);
+}
+
+/* --- Async variants (complete via krfiles_completion_cb) --- */
+
+bool krfiles_login_async(krfiles_client* client, const char* username, const char* password,
+                         krfiles_completion_cb done, void* user_data) {
+    ensure_init();
+    return KR.nativeLoginAsync(client, username, password, (void*)done, user_data);
+}
+
+bool krfiles_get_resource_async(krfiles_client* client, const char* path,
+                                krfiles_completion_cb done, void* user_data) {
+    ensure_init();
+    return KR.nativeGetResourceAsync(client, path, (void*)done, user_data);
+}
+
+bool krfiles_list_directory_async(krfiles_client* client, const char* path,
+                                  krfiles_completion_cb done, void* user_data) {
+    ensure_init();
+    return KR.nativeListDirectoryAsync(client, path, (void*)done, user_data);
+}
+
+bool krfiles_search_async(krfiles_client* client, const char* query, const char* path,
+                          krfiles_completion_cb done, void* user_data) {
+    ensure_init();
+    return KR.nativeSearchAsync(client, query, path, (void*)done, user_data);
+}
+
+bool krfiles_search_stream_async(krfiles_client* client, const char* query, const char* path,
+                                 int max_results, krfiles_search_cb on_result,
+                                 krfiles_completion_cb done, void* user_data) {
+    ensure_init();
+    return KR.nativeSearchStreamAsync(client, query, path, max_results, (void*)on_result,
+                                      (void*)done, user_data);
+}
+
+bool krfiles_download_to_file_async(krfiles_client* client, const char* remote_path,
+                                    const char* local_path, krfiles_progress_cb progress,
+                                    krfiles_completion_cb done, void* user_data) {
+    ensure_init();
+    return KR.nativeDownloadToFileAsync(client, remote_path, local_path, 1, false,
+                                        (void*)progress, (void*)done, user_data);
+}
+
+bool krfiles_download_to_file_ranged_async(krfiles_client* client, const char* remote_path,
+                                           const char* local_path, int segments, bool resume,
+                                           krfiles_progress_cb progress,
+                                           krfiles_completion_cb done, void* user_data) {
+    ensure_init();
+    return KR.nativeDownloadToFileAsync(client, remote_path, local_path, segments, resume,
+                                        (void*)progress, (void*)done, user_data);
+}
+
+bool krfiles_upload_from_file_async(krfiles_client* client, const char* remote_path,
+                                    const char* local_path, bool override_, int chunk_size,
+                                    krfiles_progress_cb progress, krfiles_completion_cb done,
+                                    void* user_data) {
+    ensure_init();
+    return KR.nativeUploadFromFileAsync(client, remote_path, local_path, override_, chunk_size,
+                                        (void*)progress, (void*)done, user_data);
+}
+
+bool krfiles_download_file_ex_async(krfiles_client* client, const char* remote_path,
+                                    const char* local_path, int segments, int flags,
+                                    krfiles_progress_cb progress, krfiles_completion_cb done,
+                                    void* user_data) {
+    ensure_init();
+    return KR.nativeDownloadFileExAsync(client, remote_path, local_path, segments, flags,
+                                        (void*)progress, (void*)done, user_data);
+}
+
+bool krfiles_upload_file_ex_async(krfiles_client* client, const char* remote_path,
+                                  const char* local_path, int flags, int chunk_size,
+                                  krfiles_progress_cb progress, krfiles_completion_cb done,
+                                  void* user_data) {
+    ensure_init();
+    return KR.nativeUploadFileExAsync(client, remote_path, local_path, flags, chunk_size,
+                                      (void*)progress, (void*)done, user_data);
+}
+
+bool krfiles_checksum_async(krfiles_client* client, const char* path, krfiles_completion_cb done,
+                            void* user_data) {
+    ensure_init();
+    return KR.nativeChecksumAsync(client, path, (void*)done, user_data);
+}
+
+bool krfiles_create_directory_async(krfiles_client* client, const char* path,
+                                    krfiles_completion_cb done, void* user_data) {
+    ensure_init();
+    return KR.nativeCreateDirectoryAsync(client, path, (void*)done, user_data);
+}
+
+bool krfiles_delete_async(krfiles_client* client, const char* path, krfiles_completion_cb done,
+                          void* user_data) {
+    ensure_init();
+    return KR.nativeDeleteAsync(client, path, (void*)done, user_data);
+}
+
+bool krfiles_rename_async(krfiles_client* client, const char* source, const char* destination,
+                          bool override_, krfiles_completion_cb done, void* user_data) {
+    ensure_init();
+    return KR.nativeRenameAsync(client, source, destination, override_, (void*)done, user_data);
+}
+
+bool krfiles_copy_async(krfiles_client* client, const char* source, const char* destination,
+                        bool override_, krfiles_completion_cb done, void* user_data) {
+    ensure_init();
+    return KR.nativeCopyAsync(client, source, destination, override_, (void*)done, user_data);
+}
+
+bool krfiles_download_to_buffer_async(krfiles_client* client, const char* remote_path,
+                                      void* buffer, long long capacity, long long* out_length,
+                                      krfiles_progress_cb progress, krfiles_completion_cb done,
+                                      void* user_data) {
+    ensure_init();
+    return KR.nativeDownloadToBufferAsync(client, remote_path, buffer, capacity, out_length,
+                                          (void*)progress, (void*)done, user_data);
+}
+
+bool krfiles_download_to_memory_async(krfiles_client* client, const char* remote_path,
+                                      void** out_data, long long* out_length,
+                                      krfiles_progress_cb progress, krfiles_completion_cb done,
+                                      void* user_data) {
+    ensure_init();
+    return KR.nativeDownloadToMemoryAsync(client, remote_path, out_data, out_length,
+                                          (void*)progress, (void*)done, user_data);
+}
+
+bool krfiles_upload_from_buffer_async(krfiles_client* client, const char* remote_path,
+                                      const void* data, long long length, bool override_,
+                                      int chunk_size, krfiles_progress_cb progress,
+                                      krfiles_completion_cb done, void* user_data) {
+    ensure_init();
+    return KR.nativeUploadFromBufferAsync(client, remote_path, (void*)data, length, override_,
+                                          chunk_size, (void*)progress, (void*)done, user_data);
+}
+
+bool krfiles_download_to_fd_async(krfiles_client* client, const char* remote_path, int fd,
+                                  krfiles_progress_cb progress, krfiles_completion_cb done,
+                                  void* user_data) {
+    ensure_init();
+    return KR.nativeDownloadToFdAsync(client, remote_path, fd, (void*)progress, (void*)done,
+                                      user_data);
+}
+
+bool krfiles_upload_from_fd_async(krfiles_client* client, const char* remote_path, int fd,
+                                  long long size, bool override_, int chunk_size,
+                                  krfiles_progress_cb progress, krfiles_completion_cb done,
+                                  void* user_data) {
     ensure_init();
-    return KR.nativeDownloadToFile(remote_path, local_path);
+    return KR.nativeUploadFromFdAsync(client, remote_path, fd, size, override_, chunk_size,
+                                      (void*)progress, (void*)done, user_data);
 }
 
-bool krfiles_upload_from_file(const char* remote_path, const char* local_path, bool override_) {
+bool krfiles_walk_async(krfiles_client* client, const char* root, int concurrency,
+                        krfiles_walk_cb on_entry, krfiles_completion_cb done, void* user_data) {
     ensure_init();
-    return KR.nativeUploadFromFile(remote_path, local_path, override_);
+    return KR.nativeWalkAsync(client, root, concurrency, (void*)on_entry, (void*)done, user_data);
 }
 
-bool krfiles_create_directory(const char* path) {
+bool krfiles_sync_async(krfiles_client* client, const char* local_root, const char* remote_root,
+                        int flags, int concurrency, krfiles_sync_cb on_action,
+                        krfiles_completion_cb done, void* user_data) {
     ensure_init();
-    return KR.nativeCreateDirectory(path);
+    return KR.nativeSyncAsync(client, local_root, remote_root, flags, concurrency,
+                              (void*)on_action, (void*)done, user_data);
 }
 
-bool krfiles_delete(const char* path) {
+bool krfiles_download_archive_async(krfiles_client* client, const char* remote_path,
+                                    const char* local_path, const char* format,
+                                    krfiles_progress_cb progress, krfiles_completion_cb done,
+                                    void* user_data) {
     ensure_init();
-    return KR.nativeDelete(path);
+    return KR.nativeDownloadArchiveAsync(client, remote_path, local_path, format, (void*)progress,
+                                         (void*)done, user_data);
 }
 
-bool krfiles_rename(const char* source, const char* destination, bool override_) {
+bool krfiles_extract_archive_async(krfiles_client* client, const char* remote_path,
+                                   const char* local_dir, const char* filter_json,
+                                   krfiles_progress_cb progress, krfiles_completion_cb done,
+                                   void* user_data) {
     ensure_init();
-    return KR.nativeRename(source, destination, override_);
+    return KR.nativeExtractArchiveAsync(client, remote_path, local_dir, filter_json,
+                                        (void*)progress, (void*)done, user_data);
 }
 
-bool krfiles_copy(const char* source, const char* destination, bool override_) {
+bool krfiles_batch_async(krfiles_client* client, const char* operations_json, int concurrency,
+                         bool stop_on_error, krfiles_batch_cb on_result,
+                         krfiles_completion_cb done, void* user_data) {
     ensure_init();
-    return KR.nativeCopy(source, destination, override_);
+    return KR.nativeBatchAsync(client, operations_json, concurrency, stop_on_error,
+                               (void*)on_result, (void*)done, user_data);
 }
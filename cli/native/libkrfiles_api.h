@@ -476,22 +476,69 @@ typedef struct {
               const char* (*get_errorMessage)(libkrfiles_kref_dev_rolandh_krfiles_FilebrowserException thiz);
               libkrfiles_KInt (*get_statusCode)(libkrfiles_kref_dev_rolandh_krfiles_FilebrowserException thiz);
             } FilebrowserException;
-            libkrfiles_KBoolean (*nativeCopy)(const char* source, const char* destination, libkrfiles_KBoolean override_);
-            void (*nativeCreateClient)(const char* baseUrl);
-            libkrfiles_KBoolean (*nativeCreateDirectory)(const char* path);
-            libkrfiles_KBoolean (*nativeDelete)(const char* path);
-            void (*nativeDestroyClient)();
-            libkrfiles_KBoolean (*nativeDownloadToFile)(const char* remotePath, const char* localPath);
+            const char* (*nativeBatch)(void* handle, const char* operationsJson, libkrfiles_KInt concurrency, libkrfiles_KBoolean stopOnError, void* onResult, void* userData);
+            libkrfiles_KBoolean (*nativeBatchAsync)(void* handle, const char* operationsJson, libkrfiles_KInt concurrency, libkrfiles_KBoolean stopOnError, void* onResult, void* callback, void* userData);
+            const char* (*nativeCacheStats)(void* handle);
+            const char* (*nativeChecksum)(void* handle, const char* path);
+            libkrfiles_KBoolean (*nativeChecksumAsync)(void* handle, const char* path, void* callback, void* userData);
+            void (*nativeClientFree)(void* handle);
+            void* (*nativeClientNew)(const char* baseUrl);
+            void* (*nativeClientNewCached)(const char* baseUrl, libkrfiles_KInt maxEntries, libkrfiles_KLong ttlMillis, libkrfiles_KBoolean persistent);
+            void* (*nativeClientNewEx)(const char* baseUrl, const char* configJson);
+            libkrfiles_KBoolean (*nativeCopy)(void* handle, const char* source, const char* destination, libkrfiles_KBoolean override_);
+            libkrfiles_KBoolean (*nativeCopyAsync)(void* handle, const char* source, const char* destination, libkrfiles_KBoolean override_, void* callback, void* userData);
+            libkrfiles_KBoolean (*nativeCreateDirectory)(void* handle, const char* path);
+            libkrfiles_KBoolean (*nativeCreateDirectoryAsync)(void* handle, const char* path, void* callback, void* userData);
+            libkrfiles_KBoolean (*nativeDelete)(void* handle, const char* path);
+            libkrfiles_KBoolean (*nativeDeleteAsync)(void* handle, const char* path, void* callback, void* userData);
+            libkrfiles_KBoolean (*nativeDownloadArchive)(void* handle, const char* remotePath, const char* localPath, const char* format, void* progress, void* userData);
+            libkrfiles_KBoolean (*nativeDownloadArchiveAsync)(void* handle, const char* remotePath, const char* localPath, const char* format, void* progress, void* callback, void* userData);
+            libkrfiles_KBoolean (*nativeDownloadFileEx)(void* handle, const char* remotePath, const char* localPath, libkrfiles_KInt segments, libkrfiles_KInt flags, void* progress, void* userData);
+            libkrfiles_KBoolean (*nativeDownloadFileExAsync)(void* handle, const char* remotePath, const char* localPath, libkrfiles_KInt segments, libkrfiles_KInt flags, void* progress, void* callback, void* userData);
+            libkrfiles_KBoolean (*nativeDownloadToBuffer)(void* handle, const char* remotePath, void* buffer, libkrfiles_KLong capacity, void* outLength, void* progress, void* userData);
+            libkrfiles_KBoolean (*nativeDownloadToBufferAsync)(void* handle, const char* remotePath, void* buffer, libkrfiles_KLong capacity, void* outLength, void* progress, void* callback, void* userData);
+            libkrfiles_KBoolean (*nativeDownloadToFd)(void* handle, const char* remotePath, libkrfiles_KInt fd, void* progress, void* userData);
+            libkrfiles_KBoolean (*nativeDownloadToFdAsync)(void* handle, const char* remotePath, libkrfiles_KInt fd, void* progress, void* callback, void* userData);
+            libkrfiles_KBoolean (*nativeDownloadToFile)(void* handle, const char* remotePath, const char* localPath, libkrfiles_KInt segments, libkrfiles_KBoolean resume, void* progress, void* userData);
+            libkrfiles_KBoolean (*nativeDownloadToFileAsync)(void* handle, const char* remotePath, const char* localPath, libkrfiles_KInt segments, libkrfiles_KBoolean resume, void* progress, void* callback, void* userData);
+            libkrfiles_KBoolean (*nativeDownloadToMemory)(void* handle, const char* remotePath, void* outData, void* outLength, void* progress, void* userData);
+            libkrfiles_KBoolean (*nativeDownloadToMemoryAsync)(void* handle, const char* remotePath, void* outData, void* outLength, void* progress, void* callback, void* userData);
+            const char* (*nativeExtractArchive)(void* handle, const char* remotePath, const char* localDir, const char* filterJson, void* progress, void* userData);
+            libkrfiles_KBoolean (*nativeExtractArchiveAsync)(void* handle, const char* remotePath, const char* localDir, const char* filterJson, void* progress, void* callback, void* userData);
             const char* (*nativeGetLastError)();
-            const char* (*nativeGetResource)(const char* path);
-            libkrfiles_KBoolean (*nativeIsAuthenticated)();
-            const char* (*nativeListDirectory)(const char* path);
-            const char* (*nativeLogin)(const char* username, const char* password);
-            libkrfiles_KBoolean (*nativeLogout)();
-            libkrfiles_KBoolean (*nativeRename)(const char* source, const char* destination, libkrfiles_KBoolean override_);
-            const char* (*nativeSearch)(const char* query, const char* path);
-            libkrfiles_KBoolean (*nativeSetToken)(const char* token);
-            libkrfiles_KBoolean (*nativeUploadFromFile)(const char* remotePath, const char* localPath, libkrfiles_KBoolean override_);
+            const char* (*nativeGetResource)(void* handle, const char* path);
+            libkrfiles_KBoolean (*nativeGetResourceAsync)(void* handle, const char* path, void* callback, void* userData);
+            const char* (*nativeGetStats)(void* handle);
+            libkrfiles_KBoolean (*nativeIsAuthenticated)(void* handle);
+            void (*nativeListClose)(void* listing);
+            const char* (*nativeListDirectory)(void* handle, const char* path);
+            libkrfiles_KBoolean (*nativeListDirectoryAsync)(void* handle, const char* path, void* callback, void* userData);
+            const char* (*nativeListNext)(void* listing);
+            void* (*nativeListOpen)(void* handle, const char* path);
+            const char* (*nativeLogin)(void* handle, const char* username, const char* password);
+            libkrfiles_KBoolean (*nativeLoginAsync)(void* handle, const char* username, const char* password, void* callback, void* userData);
+            libkrfiles_KBoolean (*nativeLogout)(void* handle);
+            libkrfiles_KBoolean (*nativeRename)(void* handle, const char* source, const char* destination, libkrfiles_KBoolean override_);
+            libkrfiles_KBoolean (*nativeRenameAsync)(void* handle, const char* source, const char* destination, libkrfiles_KBoolean override_, void* callback, void* userData);
+            libkrfiles_KBoolean (*nativeResetStats)(void* handle);
+            const char* (*nativeSearch)(void* handle, const char* query, const char* path);
+            libkrfiles_KBoolean (*nativeSearchAsync)(void* handle, const char* query, const char* path, void* callback, void* userData);
+            libkrfiles_KBoolean (*nativeSearchStream)(void* handle, const char* query, const char* path, libkrfiles_KInt maxResults, void* onResult, void* userData);
+            libkrfiles_KBoolean (*nativeSearchStreamAsync)(void* handle, const char* query, const char* path, libkrfiles_KInt maxResults, void* onResult, void* callback, void* userData);
+            libkrfiles_KBoolean (*nativeSetToken)(void* handle, const char* token);
+            libkrfiles_KBoolean (*nativeSetTraceCallback)(void* handle, void* callback, void* userData);
+            const char* (*nativeSync)(void* handle, const char* localRoot, const char* remoteRoot, libkrfiles_KInt flags, libkrfiles_KInt concurrency, void* onAction, void* userData);
+            libkrfiles_KBoolean (*nativeSyncAsync)(void* handle, const char* localRoot, const char* remoteRoot, libkrfiles_KInt flags, libkrfiles_KInt concurrency, void* onAction, void* callback, void* userData);
+            const char* (*nativeUploadFileEx)(void* handle, const char* remotePath, const char* localPath, libkrfiles_KInt flags, libkrfiles_KInt chunkSize, void* progress, void* userData);
+            libkrfiles_KBoolean (*nativeUploadFileExAsync)(void* handle, const char* remotePath, const char* localPath, libkrfiles_KInt flags, libkrfiles_KInt chunkSize, void* progress, void* callback, void* userData);
+            libkrfiles_KBoolean (*nativeUploadFromBuffer)(void* handle, const char* remotePath, void* data, libkrfiles_KLong length, libkrfiles_KBoolean override_, libkrfiles_KInt chunkSize, void* progress, void* userData);
+            libkrfiles_KBoolean (*nativeUploadFromBufferAsync)(void* handle, const char* remotePath, void* data, libkrfiles_KLong length, libkrfiles_KBoolean override_, libkrfiles_KInt chunkSize, void* progress, void* callback, void* userData);
+            libkrfiles_KBoolean (*nativeUploadFromFd)(void* handle, const char* remotePath, libkrfiles_KInt fd, libkrfiles_KLong size, libkrfiles_KBoolean override_, libkrfiles_KInt chunkSize, void* progress, void* userData);
+            libkrfiles_KBoolean (*nativeUploadFromFdAsync)(void* handle, const char* remotePath, libkrfiles_KInt fd, libkrfiles_KLong size, libkrfiles_KBoolean override_, libkrfiles_KInt chunkSize, void* progress, void* callback, void* userData);
+            libkrfiles_KBoolean (*nativeUploadFromFile)(void* handle, const char* remotePath, const char* localPath, libkrfiles_KBoolean override_, libkrfiles_KInt chunkSize, void* progress, void* userData);
+            libkrfiles_KBoolean (*nativeUploadFromFileAsync)(void* handle, const char* remotePath, const char* localPath, libkrfiles_KBoolean override_, libkrfiles_KInt chunkSize, void* progress, void* callback, void* userData);
+            libkrfiles_KBoolean (*nativeWalk)(void* handle, const char* root, libkrfiles_KInt concurrency, void* onEntry, void* userData);
+            libkrfiles_KBoolean (*nativeWalkAsync)(void* handle, const char* root, libkrfiles_KInt concurrency, void* onEntry, void* callback, void* userData);
             libkrfiles_kref_dev_rolandh_krfiles_AuthStorage (*createPlatformAuthStorage)();
           } krfiles;
         } rolandh;
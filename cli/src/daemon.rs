@@ -0,0 +1,585 @@
+//! `krfiles daemon`: keep warm clients between CLI invocations.
+//!
+//! Every `krfiles` process pays for starting the Kotlin/Native runtime,
+//! building a Ktor client and opening fresh TCP/TLS connections, only to tear
+//! it all down when the command ends. The daemon holds one client per server
+//! and settings, with its connection pool and metadata cache, and listens on a
+//! Unix domain socket.
+//!
+//! An invocation that finds the socket sends the daemon its parsed command
+//! line and working directory. It also passes its stdin, stdout and stderr as
+//! file descriptors (`SCM_RIGHTS`), so the command reads and prints exactly as
+//! it would locally, pipes and terminals included. It then exits with the
+//! status the daemon reports.
+//!
+//! Commands run one at a time, because they share the daemon's working
+//! directory and standard streams. An invocation that arrives while another
+//! runs is told the daemon is busy and runs on its own, as if there were no
+//! daemon. When a client disconnects (e.g. Ctrl-C), its command stops at the
+//! next library call. The library can't interrupt a call already in flight,
+//! so that one runs to its end with its input and output pointed at
+//! `/dev/null`, and the daemon stays busy until it has.
+//!
+//! Only the user running the daemon may use it: each side checks the other's
+//! uid before trusting it with a command line (which includes the token) or
+//! with file descriptors.
+
+use std::collections::HashMap;
+use std::fs::File;
+use std::io::{self, BufRead, BufReader, Write};
+use std::os::fd::{AsFd, AsRawFd, FromRawFd, OwnedFd, RawFd};
+use std::os::unix::fs::{DirBuilderExt, MetadataExt};
+use std::os::unix::net::UnixStream as StdUnixStream;
+use std::path::{Path, PathBuf};
+use std::sync::Arc;
+
+use colored::Colorize;
+use serde::{Deserialize, Serialize};
+use tokio::io::{AsyncReadExt, AsyncWriteExt, Interest};
+use tokio::net::{UnixListener, UnixStream};
+use tokio::signal::unix::{SignalKind, signal};
+use tokio::sync::{Mutex, Notify};
+
+use crate::{Cli, client_config, ffi, run_command};
+
+/// Longest request accepted; a parsed command line is a few hundred bytes.
+const MAX_REQUEST: usize = 1 << 20;
+
+/// Descriptors a request carries at most: the caller's stdin, stdout and stderr.
+const MAX_FDS: usize = 3;
+
+/// What an invocation asks of the daemon, sent as one JSON line.
+#[derive(Serialize, Deserialize)]
+enum Request {
+    /// Run a command with the caller's stdin, stdout and stderr attached.
+    Run {
+        cli: Box<Cli>,
+        cwd: PathBuf,
+        /// Whether the caller would print in colour.
+        color: bool,
+    },
+    Stop,
+}
+
+/// The daemon's answer, one JSON line.
+#[derive(Serialize, Deserialize)]
+enum Reply {
+    /// Another command is running; run this one locally.
+    Busy,
+    Done {
+        status: i32,
+    },
+    Stopping,
+}
+
+/// Socket path: `KRFILES_DAEMON_SOCKET`, else `$XDG_RUNTIME_DIR/krfiles.sock`,
+/// else `daemon.sock` in [`fallback_dir`].
+pub fn socket_path() -> PathBuf {
+    if let Some(path) = std::env::var_os("KRFILES_DAEMON_SOCKET") {
+        return PathBuf::from(path);
+    }
+    match std::env::var_os("XDG_RUNTIME_DIR") {
+        Some(dir) => PathBuf::from(dir).join("krfiles.sock"),
+        None => fallback_dir().join("daemon.sock"),
+    }
+}
+
+/// Per-user directory in `/tmp` for the socket, made private by [`serve`].
+///
+/// Anyone can create names in `/tmp`, so the socket doesn't go there directly.
+fn fallback_dir() -> PathBuf {
+    PathBuf::from(format!("/tmp/krfiles-{}", unsafe { libc::getuid() }))
+}
+
+/// Create `dir` with mode 0700, or check that the existing one is ours alone.
+fn make_private_dir(dir: &Path) -> Result<(), String> {
+    match std::fs::DirBuilder::new().mode(0o700).create(dir) {
+        Ok(()) => {}
+        Err(e) if e.kind() == io::ErrorKind::AlreadyExists => {}
+        Err(e) => return Err(format!("Failed to create {}: {e}", dir.display())),
+    }
+    // It may have been there already, made by someone else or as a symlink.
+    let metadata = std::fs::symlink_metadata(dir)
+        .map_err(|e| format!("Failed to read {}: {e}", dir.display()))?;
+    if !metadata.is_dir()
+        || metadata.uid() != unsafe { libc::getuid() }
+        || metadata.mode() & 0o077 != 0
+    {
+        return Err(format!(
+            "{} is not a directory private to this user; remove it or set KRFILES_DAEMON_SOCKET",
+            dir.display()
+        ));
+    }
+    Ok(())
+}
+
+// ---------------------------------------------------------------------------
+// Client side
+// ---------------------------------------------------------------------------
+
+/// Run `cli` in the daemon if one is listening.
+///
+/// Returns the command's exit status, or `None` when there is no daemon or it
+/// is busy, in which case the caller runs the command itself.
+pub fn forward(cli: &Cli) -> Result<Option<i32>, String> {
+    let Ok(stream) = StdUnixStream::connect(socket_path()) else {
+        return Ok(None);
+    };
+    // The request carries the token and our stdio; a stranger's daemon gets neither.
+    if peer_uid(&stream).ok() != Some(unsafe { libc::getuid() }) {
+        return Ok(None);
+    }
+    let request = Request::Run {
+        cli: Box::new(cli.clone()),
+        cwd: std::env::current_dir()
+            .map_err(|e| format!("Failed to read working directory: {e}"))?,
+        color: colored::control::SHOULD_COLORIZE.should_colorize(),
+    };
+    let stdio = [0, 1, 2];
+    match exchange(&stream, &request, &stdio)? {
+        Reply::Done { status } => Ok(Some(status)),
+        Reply::Busy | Reply::Stopping => Ok(None),
+    }
+}
+
+/// Ask the daemon to exit (`krfiles daemon --stop`).
+pub fn stop() -> Result<(), String> {
+    let path = socket_path();
+    let stream = StdUnixStream::connect(&path)
+        .map_err(|_| format!("No daemon is listening on {}", path.display()))?;
+    if peer_uid(&stream).ok() != Some(unsafe { libc::getuid() }) {
+        return Err(format!(
+            "The daemon on {} belongs to another user",
+            path.display()
+        ));
+    }
+    exchange(&stream, &Request::Stop, &[])?;
+    println!("{} Daemon stopped", "✓".green());
+    Ok(())
+}
+
+/// Send `request` with `fds` attached and wait for the reply.
+fn exchange(stream: &StdUnixStream, request: &Request, fds: &[RawFd]) -> Result<Reply, String> {
+    let mut line = serde_json::to_vec(request).unwrap();
+    line.push(b'\n');
+    let lost = |e: io::Error| format!("Lost connection to the daemon: {e}");
+    let sent = send_with_fds(stream.as_raw_fd(), &line, fds).map_err(lost)?;
+    (&*stream).write_all(&line[sent..]).map_err(lost)?;
+
+    let mut reply = String::new();
+    BufReader::new(stream).read_line(&mut reply).map_err(lost)?;
+    serde_json::from_str(&reply)
+        .map_err(|_| "The daemon exited before the command finished".to_string())
+}
+
+/// User id of the process at the other end of `stream`.
+fn peer_uid(stream: &StdUnixStream) -> io::Result<libc::uid_t> {
+    #[cfg(target_os = "linux")]
+    {
+        let mut cred: libc::ucred = unsafe { std::mem::zeroed() };
+        let mut len = std::mem::size_of::<libc::ucred>() as libc::socklen_t;
+        let result = unsafe {
+            libc::getsockopt(
+                stream.as_raw_fd(),
+                libc::SOL_SOCKET,
+                libc::SO_PEERCRED,
+                (&raw mut cred).cast(),
+                &mut len,
+            )
+        };
+        if result < 0 {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(cred.uid)
+    }
+    #[cfg(not(target_os = "linux"))]
+    {
+        let (mut uid, mut gid) = (0, 0);
+        if unsafe { libc::getpeereid(stream.as_raw_fd(), &mut uid, &mut gid) } < 0 {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(uid)
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Daemon side
+// ---------------------------------------------------------------------------
+
+struct Daemon {
+    /// Warm clients by server and settings. Held for the whole of a command,
+    /// which is what makes commands run one at a time.
+    clients: Mutex<HashMap<String, ffi::Client>>,
+    stop: Notify,
+    /// The daemon's own stderr, from before any command redirected it, so that
+    /// news about one connection never lands in another caller's terminal.
+    log: File,
+}
+
+impl Daemon {
+    fn warn(&self, message: impl std::fmt::Display) {
+        let _ = writeln!(&self.log, "{} {message}", "warning:".yellow().bold());
+    }
+}
+
+/// Listen on [`socket_path`] until stopped by `krfiles daemon --stop`,
+/// SIGINT or SIGTERM.
+pub async fn serve() -> Result<(), String> {
+    let path = socket_path();
+    if path.parent() == Some(fallback_dir().as_path()) {
+        make_private_dir(&fallback_dir())?;
+    }
+    if StdUnixStream::connect(&path).is_ok() {
+        return Err(format!(
+            "A daemon is already listening on {}",
+            path.display()
+        ));
+    }
+    // Left behind by a daemon that didn't shut down cleanly.
+    let _ = std::fs::remove_file(&path);
+    // Created 0600 rather than restricted after bind, which would leave a window.
+    let umask = unsafe { libc::umask(0o177) };
+    let bound = UnixListener::bind(&path);
+    unsafe { libc::umask(umask) };
+    let listener = bound.map_err(|e| format!("Failed to listen on {}: {e}", path.display()))?;
+    eprintln!("{} Listening on {}", "✓".green(), path.display());
+
+    let log = io::stderr()
+        .as_fd()
+        .try_clone_to_owned()
+        .map_err(|e| format!("Failed to keep stderr: {e}"))?;
+    let daemon = Arc::new(Daemon {
+        clients: Mutex::new(HashMap::new()),
+        stop: Notify::new(),
+        log: File::from(log),
+    });
+    let mut terminate = signal(SignalKind::terminate()).map_err(|e| e.to_string())?;
+    let uid = unsafe { libc::getuid() };
+    loop {
+        tokio::select! {
+            accepted = listener.accept() => {
+                let Ok((stream, _)) = accepted else { continue };
+                // The socket is private, but check anyway: commands run with our credentials.
+                if stream.peer_cred().ok().map(|c| c.uid()) != Some(uid) {
+                    continue;
+                }
+                let daemon = Arc::clone(&daemon);
+                tokio::spawn(async move {
+                    if let Err(e) = handle(stream, &daemon).await {
+                        daemon.warn(e);
+                    }
+                });
+            }
+            _ = daemon.stop.notified() => break,
+            _ = tokio::signal::ctrl_c() => break,
+            _ = terminate.recv() => break,
+        }
+    }
+    let _ = std::fs::remove_file(&path);
+    Ok(())
+}
+
+async fn handle(mut stream: UnixStream, daemon: &Daemon) -> io::Result<()> {
+    let (request, fds) = read_request(&stream).await?;
+    let reply = match request {
+        Request::Stop => {
+            daemon.stop.notify_one();
+            Reply::Stopping
+        }
+        Request::Run { cli, cwd, color } => {
+            let Ok(mut clients) = daemon.clients.try_lock() else {
+                return send_reply(&mut stream, &Reply::Busy).await;
+            };
+            let [stdin, stdout, stderr]: [OwnedFd; 3] = fds.try_into().map_err(|_| {
+                io::Error::new(io::ErrorKind::InvalidData, "expected 3 descriptors")
+            })?;
+            let status = {
+                let stdio = Redirect::new([stdin, stdout, stderr], &cwd)?;
+                colored::control::set_override(color);
+                let mut hangup = [0u8; 1];
+                tokio::select! {
+                    status = run(&mut clients, *cli) => Some(status),
+                    // The client sends nothing more, so any read means it went away.
+                    _ = stream.read(&mut hangup) => {
+                        // Dropping `run` stopped the command, but a library call in
+                        // flight may still use stdio: let it finish writing nowhere
+                        // before stdio goes back to the daemon or the next caller.
+                        stdio.discard()?;
+                        ffi::settled().await;
+                        None
+                    }
+                }
+            };
+            // Nobody is left to answer.
+            let Some(status) = status else {
+                return Ok(());
+            };
+            Reply::Done { status }
+        }
+    };
+    send_reply(&mut stream, &reply).await
+}
+
+/// Run a command on the warm client for its server, creating it on first use.
+async fn run(clients: &mut HashMap<String, ffi::Client>, cli: Cli) -> i32 {
+    let config = client_config(&cli);
+    let result = match &cli.server {
+        None => Err("No server specified. Use --server URL or login first.".to_string()),
+        Some(server) => {
+            let key = format!("{server} {}", serde_json::to_string(&config).unwrap());
+            let client = match clients.entry(key) {
+                std::collections::hash_map::Entry::Occupied(entry) => Ok(entry.into_mut()),
+                std::collections::hash_map::Entry::Vacant(entry) => {
+                    ffi::Client::with_config(server, &config).map(|client| entry.insert(client))
+                }
+            };
+            match client {
+                Ok(client) => {
+                    // --stats reports this command, not everything since the daemon started.
+                    client.reset_stats();
+                    run_command(client, cli).await
+                }
+                Err(e) => Err(e),
+            }
+        }
+    };
+    match result {
+        Ok(()) => 0,
+        Err(e) => {
+            eprintln!("{} {e}", "error:".red().bold());
+            1
+        }
+    }
+}
+
+/// Read one request line and the descriptors sent with it.
+async fn read_request(stream: &UnixStream) -> io::Result<(Request, Vec<OwnedFd>)> {
+    let mut data = Vec::new();
+    let mut fds = Vec::new();
+    let mut buffer = [0u8; 4096];
+    while !data.ends_with(b"\n") {
+        stream.readable().await?;
+        let read = match stream.try_io(Interest::READABLE, || {
+            recv_with_fds(stream.as_raw_fd(), &mut buffer, &mut fds, MAX_FDS)
+        }) {
+            Ok(read) => read,
+            Err(e) if e.kind() == io::ErrorKind::WouldBlock => continue,
+            Err(e) => return Err(e),
+        };
+        if read == 0 || data.len() + read > MAX_REQUEST {
+            return Err(io::Error::new(
+                io::ErrorKind::InvalidData,
+                "incomplete request",
+            ));
+        }
+        data.extend_from_slice(&buffer[..read]);
+    }
+    let request =
+        serde_json::from_slice(&data).map_err(|e| io::Error::new(io::ErrorKind::InvalidData, e))?;
+    Ok((request, fds))
+}
+
+async fn send_reply(stream: &mut UnixStream, reply: &Reply) -> io::Result<()> {
+    let mut line = serde_json::to_vec(reply).unwrap();
+    line.push(b'\n');
+    stream.write_all(&line).await
+}
+
+/// The caller's stdin, stdout, stderr and working directory, put in place of
+/// the daemon's own until dropped.
+struct Redirect {
+    saved: Vec<OwnedFd>,
+    cwd: PathBuf,
+}
+
+impl Redirect {
+    fn new(stdio: [OwnedFd; 3], cwd: &Path) -> io::Result<Self> {
+        let previous = std::env::current_dir()?;
+        std::env::set_current_dir(cwd)?;
+        let mut saved = Vec::with_capacity(3);
+        for (target, fd) in stdio.iter().enumerate() {
+            let target = target as RawFd;
+            let copy = unsafe { libc::dup(target) };
+            if copy < 0 || unsafe { libc::dup2(fd.as_raw_fd(), target) } < 0 {
+                let error = io::Error::last_os_error();
+                if copy >= 0 {
+                    unsafe { libc::close(copy) };
+                }
+                drop(Self {
+                    saved,
+                    cwd: previous,
+                });
+                return Err(error);
+            }
+            saved.push(unsafe { OwnedFd::from_raw_fd(copy) });
+        }
+        Ok(Self {
+            saved,
+            cwd: previous,
+        })
+    }
+
+    /// Point stdin, stdout and stderr at `/dev/null`, for a caller that went away.
+    fn discard(&self) -> io::Result<()> {
+        let null = File::options().read(true).write(true).open("/dev/null")?;
+        for target in 0..3 {
+            if unsafe { libc::dup2(null.as_raw_fd(), target) } < 0 {
+                return Err(io::Error::last_os_error());
+            }
+        }
+        Ok(())
+    }
+}
+
+impl Drop for Redirect {
+    fn drop(&mut self) {
+        let _ = io::stdout().flush();
+        let _ = io::stderr().flush();
+        for (target, fd) in self.saved.iter().enumerate() {
+            unsafe { libc::dup2(fd.as_raw_fd(), target as RawFd) };
+        }
+        let _ = std::env::set_current_dir(&self.cwd);
+        colored::control::unset_override();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Descriptor passing
+// ---------------------------------------------------------------------------
+
+/// `sendmsg` with `fds` attached as `SCM_RIGHTS`; returns the bytes sent.
+fn send_with_fds(socket: RawFd, data: &[u8], fds: &[RawFd]) -> io::Result<usize> {
+    let mut iov = libc::iovec {
+        iov_base: data.as_ptr() as *mut libc::c_void,
+        iov_len: data.len(),
+    };
+    let payload = std::mem::size_of_val(fds) as u32;
+    let mut control = vec![0u8; unsafe { libc::CMSG_SPACE(payload) } as usize];
+    let mut msg: libc::msghdr = unsafe { std::mem::zeroed() };
+    msg.msg_iov = &mut iov;
+    msg.msg_iovlen = 1;
+    if !fds.is_empty() {
+        msg.msg_control = control.as_mut_ptr().cast();
+        msg.msg_controllen = control.len() as _;
+        unsafe {
+            let header = libc::CMSG_FIRSTHDR(&msg);
+            (*header).cmsg_level = libc::SOL_SOCKET;
+            (*header).cmsg_type = libc::SCM_RIGHTS;
+            (*header).cmsg_len = libc::CMSG_LEN(payload) as _;
+            std::ptr::copy_nonoverlapping(fds.as_ptr(), libc::CMSG_DATA(header).cast(), fds.len());
+        }
+    }
+    let sent = unsafe { libc::sendmsg(socket, &msg, 0) };
+    if sent < 0 {
+        return Err(io::Error::last_os_error());
+    }
+    Ok(sent as usize)
+}
+
+/// Flags for `recvmsg`: received descriptors must not leak into anything a
+/// command spawns.
+#[cfg(target_os = "linux")]
+const RECV_FLAGS: libc::c_int = libc::MSG_CMSG_CLOEXEC;
+#[cfg(not(target_os = "linux"))]
+const RECV_FLAGS: libc::c_int = 0;
+
+/// `recvmsg` into `buffer`, appending received descriptors to `fds` until it
+/// holds `limit`; any beyond that are closed.
+///
+/// Fails, closing what arrived, if the descriptors didn't fit the control buffer.
+fn recv_with_fds(
+    socket: RawFd,
+    buffer: &mut [u8],
+    fds: &mut Vec<OwnedFd>,
+    limit: usize,
+) -> io::Result<usize> {
+    let mut iov = libc::iovec {
+        iov_base: buffer.as_mut_ptr().cast(),
+        iov_len: buffer.len(),
+    };
+    let capacity = (MAX_FDS * std::mem::size_of::<RawFd>()) as u32;
+    let mut control = vec![0u8; unsafe { libc::CMSG_SPACE(capacity) } as usize];
+    let mut msg: libc::msghdr = unsafe { std::mem::zeroed() };
+    msg.msg_iov = &mut iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.as_mut_ptr().cast();
+    msg.msg_controllen = control.len() as _;
+    let read = unsafe { libc::recvmsg(socket, &mut msg, RECV_FLAGS) };
+    if read < 0 {
+        return Err(io::Error::last_os_error());
+    }
+    // Take ownership of everything that arrived first, so every path closes it.
+    let mut received = Vec::new();
+    unsafe {
+        let mut header = libc::CMSG_FIRSTHDR(&msg);
+        while !header.is_null() {
+            if (*header).cmsg_level == libc::SOL_SOCKET && (*header).cmsg_type == libc::SCM_RIGHTS {
+                let bytes = (*header).cmsg_len as usize - libc::CMSG_LEN(0) as usize;
+                let data = libc::CMSG_DATA(header).cast::<RawFd>();
+                for i in 0..bytes / std::mem::size_of::<RawFd>() {
+                    received.push(OwnedFd::from_raw_fd(data.add(i).read_unaligned()));
+                }
+            }
+            header = libc::CMSG_NXTHDR(&msg, header);
+        }
+    }
+    if msg.msg_flags & libc::MSG_CTRUNC != 0 {
+        return Err(io::Error::new(
+            io::ErrorKind::InvalidData,
+            "too many descriptors",
+        ));
+    }
+    #[cfg(not(target_os = "linux"))]
+    for fd in &received {
+        unsafe { libc::fcntl(fd.as_raw_fd(), libc::F_SETFD, libc::FD_CLOEXEC) };
+    }
+    let room = limit.saturating_sub(fds.len());
+    fds.extend(received.into_iter().take(room));
+    Ok(read as usize)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// Send `count` copies of stdin's descriptor over a fresh socket pair and
+    /// receive them with `limit`.
+    fn pass_fds(count: usize, limit: usize) -> io::Result<Vec<OwnedFd>> {
+        let (sender, receiver) = StdUnixStream::pair()?;
+        send_with_fds(sender.as_raw_fd(), b"x", &vec![0; count])?;
+        let mut fds = Vec::new();
+        recv_with_fds(receiver.as_raw_fd(), &mut [0u8; 16], &mut fds, limit)?;
+        Ok(fds)
+    }
+
+    #[test]
+    fn keeps_descriptors_up_to_the_limit() {
+        assert_eq!(pass_fds(3, MAX_FDS).unwrap().len(), 3);
+        assert_eq!(pass_fds(3, 1).unwrap().len(), 1);
+    }
+
+    #[test]
+    fn sees_its_own_uid_as_peer() {
+        let (a, _b) = StdUnixStream::pair().unwrap();
+        assert_eq!(peer_uid(&a).unwrap(), unsafe { libc::getuid() });
+    }
+
+    #[test]
+    fn rejects_descriptors_beyond_the_control_buffer() {
+        let error = pass_fds(16, MAX_FDS).unwrap_err();
+        assert_eq!(error.kind(), io::ErrorKind::InvalidData);
+    }
+
+    #[test]
+    fn refuses_a_directory_others_can_enter() {
+        let dir = std::env::temp_dir().join(format!("krfiles-daemon-test-{}", std::process::id()));
+        let _ = std::fs::remove_dir_all(&dir);
+        std::fs::DirBuilder::new().mode(0o755).create(&dir).unwrap();
+        assert!(make_private_dir(&dir).is_err());
+        std::fs::remove_dir(&dir).unwrap();
+        assert!(make_private_dir(&dir).is_ok());
+        let mode = std::fs::metadata(&dir).unwrap().mode();
+        std::fs::remove_dir(&dir).unwrap();
+        assert_eq!(mode & 0o777, 0o700);
+    }
+}
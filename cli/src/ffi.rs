@@ -4,17 +4,45 @@
 /// flat function names. This module declares those functions and provides
 /// a safe Rust API around them.
 ///
+/// All calls go through a [`Client`], which owns an opaque `krfiles_client*`
+/// handle. A `Client` is `Send + Sync`: the library allows concurrent calls on
+/// one handle, so it can be shared across tasks (e.g. in an `Arc`).
+///
 /// ## How it works
 ///
+/// Network operations use the library's `*_async` entry points, so no thread
+/// blocks while a request is in flight:
+///
 /// ```text
 /// Rust (this module)
-///   → calls extern "C" krfiles_login(...)
-///     → C shim forwards to symbols->kotlin.root...nativeLogin(...)
-///       → Kotlin/Native uses runBlocking to call suspend FilebrowserClient.login()
+///   → calls extern "C" krfiles_login_async(client, ..., done, user_data)
+///     → C shim forwards to symbols->kotlin.root...nativeLoginAsync(...)
+///       → Kotlin launches suspend FilebrowserClient.login() on its dispatcher
 ///         → Ktor makes the HTTP request
+///       → Kotlin calls done(user_data, ok, result, error) on its own thread
+///   → completion_trampoline sends the outcome through a oneshot channel
+/// → the `async fn` awaiting that channel resumes
 /// ```
-use std::ffi::{CStr, CString};
-use std::os::raw::c_char;
+use std::ffi::{CStr, CString, c_void};
+use std::os::fd::RawFd;
+use std::os::raw::{c_char, c_int};
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+use serde::Serialize;
+use tokio::sync::{Notify, mpsc, oneshot};
+
+/// C progress callback: `(transferred, total, user_data)`. `total` is -1 if unknown.
+type ProgressCallback = extern "C" fn(transferred: i64, total: i64, user_data: *mut c_void);
+
+/// C walk callback: `(user_data, entry_json) -> keep_going`.
+type WalkCallback = extern "C" fn(user_data: *mut c_void, entry_json: *const c_char) -> bool;
+
+/// C sync and batch callback: `(user_data, action_json)`, one finished step at a time.
+type SyncCallback = extern "C" fn(user_data: *mut c_void, action_json: *const c_char);
+
+/// C completion callback: `(user_data, ok, result, error)`.
+type CompletionCallback =
+    extern "C" fn(user_data: *mut c_void, ok: bool, result: *const c_char, error: *const c_char);
 
 // ---------------------------------------------------------------------------
 // extern "C" declarations — these match the functions in krfiles_shim.c
@@ -27,174 +55,972 @@ use std::os::raw::c_char;
 // it could dereference null, corrupt memory, etc. Our safe wrapper below
 // handles the unsafe boundary.
 
+/// Opaque C type behind `krfiles_client*`. Never constructed in Rust.
+#[repr(C)]
+struct RawClient {
+    _private: [u8; 0],
+}
+
+/// Opaque C type behind `krfiles_listing*`. Never constructed in Rust.
+#[repr(C)]
+struct RawListing {
+    _private: [u8; 0],
+}
+
 unsafe extern "C" {
-    fn krfiles_create_client(base_url: *const c_char);
-    fn krfiles_destroy_client();
+    fn krfiles_client_new(base_url: *const c_char) -> *mut RawClient;
+    fn krfiles_client_new_ex(base_url: *const c_char, config_json: *const c_char)
+    -> *mut RawClient;
+    fn krfiles_client_free(client: *mut RawClient);
     fn krfiles_get_last_error() -> *const c_char;
+    fn krfiles_free_string(string: *const c_char);
+    #[allow(dead_code)]
+    fn krfiles_free(data: *mut c_void);
+
+    fn krfiles_get_stats(client: *mut RawClient) -> *const c_char;
+    fn krfiles_reset_stats(client: *mut RawClient) -> bool;
 
-    fn krfiles_login(username: *const c_char, password: *const c_char) -> *const c_char;
-    fn krfiles_set_token(token: *const c_char) -> bool;
+    fn krfiles_list_open(client: *mut RawClient, path: *const c_char) -> *mut RawListing;
+    fn krfiles_list_next(listing: *mut RawListing) -> *const c_char;
+    fn krfiles_list_close(listing: *mut RawListing);
+
+    fn krfiles_set_token(client: *mut RawClient, token: *const c_char) -> bool;
     #[allow(dead_code)]
-    fn krfiles_logout() -> bool;
+    fn krfiles_logout(client: *mut RawClient) -> bool;
     #[allow(dead_code)]
-    fn krfiles_is_authenticated() -> bool;
-
-    fn krfiles_get_resource(path: *const c_char) -> *const c_char;
-    fn krfiles_list_directory(path: *const c_char) -> *const c_char;
-    fn krfiles_search(query: *const c_char, path: *const c_char) -> *const c_char;
+    fn krfiles_is_authenticated(client: *mut RawClient) -> bool;
 
-    fn krfiles_download_to_file(remote_path: *const c_char, local_path: *const c_char) -> bool;
-    fn krfiles_upload_from_file(
+    fn krfiles_login_async(
+        client: *mut RawClient,
+        username: *const c_char,
+        password: *const c_char,
+        done: CompletionCallback,
+        user_data: *mut c_void,
+    ) -> bool;
+    fn krfiles_get_resource_async(
+        client: *mut RawClient,
+        path: *const c_char,
+        done: CompletionCallback,
+        user_data: *mut c_void,
+    ) -> bool;
+    #[allow(dead_code)]
+    fn krfiles_list_directory_async(
+        client: *mut RawClient,
+        path: *const c_char,
+        done: CompletionCallback,
+        user_data: *mut c_void,
+    ) -> bool;
+    #[allow(dead_code)]
+    fn krfiles_search_async(
+        client: *mut RawClient,
+        query: *const c_char,
+        path: *const c_char,
+        done: CompletionCallback,
+        user_data: *mut c_void,
+    ) -> bool;
+    #[allow(clippy::too_many_arguments)]
+    fn krfiles_download_file_ex_async(
+        client: *mut RawClient,
+        remote_path: *const c_char,
+        local_path: *const c_char,
+        segments: c_int,
+        flags: c_int,
+        progress: Option<ProgressCallback>,
+        done: CompletionCallback,
+        user_data: *mut c_void,
+    ) -> bool;
+    #[allow(clippy::too_many_arguments)]
+    fn krfiles_upload_file_ex_async(
+        client: *mut RawClient,
         remote_path: *const c_char,
         local_path: *const c_char,
+        flags: c_int,
+        chunk_size: c_int,
+        progress: Option<ProgressCallback>,
+        done: CompletionCallback,
+        user_data: *mut c_void,
+    ) -> bool;
+    fn krfiles_download_to_fd_async(
+        client: *mut RawClient,
+        remote_path: *const c_char,
+        fd: c_int,
+        progress: Option<ProgressCallback>,
+        done: CompletionCallback,
+        user_data: *mut c_void,
+    ) -> bool;
+    #[allow(clippy::too_many_arguments)]
+    fn krfiles_upload_from_fd_async(
+        client: *mut RawClient,
+        remote_path: *const c_char,
+        fd: c_int,
+        size: i64,
+        override_: bool,
+        chunk_size: c_int,
+        progress: Option<ProgressCallback>,
+        done: CompletionCallback,
+        user_data: *mut c_void,
+    ) -> bool;
+    #[allow(clippy::too_many_arguments)]
+    fn krfiles_search_stream_async(
+        client: *mut RawClient,
+        query: *const c_char,
+        path: *const c_char,
+        max_results: c_int,
+        on_result: WalkCallback,
+        done: CompletionCallback,
+        user_data: *mut c_void,
+    ) -> bool;
+    fn krfiles_walk_async(
+        client: *mut RawClient,
+        root: *const c_char,
+        concurrency: c_int,
+        on_entry: WalkCallback,
+        done: CompletionCallback,
+        user_data: *mut c_void,
+    ) -> bool;
+    #[allow(clippy::too_many_arguments)]
+    fn krfiles_sync_async(
+        client: *mut RawClient,
+        local_root: *const c_char,
+        remote_root: *const c_char,
+        flags: c_int,
+        concurrency: c_int,
+        on_action: Option<SyncCallback>,
+        done: CompletionCallback,
+        user_data: *mut c_void,
+    ) -> bool;
+    fn krfiles_extract_archive_async(
+        client: *mut RawClient,
+        remote_path: *const c_char,
+        local_dir: *const c_char,
+        filter_json: *const c_char,
+        progress: Option<ProgressCallback>,
+        done: CompletionCallback,
+        user_data: *mut c_void,
+    ) -> bool;
+    fn krfiles_batch_async(
+        client: *mut RawClient,
+        operations_json: *const c_char,
+        concurrency: c_int,
+        stop_on_error: bool,
+        on_result: Option<SyncCallback>,
+        done: CompletionCallback,
+        user_data: *mut c_void,
+    ) -> bool;
+    fn krfiles_create_directory_async(
+        client: *mut RawClient,
+        path: *const c_char,
+        done: CompletionCallback,
+        user_data: *mut c_void,
+    ) -> bool;
+    fn krfiles_delete_async(
+        client: *mut RawClient,
+        path: *const c_char,
+        done: CompletionCallback,
+        user_data: *mut c_void,
+    ) -> bool;
+    fn krfiles_rename_async(
+        client: *mut RawClient,
+        source: *const c_char,
+        dest: *const c_char,
         override_: bool,
+        done: CompletionCallback,
+        user_data: *mut c_void,
+    ) -> bool;
+    fn krfiles_copy_async(
+        client: *mut RawClient,
+        source: *const c_char,
+        dest: *const c_char,
+        override_: bool,
+        done: CompletionCallback,
+        user_data: *mut c_void,
     ) -> bool;
-    fn krfiles_create_directory(path: *const c_char) -> bool;
-    fn krfiles_delete(path: *const c_char) -> bool;
-    fn krfiles_rename(source: *const c_char, dest: *const c_char, override_: bool) -> bool;
-    fn krfiles_copy(source: *const c_char, dest: *const c_char, override_: bool) -> bool;
 }
 
 // ---------------------------------------------------------------------------
 // Safe public API
 // ---------------------------------------------------------------------------
 //
-// These functions handle:
+// These methods handle:
 // 1. Converting Rust &str → C strings (CString adds a null terminator)
-// 2. Calling the unsafe extern functions
-// 3. Converting C string results back to Rust Strings
-// 4. Null checks → Result errors with the last Kotlin error message
-
-/// Initialize the Kotlin client for a server URL.
-pub fn create_client(base_url: &str) {
-    let url = CString::new(base_url).unwrap();
-    unsafe { krfiles_create_client(url.as_ptr()) }
-}
-
-/// Clean up the Kotlin client.
-pub fn destroy_client() {
-    unsafe { krfiles_destroy_client() }
-}
-
-/// Get the last error from the Kotlin side.
-pub fn last_error() -> String {
-    unsafe {
-        let ptr = krfiles_get_last_error();
-        if ptr.is_null() {
-            "Unknown error".to_string()
-        } else {
-            // CStr::from_ptr reads bytes until it hits a null terminator.
-            // to_string_lossy handles any non-UTF8 bytes gracefully.
-            CStr::from_ptr(ptr).to_string_lossy().into_owned()
+// 2. Submitting the operation through the unsafe extern functions
+// 3. Awaiting the completion callback and converting its C strings back
+// 4. Failures → Result errors with the message from Kotlin
+//
+// Dropping one of the returned futures early does not cancel the operation;
+// it finishes in the background and its result is discarded. Anything the
+// library may still touch (progress closures, walk channels, action callbacks)
+// therefore lives in the heap-allocated call state, not in the future, and
+// [`settled`] waits for such leftovers to finish.
+
+/// Progress closure for transfers: `(transferred, total)`, `total` is `None` if unknown.
+///
+/// Runs on a library thread, so it must be `Send`, and it may outlive the future
+/// that started the transfer, so it must be `'static`.
+pub type Progress = Box<dyn FnMut(u64, Option<u64>) + Send>;
+
+/// Called with each finished sync step (SyncAction) or batch operation
+/// (BatchResult) as a JSON string.
+///
+/// Runs on a library thread, like [`Progress`].
+pub type OnAction = Box<dyn FnMut(&str) + Send>;
+
+/// Make the local tree match the remote one instead of pushing (`KRFILES_SYNC_PULL`).
+pub const SYNC_PULL: i32 = 1;
+/// Only plan the sync (`KRFILES_SYNC_DRY_RUN`).
+pub const SYNC_DRY_RUN: i32 = 2;
+/// Ignore the manifest and list every remote directory (`KRFILES_SYNC_RESCAN`).
+pub const SYNC_RESCAN: i32 = 4;
+
+/// Continue a partial local file when downloading (`KRFILES_TRANSFER_RESUME`).
+pub const TRANSFER_RESUME: i32 = 1;
+/// Check a download against the server's SHA-256 (`KRFILES_TRANSFER_VERIFY`).
+pub const TRANSFER_VERIFY: i32 = 2;
+/// Replace an existing remote file when uploading (`KRFILES_TRANSFER_OVERRIDE`).
+pub const TRANSFER_OVERRIDE: i32 = 4;
+/// Skip an upload whose remote copy has the same SHA-256 (`KRFILES_TRANSFER_SKIP_IDENTICAL`).
+pub const TRANSFER_SKIP_IDENTICAL: i32 = 8;
+
+/// Settings for [`Client::with_config`], sent to `krfiles_client_new_ex` as
+/// JSON. A `None` timeout disables that timeout.
+#[derive(Serialize)]
+#[serde(rename_all = "camelCase")]
+pub struct ClientConfig {
+    pub connect_timeout_millis: Option<i64>,
+    pub request_timeout_millis: Option<i64>,
+    /// Accept compressed file downloads too, not just API responses.
+    pub compress_transfers: bool,
+    /// Paths kept by the metadata cache; 0 disables it.
+    pub cache_entries: i32,
+    pub cache_ttl_millis: i64,
+    /// Load and save the cache in `~/.config/krfiles/metadata.json`.
+    pub persistent_cache: bool,
+    /// Bandwidth of all transfers together, in bytes per second; 0 for no cap.
+    pub max_bytes_per_second: u64,
+    /// Bandwidth of each transfer, in bytes per second; 0 for no cap.
+    pub max_transfer_bytes_per_second: u64,
+    /// Upper bound of the adaptive request concurrency; `None` keeps the library's.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub max_concurrency: Option<u32>,
+    /// Tries per lookup, listing or search, the first included; `None` keeps the library's.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub max_attempts: Option<u32>,
+    /// Send a second request for a lookup still unanswered after this many milliseconds.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub hedge_after_millis: Option<u64>,
+}
+
+/// A Kotlin `FilebrowserClient` for one server, freed on drop.
+pub struct Client {
+    raw: *mut RawClient,
+}
+
+// Safety: the library documents every krfiles_* call as safe to make
+// concurrently on one handle, and the handle is only freed in Drop.
+unsafe impl Send for Client {}
+unsafe impl Sync for Client {}
+
+impl Client {
+    /// Create a Kotlin client for a server URL.
+    pub fn new(base_url: &str) -> Self {
+        let url = CString::new(base_url).unwrap();
+        let raw = unsafe { krfiles_client_new(url.as_ptr()) };
+        assert!(!raw.is_null(), "krfiles_client_new returned null");
+        Self { raw }
+    }
+
+    /// Create a Kotlin client with transport and cache settings.
+    pub fn with_config(base_url: &str, config: &ClientConfig) -> Result<Self, String> {
+        let url = CString::new(base_url).unwrap();
+        let json = CString::new(serde_json::to_string(config).unwrap()).unwrap();
+        let raw = unsafe { krfiles_client_new_ex(url.as_ptr(), json.as_ptr()) };
+        if raw.is_null() {
+            return Err(last_error());
+        }
+        Ok(Self { raw })
+    }
+
+    /// Authenticate with username/password. Returns the auth token.
+    pub async fn login(&self, username: &str, password: &str) -> Result<String, String> {
+        let u = CString::new(username).unwrap();
+        let p = CString::new(password).unwrap();
+        let rx = submit(CallState::default(), |done, call| unsafe {
+            krfiles_login_async(self.raw, u.as_ptr(), p.as_ptr(), done, call.cast())
+        })?;
+        expect_value(completion(rx).await)
+    }
+
+    /// Set auth token directly (e.g. from stored credentials).
+    pub fn set_token(&self, token: &str) -> bool {
+        let t = CString::new(token).unwrap();
+        unsafe { krfiles_set_token(self.raw, t.as_ptr()) }
+    }
+
+    /// Log out and clear the token.
+    #[allow(dead_code)]
+    pub fn logout(&self) -> bool {
+        unsafe { krfiles_logout(self.raw) }
+    }
+
+    /// Check if the client has a valid auth token.
+    #[allow(dead_code)]
+    pub fn is_authenticated(&self) -> bool {
+        unsafe { krfiles_is_authenticated(self.raw) }
+    }
+
+    /// Request metrics so far as a `ClientStats` JSON string.
+    pub fn stats(&self) -> Result<String, String> {
+        let ptr = unsafe { krfiles_get_stats(self.raw) };
+        let json = unsafe { optional_string(ptr) };
+        unsafe { krfiles_free_string(ptr) };
+        json.ok_or_else(last_error)
+    }
+
+    /// Zero the request metrics.
+    pub fn reset_stats(&self) -> bool {
+        unsafe { krfiles_reset_stats(self.raw) }
+    }
+
+    /// Get resource info as a JSON string.
+    pub async fn get_resource(&self, path: &str) -> Result<String, String> {
+        let p = CString::new(path).unwrap();
+        let rx = submit(CallState::default(), |done, call| unsafe {
+            krfiles_get_resource_async(self.raw, p.as_ptr(), done, call.cast())
+        })?;
+        expect_value(completion(rx).await)
+    }
+
+    /// List directory contents as a JSON string.
+    #[allow(dead_code)]
+    pub async fn list_directory(&self, path: &str) -> Result<String, String> {
+        let p = CString::new(path).unwrap();
+        let rx = submit(CallState::default(), |done, call| unsafe {
+            krfiles_list_directory_async(self.raw, p.as_ptr(), done, call.cast())
+        })?;
+        expect_value(completion(rx).await)
+    }
+
+    /// Stream a directory's entries as Resource JSON strings.
+    ///
+    /// Entries are decoded while the response is still arriving, so memory
+    /// stays flat for huge directories. The iterator blocks; from async code,
+    /// drive it inside `tokio::task::block_in_place`.
+    pub fn list_stream(&self, path: &str) -> Result<Listing<'_>, String> {
+        let p = CString::new(path).unwrap();
+        let raw = unsafe { krfiles_list_open(self.raw, p.as_ptr()) };
+        if raw.is_null() {
+            return Err(last_error());
         }
+        Ok(Listing {
+            raw,
+            done: false,
+            _client: std::marker::PhantomData,
+        })
+    }
+
+    /// Search for files. Returns JSON array of results.
+    #[allow(dead_code)]
+    pub async fn search(&self, query: &str, path: &str) -> Result<String, String> {
+        let q = CString::new(query).unwrap();
+        let p = CString::new(path).unwrap();
+        let rx = submit(CallState::default(), |done, call| unsafe {
+            krfiles_search_async(self.raw, q.as_ptr(), p.as_ptr(), done, call.cast())
+        })?;
+        expect_value(completion(rx).await)
+    }
+
+    /// Search for files, yielding each result as it is decoded.
+    ///
+    /// Returns immediately; pull SearchResult JSON strings with
+    /// [`EntryStream::next`]. The request is cancelled after `limit` results
+    /// (0 = all) or when the stream is dropped.
+    pub fn search_stream(
+        &self,
+        query: &str,
+        path: &str,
+        limit: usize,
+    ) -> Result<EntryStream, String> {
+        let q = CString::new(query).unwrap();
+        let p = CString::new(path).unwrap();
+        let limit = c_int::try_from(limit).map_err(|_| "Limit too large".to_string())?;
+        let (tx, entries) = mpsc::channel(ENTRY_BUFFER);
+        let done = submit(
+            CallState {
+                entries: Some(tx),
+                ..CallState::default()
+            },
+            |done, call| unsafe {
+                krfiles_search_stream_async(
+                    self.raw,
+                    q.as_ptr(),
+                    p.as_ptr(),
+                    limit,
+                    entry_trampoline,
+                    done,
+                    call.cast(),
+                )
+            },
+        )?;
+        Ok(EntryStream {
+            entries,
+            done: Some(done),
+        })
+    }
+
+    /// Download a remote file to a local path, streaming it to disk in chunks.
+    ///
+    /// With `segments` > 1 the file is fetched as that many parallel range
+    /// requests. `flags` combines the `TRANSFER_*` constants: with
+    /// `TRANSFER_RESUME`, an existing local file is continued from its current
+    /// size and kept on failure, so the call can be repeated; with
+    /// `TRANSFER_VERIFY`, the file must match the server's checksum.
+    /// `on_progress` is called after every chunk with `(transferred, total)`.
+    pub async fn download_to_file(
+        &self,
+        remote_path: &str,
+        local_path: &str,
+        segments: usize,
+        flags: i32,
+        on_progress: Progress,
+    ) -> Result<(), String> {
+        let r = CString::new(remote_path).unwrap();
+        let l = CString::new(local_path).unwrap();
+        let segments = c_int::try_from(segments).map_err(|_| "Too many segments".to_string())?;
+        let rx = submit(CallState::with_progress(on_progress), |done, call| unsafe {
+            krfiles_download_file_ex_async(
+                self.raw,
+                r.as_ptr(),
+                l.as_ptr(),
+                segments,
+                flags,
+                Some(progress_trampoline),
+                done,
+                call.cast(),
+            )
+        })?;
+        completion(rx).await.map(|_| ())
+    }
+
+    /// Download the directory `remote_path` as one tar stream and unpack it into
+    /// `local_dir` as it arrives. `filter_json` is an optional ArchiveFilter
+    /// object. `on_progress` gets the bytes written so far; the total is unknown.
+    /// Returns the ExtractReport JSON.
+    pub async fn extract_archive(
+        &self,
+        remote_path: &str,
+        local_dir: &str,
+        filter_json: Option<&str>,
+        on_progress: Progress,
+    ) -> Result<String, String> {
+        let r = CString::new(remote_path).unwrap();
+        let l = CString::new(local_dir).unwrap();
+        let f = filter_json.map(|f| CString::new(f).unwrap());
+        let rx = submit(CallState::with_progress(on_progress), |done, call| unsafe {
+            krfiles_extract_archive_async(
+                self.raw,
+                r.as_ptr(),
+                l.as_ptr(),
+                f.as_ref().map_or(std::ptr::null(), |f| f.as_ptr()),
+                Some(progress_trampoline),
+                done,
+                call.cast(),
+            )
+        })?;
+        expect_value(completion(rx).await)
+    }
+
+    /// Upload a local file to a remote path in resumable chunks.
+    ///
+    /// `flags` combines `TRANSFER_OVERRIDE` and `TRANSFER_SKIP_IDENTICAL`.
+    /// `chunk_size` is the size of each tus PATCH in bytes (0 = library default).
+    /// `on_progress` is called after every chunk the server acknowledges.
+    /// Returns the UploadOutcome JSON.
+    pub async fn upload_from_file(
+        &self,
+        remote_path: &str,
+        local_path: &str,
+        flags: i32,
+        chunk_size: usize,
+        on_progress: Progress,
+    ) -> Result<String, String> {
+        let r = CString::new(remote_path).unwrap();
+        let l = CString::new(local_path).unwrap();
+        let chunk_size =
+            c_int::try_from(chunk_size).map_err(|_| "Chunk size too large".to_string())?;
+        let rx = submit(CallState::with_progress(on_progress), |done, call| unsafe {
+            krfiles_upload_file_ex_async(
+                self.raw,
+                r.as_ptr(),
+                l.as_ptr(),
+                flags,
+                chunk_size,
+                Some(progress_trampoline),
+                done,
+                call.cast(),
+            )
+        })?;
+        expect_value(completion(rx).await)
+    }
+
+    /// Download a remote file to an open descriptor such as stdout, chunk by chunk.
+    ///
+    /// `fd` is written in order and not closed; it must stay open until the
+    /// library is done, even if this future is dropped early.
+    pub async fn download_to_fd(
+        &self,
+        remote_path: &str,
+        fd: RawFd,
+        on_progress: Progress,
+    ) -> Result<(), String> {
+        let r = CString::new(remote_path).unwrap();
+        let rx = submit(CallState::with_progress(on_progress), |done, call| unsafe {
+            krfiles_download_to_fd_async(
+                self.raw,
+                r.as_ptr(),
+                fd,
+                Some(progress_trampoline),
+                done,
+                call.cast(),
+            )
+        })?;
+        completion(rx).await.map(|_| ())
+    }
+
+    /// Upload exactly `size` bytes read from an open descriptor such as stdin,
+    /// in resumable chunks.
+    ///
+    /// Only the upload's read-ahead is held in memory. Fails if `fd` has fewer
+    /// or more than `size` bytes; it is not closed.
+    pub async fn upload_from_fd(
+        &self,
+        remote_path: &str,
+        fd: RawFd,
+        size: u64,
+        overwrite: bool,
+        chunk_size: usize,
+        on_progress: Progress,
+    ) -> Result<(), String> {
+        let r = CString::new(remote_path).unwrap();
+        let size = i64::try_from(size).map_err(|_| "Size too large".to_string())?;
+        let chunk_size =
+            c_int::try_from(chunk_size).map_err(|_| "Chunk size too large".to_string())?;
+        let rx = submit(CallState::with_progress(on_progress), |done, call| unsafe {
+            krfiles_upload_from_fd_async(
+                self.raw,
+                r.as_ptr(),
+                fd,
+                size,
+                overwrite,
+                chunk_size,
+                Some(progress_trampoline),
+                done,
+                call.cast(),
+            )
+        })?;
+        completion(rx).await.map(|_| ())
+    }
+
+    /// Recursively walk the tree under `root` with up to `concurrency` listings
+    /// in flight (0 = library default).
+    ///
+    /// Returns immediately; pull entries with [`EntryStream::next`]. Dropping
+    /// the stream stops the crawl.
+    pub fn walk(&self, root: &str, concurrency: usize) -> Result<EntryStream, String> {
+        let r = CString::new(root).unwrap();
+        let concurrency =
+            c_int::try_from(concurrency).map_err(|_| "Concurrency too large".to_string())?;
+        // Bounded, so a slow consumer makes the crawler wait instead of piling up entries.
+        let (tx, entries) = mpsc::channel(ENTRY_BUFFER);
+        let done = submit(
+            CallState {
+                entries: Some(tx),
+                ..CallState::default()
+            },
+            |done, call| unsafe {
+                krfiles_walk_async(
+                    self.raw,
+                    r.as_ptr(),
+                    concurrency,
+                    entry_trampoline,
+                    done,
+                    call.cast(),
+                )
+            },
+        )?;
+        Ok(EntryStream {
+            entries,
+            done: Some(done),
+        })
+    }
+
+    /// Sync a local directory with a remote one; `flags` combines the `SYNC_*` constants.
+    ///
+    /// Transfers up to `concurrency` files at once (0 = library default) and
+    /// returns the SyncReport JSON. Failed steps are listed in the report rather
+    /// than failing the call.
+    pub async fn sync(
+        &self,
+        local_root: &str,
+        remote_root: &str,
+        flags: i32,
+        concurrency: usize,
+        on_action: OnAction,
+    ) -> Result<String, String> {
+        let l = CString::new(local_root).unwrap();
+        let r = CString::new(remote_root).unwrap();
+        let concurrency =
+            c_int::try_from(concurrency).map_err(|_| "Concurrency too large".to_string())?;
+        let state = CallState {
+            on_action: Some(on_action),
+            ..CallState::default()
+        };
+        let rx = submit(state, |done, call| unsafe {
+            krfiles_sync_async(
+                self.raw,
+                l.as_ptr(),
+                r.as_ptr(),
+                flags,
+                concurrency,
+                Some(action_trampoline),
+                done,
+                call.cast(),
+            )
+        })?;
+        expect_value(completion(rx).await)
+    }
+
+    /// Run a JSON array of batch operations with up to `concurrency` in flight
+    /// (0 = library default) and return the BatchReport JSON.
+    ///
+    /// With `stop_on_error`, operations not started when one fails are skipped.
+    /// Failed operations are listed in the report rather than failing the call.
+    pub async fn batch(
+        &self,
+        operations_json: &str,
+        concurrency: usize,
+        stop_on_error: bool,
+        on_result: OnAction,
+    ) -> Result<String, String> {
+        let ops = CString::new(operations_json).map_err(|_| "Operations contain a NUL byte")?;
+        let concurrency =
+            c_int::try_from(concurrency).map_err(|_| "Concurrency too large".to_string())?;
+        let state = CallState {
+            on_action: Some(on_result),
+            ..CallState::default()
+        };
+        let rx = submit(state, |done, call| unsafe {
+            krfiles_batch_async(
+                self.raw,
+                ops.as_ptr(),
+                concurrency,
+                stop_on_error,
+                Some(action_trampoline),
+                done,
+                call.cast(),
+            )
+        })?;
+        expect_value(completion(rx).await)
+    }
+
+    /// Create a remote directory.
+    pub async fn create_directory(&self, path: &str) -> Result<(), String> {
+        let p = CString::new(path).unwrap();
+        let rx = submit(CallState::default(), |done, call| unsafe {
+            krfiles_create_directory_async(self.raw, p.as_ptr(), done, call.cast())
+        })?;
+        completion(rx).await.map(|_| ())
+    }
+
+    /// Delete a remote file or directory.
+    pub async fn delete(&self, path: &str) -> Result<(), String> {
+        let p = CString::new(path).unwrap();
+        let rx = submit(CallState::default(), |done, call| unsafe {
+            krfiles_delete_async(self.raw, p.as_ptr(), done, call.cast())
+        })?;
+        completion(rx).await.map(|_| ())
+    }
+
+    /// Rename/move a remote file or directory.
+    pub async fn rename(&self, source: &str, dest: &str, overwrite: bool) -> Result<(), String> {
+        let s = CString::new(source).unwrap();
+        let d = CString::new(dest).unwrap();
+        let rx = submit(CallState::default(), |done, call| unsafe {
+            krfiles_rename_async(
+                self.raw,
+                s.as_ptr(),
+                d.as_ptr(),
+                overwrite,
+                done,
+                call.cast(),
+            )
+        })?;
+        completion(rx).await.map(|_| ())
+    }
+
+    /// Copy a remote file or directory.
+    pub async fn copy(&self, source: &str, dest: &str, overwrite: bool) -> Result<(), String> {
+        let s = CString::new(source).unwrap();
+        let d = CString::new(dest).unwrap();
+        let rx = submit(CallState::default(), |done, call| unsafe {
+            krfiles_copy_async(
+                self.raw,
+                s.as_ptr(),
+                d.as_ptr(),
+                overwrite,
+                done,
+                call.cast(),
+            )
+        })?;
+        completion(rx).await.map(|_| ())
     }
 }
 
-/// Authenticate with username/password. Returns the auth token.
-pub fn login(username: &str, password: &str) -> Result<String, String> {
-    let u = CString::new(username).unwrap();
-    let p = CString::new(password).unwrap();
-    unsafe { nullable_str_to_result(krfiles_login(u.as_ptr(), p.as_ptr())) }
+impl Drop for Client {
+    /// Closes the Ktor HttpClient inside Kotlin and releases the handle.
+    fn drop(&mut self) {
+        unsafe { krfiles_client_free(self.raw) }
+    }
 }
 
-/// Set auth token directly (e.g. from stored credentials).
-pub fn set_token(token: &str) -> bool {
-    let t = CString::new(token).unwrap();
-    unsafe { krfiles_set_token(t.as_ptr()) }
+/// Entries buffered between the library and the [`EntryStream`] consumer.
+const ENTRY_BUFFER: usize = 1024;
+
+/// An in-progress tree walk or search, started by [`Client::walk`] or
+/// [`Client::search_stream`].
+pub struct EntryStream {
+    entries: mpsc::Receiver<String>,
+    done: Option<oneshot::Receiver<Outcome>>,
 }
 
-/// Log out and clear the token.
-#[allow(dead_code)]
-pub fn logout() -> bool {
-    unsafe { krfiles_logout() }
+impl EntryStream {
+    /// Next entry as a JSON string, or `None` once the walk or search is over.
+    ///
+    /// An error is yielded once as `Some(Err(..))` after the entries
+    /// that preceded it.
+    pub async fn next(&mut self) -> Option<Result<String, String>> {
+        if let Some(entry) = self.entries.recv().await {
+            return Some(Ok(entry));
+        }
+        // The sender is dropped with the call state, i.e. after completion.
+        let done = self.done.take()?;
+        completion(done).await.err().map(Err)
+    }
 }
 
-/// Check if the client has a valid auth token.
-#[allow(dead_code)]
-pub fn is_authenticated() -> bool {
-    unsafe { krfiles_is_authenticated() }
+/// A streaming directory listing started by [`Client::list_stream`].
+///
+/// Yields each entry as a Resource JSON string; a failure is yielded once as
+/// `Err(..)` after the entries that preceded it. Dropping it cancels the request.
+pub struct Listing<'a> {
+    raw: *mut RawListing,
+    done: bool,
+    _client: std::marker::PhantomData<&'a Client>,
 }
 
-/// Get resource info as a JSON string.
-pub fn get_resource(path: &str) -> Result<String, String> {
-    let p = CString::new(path).unwrap();
-    unsafe { nullable_str_to_result(krfiles_get_resource(p.as_ptr())) }
+impl Iterator for Listing<'_> {
+    type Item = Result<String, String>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        if self.done {
+            return None;
+        }
+        let ptr = unsafe { krfiles_list_next(self.raw) };
+        if let Some(entry) = unsafe { optional_string(ptr) } {
+            unsafe { krfiles_free_string(ptr) };
+            return Some(Ok(entry));
+        }
+        // NULL means the end, or a failure if an error was recorded.
+        self.done = true;
+        take_last_error().map(Err)
+    }
 }
 
-/// List directory contents as a JSON string.
-pub fn list_directory(path: &str) -> Result<String, String> {
-    let p = CString::new(path).unwrap();
-    unsafe { nullable_str_to_result(krfiles_list_directory(p.as_ptr())) }
+impl Drop for Listing<'_> {
+    fn drop(&mut self) {
+        unsafe { krfiles_list_close(self.raw) }
+    }
 }
 
-/// Search for files. Returns JSON array of results.
-pub fn search(query: &str, path: &str) -> Result<String, String> {
-    let q = CString::new(query).unwrap();
-    let p = CString::new(path).unwrap();
-    unsafe { nullable_str_to_result(krfiles_search(q.as_ptr(), p.as_ptr())) }
+/// Get the last error reported on the current thread, if there is one.
+fn take_last_error() -> Option<String> {
+    let ptr = unsafe { krfiles_get_last_error() };
+    let message = unsafe { optional_string(ptr) };
+    unsafe { krfiles_free_string(ptr) };
+    message
 }
 
-/// Download a remote file to a local path.
-pub fn download_to_file(remote_path: &str, local_path: &str) -> Result<(), String> {
-    let r = CString::new(remote_path).unwrap();
-    let l = CString::new(local_path).unwrap();
-    bool_to_result(unsafe { krfiles_download_to_file(r.as_ptr(), l.as_ptr()) })
+/// Get the last error reported on the current thread.
+fn last_error() -> String {
+    take_last_error().unwrap_or_else(|| "Unknown error".into())
 }
 
-/// Upload a local file to a remote path.
-pub fn upload_from_file(
-    remote_path: &str,
-    local_path: &str,
-    overwrite: bool,
-) -> Result<(), String> {
-    let r = CString::new(remote_path).unwrap();
-    let l = CString::new(local_path).unwrap();
-    bool_to_result(unsafe { krfiles_upload_from_file(r.as_ptr(), l.as_ptr(), overwrite) })
+// ---------------------------------------------------------------------------
+// Internal helpers
+// ---------------------------------------------------------------------------
+
+/// What a successful call produced, as reported through the completion callback.
+#[derive(Default)]
+struct Reply {
+    /// The result string (token or JSON), if the operation has one.
+    text: Option<String>,
 }
 
-/// Create a remote directory.
-pub fn create_directory(path: &str) -> Result<(), String> {
-    let p = CString::new(path).unwrap();
-    bool_to_result(unsafe { krfiles_create_directory(p.as_ptr()) })
+/// What the completion callback reports: a [`Reply`] or an error message.
+type Outcome = Result<Reply, String>;
+
+/// State for one in-flight async call, owned by the library until `done` runs.
+///
+/// Passed as `user_data` to the completion callback and to any progress or
+/// walk callbacks of the same call.
+struct AsyncCall {
+    tx: oneshot::Sender<Outcome>,
+    state: CallState,
 }
 
-/// Delete a remote file or directory.
-pub fn delete(path: &str) -> Result<(), String> {
-    let p = CString::new(path).unwrap();
-    bool_to_result(unsafe { krfiles_delete(p.as_ptr()) })
+/// Per-call data the library may touch until the call completes.
+#[derive(Default)]
+struct CallState {
+    progress: Option<Progress>,
+    /// Where `walk` entries and `search_stream` results go.
+    entries: Option<mpsc::Sender<String>>,
+    /// Receives finished `sync` steps and `batch` results.
+    on_action: Option<OnAction>,
 }
 
-/// Rename/move a remote file or directory.
-pub fn rename(source: &str, dest: &str, overwrite: bool) -> Result<(), String> {
-    let s = CString::new(source).unwrap();
-    let d = CString::new(dest).unwrap();
-    bool_to_result(unsafe { krfiles_rename(s.as_ptr(), d.as_ptr(), overwrite) })
+impl CallState {
+    fn with_progress(progress: Progress) -> Self {
+        Self {
+            progress: Some(progress),
+            ..Self::default()
+        }
+    }
 }
 
-/// Copy a remote file or directory.
-pub fn copy(source: &str, dest: &str, overwrite: bool) -> Result<(), String> {
-    let s = CString::new(source).unwrap();
-    let d = CString::new(dest).unwrap();
-    bool_to_result(unsafe { krfiles_copy(s.as_ptr(), d.as_ptr(), overwrite) })
+/// Calls submitted and not yet completed, whether or not anything still awaits them.
+static IN_FLIGHT: AtomicUsize = AtomicUsize::new(0);
+/// Woken when [`IN_FLIGHT`] drops to zero.
+static SETTLED: Notify = Notify::const_new();
+
+/// Wait until every submitted call has completed, including those whose
+/// futures were dropped and which still run in the library.
+pub async fn settled() {
+    loop {
+        // Created before the check, so a completion right after it still wakes us.
+        let notified = SETTLED.notified();
+        if IN_FLIGHT.load(Ordering::Acquire) == 0 {
+            return;
+        }
+        notified.await;
+    }
 }
 
-// ---------------------------------------------------------------------------
-// Internal helpers
-// ---------------------------------------------------------------------------
+/// Box up the call state and hand it to `start`, which invokes the C submit function.
+///
+/// Synchronous on purpose: the raw pointer never lives across an `.await`, which
+/// keeps the calling futures `Send`.
+fn submit(
+    state: CallState,
+    start: impl FnOnce(CompletionCallback, *mut AsyncCall) -> bool,
+) -> Result<oneshot::Receiver<Outcome>, String> {
+    let (tx, rx) = oneshot::channel();
+    let call = Box::into_raw(Box::new(AsyncCall { tx, state }));
+    IN_FLIGHT.fetch_add(1, Ordering::AcqRel);
+    if start(completion_trampoline, call) {
+        Ok(rx)
+    } else {
+        // Not submitted, so `done` will never run: reclaim the state here.
+        // The error was recorded on this thread, so read it right away.
+        drop(unsafe { Box::from_raw(call) });
+        IN_FLIGHT.fetch_sub(1, Ordering::AcqRel);
+        Err(last_error())
+    }
+}
+
+/// Wait for the completion callback of a submitted call.
+async fn completion(rx: oneshot::Receiver<Outcome>) -> Outcome {
+    rx.await
+        .map_err(|_| "Operation ended without completing".to_string())?
+}
 
-/// Convert a nullable C string to Result. Null means error → check last_error().
-unsafe fn nullable_str_to_result(ptr: *const c_char) -> Result<String, String> {
+/// Require a result string from an operation that always produces one.
+fn expect_value(outcome: Outcome) -> Result<String, String> {
+    outcome?
+        .text
+        .ok_or_else(|| "Empty response from library".to_string())
+}
+
+/// Copy a nullable C string into an owned String.
+unsafe fn optional_string(ptr: *const c_char) -> Option<String> {
     if ptr.is_null() {
-        Err(last_error())
+        None
+    } else {
+        // CStr::from_ptr reads bytes until it hits a null terminator.
+        // to_string_lossy handles any non-UTF8 bytes gracefully.
+        Some(
+            unsafe { CStr::from_ptr(ptr) }
+                .to_string_lossy()
+                .into_owned(),
+        )
+    }
+}
+
+/// Deliver a call's outcome to the awaiting future and free its state.
+extern "C" fn completion_trampoline(
+    user_data: *mut c_void,
+    ok: bool,
+    result: *const c_char,
+    error: *const c_char,
+) {
+    // Safety: user_data is the Box leaked in `submit`, and the library invokes
+    // this exactly once, after the last progress callback.
+    let AsyncCall { tx, state } = *unsafe { Box::from_raw(user_data as *mut AsyncCall) };
+    // The callback's strings belong to the library and die when we return: copy them.
+    let outcome = if ok {
+        Ok(Reply {
+            text: unsafe { optional_string(result) },
+        })
     } else {
-        // unsafe block required even inside unsafe fn (Rust 2024 edition)
-        Ok(unsafe { CStr::from_ptr(ptr) }
-            .to_string_lossy()
-            .into_owned())
+        Err(unsafe { optional_string(error) }.unwrap_or_else(|| "Unknown error".into()))
+    };
+    // The receiver is gone if the future was dropped; nothing left to notify.
+    let _ = tx.send(outcome);
+    // Release the closures before counting the call as done.
+    drop(state);
+    if IN_FLIGHT.fetch_sub(1, Ordering::AcqRel) == 1 {
+        SETTLED.notify_waiters();
     }
 }
 
-/// Convert a bool return to Result. False means error → check last_error().
-fn bool_to_result(ok: bool) -> Result<(), String> {
-    if ok { Ok(()) } else { Err(last_error()) }
+/// Forward a C progress callback to the closure stored in the call state.
+extern "C" fn progress_trampoline(transferred: i64, total: i64, user_data: *mut c_void) {
+    // Safety: user_data is the live AsyncCall from `submit`; progress callbacks
+    // for one call run sequentially and always before the completion callback.
+    let call = unsafe { &mut *(user_data as *mut AsyncCall) };
+    if let Some(progress) = call.state.progress.as_mut() {
+        progress(transferred.max(0) as u64, u64::try_from(total).ok());
+    }
+}
+
+/// Forward one walk entry or search result to the [`EntryStream`]; false stops it.
+extern "C" fn entry_trampoline(user_data: *mut c_void, entry_json: *const c_char) -> bool {
+    // Safety: as for progress_trampoline; entries are delivered one at a time.
+    let call = unsafe { &*(user_data as *const AsyncCall) };
+    let (Some(tx), Some(json)) = (&call.state.entries, unsafe { optional_string(entry_json) })
+    else {
+        return false;
+    };
+    // Runs on a library thread, outside the tokio runtime, so blocking is fine.
+    // An error means the EntryStream was dropped.
+    tx.blocking_send(json).is_ok()
+}
+
+/// Forward one finished sync step or batch result to the closure stored in the call state.
+extern "C" fn action_trampoline(user_data: *mut c_void, action_json: *const c_char) {
+    // Safety: as for progress_trampoline; steps are reported one at a time.
+    let call = unsafe { &mut *(user_data as *mut AsyncCall) };
+    if let (Some(on_action), Some(json)) = (call.state.on_action.as_mut(), unsafe {
+        optional_string(action_json)
+    }) {
+        on_action(&json);
+    }
 }
@@ -19,18 +19,31 @@
 //!
 //! - [`ffi`] — Safe wrappers around the C FFI boundary
 //! - [`models`] — Serde models for deserializing JSON from Kotlin
+//! - [`daemon`] — `krfiles daemon`, which keeps clients warm between invocations
+//! - [`watch`] — `krfiles watch`, which uploads local changes as they happen (Linux)
 
 // `mod` declares a module — tells Rust to look for ffi.rs and models.rs
 // in the same directory. Like Kotlin's file-per-class but explicit.
+mod daemon;
 mod ffi;
 mod models;
+#[cfg(target_os = "linux")]
+mod watch;
 
+use std::io::{IsTerminal, Read, Seek, Write};
+use std::os::fd::{AsFd, AsRawFd};
 use std::process;
+use std::sync::{Arc, Mutex};
+use std::time::{Duration, Instant};
 
-use clap::{Parser, Subcommand};
+use clap::{Parser, Subcommand, ValueEnum};
 use colored::Colorize;
+use serde::{Deserialize, Serialize};
 
-use crate::models::Resource;
+use crate::models::{
+    BatchReport, BatchResult, ClientStats, ExtractReport, Resource, SyncAction, SyncReport,
+    UploadOutcome,
+};
 
 // ---------------------------------------------------------------------------
 // CLI definition using clap's derive macros
@@ -44,7 +57,9 @@ use crate::models::Resource;
 // rather than runtime — if your CLI definition has a typo, it won't compile.
 
 /// krfiles — Filebrowser CLI powered by Kotlin Multiplatform
-#[derive(Parser)]
+///
+/// Serializable so an invocation can hand its parsed arguments to the daemon.
+#[derive(Parser, Clone, Serialize, Deserialize)]
 #[command(name = "krfiles", version, about)]
 struct Cli {
     /// Server URL (overrides stored default)
@@ -55,6 +70,64 @@ struct Cli {
     #[arg(long, global = true, env = "KRFILES_TOKEN")]
     token: Option<String>,
 
+    /// Cache file and directory metadata for this many seconds between runs
+    /// (0 disables). Alternatively set KRFILES_CACHE_TTL.
+    #[arg(
+        long,
+        global = true,
+        env = "KRFILES_CACHE_TTL",
+        default_value_t = 0,
+        value_name = "SECS"
+    )]
+    cache_ttl: u64,
+
+    /// Give up connecting to the server after this many seconds (0 waits for the OS).
+    #[arg(long, global = true, default_value_t = 30, value_name = "SECS")]
+    connect_timeout: u64,
+
+    /// Fail any single request, body included, that takes longer than this many
+    /// seconds (0, the default, never does). Leave room for large transfers.
+    #[arg(long, global = true, default_value_t = 0, value_name = "SECS")]
+    timeout: u64,
+
+    /// Accept compressed file downloads as well as API responses; pays off for
+    /// text-heavy trees behind a compressing proxy
+    #[arg(long, global = true)]
+    compress: bool,
+
+    /// Cap the bandwidth of all transfers together, in bytes per second:
+    /// 800, 500K, 1.5M or 2G (powers of 1024)
+    #[arg(long, global = true, value_name = "RATE", value_parser = parse_rate)]
+    limit_rate: Option<u64>,
+
+    /// Cap the bandwidth of each file transfer, in the units of --limit-rate
+    #[arg(long, global = true, value_name = "RATE", value_parser = parse_rate)]
+    limit_rate_per_file: Option<u64>,
+
+    /// Most requests in flight at once; below this, concurrency backs off
+    /// while the server is slow or answers 429/503, and recovers after
+    #[arg(long, global = true, value_name = "N", value_parser = clap::value_parser!(u32).range(1..=1024))]
+    max_requests: Option<u32>,
+
+    /// Retry failed lookups, listings and searches up to N times, with
+    /// jittered backoff, on network errors and 408/429/5xx (default 2; 0 to fail at once)
+    #[arg(long, global = true, value_name = "N", value_parser = clap::value_parser!(u32).range(0..=100))]
+    retries: Option<u32>,
+
+    /// Send a second request for a lookup, listing or search still
+    /// unanswered after MS milliseconds, and keep whichever answers first
+    #[arg(long, global = true, value_name = "MS", value_parser = clap::value_parser!(u64).range(1..))]
+    hedge_after: Option<u64>,
+
+    /// Print request counts and latencies per endpoint to stderr when done
+    #[arg(long, global = true)]
+    stats: bool,
+
+    /// Run in this process even if `krfiles daemon` is running.
+    /// Alternatively set KRFILES_NO_DAEMON=1.
+    #[arg(long, global = true, env = "KRFILES_NO_DAEMON")]
+    no_daemon: bool,
+
     #[command(subcommand)]
     command: Commands,
 }
@@ -63,7 +136,7 @@ struct Cli {
 ///
 /// In Rust, enums can hold data — unlike Java/Kotlin enums which are just
 /// constants. Each variant here is like a different data class.
-#[derive(Subcommand)]
+#[derive(Subcommand, Clone, Serialize, Deserialize)]
 enum Commands {
     /// Authenticate with a Filebrowser server
     Login {
@@ -83,6 +156,38 @@ enum Commands {
         /// Path to list (defaults to root)
         #[arg(default_value = "/")]
         path: String,
+        /// List subdirectories recursively
+        #[arg(short = 'R', long)]
+        recursive: bool,
+        /// Directory listings in flight when recursing
+        #[arg(short = 'j', long, default_value_t = DEFAULT_JOBS, value_parser = jobs_parser())]
+        jobs: u32,
+    },
+
+    /// Show the total size of a directory tree
+    Du {
+        /// Directory to measure
+        #[arg(default_value = "/")]
+        path: String,
+        /// Directory listings in flight
+        #[arg(short = 'j', long, default_value_t = DEFAULT_JOBS, value_parser = jobs_parser())]
+        jobs: u32,
+    },
+
+    /// Find files and directories below a path
+    Find {
+        /// Directory to search from
+        #[arg(default_value = "/")]
+        path: String,
+        /// Only match names against this glob (`*` and `?` wildcards)
+        #[arg(long)]
+        name: Option<String>,
+        /// Only match files (f) or directories (d)
+        #[arg(long = "type", value_enum)]
+        kind: Option<EntryKind>,
+        /// Directory listings in flight
+        #[arg(short = 'j', long, default_value_t = DEFAULT_JOBS, value_parser = jobs_parser())]
+        jobs: u32,
     },
 
     /// Get info about a file or directory
@@ -95,19 +200,49 @@ enum Commands {
     Get {
         /// Remote file path
         remote_path: String,
-        /// Local file path (defaults to filename from remote path)
+        /// Local file path (defaults to filename from remote path; `-` for stdout)
         local_path: Option<String>,
+        /// Fetch large files as this many parallel range requests
+        #[arg(long, default_value_t = 1, value_parser = clap::value_parser!(u32).range(1..=64))]
+        segments: u32,
+        /// Continue a partial local file, and keep it if the download fails
+        #[arg(short = 'c', long)]
+        resume: bool,
+        /// Check the file against the server's SHA-256 while it is written
+        #[arg(long)]
+        verify: bool,
+        /// Download a directory into a local directory, file by file
+        #[arg(short = 'r', long, conflicts_with_all = ["segments", "resume", "verify"])]
+        recursive: bool,
+        /// With -r, fetch the whole tree as one tar stream, unpacked as it arrives
+        #[arg(long, requires = "recursive")]
+        archive: bool,
+        /// With --archive, only extract entries matching this glob (repeatable)
+        #[arg(long, requires = "archive")]
+        include: Vec<String>,
+        /// With --archive, skip entries matching this glob (repeatable)
+        #[arg(long, requires = "archive")]
+        exclude: Vec<String>,
     },
 
-    /// Upload a file
+    /// Upload a file (chunked and resumable)
     Put {
-        /// Local file path
+        /// Local file path (`-` for stdin)
         local_path: String,
         /// Remote file path
         remote_path: String,
         /// Overwrite if exists
         #[arg(short = 'f', long)]
         force: bool,
+        /// Upload chunk size in MiB
+        #[arg(long, default_value_t = 8, value_parser = clap::value_parser!(u32).range(1..=1024))]
+        chunk_size: u32,
+        /// Skip the upload if the remote file has the same size and SHA-256
+        #[arg(long)]
+        verify: bool,
+        /// Bytes to read from stdin; needed when it is a pipe, as the size is sent first
+        #[arg(long)]
+        size: Option<u64>,
     },
 
     /// Delete a file or directory
@@ -144,6 +279,42 @@ enum Commands {
         path: String,
     },
 
+    /// Transfer only what changed between a local and a remote directory
+    Sync {
+        /// Local directory
+        local_dir: String,
+        /// Remote directory
+        remote_dir: String,
+        /// Pull remote changes into the local directory instead of pushing
+        #[arg(long)]
+        pull: bool,
+        /// Print the plan without transferring anything
+        #[arg(short = 'n', long)]
+        dry_run: bool,
+        /// Push: ignore the cached manifest and list every remote directory (pulls always do)
+        #[arg(long)]
+        rescan: bool,
+        /// Files transferred in parallel
+        #[arg(short = 'j', long, default_value_t = 4, value_parser = clap::value_parser!(u32).range(1..=64))]
+        jobs: u32,
+    },
+
+    /// Run many delete/rename/copy/mkdir operations from a JSON Lines file
+    ///
+    /// One operation per line, e.g. {"op":"rename","path":"/a","destination":"/b"}.
+    /// Ops are delete, rename, copy and mkdir; rename and copy take "override".
+    /// Blank lines and lines starting with # are ignored.
+    Batch {
+        /// Operations file (`-` for stdin)
+        file: String,
+        /// Operations in flight at once (1 runs them in order)
+        #[arg(short = 'j', long, default_value_t = 8, value_parser = clap::value_parser!(u32).range(1..=256))]
+        jobs: u32,
+        /// Start no further operations after the first failure
+        #[arg(long)]
+        stop_on_error: bool,
+    },
+
     /// Search for files
     Search {
         /// Search query
@@ -151,7 +322,102 @@ enum Commands {
         /// Path to search within
         #[arg(default_value = "/")]
         path: String,
+        /// Stop after this many results
+        #[arg(short = 'n', long)]
+        limit: Option<u32>,
     },
+
+    /// Upload changes in a local directory to a remote one as they happen (Linux)
+    ///
+    /// Directories are watched with inotify, so nothing is rescanned. Events
+    /// on a path are collected until it has been quiet for --settle, then sent
+    /// as one change: repeated writes become one upload, a file created and
+    /// deleted again is never sent, and renames are renamed on the server.
+    /// Runs until Ctrl-C.
+    Watch {
+        /// Local directory
+        local_dir: String,
+        /// Remote directory
+        remote_dir: String,
+        /// Quiet time before a changed path is sent, in milliseconds (a file
+        /// that keeps changing waits at most 20 times as long)
+        #[arg(long, default_value_t = 500, value_name = "MS", value_parser = clap::value_parser!(u64).range(10..=60_000))]
+        settle: u64,
+        /// Changes sent in parallel
+        #[arg(short = 'j', long, default_value_t = 4, value_parser = clap::value_parser!(u32).range(1..=64))]
+        jobs: u32,
+        /// Push the whole tree once before watching, to catch up on changes
+        /// made while nothing was watching
+        #[arg(long)]
+        sync: bool,
+    },
+
+    /// Keep clients warm for other invocations, serving them over a Unix socket
+    ///
+    /// While it runs, other krfiles commands hand their work to it and reuse
+    /// its connections and caches instead of starting from scratch. The socket
+    /// is $KRFILES_DAEMON_SOCKET, else $XDG_RUNTIME_DIR/krfiles.sock, else
+    /// daemon.sock in a private /tmp/krfiles-<uid> directory.
+    Daemon {
+        /// Stop the running daemon
+        #[arg(long)]
+        stop: bool,
+    },
+}
+
+/// Entry type filter for `find --type`.
+#[derive(Clone, Copy, ValueEnum, Serialize, Deserialize)]
+enum EntryKind {
+    /// Regular files
+    F,
+    /// Directories
+    D,
+}
+
+/// Paths kept by the metadata cache enabled with `--cache-ttl`.
+const CACHE_ENTRIES: i32 = 1024;
+
+/// Transport and cache settings from the global flags.
+fn client_config(cli: &Cli) -> ffi::ClientConfig {
+    let millis = |secs: u64| i64::try_from(secs.saturating_mul(1000)).unwrap_or(i64::MAX);
+    ffi::ClientConfig {
+        connect_timeout_millis: (cli.connect_timeout > 0).then(|| millis(cli.connect_timeout)),
+        request_timeout_millis: (cli.timeout > 0).then(|| millis(cli.timeout)),
+        compress_transfers: cli.compress,
+        cache_entries: if cli.cache_ttl > 0 { CACHE_ENTRIES } else { 0 },
+        cache_ttl_millis: millis(cli.cache_ttl),
+        persistent_cache: true,
+        max_bytes_per_second: cli.limit_rate.unwrap_or(0),
+        max_transfer_bytes_per_second: cli.limit_rate_per_file.unwrap_or(0),
+        max_concurrency: cli.max_requests,
+        max_attempts: cli.retries.map(|n| n + 1),
+        hedge_after_millis: cli.hedge_after,
+    }
+}
+
+/// Parse a byte rate such as `800`, `500K`, `1.5M` or `2G`, in powers of
+/// 1024; a trailing `B` or `/s` is accepted.
+fn parse_rate(value: &str) -> Result<u64, String> {
+    let rate = value.trim().trim_end_matches("/s");
+    let rate = rate.strip_suffix(['B', 'b']).unwrap_or(rate);
+    let (number, multiplier) = match rate.chars().last().map(|c| c.to_ascii_uppercase()) {
+        Some('K') => (&rate[..rate.len() - 1], 1024.0),
+        Some('M') => (&rate[..rate.len() - 1], 1024.0 * 1024.0),
+        Some('G') => (&rate[..rate.len() - 1], 1024.0 * 1024.0 * 1024.0),
+        _ => (rate, 1.0),
+    };
+    match number.parse::<f64>() {
+        Ok(n) if n.is_finite() && n > 0.0 => Ok(((n * multiplier) as u64).max(1)),
+        _ => Err(format!("`{value}` is not a rate like 500K, 10M or 1G")),
+    }
+}
+
+/// Default number of concurrent directory listings for tree walks.
+const DEFAULT_JOBS: u32 = 16;
+
+/// Accepts 1..=256 concurrent listings; more mostly just loads the server.
+fn jobs_parser() -> clap::builder::RangedI64ValueParser<u32> {
+    clap::value_parser!(u32).range(1..=256)
 }
 
 // ---------------------------------------------------------------------------
@@ -163,9 +429,9 @@ enum Commands {
 // Into:
 //   fn main() { tokio::runtime::Runtime::new().block_on(async { ... }) }
 //
-// We use async here so we CAN use spawn_blocking for the FFI calls,
-// though for a simple CLI doing one operation at a time, it's mostly
-// for consistency and future-proofing (e.g., progress indicators).
+// The ffi::Client methods are async: each one submits the operation to the
+// Kotlin library and awaits its completion callback, so no thread sits
+// blocked while the HTTP request is in flight.
 
 #[tokio::main]
 async fn main() {
@@ -175,13 +441,8 @@ async fn main() {
     // Run the command, print errors nicely
     if let Err(e) = run(cli).await {
         eprintln!("{} {e}", "error:".red().bold());
-        // Clean up Kotlin resources before exiting
-        ffi::destroy_client();
         process::exit(1);
     }
-
-    // Always clean up — this closes the Ktor HttpClient inside Kotlin
-    ffi::destroy_client();
 }
 
 /// Dispatch to the right command handler.
@@ -199,50 +460,155 @@ async fn run(cli: Cli) -> Result<(), String> {
             password,
         } => cmd_login(&server, &username, password).await,
 
+        Commands::Daemon { stop: true } => daemon::stop(),
+        Commands::Daemon { stop: false } => daemon::serve().await,
+
         // All other commands need an authenticated client
         _ => {
+            // A watch runs until interrupted and would keep the daemon busy.
+            if !cli.no_daemon && !matches!(cli.command, Commands::Watch { .. }) {
+                if let Some(status) = daemon::forward(&cli)? {
+                    process::exit(status);
+                }
+            }
+            let config = client_config(&cli);
             let server = cli
                 .server
+                .as_deref()
                 .ok_or("No server specified. Use --server URL or login first.")?;
 
-            // Initialize the Kotlin client
-            ffi::create_client(&server);
-
-            // Authenticate with stored token if available
-            let token = cli.token.ok_or(
-                "No token provided. Use --token, set KRFILES_TOKEN, or run `krfiles login` first.",
-            )?;
-            ffi::set_token(&token);
-
-            match cli.command {
-                Commands::Ls { path } => cmd_ls(&path).await,
-                Commands::Info { path } => cmd_info(&path).await,
-                Commands::Get {
-                    remote_path,
-                    local_path,
-                } => cmd_get(&remote_path, local_path).await,
-                Commands::Put {
-                    local_path,
-                    remote_path,
-                    force,
-                } => cmd_put(&local_path, &remote_path, force).await,
-                Commands::Rm { path } => cmd_rm(&path).await,
-                Commands::Mv {
-                    source,
-                    destination,
-                    force,
-                } => cmd_mv(&source, &destination, force).await,
-                Commands::Cp {
-                    source,
-                    destination,
-                    force,
-                } => cmd_cp(&source, &destination, force).await,
-                Commands::Mkdir { path } => cmd_mkdir(&path).await,
-                Commands::Search { query, path } => cmd_search(&query, &path).await,
-                Commands::Login { .. } => unreachable!(),
+            // Initialize the Kotlin client. The handle is freed (and the Ktor
+            // HttpClient closed) when `client` is dropped.
+            let client = ffi::Client::with_config(server, &config)?;
+            run_command(&client, cli).await
+        }
+    }
+}
+
+/// Run a command that needs an authenticated client, here or in the daemon.
+async fn run_command(client: &ffi::Client, cli: Cli) -> Result<(), String> {
+    // Authenticate with stored token if available
+    let token = cli.token.ok_or(
+        "No token provided. Use --token, set KRFILES_TOKEN, or run `krfiles login` first.",
+    )?;
+    client.set_token(&token);
+
+    let result = match cli.command {
+        Commands::Ls {
+            path,
+            recursive: false,
+            ..
+        } => cmd_ls(client, &path).await,
+        Commands::Ls { path, jobs, .. } => cmd_ls_recursive(client, &path, jobs).await,
+        Commands::Du { path, jobs } => cmd_du(client, &path, jobs).await,
+        Commands::Find {
+            path,
+            name,
+            kind,
+            jobs,
+        } => cmd_find(client, &path, name.as_deref(), kind, jobs).await,
+        Commands::Info { path } => cmd_info(client, &path).await,
+        Commands::Get {
+            remote_path,
+            local_path,
+            recursive: true,
+            archive,
+            include,
+            exclude,
+            ..
+        } => {
+            // Default local directory: last segment of the remote path.
+            let local = local_path.unwrap_or_else(|| default_local_name(&remote_path));
+            if archive {
+                cmd_get_archive(client, &remote_path, &local, include, exclude).await
+            } else {
+                cmd_sync(client, &local, &remote_path, ffi::SYNC_PULL, 4).await
             }
         }
+        Commands::Get {
+            remote_path,
+            local_path,
+            segments,
+            resume,
+            verify,
+            ..
+        } => {
+            let flags = (if resume { ffi::TRANSFER_RESUME } else { 0 })
+                | (if verify { ffi::TRANSFER_VERIFY } else { 0 });
+            cmd_get(client, &remote_path, local_path, segments, flags).await
+        }
+        Commands::Put {
+            local_path,
+            remote_path,
+            force,
+            chunk_size,
+            verify,
+            size,
+        } => {
+            let flags = (if force { ffi::TRANSFER_OVERRIDE } else { 0 })
+                | (if verify {
+                    ffi::TRANSFER_SKIP_IDENTICAL
+                } else {
+                    0
+                });
+            cmd_put(client, &local_path, &remote_path, flags, chunk_size, size).await
+        }
+        Commands::Rm { path } => cmd_rm(client, &path).await,
+        Commands::Mv {
+            source,
+            destination,
+            force,
+        } => cmd_mv(client, &source, &destination, force).await,
+        Commands::Cp {
+            source,
+            destination,
+            force,
+        } => cmd_cp(client, &source, &destination, force).await,
+        Commands::Mkdir { path } => cmd_mkdir(client, &path).await,
+        Commands::Batch {
+            file,
+            jobs,
+            stop_on_error,
+        } => cmd_batch(client, &file, jobs, stop_on_error).await,
+        Commands::Sync {
+            local_dir,
+            remote_dir,
+            pull,
+            dry_run,
+            rescan,
+            jobs,
+        } => {
+            let flags = (if pull { ffi::SYNC_PULL } else { 0 })
+                | (if dry_run { ffi::SYNC_DRY_RUN } else { 0 })
+                | (if rescan { ffi::SYNC_RESCAN } else { 0 });
+            cmd_sync(client, &local_dir, &remote_dir, flags, jobs).await
+        }
+        Commands::Search { query, path, limit } => {
+            cmd_search(client, &query, &path, limit.unwrap_or(0)).await
+        }
+        #[cfg(target_os = "linux")]
+        Commands::Watch {
+            local_dir,
+            remote_dir,
+            settle,
+            jobs,
+            sync,
+        } => {
+            let options = watch::Options {
+                settle: Duration::from_millis(settle),
+                jobs: jobs as usize,
+                initial_sync: sync,
+            };
+            watch::run(client, &local_dir, &remote_dir, options).await
+        }
+        #[cfg(not(target_os = "linux"))]
+        Commands::Watch { .. } => Err("watch needs inotify, which only Linux has".into()),
+        Commands::Login { .. } | Commands::Daemon { .. } => unreachable!(),
+    };
+    if cli.stats {
+        print_stats(client);
     }
+    result
 }
 
 // ---------------------------------------------------------------------------
@@ -250,7 +616,7 @@ async fn run(cli: Cli) -> Result<(), String> {
 // ---------------------------------------------------------------------------
 //
 // Each command follows the same pattern:
-// 1. Call ffi:: functions (which call Kotlin via the C shim)
+// 1. Call ffi::Client methods (which call Kotlin via the C shim)
 // 2. For JSON responses, deserialize with serde into our model structs
 // 3. Format and print the output
 
@@ -262,79 +628,113 @@ async fn cmd_login(server: &str, username: &str, password: Option<String>) -> Re
             // eprint! writes to stderr so it doesn't interfere with piped output
             eprint!("Password: ");
             // Read password without echoing — like sudo does.
-            // This is a simple sync call, no need for spawn_blocking.
             rpassword::read_password().map_err(|e| format!("Failed to read password: {e}"))?
         }
     };
 
-    ffi::create_client(server);
-
-    // spawn_blocking moves this closure to a thread pool thread,
-    // because ffi::login blocks (Kotlin's runBlocking is running underneath).
-    // The .await waits for that thread to finish.
-    let token = tokio::task::spawn_blocking({
-        // We need to clone these strings because the closure takes ownership.
-        // In Rust, each value has exactly one owner — to give the closure its
-        // own copy, we clone. (Kotlin doesn't have this; it just reference-counts.)
-        let username = username.to_owned();
-        let password = password.clone();
-        // `move` means: take ownership of username and password into the closure.
-        // Without it, the closure would try to borrow them, but the closure
-        // outlives this function (it runs on another thread), so borrowing
-        // wouldn't be safe — the compiler would reject it.
-        move || ffi::login(&username, &password)
-    })
-    .await
-    .map_err(|e| format!("Task failed: {e}"))??;
-    // ^^ Two ?? because spawn_blocking returns Result<Result<String, String>, JoinError>
-    //    First ? unwraps the JoinError, second ? unwraps our ffi::login Result.
+    let client = ffi::Client::new(server);
+
+    // login() returns a Future; .await suspends this task until Kotlin calls
+    // back with the token. The ? unwraps the Result, returning early on error.
+    let token = client.login(username, &password).await?;
 
     println!("{} Logged in to {server}", "✓".green().bold());
     println!("  Token: {}...", &token[..20.min(token.len())]);
     Ok(())
 }
 
-async fn cmd_ls(path: &str) -> Result<(), String> {
-    let json = tokio::task::spawn_blocking({
-        let path = path.to_owned();
-        move || ffi::list_directory(&path)
-    })
-    .await
-    .map_err(|e| format!("Task failed: {e}"))??;
+async fn cmd_ls(client: &ffi::Client, path: &str) -> Result<(), String> {
+    let (mut files, mut dirs) = (0u64, 0u64);
+    // Print entries as they stream in; the listing blocks between them, so
+    // keep it off the async workers.
+    tokio::task::block_in_place(|| {
+        for entry in client.list_stream(path)? {
+            // Deserialize the JSON into our Resource struct.
+            // serde_json::from_str parses the string and fills in the struct fields.
+            // Fields marked #[serde(default)] get their default if missing from JSON.
+            let item: Resource = serde_json::from_str(&entry?)
+                .map_err(|e| format!("Failed to parse response: {e}"))?;
+            if item.is_dir {
+                dirs += 1;
+            } else {
+                files += 1;
+            }
+            print_resource_line(&item);
+        }
+        Ok::<_, String>(())
+    })?;
 
-    // Deserialize the JSON into our Resource struct.
-    // serde_json::from_str parses the string and fills in the struct fields.
-    // Fields marked #[serde(default)] get their default if missing from JSON.
-    let resource: Resource =
-        serde_json::from_str(&json).map_err(|e| format!("Failed to parse response: {e}"))?;
+    if files + dirs == 0 {
+        println!("(empty directory)");
+    } else {
+        println!("\n{files} files, {dirs} directories");
+    }
+    Ok(())
+}
 
-    // Print directory listing
-    if let Some(items) = &resource.items {
-        if items.is_empty() {
-            println!("(empty directory)");
+async fn cmd_ls_recursive(client: &ffi::Client, path: &str, jobs: u32) -> Result<(), String> {
+    let (mut files, mut dirs) = (0u64, 0u64);
+    // Entries arrive in discovery order across directories, so print full paths.
+    walk(client, path, jobs, |entry| {
+        if entry.is_dir {
+            dirs += 1;
+            println!("  {}/", entry.path.blue().bold());
         } else {
-            for item in items {
-                print_resource_line(item);
-            }
+            files += 1;
             println!(
-                "\n{} files, {} directories",
-                resource.num_files, resource.num_dirs
+                "  {:<60} {:>10}",
+                entry.path,
+                format_size(entry.size).dimmed()
             );
         }
-    } else {
-        println!("(not a directory)");
-    }
+    })
+    .await?;
+
+    println!("\n{files} files, {dirs} directories");
+    Ok(())
+}
+
+async fn cmd_du(client: &ffi::Client, path: &str, jobs: u32) -> Result<(), String> {
+    let (mut bytes, mut files, mut dirs) = (0f64, 0u64, 0u64);
+    walk(client, path, jobs, |entry| {
+        if entry.is_dir {
+            dirs += 1;
+        } else {
+            files += 1;
+            bytes += entry.size;
+        }
+    })
+    .await?;
 
+    println!(
+        "{:>10}  {path}  ({files} files, {dirs} directories)",
+        format_size(bytes)
+    );
     Ok(())
 }
 
-async fn cmd_info(path: &str) -> Result<(), String> {
-    let json = tokio::task::spawn_blocking({
-        let path = path.to_owned();
-        move || ffi::get_resource(&path)
+async fn cmd_find(
+    client: &ffi::Client,
+    path: &str,
+    name: Option<&str>,
+    kind: Option<EntryKind>,
+    jobs: u32,
+) -> Result<(), String> {
+    walk(client, path, jobs, |entry| {
+        let kind_matches = match kind {
+            Some(EntryKind::F) => !entry.is_dir,
+            Some(EntryKind::D) => entry.is_dir,
+            None => true,
+        };
+        if kind_matches && name.is_none_or(|pattern| glob_match(pattern, &entry.name)) {
+            println!("{}", entry.path);
+        }
     })
     .await
-    .map_err(|e| format!("Task failed: {e}"))??;
+}
+
+async fn cmd_info(client: &ffi::Client, path: &str) -> Result<(), String> {
+    let json = client.get_resource(path).await?;
 
     let resource: Resource =
         serde_json::from_str(&json).map_err(|e| format!("Failed to parse response: {e}"))?;
@@ -355,115 +755,381 @@ async fn cmd_info(path: &str) -> Result<(), String> {
     Ok(())
 }
 
-async fn cmd_get(remote_path: &str, local_path: Option<String>) -> Result<(), String> {
+async fn cmd_get(
+    client: &ffi::Client,
+    remote_path: &str,
+    local_path: Option<String>,
+    segments: u32,
+    flags: i32,
+) -> Result<(), String> {
     // Default local filename: last segment of the remote path.
+    let local = local_path.unwrap_or_else(|| default_local_name(remote_path));
+
+    let progress = Arc::new(Mutex::new(Progress::new()));
+
+    // `-` streams to stdout chunk by chunk, so pipelines never touch the disk.
+    if local == "-" {
+        if flags != 0 || segments > 1 {
+            return Err("--resume, --verify and --segments need a local file, not stdout".into());
+        }
+        let stdout = std::io::stdout();
+        // The library writes to the descriptor directly, behind Rust's buffer.
+        stdout
+            .lock()
+            .flush()
+            .map_err(|e| format!("Failed to write to stdout: {e}"))?;
+        let result = client
+            .download_to_fd(
+                remote_path,
+                stdout.as_raw_fd(),
+                progress_callback(&progress),
+            )
+            .await;
+        progress.lock().unwrap().finish();
+        return result;
+    }
+
+    let result = client
+        .download_to_file(
+            remote_path,
+            &local,
+            segments as usize,
+            flags,
+            progress_callback(&progress),
+        )
+        .await;
+    progress.lock().unwrap().finish();
+    result?;
+
+    let verified = if flags & ffi::TRANSFER_VERIFY != 0 {
+        " (checksum verified)"
+    } else {
+        ""
+    };
+    println!(
+        "{} Downloaded {remote_path} → {local}{verified}",
+        "✓".green().bold()
+    );
+    Ok(())
+}
+
+/// Last segment of a remote path, used when no local name is given.
+fn default_local_name(remote_path: &str) -> String {
     // rsplit('/') splits from the right and takes the first piece = filename.
-    let local = local_path.unwrap_or_else(|| {
-        remote_path
-            .rsplit('/')
-            .next()
-            .unwrap_or("download")
-            .to_string()
-    });
+    remote_path
+        .trim_end_matches('/')
+        .rsplit('/')
+        .next()
+        .filter(|name| !name.is_empty())
+        .unwrap_or("download")
+        .to_string()
+}
 
-    tokio::task::spawn_blocking({
-        let remote = remote_path.to_owned();
-        let local = local.clone();
-        move || ffi::download_to_file(&remote, &local)
-    })
-    .await
-    .map_err(|e| format!("Task failed: {e}"))??;
+async fn cmd_get_archive(
+    client: &ffi::Client,
+    remote_path: &str,
+    local_dir: &str,
+    include: Vec<String>,
+    exclude: Vec<String>,
+) -> Result<(), String> {
+    let filter = (!include.is_empty() || !exclude.is_empty())
+        .then(|| serde_json::json!({ "include": include, "exclude": exclude }).to_string());
+    let progress = Arc::new(Mutex::new(Progress::new()));
+    let result = client
+        .extract_archive(
+            remote_path,
+            local_dir,
+            filter.as_deref(),
+            progress_callback(&progress),
+        )
+        .await;
+    progress.lock().unwrap().finish();
+    let report: ExtractReport =
+        serde_json::from_str(&result?).map_err(|e| format!("Failed to parse response: {e}"))?;
 
-    println!("{} Downloaded {remote_path} → {local}", "✓".green().bold());
+    println!(
+        "{} Extracted {remote_path} → {local_dir}: {} files, {} directories, {}",
+        "✓".green().bold(),
+        report.files,
+        report.directories,
+        format_size(report.bytes as f64)
+    );
+    if report.skipped > 0 {
+        println!("  ({} entries skipped)", report.skipped);
+    }
     Ok(())
 }
 
-async fn cmd_put(local_path: &str, remote_path: &str, force: bool) -> Result<(), String> {
-    tokio::task::spawn_blocking({
-        let remote = remote_path.to_owned();
-        let local = local_path.to_owned();
-        move || ffi::upload_from_file(&remote, &local, force)
-    })
-    .await
-    .map_err(|e| format!("Task failed: {e}"))??;
+async fn cmd_put(
+    client: &ffi::Client,
+    local_path: &str,
+    remote_path: &str,
+    flags: i32,
+    chunk_size_mib: u32,
+    size: Option<u64>,
+) -> Result<(), String> {
+    let chunk_size = chunk_size_mib as usize * 1024 * 1024;
+    let progress = Arc::new(Mutex::new(Progress::new()));
+    let result = if local_path == "-" {
+        if flags & ffi::TRANSFER_SKIP_IDENTICAL != 0 {
+            return Err("--verify needs a local file, not stdin".into());
+        }
+        // Streamed chunk by chunk: only the upload's read-ahead is held in memory.
+        let size = match size {
+            Some(size) => size,
+            None => stdin_size()?,
+        };
+        client
+            .upload_from_fd(
+                remote_path,
+                std::io::stdin().as_raw_fd(),
+                size,
+                flags & ffi::TRANSFER_OVERRIDE != 0,
+                chunk_size,
+                progress_callback(&progress),
+            )
+            .await
+            .map(|_| UploadOutcome::default())
+    } else if size.is_some() {
+        return Err("--size only applies to stdin (`-`)".into());
+    } else {
+        client
+            .upload_from_file(
+                remote_path,
+                local_path,
+                flags,
+                chunk_size,
+                progress_callback(&progress),
+            )
+            .await
+            .and_then(|json| {
+                serde_json::from_str::<UploadOutcome>(&json)
+                    .map_err(|e| format!("Failed to parse response: {e}"))
+            })
+    };
+    progress.lock().unwrap().finish();
+
+    if result?.skipped {
+        println!(
+            "{} {remote_path} already matches {local_path}, nothing sent",
+            "✓".green().bold()
+        );
+    } else {
+        println!(
+            "{} Uploaded {local_path} → {remote_path}",
+            "✓".green().bold()
+        );
+    }
+    Ok(())
+}
 
+/// Bytes left in stdin when it is a regular file; a pipe's size isn't known up front.
+fn stdin_size() -> Result<u64, String> {
+    let stdin = std::io::stdin();
+    let fd = stdin
+        .as_fd()
+        .try_clone_to_owned()
+        .map_err(|e| format!("Failed to read stdin: {e}"))?;
+    let mut file = std::fs::File::from(fd);
+    let metadata = file
+        .metadata()
+        .map_err(|e| format!("Failed to read stdin: {e}"))?;
+    if !metadata.is_file() {
+        return Err("Uploading from a pipe needs --size, as tus sends the length first".into());
+    }
+    // The duplicate shares stdin's offset, so this is where the upload will start.
+    let position = file
+        .stream_position()
+        .map_err(|e| format!("Failed to read stdin: {e}"))?;
+    Ok(metadata.len().saturating_sub(position))
+}
+
+async fn cmd_sync(
+    client: &ffi::Client,
+    local_dir: &str,
+    remote_dir: &str,
+    flags: i32,
+    jobs: u32,
+) -> Result<(), String> {
+    // Steps are printed as they finish; the report only adds the totals.
+    let on_action: ffi::OnAction = Box::new(|json| {
+        if let Ok(action) = serde_json::from_str::<SyncAction>(json) {
+            print_sync_action(&action);
+        }
+    });
+    let json = client
+        .sync(local_dir, remote_dir, flags, jobs as usize, on_action)
+        .await?;
+    let report: SyncReport =
+        serde_json::from_str(&json).map_err(|e| format!("Failed to parse response: {e}"))?;
+
+    if report.dry_run {
+        report.actions.iter().for_each(print_sync_action);
+    }
+    let failed = report.actions.iter().filter(|a| a.error.is_some()).count();
+    let bytes: i64 = report
+        .actions
+        .iter()
+        .filter(|a| a.error.is_none())
+        .map(|a| a.size)
+        .sum();
+    let verb = if report.dry_run {
+        "to transfer"
+    } else {
+        "transferred"
+    };
     println!(
-        "{} Uploaded {local_path} → {remote_path}",
-        "✓".green().bold()
+        "\n{} {verb} ({}), {} unchanged, {} directories listed, {} from manifest",
+        report.actions.len() - failed,
+        format_size(bytes as f64),
+        report.unchanged,
+        report.listed_directories,
+        report.cached_directories,
     );
+    if failed > 0 {
+        return Err(format!("{failed} of {} steps failed", report.actions.len()));
+    }
     Ok(())
 }
 
-async fn cmd_rm(path: &str) -> Result<(), String> {
-    tokio::task::spawn_blocking({
-        let path = path.to_owned();
-        move || ffi::delete(&path)
-    })
-    .await
-    .map_err(|e| format!("Task failed: {e}"))??;
+/// One batch operation as read from the input, for error messages.
+struct BatchLine {
+    number: usize,
+    summary: String,
+}
+
+async fn cmd_batch(
+    client: &ffi::Client,
+    file: &str,
+    jobs: u32,
+    stop_on_error: bool,
+) -> Result<(), String> {
+    let input = if file == "-" {
+        let mut text = String::new();
+        std::io::stdin()
+            .read_to_string(&mut text)
+            .map_err(|e| format!("Failed to read stdin: {e}"))?;
+        text
+    } else {
+        std::fs::read_to_string(file).map_err(|e| format!("Failed to read {file}: {e}"))?
+    };
+
+    // Check every line up front, so a typo on line 9000 fails before anything runs.
+    let mut lines = Vec::new();
+    let mut operations = Vec::new();
+    for (i, line) in input.lines().enumerate() {
+        let line = line.trim();
+        if line.is_empty() || line.starts_with('#') {
+            continue;
+        }
+        let op: serde_json::Value =
+            serde_json::from_str(line).map_err(|e| format!("Line {}: {e}", i + 1))?;
+        let field = |name: &str| op[name].as_str().unwrap_or("?").to_string();
+        lines.push(BatchLine {
+            number: i + 1,
+            summary: format!("{} {}", field("op"), field("path")),
+        });
+        operations.push(line);
+    }
+    if operations.is_empty() {
+        println!("(no operations)");
+        return Ok(());
+    }
+
+    // Failures are printed as they happen; successes only count towards the totals.
+    let lines = Arc::new(lines);
+    let on_result: ffi::OnAction = Box::new({
+        let lines = Arc::clone(&lines);
+        move |json| {
+            let Ok(result) = serde_json::from_str::<BatchResult>(json) else {
+                return;
+            };
+            if let (Some(error), Some(line)) = (&result.error, lines.get(result.index)) {
+                println!(
+                    "  {} line {}: {}  {}",
+                    "✗".red().bold(),
+                    line.number,
+                    line.summary,
+                    error.red()
+                );
+            }
+        }
+    });
+    let json = client
+        .batch(
+            &format!("[{}]", operations.join(",")),
+            jobs as usize,
+            stop_on_error,
+            on_result,
+        )
+        .await?;
+    let report: BatchReport =
+        serde_json::from_str(&json).map_err(|e| format!("Failed to parse response: {e}"))?;
+
+    let succeeded = report.results.iter().filter(|r| r.ok).count();
+    let skipped = report.results.iter().filter(|r| r.skipped).count();
+    let failed = report.results.len() - succeeded - skipped;
+    println!("\n{succeeded} succeeded, {failed} failed, {skipped} skipped");
+    if failed > 0 {
+        return Err(format!(
+            "{failed} of {} operations failed",
+            report.results.len()
+        ));
+    }
+    Ok(())
+}
+
+async fn cmd_rm(client: &ffi::Client, path: &str) -> Result<(), String> {
+    client.delete(path).await?;
 
     println!("{} Deleted {path}", "✓".green().bold());
     Ok(())
 }
 
-async fn cmd_mv(source: &str, dest: &str, force: bool) -> Result<(), String> {
-    tokio::task::spawn_blocking({
-        let s = source.to_owned();
-        let d = dest.to_owned();
-        move || ffi::rename(&s, &d, force)
-    })
-    .await
-    .map_err(|e| format!("Task failed: {e}"))??;
+async fn cmd_mv(client: &ffi::Client, source: &str, dest: &str, force: bool) -> Result<(), String> {
+    client.rename(source, dest, force).await?;
 
     println!("{} Moved {source} → {dest}", "✓".green().bold());
     Ok(())
 }
 
-async fn cmd_cp(source: &str, dest: &str, force: bool) -> Result<(), String> {
-    tokio::task::spawn_blocking({
-        let s = source.to_owned();
-        let d = dest.to_owned();
-        move || ffi::copy(&s, &d, force)
-    })
-    .await
-    .map_err(|e| format!("Task failed: {e}"))??;
+async fn cmd_cp(client: &ffi::Client, source: &str, dest: &str, force: bool) -> Result<(), String> {
+    client.copy(source, dest, force).await?;
 
     println!("{} Copied {source} → {dest}", "✓".green().bold());
     Ok(())
 }
 
-async fn cmd_mkdir(path: &str) -> Result<(), String> {
-    tokio::task::spawn_blocking({
-        let path = path.to_owned();
-        move || ffi::create_directory(&path)
-    })
-    .await
-    .map_err(|e| format!("Task failed: {e}"))??;
+async fn cmd_mkdir(client: &ffi::Client, path: &str) -> Result<(), String> {
+    client.create_directory(path).await?;
 
     println!("{} Created directory {path}", "✓".green().bold());
     Ok(())
 }
 
-async fn cmd_search(query: &str, path: &str) -> Result<(), String> {
-    let json = tokio::task::spawn_blocking({
-        let q = query.to_owned();
-        let p = path.to_owned();
-        move || ffi::search(&q, &p)
-    })
-    .await
-    .map_err(|e| format!("Task failed: {e}"))??;
-
-    let results: Vec<models::SearchResult> =
-        serde_json::from_str(&json).map_err(|e| format!("Failed to parse response: {e}"))?;
+async fn cmd_search(
+    client: &ffi::Client,
+    query: &str,
+    path: &str,
+    limit: u32,
+) -> Result<(), String> {
+    // Results are printed as they are decoded; none are kept.
+    let mut results = client.search_stream(query, path, limit as usize)?;
+    let mut count = 0usize;
+    while let Some(json) = results.next().await {
+        let result: models::SearchResult =
+            serde_json::from_str(&json?).map_err(|e| format!("Failed to parse response: {e}"))?;
+        let kind = if result.dir { "dir " } else { "file" };
+        println!("  [{kind}] {}", result.path);
+        count += 1;
+    }
 
-    if results.is_empty() {
+    if count == 0 {
         println!("No results found for '{query}'");
+    } else if count == limit as usize {
+        println!("\n{count} result(s), stopped at --limit");
     } else {
-        for result in &results {
-            let kind = if result.dir { "dir " } else { "file" };
-            println!("  [{kind}] {}", result.path);
-        }
-        println!("\n{} result(s)", results.len());
+        println!("\n{count} result(s)");
     }
 
     Ok(())
@@ -484,6 +1150,216 @@ fn print_resource_line(resource: &Resource) {
     }
 }
 
+/// Walk the tree under `root`, calling `on_entry` for every entry as it arrives.
+async fn walk(
+    client: &ffi::Client,
+    root: &str,
+    jobs: u32,
+    mut on_entry: impl FnMut(Resource),
+) -> Result<(), String> {
+    let mut walk = client.walk(root, jobs as usize)?;
+    while let Some(entry) = walk.next().await {
+        let resource: Resource =
+            serde_json::from_str(&entry?).map_err(|e| format!("Failed to parse response: {e}"))?;
+        on_entry(resource);
+    }
+    Ok(())
+}
+
+/// Match `name` against a glob where `*` is any run of characters and `?` is one.
+fn glob_match(pattern: &str, name: &str) -> bool {
+    let (p, n): (Vec<char>, Vec<char>) = (pattern.chars().collect(), name.chars().collect());
+    let (mut pi, mut ni) = (0, 0);
+    // Position of the last `*` and the name index it was tried at, for backtracking.
+    let mut star: Option<(usize, usize)> = None;
+    while ni < n.len() {
+        if pi < p.len() && (p[pi] == '?' || p[pi] == n[ni]) {
+            pi += 1;
+            ni += 1;
+        } else if pi < p.len() && p[pi] == '*' {
+            star = Some((pi, ni));
+            pi += 1;
+        } else if let Some((sp, sn)) = star {
+            // Let the last `*` swallow one more character and retry.
+            pi = sp + 1;
+            ni = sn + 1;
+            star = Some((sp, sn + 1));
+        } else {
+            return false;
+        }
+    }
+    p[pi..].iter().all(|&c| c == '*')
+}
+
+/// One line per sync step: `+` for directories, arrows for transfers.
+fn print_sync_action(action: &SyncAction) {
+    let marker = match action.kind.as_str() {
+        "mkdir" => "+",
+        "upload" => "↑",
+        _ => "↓",
+    };
+    match &action.error {
+        Some(error) => println!("  {} {}  {}", marker.red().bold(), action.path, error.red()),
+        None if action.kind == "mkdir" => println!("  {} {}/", marker.green(), action.path),
+        None => println!(
+            "  {} {:<58} {:>10}  {}",
+            marker.green(),
+            action.path,
+            format_size(action.size as f64),
+            action.reason.dimmed()
+        ),
+    }
+}
+
+/// Single-line transfer progress on stderr, redrawn at most every 100ms.
+///
+/// Stays silent when stderr isn't a terminal so piped/scripted output is clean.
+struct Progress {
+    enabled: bool,
+    last_draw: Option<Instant>,
+    drawn: bool,
+}
+
+impl Progress {
+    const REDRAW_INTERVAL: Duration = Duration::from_millis(100);
+
+    fn new() -> Self {
+        Self {
+            enabled: std::io::stderr().is_terminal(),
+            last_draw: None,
+            drawn: false,
+        }
+    }
+
+    fn update(&mut self, done: u64, total: Option<u64>) {
+        if !self.enabled {
+            return;
+        }
+        let finished = total == Some(done);
+        if !finished
+            && self
+                .last_draw
+                .is_some_and(|t| t.elapsed() < Self::REDRAW_INTERVAL)
+        {
+            return;
+        }
+        self.last_draw = Some(Instant::now());
+        self.drawn = true;
+
+        let line = match total {
+            Some(total) if total > 0 => format!(
+                "{} / {} ({:.0}%)",
+                format_size(done as f64),
+                format_size(total as f64),
+                done as f64 * 100.0 / total as f64
+            ),
+            _ => format_size(done as f64),
+        };
+        // \r returns to the start of the line; the padding clears leftovers.
+        eprint!("\r  {line:<40}");
+        let _ = std::io::stderr().flush();
+    }
+
+    /// Clear the progress line so the final status message starts clean.
+    fn finish(&mut self) {
+        if self.drawn {
+            eprint!("\r{:<44}\r", "");
+            let _ = std::io::stderr().flush();
+        }
+    }
+}
+
+/// Share a [`Progress`] with a transfer's callback, which runs on a library thread.
+fn progress_callback(progress: &Arc<Mutex<Progress>>) -> ffi::Progress {
+    let progress = Arc::clone(progress);
+    Box::new(move |done, total| progress.lock().unwrap().update(done, total))
+}
+
+/// Print the client's request metrics to stderr, one line per endpoint.
+fn print_stats(client: &ffi::Client) {
+    let stats = client.stats().and_then(|json| {
+        serde_json::from_str::<ClientStats>(&json)
+            .map_err(|e| format!("Failed to parse stats: {e}"))
+    });
+    let stats = match stats {
+        Ok(stats) => stats,
+        Err(e) => {
+            eprintln!("{} {e}", "warning:".yellow().bold());
+            return;
+        }
+    };
+    eprintln!();
+    eprintln!(
+        "{}",
+        format!(
+            "{:<22} {:>6} {:>5} {:>10} {:>9} {:>9} {:>9} {:>9}",
+            "ENDPOINT", "REQS", "ERRS", "RECEIVED", "TTFB p50", "p50", "p99", "DECODE"
+        )
+        .dimmed()
+    );
+    for e in &stats.endpoints {
+        eprintln!(
+            "{:<22} {:>6} {:>5} {:>10} {:>9} {:>9} {:>9} {:>9}",
+            e.endpoint,
+            e.requests,
+            e.errors,
+            format_size(e.bytes_received),
+            format_millis(e.headers.p50_millis),
+            format_millis(e.total.p50_millis),
+            format_millis(e.total.p99_millis),
+            format_millis(e.decode.total_millis),
+        );
+    }
+    if stats.encode.count > 0 {
+        eprintln!(
+            "JSON encoding: {} results in {}",
+            stats.encode.count,
+            format_millis(stats.encode.total_millis)
+        );
+    }
+    let c = &stats.compression;
+    if c.responses > 0 {
+        eprintln!(
+            "Compression: {} responses, {} -> {} ({:.1}x), {} inflating",
+            c.responses,
+            format_size(c.compressed_bytes),
+            format_size(c.decompressed_bytes),
+            c.decompressed_bytes / c.compressed_bytes.max(1.0),
+            format_millis(c.inflate_millis)
+        );
+    }
+    let s = &stats.scheduler;
+    if s.bytes_transferred > 0.0 || s.congestion_signals > 0 {
+        eprintln!(
+            "Scheduler: {} transferred, {}/s recently, {} throttled; limit {} requests after {} backoffs ({} slow or refused)",
+            format_size(s.bytes_transferred),
+            format_size(s.throughput_bytes_per_second),
+            format_millis(s.throttled_millis),
+            s.concurrency_limit,
+            s.backoffs,
+            s.congestion_signals
+        );
+    }
+    let r = &stats.retry;
+    if r.retries > 0 || r.hedges > 0 || r.budget_exhausted > 0 {
+        eprintln!(
+            "Retries: {} over {} calls, {} hedges ({} won), {} refused by the budget",
+            r.retries, r.calls, r.hedges, r.hedge_wins, r.budget_exhausted
+        );
+    }
+}
+
+/// Format a latency: `0.42ms`, `35ms` or `1.2s`.
+fn format_millis(millis: f64) -> String {
+    if millis < 1.0 {
+        format!("{millis:.2}ms")
+    } else if millis < 1000.0 {
+        format!("{millis:.0}ms")
+    } else {
+        format!("{:.1}s", millis / 1000.0)
+    }
+}
+
 /// Format bytes into human-readable size (like `ls -lh`).
 fn format_size(bytes: f64) -> String {
     const KB: f64 = 1024.0;
@@ -3,6 +3,8 @@
 //! These structs mirror the Kotlin `Resource` and search result types, but only
 //! include the fields needed for CLI display. Fields absent from the JSON are
 //! handled via `#[serde(default)]` — serde silently ignores unknown keys.
+//! Resource and search JSON is the server's own response body, passed through
+//! by the library undecoded, so fields the server omits really are missing.
 //!
 //! ## Why `f64` for sizes?
 //!
@@ -15,7 +17,8 @@ use serde::Deserialize;
 
 /// A file or directory from the Filebrowser API.
 ///
-/// Returned by [`crate::ffi::get_resource`] and [`crate::ffi::list_directory`].
+/// Returned by [`crate::ffi::Client::get_resource`] and [`crate::ffi::Client::list_directory`], and streamed one
+/// entry at a time by [`crate::ffi::Client::walk`].
 /// For directory listings, `items` contains child resources and `num_files`/`num_dirs`
 /// provide summary counts.
 #[derive(Deserialize, Debug)]
@@ -24,8 +27,10 @@ pub struct Resource {
     /// Filename or directory name (without path).
     pub name: String,
     /// File size in bytes. Uses `f64` for JS compatibility (see module docs).
+    #[serde(default)]
     pub size: f64,
     /// File extension (e.g. `"txt"`, `"png"`), empty string for directories.
+    #[serde(default)]
     #[allow(dead_code)]
     pub extension: String,
     /// Whether this resource is a directory.
@@ -34,9 +39,11 @@ pub struct Resource {
     /// Full path on the Filebrowser server (e.g. `"/documents/report.pdf"`).
     pub path: String,
     /// ISO 8601 timestamp of last modification.
+    #[serde(default)]
     pub modified: String,
     /// Child resources, present only when listing a directory's contents.
     #[serde(default)]
+    #[allow(dead_code)]
     pub items: Option<Vec<Resource>>,
     /// Number of files in this directory (0 for files).
     #[serde(default)]
@@ -48,7 +55,7 @@ pub struct Resource {
 
 /// A single result from the Filebrowser search API.
 ///
-/// Returned as a `Vec<SearchResult>` by [`crate::ffi::search`].
+/// Returned as a `Vec<SearchResult>` by [`crate::ffi::Client::search`].
 #[derive(Deserialize, Debug)]
 pub struct SearchResult {
     /// Full path of the matching file or directory.
@@ -57,3 +64,167 @@ pub struct SearchResult {
     #[serde(default)]
     pub dir: bool,
 }
+
+/// One step of a sync, as planned or as performed.
+///
+/// Streamed to the [`crate::ffi::OnAction`] callback while a sync runs and
+/// collected in [`SyncReport::actions`].
+#[derive(Deserialize, Debug)]
+pub struct SyncAction {
+    /// `"mkdir"`, `"upload"` or `"download"`.
+    pub kind: String,
+    /// Path relative to the synced directories.
+    pub path: String,
+    /// Bytes to transfer (0 for directories).
+    #[serde(default)]
+    pub size: i64,
+    /// Why the step is needed: `"new"`, `"size"` or `"newer"`.
+    #[serde(default)]
+    pub reason: String,
+    /// Why the step failed; `None` if it succeeded or did not run.
+    #[serde(default)]
+    pub error: Option<String>,
+}
+
+/// Outcome of [`crate::ffi::Client::extract_archive`].
+#[derive(Deserialize, Debug)]
+pub struct ExtractReport {
+    /// Files written.
+    pub files: u64,
+    /// Directories created.
+    pub directories: u64,
+    /// Bytes written to files.
+    pub bytes: u64,
+    /// Entries left out by the filters, plus links and special files.
+    pub skipped: u64,
+}
+
+/// Outcome of [`crate::ffi::Client::sync`].
+#[derive(Deserialize, Debug)]
+#[serde(rename_all = "camelCase")]
+pub struct SyncReport {
+    /// Whether `actions` is only the plan.
+    pub dry_run: bool,
+    /// Every planned step, directories first.
+    pub actions: Vec<SyncAction>,
+    /// Files that were already up to date.
+    pub unchanged: i64,
+    /// Remote directories listed from the server.
+    pub listed_directories: i64,
+    /// Remote directories recalled from the manifest instead of listed.
+    pub cached_directories: i64,
+}
+
+/// Outcome of one operation in [`crate::ffi::Client::batch`].
+#[derive(Deserialize, Debug)]
+pub struct BatchResult {
+    /// Position of the operation in the batch.
+    pub index: usize,
+    /// Whether it succeeded.
+    pub ok: bool,
+    /// Why it failed; `None` if it succeeded or was skipped.
+    #[serde(default)]
+    pub error: Option<String>,
+    /// Never started, because an earlier operation failed with stop-on-error.
+    #[serde(default)]
+    pub skipped: bool,
+}
+
+/// Outcome of [`crate::ffi::Client::batch`].
+#[derive(Deserialize, Debug)]
+pub struct BatchReport {
+    /// One result per operation, in batch order.
+    pub results: Vec<BatchResult>,
+}
+
+/// Latency distribution of one request phase, in milliseconds.
+#[derive(Deserialize, Debug, Default)]
+#[serde(rename_all = "camelCase", default)]
+pub struct LatencyHistogram {
+    pub count: u64,
+    pub total_millis: f64,
+    pub p50_millis: f64,
+    pub p99_millis: f64,
+}
+
+/// Counters and latencies of one endpoint, such as `GET /api/resources`.
+#[derive(Deserialize, Debug)]
+#[serde(rename_all = "camelCase")]
+pub struct EndpointStats {
+    pub endpoint: String,
+    pub requests: u64,
+    pub errors: u64,
+    pub bytes_received: f64,
+    /// From sending the request until the response headers arrive.
+    pub headers: LatencyHistogram,
+    /// From sending the request until the response is consumed.
+    pub total: LatencyHistogram,
+    /// Turning response bodies into objects.
+    pub decode: LatencyHistogram,
+}
+
+/// Compressed responses the library inflated.
+#[derive(Deserialize, Debug, Default)]
+#[serde(rename_all = "camelCase", default)]
+pub struct CompressionStats {
+    pub responses: u64,
+    pub compressed_bytes: f64,
+    pub decompressed_bytes: f64,
+    pub inflate_millis: f64,
+}
+
+/// State of the library's request scheduler.
+#[derive(Deserialize, Debug, Default)]
+#[serde(rename_all = "camelCase", default)]
+pub struct SchedulerStats {
+    /// Requests allowed in flight; adapts to the server's latency and 429/503s.
+    pub concurrency_limit: u32,
+    pub running: u32,
+    pub queued_interactive: u32,
+    pub queued_normal: u32,
+    pub queued_bulk: u32,
+    pub bytes_transferred: f64,
+    pub throughput_bytes_per_second: f64,
+    /// Time transfers waited for the bandwidth caps.
+    pub throttled_millis: f64,
+    /// Responses that were slow, 429 or 503.
+    pub congestion_signals: u64,
+    /// Times the concurrency limit was lowered.
+    pub backoffs: u64,
+}
+
+/// Retries and hedges of the library's idempotent calls.
+#[derive(Deserialize, Debug, Default)]
+#[serde(rename_all = "camelCase", default)]
+pub struct RetryStats {
+    pub calls: u64,
+    /// Requests repeated after a network error or a 408/429/5xx.
+    pub retries: u64,
+    /// Second requests sent for slow calls.
+    pub hedges: u64,
+    /// Hedges that answered first.
+    pub hedge_wins: u64,
+    /// Retries and hedges skipped because the retry budget was spent.
+    pub budget_exhausted: u64,
+}
+
+/// Request metrics from [`crate::ffi::Client::stats`].
+#[derive(Deserialize, Debug)]
+pub struct ClientStats {
+    pub endpoints: Vec<EndpointStats>,
+    /// Encoding results as JSON for the C API.
+    pub encode: LatencyHistogram,
+    #[serde(default)]
+    pub compression: CompressionStats,
+    #[serde(default)]
+    pub scheduler: SchedulerStats,
+    #[serde(default)]
+    pub retry: RetryStats,
+}
+
+/// Result of [`crate::ffi::Client::upload_from_file`].
+#[derive(Deserialize, Debug, Default)]
+pub struct UploadOutcome {
+    /// The remote file already matched, so nothing was sent.
+    pub skipped: bool,
+}
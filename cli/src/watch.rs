@@ -0,0 +1,1172 @@
+//! `krfiles watch`: upload local changes as they happen.
+//!
+//! Rather than rescanning the tree, the watcher asks the kernel (inotify) for
+//! events on every directory below the local root: once at start, then for
+//! each directory as it appears. Events are not acted on straight away. They
+//! are folded into one pending change per path, which is sent once the path
+//! has been quiet for the settle time. So a file written in many bursts is
+//! uploaded once, a file created and deleted again is never sent, and a
+//! rename becomes a rename on the server rather than an upload and a delete.
+//! An editor's save through a temporary file is a single upload of the file.
+//!
+//! Changes run on the one client, at most `--jobs` at a time. A change waits
+//! while an earlier one on the same path, or on a directory above or below
+//! it, is pending or running. A directory is therefore created before its
+//! files, and renamed before anything inside it moves.
+//!
+//! A change that fails goes back to the front of the line and is sent again
+//! after a growing delay, a few times at most. A failed rename is retried as
+//! an upload of the new path and a delete of the old one, which is right
+//! whether or not the rename itself went through.
+//!
+//! If the kernel's event queue overflows, events were lost. The watcher then
+//! lets running changes finish and pushes the whole tree once with `sync`.
+//! Deletions made while events were lost are not replayed.
+
+use std::collections::{BTreeMap, HashMap};
+use std::ffi::{CString, OsStr};
+use std::future::Future;
+use std::io;
+use std::os::fd::{AsRawFd, FromRawFd, OwnedFd};
+use std::os::unix::ffi::{OsStrExt, OsStringExt};
+use std::path::{Path, PathBuf};
+use std::pin::{Pin, pin};
+use std::task::Poll;
+use std::time::{Duration, Instant};
+
+use colored::Colorize;
+use libc::c_int;
+use tokio::io::Interest;
+use tokio::io::unix::AsyncFd;
+
+use crate::{cmd_sync, ffi};
+
+/// Events read per `read(2)`; a burst beyond this is read in several.
+const EVENT_BUFFER: usize = 64 * 1024;
+
+/// How much longer than the settle time a file that keeps changing may wait
+/// for a quiet moment, and a created file that is never closed may wait at all.
+const MAX_DEFER_FACTOR: u32 = 20;
+
+/// Times a change is sent before a failure is final. Retries wait twice the
+/// settle time, doubling each time, up to the longest deferral.
+const MAX_ATTEMPTS: u32 = 5;
+
+/// What a directory watch reports. Events on the directory itself are not
+/// needed: its parent reports its creation, deletion and moves.
+const WATCH_MASK: u32 = libc::IN_CREATE
+    | libc::IN_CLOSE_WRITE
+    | libc::IN_MODIFY
+    | libc::IN_DELETE
+    | libc::IN_MOVED_FROM
+    | libc::IN_MOVED_TO
+    | libc::IN_ONLYDIR
+    | libc::IN_DONT_FOLLOW
+    | libc::IN_EXCL_UNLINK;
+
+/// Settings of `krfiles watch`.
+pub struct Options {
+    /// Quiet time after a path's last event before its change is sent.
+    pub settle: Duration,
+    /// Changes sent at once.
+    pub jobs: usize,
+    /// Push the whole tree once before watching.
+    pub initial_sync: bool,
+}
+
+/// Upload changes below `local_dir` to `remote_dir` until interrupted.
+pub async fn run(
+    client: &ffi::Client,
+    local_dir: &str,
+    remote_dir: &str,
+    options: Options,
+) -> Result<(), String> {
+    let root =
+        std::fs::canonicalize(local_dir).map_err(|e| format!("Failed to open {local_dir}: {e}"))?;
+    if !root.is_dir() {
+        return Err(format!("{local_dir} is not a directory"));
+    }
+    let remote_root = remote_dir.trim_end_matches('/');
+    let inotify =
+        Inotify::new(root.clone()).map_err(|e| format!("Failed to start inotify: {e}"))?;
+    let mut watcher = Watcher {
+        inotify,
+        changes: Changes::default(),
+        moved_from: None,
+        overflowed: false,
+    };
+
+    // Watch first, so nothing changed during the initial sync goes unseen.
+    let watched = watcher.watch_tree("", None)?;
+    if options.initial_sync {
+        cmd_sync(client, local_dir, remote_dir, 0, options.jobs as u32).await?;
+    }
+    println!(
+        "{} Watching {} ({watched} directories) → {remote_root}/, Ctrl-C to stop",
+        "✓".green().bold(),
+        root.display()
+    );
+
+    let settle = options.settle;
+    let max_defer = settle * MAX_DEFER_FACTOR;
+    let tick = (settle / 2).max(Duration::from_millis(20));
+    let mut buffer = vec![0u8; EVENT_BUFFER];
+    let mut running: Vec<Running<'_>> = Vec::new();
+    let mut busy: Vec<Op> = Vec::new();
+    // Failed attempts so far, by the path a change is for.
+    let mut failures: HashMap<String, u32> = HashMap::new();
+    let mut totals = Totals::default();
+    let mut interrupt = pin!(tokio::signal::ctrl_c());
+    loop {
+        if watcher.overflowed && running.is_empty() {
+            eprintln!(
+                "{} inotify queue overflowed, events were lost; pushing the whole tree",
+                "warning:".yellow().bold()
+            );
+            watcher.overflowed = false;
+            watcher.changes = Changes::default();
+            failures.clear();
+            watcher.moved_from = None;
+            watcher.watch_tree("", None)?;
+            if let Err(e) = cmd_sync(client, local_dir, remote_dir, 0, options.jobs as u32).await {
+                eprintln!("{} {e}", "warning:".yellow().bold());
+            }
+        }
+
+        let now = Instant::now();
+        while !watcher.overflowed && running.len() < options.jobs {
+            let Some(op) = watcher.changes.next_ready(now, settle, max_defer, &busy) else {
+                break;
+            };
+            busy.push(op.clone());
+            let root = root.as_path();
+            running.push(Box::pin(async move {
+                let result = perform(client, root, remote_root, &op).await;
+                (op, result)
+            }));
+        }
+
+        let wake = tokio::select! {
+            read = watcher.inotify.read(&mut buffer) => Wake::Events(read),
+            (op, result) = next_done(&mut running), if !running.is_empty() => Wake::Done(op, result),
+            () = tokio::time::sleep(tick) => Wake::Tick,
+            _ = &mut interrupt => Wake::Interrupt,
+        };
+        match wake {
+            Wake::Events(read) => {
+                let read = read.map_err(|e| format!("Failed to read inotify events: {e}"))?;
+                let now = Instant::now();
+                for event in parse_events(&buffer[..read]) {
+                    watcher.handle(event, now)?;
+                }
+            }
+            Wake::Done(op, result) => {
+                busy.retain(|o| *o != op);
+                let path = op.paths().0.to_string();
+                let attempts = failures.remove(&path).unwrap_or(0) + 1;
+                match &result {
+                    Err(e) if attempts < MAX_ATTEMPTS => {
+                        let delay = settle.saturating_mul(1 << attempts).min(max_defer);
+                        totals.retrying(&op, e, delay);
+                        failures.insert(path, attempts);
+                        watcher.retry(op, Instant::now() + delay)?;
+                    }
+                    _ => totals.record(&op, &result),
+                }
+            }
+            Wake::Tick => watcher.flush_move(Instant::now()),
+            Wake::Interrupt => break,
+        }
+    }
+
+    // Let what already started finish; what is still settling is dropped.
+    while !running.is_empty() {
+        let (op, result) = next_done(&mut running).await;
+        totals.record(&op, &result);
+    }
+    println!(
+        "\n{} uploaded, {} renamed, {} deleted, {} directories created, {} failed, {} not sent",
+        totals.uploaded,
+        totals.renamed,
+        totals.deleted,
+        totals.created,
+        totals.failed,
+        watcher.changes.len()
+    );
+    Ok(())
+}
+
+/// What woke the watch loop.
+enum Wake {
+    Events(io::Result<usize>),
+    Done(Op, Result<bool, String>),
+    Tick,
+    Interrupt,
+}
+
+/// A change being sent, borrowing the client.
+type Running<'a> = Pin<Box<dyn Future<Output = (Op, Result<bool, String>)> + Send + 'a>>;
+
+/// Wait for the first of `running` to finish and take it out.
+async fn next_done(running: &mut Vec<Running<'_>>) -> (Op, Result<bool, String>) {
+    std::future::poll_fn(|cx| {
+        for i in 0..running.len() {
+            if let Poll::Ready(done) = running[i].as_mut().poll(cx) {
+                drop(running.swap_remove(i));
+                return Poll::Ready(done);
+            }
+        }
+        Poll::Pending
+    })
+    .await
+}
+
+/// Counts of changes sent, for the summary line.
+#[derive(Default)]
+struct Totals {
+    uploaded: u64,
+    renamed: u64,
+    deleted: u64,
+    created: u64,
+    failed: u64,
+}
+
+impl Totals {
+    /// Count a finished change and print it, like the steps of `sync`.
+    fn record(&mut self, op: &Op, result: &Result<bool, String>) {
+        let (marker, text) = describe(op);
+        match result {
+            // The file was gone by the time it was sent; its deletion follows.
+            Ok(false) => {}
+            Ok(true) => {
+                match op {
+                    Op::Upload { .. } => self.uploaded += 1,
+                    Op::Mkdir { .. } => self.created += 1,
+                    Op::Rename { .. } => self.renamed += 1,
+                    Op::Delete { .. } => self.deleted += 1,
+                }
+                println!("  {} {text}", marker.green());
+            }
+            Err(e) => {
+                self.failed += 1;
+                println!("  {} {text}  {}", marker.red().bold(), e.red());
+            }
+        }
+    }
+
+    /// Print a failed change that will be sent again after `delay`.
+    fn retrying(&self, op: &Op, error: &str, delay: Duration) {
+        let (marker, text) = describe(op);
+        println!(
+            "  {} {text}  {} (retrying in {:.1}s)",
+            marker.yellow().bold(),
+            error.yellow(),
+            delay.as_secs_f64()
+        );
+    }
+}
+
+/// Marker and text of `op` in the output.
+fn describe(op: &Op) -> (&'static str, String) {
+    match op {
+        Op::Upload { path } => ("↑", path.clone()),
+        Op::Mkdir { path, .. } => ("+", format!("{path}/")),
+        Op::Rename { from, to, .. } => ("→", format!("{from} → {to}")),
+        Op::Delete { path } => ("-", path.clone()),
+    }
+}
+
+/// Send one change. Returns false if there turned out to be nothing to send.
+async fn perform(
+    client: &ffi::Client,
+    root: &Path,
+    remote_root: &str,
+    op: &Op,
+) -> Result<bool, String> {
+    let remote = |path: &str| format!("{remote_root}/{path}");
+    match op {
+        Op::Upload { path } => upload(client, root, &remote(path), path).await,
+        Op::Mkdir { path, replace } => {
+            let target = remote(path);
+            if *replace {
+                // Whatever the server had there was deleted locally first.
+                let _ = client.delete(&target).await;
+            }
+            if let Err(e) = client.create_directory(&target).await {
+                // Already there, e.g. from a sync or an earlier watch.
+                let exists = client.get_resource(&target).await.is_ok_and(|json| {
+                    serde_json::from_str::<crate::models::Resource>(&json).is_ok_and(|r| r.is_dir)
+                });
+                if !exists {
+                    return Err(e);
+                }
+            }
+            Ok(true)
+        }
+        Op::Rename {
+            from,
+            to,
+            upload: then_upload,
+        } => {
+            client.rename(&remote(from), &remote(to), true).await?;
+            if *then_upload {
+                upload(client, root, &remote(to), to).await?;
+            }
+            Ok(true)
+        }
+        Op::Delete { path } => client.delete(&remote(path)).await.map(|()| true),
+    }
+}
+
+/// Upload `path` below `root` if it is still a regular file.
+async fn upload(
+    client: &ffi::Client,
+    root: &Path,
+    remote: &str,
+    path: &str,
+) -> Result<bool, String> {
+    let local = root.join(path);
+    if !std::fs::symlink_metadata(&local).is_ok_and(|m| m.is_file()) {
+        return Ok(false);
+    }
+    let local = local
+        .to_str()
+        .ok_or_else(|| format!("{} is not valid UTF-8", local.display()))?;
+    client
+        .upload_from_file(
+            remote,
+            local,
+            ffi::TRANSFER_OVERRIDE,
+            0,
+            Box::new(|_, _| {}),
+        )
+        .await
+        .map(|_| true)
+}
+
+// ---------------------------------------------------------------------------
+// Events
+// ---------------------------------------------------------------------------
+
+/// The inotify instance and the directory each of its watches stands for.
+struct Inotify {
+    fd: AsyncFd<OwnedFd>,
+    root: PathBuf,
+    /// Directory, relative to the root ("" for the root), by watch descriptor.
+    dirs: HashMap<c_int, String>,
+    watches: HashMap<String, c_int>,
+}
+
+/// One `inotify_event`.
+struct Event {
+    wd: c_int,
+    mask: u32,
+    cookie: u32,
+    name: Option<String>,
+}
+
+impl Inotify {
+    fn new(root: PathBuf) -> io::Result<Self> {
+        let fd = unsafe { libc::inotify_init1(libc::IN_NONBLOCK | libc::IN_CLOEXEC) };
+        if fd < 0 {
+            return Err(io::Error::last_os_error());
+        }
+        let fd = unsafe { OwnedFd::from_raw_fd(fd) };
+        Ok(Self {
+            fd: AsyncFd::with_interest(fd, Interest::READABLE)?,
+            root,
+            dirs: HashMap::new(),
+            watches: HashMap::new(),
+        })
+    }
+
+    /// Watch directory `dir`. Returns false if it is already gone.
+    fn watch(&mut self, dir: &str) -> Result<bool, String> {
+        let path = CString::new(self.root.join(dir).into_os_string().into_vec())
+            .map_err(|_| format!("{dir} contains a NUL byte"))?;
+        let wd = unsafe { libc::inotify_add_watch(self.fd.as_raw_fd(), path.as_ptr(), WATCH_MASK) };
+        if wd < 0 {
+            let e = io::Error::last_os_error();
+            return match e.raw_os_error() {
+                Some(libc::ENOENT | libc::ENOTDIR) => Ok(false),
+                Some(libc::ENOSPC) => Err(format!(
+                    "Out of inotify watches at {dir}; raise fs.inotify.max_user_watches"
+                )),
+                _ => Err(format!("Failed to watch {dir}: {e}")),
+            };
+        }
+        // Watching a directory again (after a move) hands back its old descriptor.
+        if let Some(old) = self.dirs.insert(wd, dir.to_string()) {
+            if self.watches.get(&old) == Some(&wd) {
+                self.watches.remove(&old);
+            }
+        }
+        self.watches.insert(dir.to_string(), wd);
+        Ok(true)
+    }
+
+    /// Forget a watch the kernel dropped (`IN_IGNORED`).
+    fn forget(&mut self, wd: c_int) {
+        if let Some(dir) = self.dirs.remove(&wd) {
+            if self.watches.get(&dir) == Some(&wd) {
+                self.watches.remove(&dir);
+            }
+        }
+    }
+
+    /// Stop watching `dir` and everything below it, which left the tree.
+    fn unwatch_tree(&mut self, dir: &str) {
+        for (_, wd) in self.take_below(dir) {
+            unsafe { libc::inotify_rm_watch(self.fd.as_raw_fd(), wd) };
+            self.dirs.remove(&wd);
+        }
+    }
+
+    /// Follow `from` and everything below it to `to`.
+    fn move_tree(&mut self, from: &str, to: &str) {
+        for (path, wd) in self.take_below(from) {
+            let moved = format!("{to}{}", &path[from.len()..]);
+            self.dirs.insert(wd, moved.clone());
+            self.watches.insert(moved, wd);
+        }
+    }
+
+    /// Remove and return the watches of `dir` and the directories below it.
+    fn take_below(&mut self, dir: &str) -> Vec<(String, c_int)> {
+        let below: Vec<String> = self
+            .watches
+            .keys()
+            .filter(|path| is_within(path, dir))
+            .cloned()
+            .collect();
+        below
+            .into_iter()
+            .filter_map(|path| self.watches.remove(&path).map(|wd| (path, wd)))
+            .collect()
+    }
+
+    /// Read a batch of events into `buffer`, returning the bytes read.
+    async fn read(&self, buffer: &mut [u8]) -> io::Result<usize> {
+        loop {
+            let mut guard = self.fd.readable().await?;
+            let read = guard.try_io(|fd| {
+                let n =
+                    unsafe { libc::read(fd.as_raw_fd(), buffer.as_mut_ptr().cast(), buffer.len()) };
+                if n < 0 {
+                    Err(io::Error::last_os_error())
+                } else {
+                    Ok(n as usize)
+                }
+            });
+            if let Ok(result) = read {
+                return result;
+            }
+        }
+    }
+}
+
+/// Split a buffer from `read(2)` into events.
+fn parse_events(buffer: &[u8]) -> Vec<Event> {
+    const HEADER: usize = std::mem::size_of::<libc::inotify_event>();
+    let mut events = Vec::new();
+    let mut at = 0;
+    while at + HEADER <= buffer.len() {
+        let field = |offset: usize| {
+            u32::from_ne_bytes(buffer[at + offset..at + offset + 4].try_into().unwrap())
+        };
+        let len = field(12) as usize;
+        let end = (at + HEADER + len).min(buffer.len());
+        // The name is NUL-padded; names that aren't UTF-8 are skipped.
+        let name = buffer[at + HEADER..end]
+            .split(|&b| b == 0)
+            .next()
+            .filter(|name| !name.is_empty())
+            .map(|name| OsStr::from_bytes(name).to_str().map(str::to_string));
+        if name != Some(None) {
+            events.push(Event {
+                wd: field(0) as c_int,
+                mask: field(4),
+                cookie: field(8),
+                name: name.flatten(),
+            });
+        }
+        at = end;
+    }
+    events
+}
+
+/// Turns inotify events into [`Changes`].
+struct Watcher {
+    inotify: Inotify,
+    changes: Changes,
+    /// A `IN_MOVED_FROM` waiting for its `IN_MOVED_TO`: cookie, path, is a directory.
+    moved_from: Option<(u32, String, bool)>,
+    overflowed: bool,
+}
+
+impl Watcher {
+    fn handle(&mut self, event: Event, now: Instant) -> Result<(), String> {
+        if event.mask & libc::IN_Q_OVERFLOW != 0 {
+            self.overflowed = true;
+            return Ok(());
+        }
+        if event.mask & libc::IN_IGNORED != 0 {
+            self.inotify.forget(event.wd);
+            return Ok(());
+        }
+        let (Some(dir), Some(name)) = (self.inotify.dirs.get(&event.wd), event.name) else {
+            return Ok(());
+        };
+        let path = if dir.is_empty() {
+            name
+        } else {
+            format!("{dir}/{name}")
+        };
+        let is_dir = event.mask & libc::IN_ISDIR != 0;
+
+        // The two halves of a rename arrive back to back.
+        if let Some((cookie, from, from_dir)) = self.moved_from.take() {
+            if event.mask & libc::IN_MOVED_TO != 0 && event.cookie == cookie {
+                if from_dir {
+                    self.inotify.move_tree(&from, &path);
+                }
+                if self.changes.renamed(&from, &path, from_dir, now) {
+                    self.watch_tree(&path, Some(now))?;
+                }
+                return Ok(());
+            }
+            self.moved_out(&from, from_dir, now);
+        }
+
+        let mask = event.mask;
+        if mask & libc::IN_MOVED_FROM != 0 {
+            self.moved_from = Some((event.cookie, path, is_dir));
+        } else if mask & (libc::IN_CREATE | libc::IN_MOVED_TO) != 0 && is_dir {
+            self.changes.created_dir(&path, now);
+            self.watch_tree(&path, Some(now))?;
+        } else if mask & libc::IN_CREATE != 0 {
+            self.changes.created(&path, now);
+        } else if mask & (libc::IN_CLOSE_WRITE | libc::IN_MOVED_TO) != 0 {
+            self.changes.closed(&path, now);
+        } else if mask & libc::IN_MODIFY != 0 {
+            self.changes.touch(&path, now);
+        } else if mask & libc::IN_DELETE != 0 {
+            self.changes.deleted(&path, is_dir, now);
+        }
+        Ok(())
+    }
+
+    /// Settle a `IN_MOVED_FROM` whose other half never came: it left the tree.
+    fn flush_move(&mut self, now: Instant) {
+        if let Some((_, from, is_dir)) = self.moved_from.take() {
+            self.moved_out(&from, is_dir, now);
+        }
+    }
+
+    /// Queue `op`, which failed, to be sent again from `at`.
+    fn retry(&mut self, op: Op, at: Instant) -> Result<(), String> {
+        match op {
+            Op::Upload { path } => self.changes.retry(&path, Change::Upload, false, at),
+            Op::Mkdir { path, replace } => self.changes.retry(&path, Change::Mkdir, !replace, at),
+            Op::Delete { path } => self.changes.retry(&path, Change::Delete, false, at),
+            Op::Rename { from, to, .. } => {
+                // The rename may have gone through with only the upload after it
+                // failed, so send the content and delete the old name instead.
+                let local = self.inotify.root.join(&to);
+                if std::fs::symlink_metadata(local).is_ok_and(|m| m.is_dir()) {
+                    self.changes.retry(&to, Change::Mkdir, false, at);
+                    self.watch_tree(&to, Some(at))?;
+                } else {
+                    self.changes.retry(&to, Change::Upload, false, at);
+                }
+                self.changes.vanish(&from, at);
+            }
+        }
+        Ok(())
+    }
+
+    fn moved_out(&mut self, path: &str, is_dir: bool, now: Instant) {
+        if is_dir {
+            self.inotify.unwatch_tree(path);
+        }
+        self.changes.deleted(path, is_dir, now);
+    }
+
+    /// Watch `dir` and the directories below it. With `now`, the tree is new,
+    /// and what it holds is queued for upload. Returns the directories watched.
+    fn watch_tree(&mut self, dir: &str, now: Option<Instant>) -> Result<usize, String> {
+        let mut watched = 0;
+        let mut pending = vec![dir.to_string()];
+        while let Some(dir) = pending.pop() {
+            // Watch before listing, so a file created in between is seen either way.
+            if !self.inotify.watch(&dir)? {
+                continue;
+            }
+            watched += 1;
+            let Ok(entries) = std::fs::read_dir(self.inotify.root.join(&dir)) else {
+                continue;
+            };
+            for entry in entries.flatten() {
+                let name = entry.file_name();
+                let (Ok(kind), Some(name)) = (entry.file_type(), name.to_str()) else {
+                    continue;
+                };
+                let path = if dir.is_empty() {
+                    name.to_string()
+                } else {
+                    format!("{dir}/{name}")
+                };
+                if kind.is_dir() {
+                    if let Some(now) = now {
+                        self.changes.created_dir(&path, now);
+                    }
+                    pending.push(path);
+                } else if kind.is_file() {
+                    if let Some(now) = now {
+                        self.changes.added(&path, now);
+                    }
+                }
+            }
+        }
+        Ok(watched)
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Coalescing
+// ---------------------------------------------------------------------------
+
+/// Pending change to one path.
+#[derive(Clone, Debug, PartialEq)]
+enum Change {
+    /// A file appeared and may still be being written.
+    Created,
+    Upload,
+    Mkdir,
+    /// The server's `from` moves here; `modified` if the content changed too.
+    Rename {
+        from: String,
+        modified: bool,
+    },
+    Delete,
+}
+
+struct Entry {
+    change: Change,
+    /// Once the changes queued before this one ran, the server has nothing at
+    /// this path, so taking the change back needs no request.
+    fresh: bool,
+    /// Place in line: a change only overtakes earlier ones on unrelated paths.
+    seq: i64,
+    first: Instant,
+    last: Instant,
+}
+
+/// A change ready to send.
+#[derive(Clone, Debug, PartialEq)]
+enum Op {
+    Upload {
+        path: String,
+    },
+    /// `replace`: delete what the server has there first.
+    Mkdir {
+        path: String,
+        replace: bool,
+    },
+    Rename {
+        from: String,
+        to: String,
+        upload: bool,
+    },
+    Delete {
+        path: String,
+    },
+}
+
+impl Op {
+    fn paths(&self) -> (&str, Option<&str>) {
+        match self {
+            Op::Upload { path } | Op::Mkdir { path, .. } | Op::Delete { path } => (path, None),
+            Op::Rename { from, to, .. } => (to, Some(from)),
+        }
+    }
+}
+
+/// Pending changes, one per path, in the order they must reach the server.
+#[derive(Default)]
+struct Changes {
+    entries: HashMap<String, Entry>,
+    order: BTreeMap<i64, String>,
+    next_seq: i64,
+}
+
+impl Changes {
+    fn len(&self) -> usize {
+        self.entries.len()
+    }
+
+    /// Record `change` for `path`, keeping the entry's place in line if it has one.
+    fn set(&mut self, path: &str, change: Change, fresh: bool, now: Instant) {
+        match self.entries.get_mut(path) {
+            Some(entry) => {
+                entry.change = change;
+                entry.fresh = fresh;
+                entry.last = now;
+            }
+            None => self.insert(
+                path.to_string(),
+                Entry {
+                    change,
+                    fresh,
+                    seq: 0,
+                    first: now,
+                    last: now,
+                },
+            ),
+        }
+    }
+
+    /// Put `entry` at the back of the line.
+    fn insert(&mut self, path: String, mut entry: Entry) {
+        self.next_seq += 1;
+        entry.seq = self.next_seq;
+        self.order.insert(entry.seq, path.clone());
+        if let Some(old) = self.entries.insert(path, entry) {
+            self.order.remove(&old.seq);
+        }
+    }
+
+    /// Queue `change` for `path` again after it failed: ahead of everything
+    /// queued since, which may depend on it, and not before `at`. A newer change
+    /// to `path` wins, though the server may still have what it replaces.
+    fn retry(&mut self, path: &str, change: Change, fresh: bool, at: Instant) {
+        if let Some(entry) = self.entries.get_mut(path) {
+            entry.fresh &= fresh;
+            return;
+        }
+        let seq = self
+            .order
+            .keys()
+            .next()
+            .map_or(self.next_seq + 1, |first| first - 1);
+        self.order.insert(seq, path.to_string());
+        let entry = Entry {
+            change,
+            fresh,
+            seq,
+            first: at,
+            last: at,
+        };
+        self.entries.insert(path.to_string(), entry);
+    }
+
+    fn remove(&mut self, path: &str) -> Option<Entry> {
+        let entry = self.entries.remove(path)?;
+        self.order.remove(&entry.seq);
+        Some(entry)
+    }
+
+    fn is_fresh(&self, path: &str, default: bool) -> bool {
+        self.entries.get(path).map_or(default, |e| e.fresh)
+    }
+
+    /// A file was written to without being closed: hold its upload back.
+    fn touch(&mut self, path: &str, now: Instant) {
+        if let Some(entry) = self.entries.get_mut(path) {
+            if entry.change != Change::Delete {
+                entry.last = now;
+            }
+        }
+    }
+
+    fn created(&mut self, path: &str, now: Instant) {
+        let fresh = self.is_fresh(path, true);
+        self.set(path, Change::Created, fresh, now);
+    }
+
+    fn created_dir(&mut self, path: &str, now: Instant) {
+        let fresh = self.is_fresh(path, true);
+        self.set(path, Change::Mkdir, fresh, now);
+    }
+
+    /// A file found in a new directory.
+    fn added(&mut self, path: &str, now: Instant) {
+        let fresh = self.is_fresh(path, true);
+        self.set(path, Change::Upload, fresh, now);
+    }
+
+    /// A file was closed after writing, or moved in from outside the tree.
+    fn closed(&mut self, path: &str, now: Instant) {
+        match self.entries.get_mut(path) {
+            Some(Entry {
+                change: Change::Rename { modified, .. },
+                last,
+                ..
+            }) => {
+                *modified = true;
+                *last = now;
+            }
+            Some(entry) => {
+                entry.change = Change::Upload;
+                entry.last = now;
+            }
+            None => self.set(path, Change::Upload, false, now),
+        }
+    }
+
+    fn deleted(&mut self, path: &str, is_dir: bool, now: Instant) {
+        if is_dir {
+            self.discard_below(path, now);
+        }
+        let Some(entry) = self.entries.get_mut(path) else {
+            self.set(path, Change::Delete, false, now);
+            return;
+        };
+        if let Change::Rename { from, .. } = &entry.change {
+            // The server still has it under its old name.
+            let (from, fresh) = (from.clone(), entry.fresh);
+            self.remove(path);
+            self.vanish(&from, now);
+            if !fresh {
+                self.set(path, Change::Delete, false, now);
+            }
+        } else if entry.fresh {
+            self.remove(path);
+        } else {
+            entry.change = Change::Delete;
+            entry.last = now;
+        }
+    }
+
+    /// `from` was renamed to `to`. Returns true if `to` is a directory whose
+    /// contents have to be uploaded afresh, because the rename could not be kept.
+    fn renamed(&mut self, from: &str, to: &str, is_dir: bool, now: Instant) -> bool {
+        let dest_fresh = self.vacate(to, now);
+        let change = match self.remove(from) {
+            None => Some(Change::Rename {
+                from: from.to_string(),
+                modified: false,
+            }),
+            Some(Entry {
+                change:
+                    Change::Rename {
+                        from: origin,
+                        modified,
+                    },
+                ..
+            }) => {
+                if self.entries.contains_key(&origin) {
+                    // Something took the original's place, so `origin` → `to` in
+                    // one step would clobber it: send the content instead.
+                    self.vanish(&origin, now);
+                    if is_dir {
+                        self.discard_below(from, now);
+                        self.set(to, Change::Mkdir, dest_fresh, now);
+                        return true;
+                    }
+                    self.set(to, Change::Upload, dest_fresh, now);
+                    return false;
+                }
+                if origin == to {
+                    modified.then_some(Change::Upload)
+                } else {
+                    Some(Change::Rename {
+                        from: origin,
+                        modified,
+                    })
+                }
+            }
+            Some(entry) if entry.fresh => Some(entry.change),
+            Some(Entry {
+                change: Change::Mkdir,
+                ..
+            }) => {
+                // A new directory in place of one the server has: that one goes.
+                self.set(from, Change::Delete, false, now);
+                Some(Change::Mkdir)
+            }
+            Some(entry) => Some(Change::Rename {
+                from: from.to_string(),
+                modified: entry.change == Change::Upload,
+            }),
+        };
+        if let Some(change) = change {
+            self.set(to, change, dest_fresh, now);
+        }
+        if is_dir {
+            self.move_below(from, to);
+        }
+        false
+    }
+
+    /// Drop the change for `path`, which something is replacing. Returns
+    /// whether the server had nothing there.
+    fn vacate(&mut self, path: &str, now: Instant) -> bool {
+        match self.remove(path) {
+            None => false,
+            Some(Entry {
+                change: Change::Rename { from, .. },
+                fresh,
+                ..
+            }) => {
+                self.vanish(&from, now);
+                fresh
+            }
+            Some(entry) => entry.fresh,
+        }
+    }
+
+    /// Make sure the server ends up without what it has at `path`.
+    fn vanish(&mut self, path: &str, now: Instant) {
+        match self.entries.get_mut(path) {
+            // Whatever is queued there now replaces it, or deletes it if taken back.
+            Some(entry) => entry.fresh = false,
+            None => self.set(path, Change::Delete, false, now),
+        }
+    }
+
+    /// Drop the changes below deleted directory `dir`.
+    fn discard_below(&mut self, dir: &str, now: Instant) {
+        let prefix = format!("{dir}/");
+        let below: Vec<String> = self
+            .entries
+            .keys()
+            .filter(|path| path.starts_with(&prefix))
+            .cloned()
+            .collect();
+        for path in below {
+            if let Some(Entry {
+                change: Change::Rename { from, .. },
+                ..
+            }) = self.remove(&path)
+            {
+                if !from.starts_with(&prefix) {
+                    self.vanish(&from, now);
+                }
+            }
+        }
+    }
+
+    /// Carry the changes below `from` over to `to`, after the directory's own
+    /// rename, which has to reach the server first.
+    fn move_below(&mut self, from: &str, to: &str) {
+        let prefix = format!("{from}/");
+        let moved = |path: &str| format!("{to}/{}", &path[prefix.len()..]);
+        let below: Vec<String> = self
+            .order
+            .values()
+            .filter(|path| path.starts_with(&prefix))
+            .cloned()
+            .collect();
+        for path in below {
+            let mut entry = self.remove(&path).unwrap();
+            if let Change::Rename { from: origin, .. } = &mut entry.change {
+                if origin.starts_with(&prefix) {
+                    *origin = moved(origin);
+                }
+            }
+            self.insert(moved(&path), entry);
+        }
+    }
+
+    /// Take the first change that is ready and may run alongside `busy`.
+    ///
+    /// A change is ready once its path has been quiet for `settle`, or has
+    /// been changing for `max_defer`. A file that was created but never closed
+    /// waits `max_defer` of quiet. Uploads only wait for earlier renames,
+    /// deletes and new directories; those wait for every earlier change.
+    fn next_ready(
+        &mut self,
+        now: Instant,
+        settle: Duration,
+        max_defer: Duration,
+        busy: &[Op],
+    ) -> Option<Op> {
+        let mut earlier: Vec<(&str, Option<&str>)> = Vec::new();
+        let mut earlier_structural: Vec<(&str, Option<&str>)> = Vec::new();
+        let mut chosen = None;
+        for path in self.order.values() {
+            let entry = &self.entries[path];
+            let paths = match &entry.change {
+                Change::Rename { from, .. } => (path.as_str(), Some(from.as_str())),
+                _ => (path.as_str(), None),
+            };
+            let structural = !matches!(entry.change, Change::Created | Change::Upload);
+            let quiet = now.duration_since(entry.last);
+            let ready = match entry.change {
+                Change::Created => quiet >= max_defer,
+                _ => quiet >= settle || now.duration_since(entry.first) >= max_defer,
+            };
+            if ready {
+                let blockers = if structural {
+                    &earlier
+                } else {
+                    &earlier_structural
+                };
+                let blocked = busy.iter().any(|op| overlaps(op.paths(), paths))
+                    || blockers.iter().any(|&other| overlaps(other, paths));
+                if !blocked {
+                    chosen = Some(path.clone());
+                    break;
+                }
+            }
+            earlier.push(paths);
+            if structural {
+                earlier_structural.push(paths);
+            }
+        }
+
+        let path = chosen?;
+        let entry = self.remove(&path).unwrap();
+        Some(match entry.change {
+            Change::Created | Change::Upload => Op::Upload { path },
+            Change::Mkdir => Op::Mkdir {
+                path,
+                replace: !entry.fresh,
+            },
+            Change::Rename { from, modified } => Op::Rename {
+                from,
+                to: path,
+                upload: modified,
+            },
+            Change::Delete => Op::Delete { path },
+        })
+    }
+}
+
+/// Whether `path` is `dir` or below it.
+fn is_within(path: &str, dir: &str) -> bool {
+    dir.is_empty()
+        || path
+            .strip_prefix(dir)
+            .is_some_and(|rest| rest.is_empty() || rest.starts_with('/'))
+}
+
+/// Whether two changes touch the same path, or one a directory holding the other's.
+fn overlaps(a: (&str, Option<&str>), b: (&str, Option<&str>)) -> bool {
+    let related = |x: &str, y: &str| is_within(x, y) || is_within(y, x);
+    [Some(a.0), a.1].into_iter().flatten().any(|x| {
+        [Some(b.0), b.1]
+            .into_iter()
+            .flatten()
+            .any(|y| related(x, y))
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const SETTLE: Duration = Duration::from_millis(500);
+    const MAX_DEFER: Duration = Duration::from_secs(10);
+
+    /// Every op `changes` sends once all paths have settled, in order.
+    fn drain(changes: &mut Changes, now: Instant) -> Vec<Op> {
+        let later = now + MAX_DEFER * 2;
+        std::iter::from_fn(|| changes.next_ready(later, SETTLE, MAX_DEFER, &[])).collect()
+    }
+
+    fn upload(path: &str) -> Op {
+        Op::Upload { path: path.into() }
+    }
+
+    #[test]
+    fn created_then_deleted_file_sends_nothing() {
+        let (mut changes, now) = (Changes::default(), Instant::now());
+        changes.created("a", now);
+        changes.touch("a", now);
+        changes.closed("a", now);
+        changes.deleted("a", false, now);
+        assert_eq!(drain(&mut changes, now), []);
+    }
+
+    #[test]
+    fn repeated_writes_upload_once() {
+        let (mut changes, now) = (Changes::default(), Instant::now());
+        changes.created("a", now);
+        for _ in 0..5 {
+            changes.touch("a", now);
+            changes.closed("a", now);
+        }
+        assert_eq!(drain(&mut changes, now), [upload("a")]);
+    }
+
+    #[test]
+    fn rename_chain_is_one_rename() {
+        let (mut changes, now) = (Changes::default(), Instant::now());
+        changes.renamed("a", "b", false, now);
+        changes.renamed("b", "c", false, now);
+        let rename = Op::Rename {
+            from: "a".into(),
+            to: "c".into(),
+            upload: false,
+        };
+        assert_eq!(drain(&mut changes, now), [rename]);
+    }
+
+    #[test]
+    fn save_through_temporary_file_uploads_target() {
+        let (mut changes, now) = (Changes::default(), Instant::now());
+        changes.created(".a.swp", now);
+        changes.closed(".a.swp", now);
+        changes.renamed(".a.swp", "a", false, now);
+        assert_eq!(drain(&mut changes, now), [upload("a")]);
+    }
+
+    #[test]
+    fn deleted_directory_is_one_delete() {
+        let (mut changes, now) = (Changes::default(), Instant::now());
+        changes.closed("d/a", now);
+        changes.closed("d/e/b", now);
+        // The kernel reports the contents first, deepest first.
+        changes.deleted("d/e/b", false, now);
+        changes.deleted("d/e", true, now);
+        changes.deleted("d/a", false, now);
+        changes.deleted("d", true, now);
+        assert_eq!(drain(&mut changes, now), [Op::Delete { path: "d".into() }]);
+    }
+
+    #[test]
+    fn busy_paths_block_overlapping_changes() {
+        let (mut changes, now) = (Changes::default(), Instant::now());
+        changes.closed("d/a", now);
+        changes.closed("b", now);
+        let later = now + SETTLE;
+        let busy = [Op::Mkdir {
+            path: "d".into(),
+            replace: false,
+        }];
+        assert_eq!(
+            changes.next_ready(later, SETTLE, MAX_DEFER, &busy),
+            Some(upload("b"))
+        );
+        assert_eq!(changes.next_ready(later, SETTLE, MAX_DEFER, &busy), None);
+        assert_eq!(
+            changes.next_ready(later, SETTLE, MAX_DEFER, &[]),
+            Some(upload("d/a"))
+        );
+    }
+
+    #[test]
+    fn retry_waits_and_goes_first() {
+        let (mut changes, now) = (Changes::default(), Instant::now());
+        changes.created_dir("d", now);
+        changes.added("d/a", now);
+        let mkdir = changes
+            .next_ready(now + SETTLE, SETTLE, MAX_DEFER, &[])
+            .unwrap();
+        assert_eq!(
+            mkdir,
+            Op::Mkdir {
+                path: "d".into(),
+                replace: false,
+            }
+        );
+
+        // The directory failed; its file must not overtake the retry.
+        let at = now + Duration::from_secs(1);
+        changes.retry("d", Change::Mkdir, true, at);
+        assert_eq!(changes.next_ready(at, SETTLE, MAX_DEFER, &[]), None);
+        assert_eq!(drain(&mut changes, at), [mkdir, upload("d/a")]);
+    }
+}
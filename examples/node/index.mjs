@@ -10,8 +10,17 @@
  *                          FILEBROWSER_USERNAME=admin \
  *                          FILEBROWSER_PASSWORD=admin \
  *                          npm start
+ *
+ *   Set FILEBROWSER_LARGE_FILE to a local file (any size) to also stream it up
+ *   and back down; memory use stays flat however large the file is.
  */
 
+import { createReadStream, createWriteStream, statSync, unlinkSync } from "node:fs";
+import { tmpdir } from "node:os";
+import { join } from "node:path";
+import { Readable, Writable } from "node:stream";
+import { pipeline } from "node:stream/promises";
+
 // Import the krfiles library
 import krfiles from "krfiles";
 const { JsFilebrowserClient, Resource } = krfiles.dev.rolandh.krfiles;
@@ -19,6 +28,7 @@ const { JsFilebrowserClient, Resource } = krfiles.dev.rolandh.krfiles;
 const url = process.env.FILEBROWSER_URL;
 const username = process.env.FILEBROWSER_USERNAME;
 const password = process.env.FILEBROWSER_PASSWORD;
+const largeFile = process.env.FILEBROWSER_LARGE_FILE;
 
 if (!url || !username || !password) {
   console.error(
@@ -28,7 +38,8 @@ if (!url || !username || !password) {
 }
 
 async function main() {
-  const client = new JsFilebrowserClient(url);
+  // No metadata cache; at most 8 requests in flight, however many calls are made
+  const client = new JsFilebrowserClient(url, 0, 8);
 
   try {
     // Login
@@ -49,6 +60,17 @@ async function main() {
     }
     console.log(`\n  ${root.numDirs} directories, ${root.numFiles} files\n`);
 
+    // Walk the whole tree; entries arrive while listings are still loading
+    let files = 0;
+    let bytes = 0;
+    for await (const entry of client.walkStream("/")) {
+      if (!entry.isDir) {
+        files++;
+        bytes += entry.size;
+      }
+    }
+    console.log(`Tree: ${files} files, ${bytes} bytes\n`);
+
     // Upload a test file
     // Note: Kotlin ByteArray maps to Int8Array in JS
     const testPath = "/krfiles-node-example.txt";
@@ -67,6 +89,8 @@ async function main() {
     // Clean up
     console.log(`Cleaning up ${testPath}...`);
     await client.delete(testPath);
+
+    if (largeFile) await streamLargeFile(client, largeFile);
     console.log("Done!");
   } catch (err) {
     console.error("Error:", err.message || err);
@@ -75,4 +99,23 @@ async function main() {
   }
 }
 
+/** Upload and download a file of any size through Node streams. */
+async function streamLargeFile(client, file) {
+  const remote = "/krfiles-node-example.bin";
+  const copy = join(tmpdir(), "krfiles-node-example.bin");
+  const { size } = statSync(file);
+  const rss = () => `${Math.round(process.memoryUsage().rss / 1048576)} MB RSS`;
+
+  console.log(`\nStreaming ${file} (${size} bytes) to ${remote}...`);
+  await pipeline(createReadStream(file), Writable.fromWeb(client.uploadStream(remote, size)));
+  console.log(`Upload complete, ${rss()}`);
+
+  console.log(`Streaming ${remote} back to ${copy}...`);
+  await pipeline(Readable.fromWeb(client.downloadStream(remote)), createWriteStream(copy));
+  console.log(`Download complete (${statSync(copy).size} bytes), ${rss()}`);
+
+  unlinkSync(copy);
+  await client.delete(remote);
+}
+
 main();
@@ -1,6 +1,8 @@
 plugins {
     alias(libs.plugins.kotlin.multiplatform)
     alias(libs.plugins.kotlin.serialization)
+    alias(libs.plugins.kotlin.allopen)
+    alias(libs.plugins.kotlinx.benchmark)
     alias(libs.plugins.dokka)
     alias(libs.plugins.kover)
     alias(libs.plugins.ktlint)
@@ -45,6 +47,11 @@ kotlin {
                 environment("FILEBROWSER_PASSWORD", System.getenv("FILEBROWSER_PASSWORD") ?: "")
             }
         }
+
+        // Benchmarks against bench/mockserver.py (see jvmBenchmark source set)
+        compilations.create("benchmark") {
+            associateWith(this@jvm.compilations.getByName("main"))
+        }
     }
 
     js {
@@ -91,11 +98,13 @@ kotlin {
     }
 
     linuxX64 {
+        compilations.getByName("main").cinterops.create("libcrypto")
         binaries {
             sharedLib("krfiles") { baseName = "krfiles" }
         }
     }
     linuxArm64 {
+        compilations.getByName("main").cinterops.create("libcrypto")
         binaries {
             sharedLib("krfiles") { baseName = "krfiles" }
         }
@@ -120,6 +129,7 @@ kotlin {
             dependencies {
                 implementation(libs.ktor.client.core)
                 implementation(libs.ktor.client.content.negotiation)
+                implementation(libs.ktor.client.encoding)
                 implementation(libs.ktor.serialization.json)
                 implementation(libs.kotlinx.serialization.json)
                 implementation(libs.kotlinx.coroutines.core)
@@ -144,6 +154,11 @@ kotlin {
                 implementation(libs.junit.jupiter)
             }
         }
+        getByName("jvmBenchmark") {
+            dependencies {
+                implementation(libs.kotlinx.benchmark.runtime)
+            }
+        }
 
         jsMain {
             dependencies {
@@ -174,13 +189,42 @@ kotlin {
             }
         }
 
-        linuxX64Main { dependsOn(desktopNativeMain) }
-        linuxArm64Main { dependsOn(desktopNativeMain) }
-        macosX64Main { dependsOn(desktopNativeMain) }
-        macosArm64Main { dependsOn(desktopNativeMain) }
-        iosX64Main { dependsOn(iosNativeMain) }
-        iosArm64Main { dependsOn(iosNativeMain) }
-        iosSimulatorArm64Main { dependsOn(iosNativeMain) }
+        // SHA-256 from the platform: libcrypto on Linux (src/nativeInterop/cinterop), CommonCrypto on Apple
+        val linuxNativeMain by creating {
+            dependsOn(nativeMain)
+        }
+        val appleNativeMain by creating {
+            dependsOn(nativeMain)
+        }
+
+        linuxX64Main {
+            dependsOn(desktopNativeMain)
+            dependsOn(linuxNativeMain)
+        }
+        linuxArm64Main {
+            dependsOn(desktopNativeMain)
+            dependsOn(linuxNativeMain)
+        }
+        macosX64Main {
+            dependsOn(desktopNativeMain)
+            dependsOn(appleNativeMain)
+        }
+        macosArm64Main {
+            dependsOn(desktopNativeMain)
+            dependsOn(appleNativeMain)
+        }
+        iosX64Main {
+            dependsOn(iosNativeMain)
+            dependsOn(appleNativeMain)
+        }
+        iosArm64Main {
+            dependsOn(iosNativeMain)
+            dependsOn(appleNativeMain)
+        }
+        iosSimulatorArm64Main {
+            dependsOn(iosNativeMain)
+            dependsOn(appleNativeMain)
+        }
 
         linuxX64Test { dependsOn(nativeTest) }
         linuxArm64Test { dependsOn(nativeTest) }
@@ -199,6 +243,62 @@ tasks.matching { it.name.contains("linuxX64Test") || it.name.contains("linuxArm6
     }
 }
 
+// JMH needs the @State classes open
+allOpen {
+    annotation("org.openjdk.jmh.annotations.State")
+}
+
+// Benchmarks: start `python3 bench/mockserver.py`, then `./gradlew benchmark`.
+// JSON results land in build/reports/benchmarks/main/<timestamp>/jvmBenchmark.json.
+benchmark {
+    targets {
+        register("jvmBenchmark")
+    }
+    configurations {
+        named("main") {
+            warmups = 2
+            iterations = 5
+            iterationTime = 2
+            iterationTimeUnit = "s"
+            reportFormat = "json"
+        }
+        // Largest sizes only: ./gradlew largeBenchmark
+        register("large") {
+            warmups = 1
+            iterations = 3
+            iterationTime = 10
+            iterationTimeUnit = "s"
+            reportFormat = "json"
+            param("entries", 1000000)
+            param("size", 4294967296)
+            param("operations", 10000)
+        }
+        // Passthrough vs. decode + re-encode of large listings, with allocation
+        // per operation (gc.alloc.rate.norm): ./gradlew jsonBenchmark
+        register("json") {
+            warmups = 2
+            iterations = 5
+            iterationTime = 2
+            iterationTimeUnit = "s"
+            reportFormat = "json"
+            include("ListingBenchmark")
+            param("entries", 10000, 100000)
+            advanced("jvmProfiler", "gc")
+        }
+        // Smallest sizes only, for a quick check: ./gradlew smokeBenchmark
+        register("smoke") {
+            warmups = 1
+            iterations = 2
+            iterationTime = 1
+            iterationTimeUnit = "s"
+            reportFormat = "json"
+            param("entries", 1000)
+            param("size", 1024)
+            param("operations", 100)
+        }
+    }
+}
+
 // Dokka configuration for beautiful documentation
 dokka {
     moduleName.set("krfiles")
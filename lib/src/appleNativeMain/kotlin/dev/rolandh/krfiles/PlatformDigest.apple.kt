@@ -0,0 +1,48 @@
+@file:OptIn(ExperimentalForeignApi::class, ExperimentalNativeApi::class)
+
+package dev.rolandh.krfiles
+
+import kotlinx.cinterop.ExperimentalForeignApi
+import kotlinx.cinterop.addressOf
+import kotlinx.cinterop.alloc
+import kotlinx.cinterop.convert
+import kotlinx.cinterop.free
+import kotlinx.cinterop.nativeHeap
+import kotlinx.cinterop.ptr
+import kotlinx.cinterop.reinterpret
+import kotlinx.cinterop.usePinned
+import platform.CoreCrypto.CC_SHA256_CTX
+import platform.CoreCrypto.CC_SHA256_DIGEST_LENGTH
+import platform.CoreCrypto.CC_SHA256_Final
+import platform.CoreCrypto.CC_SHA256_Init
+import platform.CoreCrypto.CC_SHA256_Update
+import kotlin.experimental.ExperimentalNativeApi
+import kotlin.native.ref.createCleaner
+
+/** Apple implementation over CommonCrypto, which uses the CPU's SHA extensions where available. */
+internal actual fun sha256(): Digest = CommonCryptoSha256()
+
+private class CommonCryptoSha256 : Digest {
+    private val context = nativeHeap.alloc<CC_SHA256_CTX>().also { CC_SHA256_Init(it.ptr) }
+
+    // Freed when the digest is collected, whether or not hex() was reached.
+    @Suppress("unused")
+    private val cleaner = createCleaner(context) { nativeHeap.free(it) }
+
+    override fun update(
+        buffer: ByteArray,
+        offset: Int,
+        length: Int,
+    ) {
+        if (length == 0) return
+        buffer.usePinned { pinned ->
+            CC_SHA256_Update(context.ptr, pinned.addressOf(offset), length.convert())
+        }
+    }
+
+    override fun hex(): String {
+        val hash = ByteArray(CC_SHA256_DIGEST_LENGTH)
+        hash.usePinned { pinned -> CC_SHA256_Final(pinned.addressOf(0).reinterpret(), context.ptr) }
+        return hash.joinToString("") { it.toUByte().toString(16).padStart(2, '0') }
+    }
+}
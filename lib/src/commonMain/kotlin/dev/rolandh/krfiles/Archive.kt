@@ -0,0 +1,336 @@
+package dev.rolandh.krfiles
+
+import io.ktor.utils.io.ByteReadChannel
+import io.ktor.utils.io.discard
+import io.ktor.utils.io.readAvailable
+import kotlinx.serialization.Serializable
+
+/** Archive formats the server can pack a directory into; see [FilebrowserClient.downloadArchive]. */
+public enum class ArchiveFormat(
+    internal val algo: String,
+) {
+    ZIP("zip"),
+    TAR("tar"),
+    TAR_GZ("targz"),
+}
+
+/**
+ * Selects the entries [FilebrowserClient.extractArchive] writes, by path
+ * relative to the extracted directory.
+ *
+ * Patterns are globs: `*` and `?` match within one path segment, `**` across
+ * segments. A pattern without a `/` matches an entry's name at any depth, like
+ * `*.log` or `node_modules`. A pattern matching a directory also matches
+ * everything below it. An entry is extracted when it matches an [include]
+ * pattern (or [include] is empty) and no [exclude] pattern.
+ */
+@Serializable
+public data class ArchiveFilter(
+    val include: List<String> = emptyList(),
+    val exclude: List<String> = emptyList(),
+)
+
+/**
+ * Outcome of a [FilebrowserClient.extractArchive].
+ *
+ * @property files Files written
+ * @property directories Directories created
+ * @property bytes Bytes written to files
+ * @property skipped Entries left out by the filter, and links or special files
+ */
+@Serializable
+public data class ExtractReport(
+    val files: Int = 0,
+    val directories: Int = 0,
+    val bytes: Long = 0,
+    val skipped: Int = 0,
+)
+
+/**
+ * Download the directory at [path] as a tar archive and unpack it into
+ * [target] while it arrives, without storing the archive.
+ *
+ * Entries land in [target] relative to [path], so `/photos/2024/a.jpg` becomes
+ * `2024/a.jpg`. Files are written through [LocalTree.write], so a file is only
+ * replaced once it is complete, and get the modification time recorded in the
+ * archive. Missing parent directories are created. Symlinks and other special
+ * entries are skipped, and an entry whose path would leave [target] fails the
+ * extraction.
+ *
+ * The archive is uncompressed tar: the server streams it as it reads the
+ * files, and for trees of many small files the cost saved is the per-file
+ * requests, not bytes on the wire. Use [FilebrowserClient.downloadArchive] for
+ * a compressed archive to keep as is.
+ *
+ * @param path Remote directory to fetch
+ * @param target Local directory to unpack into
+ * @param filter Entries to extract; everything by default
+ * @param progress Optional listener notified with the bytes written so far (total -1)
+ * @return Result containing what was extracted
+ */
+public suspend fun FilebrowserClient.extractArchive(
+    path: String,
+    target: LocalTree,
+    filter: ArchiveFilter = ArchiveFilter(),
+    progress: TransferProgress? = null,
+): Result<ExtractReport> =
+    runCatching {
+        val matcher = PathMatcher(filter)
+        val root = path.trim('/').substringAfterLast('/')
+        openArchive(path, ArchiveFormat.TAR) { channel, meter ->
+            val reader = TarReader(channel)
+            val buffer = ByteArray(FilebrowserClient.DEFAULT_CHUNK_SIZE)
+            val directories = mutableSetOf("")
+            var report = ExtractReport()
+
+            // Create [dir] and any missing ancestors, counting the new ones.
+            fun ensureDirectory(dir: String) {
+                if (dir in directories) return
+                ensureDirectory(dir.substringBeforeLast('/', missingDelimiterValue = ""))
+                target.createDirectory(dir)
+                directories += dir
+                report = report.copy(directories = report.directories + 1)
+            }
+
+            while (true) {
+                val entry = reader.next() ?: break
+                val relative = relativeEntryPath(root, entry.path)
+                when {
+                    relative.isEmpty() -> continue
+                    entry.type == TarEntryType.OTHER || !matcher.matches(relative) ->
+                        report = report.copy(skipped = report.skipped + 1)
+                    entry.type == TarEntryType.DIRECTORY -> ensureDirectory(relative)
+                    else -> {
+                        ensureDirectory(relative.substringBeforeLast('/', missingDelimiterValue = ""))
+                        target.write(relative, entry.modified) { sink ->
+                            while (true) {
+                                val read = reader.read(buffer)
+                                if (read < 0) break
+                                sink(buffer, read)
+                                report = report.copy(bytes = report.bytes + read)
+                                progress?.onProgress(report.bytes, -1)
+                                meter.add(read)
+                            }
+                        }
+                        report = report.copy(files = report.files + 1)
+                    }
+                }
+            }
+            report
+        }
+    }
+
+/**
+ * [entryPath] relative to the requested directory: the server names entries
+ * after the directory itself (`photos/2024/a.jpg`), which is dropped. Paths
+ * that could escape the target (`..`) are rejected.
+ */
+private fun relativeEntryPath(
+    root: String,
+    entryPath: String,
+): String {
+    val segments = entryPath.split('/').filter { it.isNotEmpty() && it != "." }
+    check(segments.none { it == ".." }) { "Unsafe path in archive: $entryPath" }
+    val inside = if (root.isNotEmpty() && segments.firstOrNull() == root) segments.drop(1) else segments
+    return inside.joinToString("/")
+}
+
+/** [ArchiveFilter] with its patterns compiled. */
+private class PathMatcher(
+    filter: ArchiveFilter,
+) {
+    private val include = filter.include.map(::globRegex)
+    private val exclude = filter.exclude.map(::globRegex)
+
+    fun matches(path: String): Boolean {
+        // The path and each of its ancestors, so a pattern on a directory covers its contents.
+        val candidates = path.indices.filter { path[it] == '/' }.map { path.substring(0, it) } + path
+        if (exclude.any { pattern -> candidates.any { pattern.matches(it) } }) return false
+        return include.isEmpty() || include.any { pattern -> candidates.any { pattern.matches(it) } }
+    }
+
+    private companion object {
+        fun globRegex(glob: String): Regex {
+            val pattern = glob.trim('/')
+            val regex = StringBuilder(if ('/' in pattern) "" else "(?:.*/)?")
+            var i = 0
+            while (i < pattern.length) {
+                when {
+                    pattern.startsWith("**/", i) -> {
+                        regex.append("(?:.*/)?")
+                        i += 3
+                        continue
+                    }
+                    pattern.startsWith("**", i) -> {
+                        regex.append(".*")
+                        i += 2
+                        continue
+                    }
+                    pattern[i] == '*' -> regex.append("[^/]*")
+                    pattern[i] == '?' -> regex.append("[^/]")
+                    else -> regex.append(Regex.escape(pattern[i].toString()))
+                }
+                i++
+            }
+            return Regex(regex.toString())
+        }
+    }
+}
+
+internal enum class TarEntryType { FILE, DIRECTORY, OTHER }
+
+internal class TarEntry(
+    val path: String,
+    val type: TarEntryType,
+    val size: Long,
+    /** Seconds since the epoch. */
+    val modified: Long,
+)
+
+/**
+ * Streaming reader for tar archives (ustar, with GNU long names and PAX
+ * `path` records) from [channel].
+ *
+ * Call [next] for each entry header, then [read] its data; data not read is
+ * skipped by the following [next].
+ */
+internal class TarReader(
+    private val channel: ByteReadChannel,
+) {
+    private val header = ByteArray(BLOCK_SIZE)
+    private var remaining = 0L
+    private var padding = 0L
+
+    /** The next entry, or null at the end of the archive. */
+    suspend fun next(): TarEntry? {
+        skip(remaining + padding)
+        remaining = 0
+        padding = 0
+        var longName: String? = null
+        while (true) {
+            if (!readFully(header, BLOCK_SIZE) || header.all { it == 0.toByte() }) return null
+            check(checksumMatches()) { "Corrupt tar header" }
+            val size = number(SIZE_OFFSET, SIZE_LENGTH)
+            when (header[TYPE_OFFSET].toInt().toChar()) {
+                // GNU long name and PAX headers: metadata for the entry that follows
+                'L' -> longName = readText(size).trimEnd('\u0000')
+                'x' -> paxPath(readText(size))?.let { longName = it }
+                'g' -> skip(size + paddingOf(size))
+                else -> {
+                    val type =
+                        when (header[TYPE_OFFSET].toInt().toChar()) {
+                            '0', '\u0000', '7' -> TarEntryType.FILE
+                            '5' -> TarEntryType.DIRECTORY
+                            else -> TarEntryType.OTHER
+                        }
+                    remaining = size
+                    padding = paddingOf(size)
+                    return TarEntry(longName ?: headerName(), type, size, number(MTIME_OFFSET, MTIME_LENGTH))
+                }
+            }
+        }
+    }
+
+    /** Read the current entry's data into [buffer]; returns the bytes read, or -1 at its end. */
+    suspend fun read(buffer: ByteArray): Int {
+        if (remaining == 0L) return -1
+        val read = channel.readAvailable(buffer, 0, minOf(buffer.size.toLong(), remaining).toInt())
+        if (read < 0) throw IllegalStateException("Truncated tar archive")
+        remaining -= read
+        return read
+    }
+
+    private suspend fun readFully(
+        buffer: ByteArray,
+        length: Int,
+    ): Boolean {
+        var filled = 0
+        while (filled < length) {
+            val read = channel.readAvailable(buffer, filled, length - filled)
+            if (read < 0) {
+                check(filled == 0) { "Truncated tar archive" }
+                return false
+            }
+            filled += read
+        }
+        return true
+    }
+
+    private suspend fun readText(size: Long): String {
+        require(size <= MAX_METADATA_SIZE) { "Tar metadata entry too large: $size bytes" }
+        val bytes = ByteArray(size.toInt())
+        check(readFully(bytes, bytes.size)) { "Truncated tar archive" }
+        skip(paddingOf(size))
+        return bytes.decodeToString()
+    }
+
+    private suspend fun skip(count: Long) {
+        if (count > 0) check(channel.discard(count) == count) { "Truncated tar archive" }
+    }
+
+    private fun headerName(): String {
+        val name = text(NAME_OFFSET, NAME_LENGTH)
+        val prefix = if (text(MAGIC_OFFSET, 5) == "ustar") text(PREFIX_OFFSET, PREFIX_LENGTH) else ""
+        return if (prefix.isEmpty()) name else "$prefix/$name"
+    }
+
+    private fun text(
+        offset: Int,
+        length: Int,
+    ): String {
+        var end = offset
+        while (end < offset + length && header[end] != 0.toByte()) end++
+        return header.decodeToString(offset, end)
+    }
+
+    /** Octal field, or base-256 when the high bit is set (GNU, for large values). */
+    private fun number(
+        offset: Int,
+        length: Int,
+    ): Long {
+        if (header[offset].toInt() and 0x80 != 0) {
+            var value = (header[offset].toLong() and 0x7f)
+            for (i in offset + 1 until offset + length) value = (value shl 8) or (header[i].toLong() and 0xff)
+            return value
+        }
+        val digits = text(offset, length).trim()
+        if (digits.isEmpty()) return 0
+        return checkNotNull(digits.toLongOrNull(8)) { "Corrupt tar header" }
+    }
+
+    private fun checksumMatches(): Boolean {
+        var sum = 0L
+        for (i in header.indices) {
+            val inField = i >= CHECKSUM_OFFSET && i < CHECKSUM_OFFSET + CHECKSUM_LENGTH
+            sum += if (inField) ' '.code.toLong() else header[i].toLong() and 0xff
+        }
+        return sum == number(CHECKSUM_OFFSET, CHECKSUM_LENGTH)
+    }
+
+    private companion object {
+        const val BLOCK_SIZE = 512
+        const val NAME_OFFSET = 0
+        const val NAME_LENGTH = 100
+        const val SIZE_OFFSET = 124
+        const val SIZE_LENGTH = 12
+        const val MTIME_OFFSET = 136
+        const val MTIME_LENGTH = 12
+        const val CHECKSUM_OFFSET = 148
+        const val CHECKSUM_LENGTH = 8
+        const val TYPE_OFFSET = 156
+        const val MAGIC_OFFSET = 257
+        const val PREFIX_OFFSET = 345
+        const val PREFIX_LENGTH = 155
+        const val MAX_METADATA_SIZE = 1L shl 20
+
+        fun paddingOf(size: Long): Long = (BLOCK_SIZE - size % BLOCK_SIZE) % BLOCK_SIZE
+
+        /** The `path` record of a PAX header: lines of `<length> <key>=<value>\n`. */
+        fun paxPath(records: String): String? =
+            records
+                .lineSequence()
+                .map { it.substringAfter(' ') }
+                .firstOrNull { it.startsWith("path=") }
+                ?.removePrefix("path=")
+    }
+}
@@ -0,0 +1,168 @@
+package dev.rolandh.krfiles
+
+import kotlinx.coroutines.CompletableDeferred
+import kotlinx.coroutines.channels.Channel
+import kotlinx.coroutines.coroutineScope
+import kotlinx.coroutines.launch
+import kotlinx.serialization.SerialName
+import kotlinx.serialization.Serializable
+
+/** What a [BatchOperation] does. */
+@Serializable
+public enum class BatchOpKind {
+    /** [FilebrowserClient.delete] the path. */
+    @SerialName("delete")
+    DELETE,
+
+    /** [FilebrowserClient.rename] the path to the destination. */
+    @SerialName("rename")
+    RENAME,
+
+    /** [FilebrowserClient.copy] the path to the destination. */
+    @SerialName("copy")
+    COPY,
+
+    /** [FilebrowserClient.createDirectory] at the path. */
+    @SerialName("mkdir")
+    MKDIR,
+}
+
+/**
+ * One step of a [FilebrowserClient.batch], e.g. `{"op":"rename","path":"/a","destination":"/b"}`.
+ *
+ * @property op What to do
+ * @property path The path to act on
+ * @property destination Target path; required for rename and copy
+ * @property override Replace an existing destination (rename and copy only)
+ */
+@Serializable
+public data class BatchOperation(
+    val op: BatchOpKind,
+    val path: String,
+    val destination: String? = null,
+    val override: Boolean = false,
+)
+
+/**
+ * Tuning for [FilebrowserClient.batch].
+ *
+ * @property concurrency Operations in flight at once; 1 runs them strictly in order
+ * @property stopOnError Start no further operations once one has failed
+ */
+public data class BatchOptions(
+    val concurrency: Int = FilebrowserClient.DEFAULT_BATCH_CONCURRENCY,
+    val stopOnError: Boolean = false,
+)
+
+/**
+ * Outcome of one [BatchOperation].
+ *
+ * @property index Position of the operation in the batch
+ * @property ok Whether it succeeded
+ * @property error Why it failed; null if it succeeded or was skipped
+ * @property status HTTP status of a failed request, if the server answered
+ * @property skipped Never started, because an earlier operation failed with [BatchOptions.stopOnError]
+ */
+@Serializable
+public data class BatchResult(
+    val index: Int,
+    val ok: Boolean,
+    val error: String? = null,
+    val status: Int? = null,
+    val skipped: Boolean = false,
+)
+
+/**
+ * Result of a [FilebrowserClient.batch].
+ *
+ * @property results One result per operation, in batch order
+ */
+@Serializable
+public data class BatchReport(
+    val results: List<BatchResult>,
+) {
+    /** Operations that succeeded. */
+    val succeeded: Int get() = results.count { it.ok }
+
+    /** Operations that ran and failed. */
+    val failed: List<BatchResult> get() = results.filter { !it.ok && !it.skipped }
+}
+
+/**
+ * Run [operations] with up to [BatchOptions.concurrency] requests in flight over
+ * the client's shared connection pool.
+ *
+ * Operations start in batch order but may finish in any order, so an operation
+ * must not depend on another in the same batch unless the concurrency is 1.
+ * A failed operation does not fail the batch; it is reported in its
+ * [BatchResult]. With [BatchOptions.stopOnError], operations not yet started
+ * when one fails are reported as skipped.
+ *
+ * @param operations The operations to run
+ * @param options Concurrency and error handling
+ * @param onResult Called as each operation finishes (not for skipped ones), one at a time
+ * @return Result containing the per-operation results; fails only on invalid options
+ */
+public suspend fun FilebrowserClient.batch(
+    operations: List<BatchOperation>,
+    options: BatchOptions = BatchOptions(),
+    onResult: (BatchResult) -> Unit = {},
+): Result<BatchReport> =
+    runCatching {
+        require(options.concurrency > 0) { "concurrency must be positive" }
+        val results = arrayOfNulls<BatchResult>(operations.size)
+        val queue = Channel<Int>(Channel.UNLIMITED)
+        operations.indices.forEach { queue.trySend(it) }
+        queue.close()
+        val done = Channel<BatchResult>(Channel.UNLIMITED)
+        // Completed once an operation fails with stopOnError; workers check it before each start.
+        val stop = CompletableDeferred<Unit>()
+        coroutineScope {
+            val workers =
+                List(minOf(options.concurrency, operations.size)) {
+                    launch {
+                        for (index in queue) {
+                            if (stop.isCompleted) break
+                            val result = runOperation(index, operations[index])
+                            if (!result.ok && options.stopOnError) stop.complete(Unit)
+                            done.send(result)
+                        }
+                    }
+                }
+            launch {
+                workers.forEach { it.join() }
+                done.close()
+            }
+            // Only this coroutine touches `results` and calls `onResult`.
+            for (result in done) {
+                results[result.index] = result
+                onResult(result)
+            }
+        }
+        BatchReport(results.mapIndexed { index, result -> result ?: BatchResult(index, ok = false, skipped = true) })
+    }
+
+private suspend fun FilebrowserClient.runOperation(
+    index: Int,
+    operation: BatchOperation,
+): BatchResult {
+    val result =
+        runCatching {
+            when (operation.op) {
+                BatchOpKind.DELETE -> delete(operation.path)
+                BatchOpKind.MKDIR -> createDirectory(operation.path)
+                BatchOpKind.RENAME -> rename(operation.path, destinationOf(operation), operation.override)
+                BatchOpKind.COPY -> copy(operation.path, destinationOf(operation), operation.override)
+            }.getOrThrow()
+        }
+    val error = result.exceptionOrNull() ?: return BatchResult(index, ok = true)
+    return BatchResult(
+        index,
+        ok = false,
+        error = error.message ?: error.toString(),
+        status = (error as? FilebrowserException)?.statusCode,
+    )
+}
+
+private fun destinationOf(operation: BatchOperation): String =
+    requireNotNull(operation.destination) { "${operation.op.name.lowercase()} needs a destination" }
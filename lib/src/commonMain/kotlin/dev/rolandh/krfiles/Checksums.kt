@@ -0,0 +1,194 @@
+package dev.rolandh.krfiles
+
+/** Incremental hash over a stream of bytes; see [sha256]. */
+internal interface Digest {
+    fun update(
+        buffer: ByteArray,
+        offset: Int,
+        length: Int,
+    )
+
+    /** The hash of everything passed to [update], as lowercase hex. Call once. */
+    fun hex(): String
+}
+
+/**
+ * A SHA-256 [Digest], the checksum compared with the server's. The JVM uses
+ * `MessageDigest`, whose SHA-256 the JIT compiles to the CPU's SHA extensions
+ * where available; Native uses OpenSSL's libcrypto on Linux and CommonCrypto
+ * on Apple platforms, both of which use them too. JS, and Linux hosts without
+ * libcrypto, use [Sha256].
+ */
+internal expect fun sha256(): Digest
+
+/**
+ * A transferred file's hash differs from the server's: the copy is corrupt or
+ * the remote file changed during the transfer.
+ *
+ * @property path Remote path of the file
+ * @property expected SHA-256 reported by the server
+ * @property actual SHA-256 of the bytes received
+ */
+public class ChecksumMismatchException(
+    public val path: String,
+    public val expected: String,
+    public val actual: String,
+) : Exception("Checksum mismatch for $path: got $actual, expected $expected")
+
+/**
+ * Whether the remote file at [path] has the same contents as [source]: the
+ * sizes match and so do their SHA-256 checksums. The server only hashes the
+ * file, and [source] is only read, when the sizes already agree.
+ *
+ * @param path Remote file
+ * @param size Size of [source] in bytes
+ * @param source Local contents
+ * @return Result containing false if the remote file differs or doesn't exist
+ */
+public suspend fun FilebrowserClient.matchesRemote(
+    path: String,
+    size: Long,
+    source: ChunkSource,
+): Result<Boolean> =
+    runCatching {
+        val remote =
+            getResource(path).getOrElse { e ->
+                if (e is FilebrowserException && e.statusCode == 404) return@runCatching false
+                throw e
+            }
+        if (remote.isDir || remote.size.toLong() != size) return@runCatching false
+        val expected = getChecksum(path).getOrThrow()
+        hashSource(source, size) == expected
+    }
+
+/** SHA-256 of the first [size] bytes of [source], as lowercase hex. */
+internal suspend fun hashSource(
+    source: ChunkSource,
+    size: Long,
+): String {
+    val digest = sha256()
+    val buffer = ByteArray(FilebrowserClient.DEFAULT_CHUNK_SIZE)
+    var position = 0L
+    while (position < size) {
+        val wanted = minOf(buffer.size.toLong(), size - position).toInt()
+        val read = source.read(position, buffer, wanted)
+        check(read > 0) { "Source ended at byte $position, expected $size" }
+        digest.update(buffer, 0, read)
+        position += read
+    }
+    return digest.hex()
+}
+
+/** SHA-256 (FIPS 180-4) in plain Kotlin. */
+internal class Sha256 : Digest {
+    private val state = INITIAL_STATE.copyOf()
+    private val block = ByteArray(BLOCK_SIZE)
+    private val schedule = IntArray(64)
+    private var blockLength = 0
+    private var total = 0L
+
+    override fun update(
+        buffer: ByteArray,
+        offset: Int,
+        length: Int,
+    ) {
+        var i = offset
+        val end = offset + length
+        total += length
+        if (blockLength > 0) {
+            val count = minOf(BLOCK_SIZE - blockLength, length)
+            buffer.copyInto(block, blockLength, i, i + count)
+            blockLength += count
+            i += count
+            if (blockLength < BLOCK_SIZE) return
+            compress(block, 0)
+            blockLength = 0
+        }
+        while (end - i >= BLOCK_SIZE) {
+            compress(buffer, i)
+            i += BLOCK_SIZE
+        }
+        buffer.copyInto(block, 0, i, end)
+        blockLength = end - i
+    }
+
+    override fun hex(): String {
+        val bits = total * 8
+        // 0x80, zeros up to 8 bytes short of a block boundary, then the length in bits.
+        val padded = if (blockLength < BLOCK_SIZE - 8) BLOCK_SIZE else 2 * BLOCK_SIZE
+        val padding = ByteArray(padded - blockLength)
+        padding[0] = 0x80.toByte()
+        for (k in 0 until 8) padding[padding.size - 1 - k] = (bits ushr (8 * k)).toByte()
+        update(padding, 0, padding.size)
+        return state.joinToString("") { it.toUInt().toString(16).padStart(8, '0') }
+    }
+
+    private fun compress(
+        data: ByteArray,
+        offset: Int,
+    ) {
+        val w = schedule
+        for (t in 0 until 16) {
+            val i = offset + 4 * t
+            w[t] = (data[i].toInt() and 0xff shl 24) or (data[i + 1].toInt() and 0xff shl 16) or
+                (data[i + 2].toInt() and 0xff shl 8) or (data[i + 3].toInt() and 0xff)
+        }
+        for (t in 16 until 64) {
+            val s0 = w[t - 15].rotateRight(7) xor w[t - 15].rotateRight(18) xor (w[t - 15] ushr 3)
+            val s1 = w[t - 2].rotateRight(17) xor w[t - 2].rotateRight(19) xor (w[t - 2] ushr 10)
+            w[t] = w[t - 16] + s0 + w[t - 7] + s1
+        }
+        var a = state[0]
+        var b = state[1]
+        var c = state[2]
+        var d = state[3]
+        var e = state[4]
+        var f = state[5]
+        var g = state[6]
+        var h = state[7]
+        for (t in 0 until 64) {
+            val s1 = e.rotateRight(6) xor e.rotateRight(11) xor e.rotateRight(25)
+            val choice = (e and f) xor (e.inv() and g)
+            val t1 = h + s1 + choice + K[t] + w[t]
+            val s0 = a.rotateRight(2) xor a.rotateRight(13) xor a.rotateRight(22)
+            val majority = (a and b) xor (a and c) xor (b and c)
+            h = g
+            g = f
+            f = e
+            e = d + t1
+            d = c
+            c = b
+            b = a
+            a = t1 + s0 + majority
+        }
+        state[0] += a
+        state[1] += b
+        state[2] += c
+        state[3] += d
+        state[4] += e
+        state[5] += f
+        state[6] += g
+        state[7] += h
+    }
+
+    private companion object {
+        const val BLOCK_SIZE = 64
+
+        val INITIAL_STATE =
+            uintArrayOf(
+                0x6a09e667u, 0xbb67ae85u, 0x3c6ef372u, 0xa54ff53au, 0x510e527fu, 0x9b05688cu, 0x1f83d9abu, 0x5be0cd19u,
+            ).toIntArray()
+
+        val K =
+            uintArrayOf(
+                0x428a2f98u, 0x71374491u, 0xb5c0fbcfu, 0xe9b5dba5u, 0x3956c25bu, 0x59f111f1u, 0x923f82a4u, 0xab1c5ed5u,
+                0xd807aa98u, 0x12835b01u, 0x243185beu, 0x550c7dc3u, 0x72be5d74u, 0x80deb1feu, 0x9bdc06a7u, 0xc19bf174u,
+                0xe49b69c1u, 0xefbe4786u, 0x0fc19dc6u, 0x240ca1ccu, 0x2de92c6fu, 0x4a7484aau, 0x5cb0a9dcu, 0x76f988dau,
+                0x983e5152u, 0xa831c66du, 0xb00327c8u, 0xbf597fc7u, 0xc6e00bf3u, 0xd5a79147u, 0x06ca6351u, 0x14292967u,
+                0x27b70a85u, 0x2e1b2138u, 0x4d2c6dfcu, 0x53380d13u, 0x650a7354u, 0x766a0abbu, 0x81c2c92eu, 0x92722c85u,
+                0xa2bfe8a1u, 0xa81a664bu, 0xc24b8b70u, 0xc76c51a3u, 0xd192e819u, 0xd6990624u, 0xf40e3585u, 0x106aa070u,
+                0x19a4c116u, 0x1e376c08u, 0x2748774cu, 0x34b0bcb5u, 0x391c0cb3u, 0x4ed8aa4au, 0x5b9cca4fu, 0x682e6ff3u,
+                0x748f82eeu, 0x78a5636fu, 0x84c87814u, 0x8cc70208u, 0x90befffau, 0xa4506cebu, 0xbef9a3f7u, 0xc67178f2u,
+            ).toIntArray()
+    }
+}
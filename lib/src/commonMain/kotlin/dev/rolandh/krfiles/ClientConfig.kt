@@ -0,0 +1,93 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.HttpClientConfig
+import io.ktor.client.plugins.HttpTimeout
+import kotlinx.serialization.Serializable
+
+/**
+ * HTTP transport settings for the client [FilebrowserClient] creates when none is passed in.
+ *
+ * Each engine applies what it supports and ignores the rest:
+ *
+ * | Setting | CIO (JVM) | Curl (Linux, macOS) | Darwin (iOS) | JS |
+ * |---|---|---|---|---|
+ * | timeouts | all | connect, request | all | request |
+ * | [maxConnections] | yes | – | – | – |
+ * | [maxConnectionsPerHost] | yes | – | yes | – |
+ * | [keepAliveMillis] | yes | – | – | – |
+ * | [compressResponses] | yes | yes | always on | always on |
+ *
+ * Curl and Darwin negotiate HTTP/2 over TLS on their own, multiplexing requests
+ * to the same host over one connection. CIO speaks HTTP/1.1 only. All engines
+ * already disable Nagle's algorithm (`TCP_NODELAY`).
+ *
+ * With [compressResponses], CIO and Curl clients send `Accept-Encoding: gzip,
+ * deflate` and inflate responses as they are read; the ratio and time spent show
+ * in [ClientStats.compression]. Darwin and JS engines negotiate and decompress
+ * on their own, so there it can't be turned off and isn't measured.
+ * File downloads ask for an uncompressed body unless [compressTransfers] is set:
+ * Filebrowser sends files as stored, but a compressing proxy in front of it
+ * would otherwise spend CPU on both ends for media that doesn't shrink.
+ * Segmented downloads always do, since byte ranges only address the file itself.
+ *
+ * A null setting leaves the engine's default. Without a request or socket
+ * timeout, a server that stops responding mid-transfer stalls the call until
+ * the OS gives up on the connection.
+ *
+ * @property connectTimeoutMillis Time allowed to establish a connection
+ * @property requestTimeoutMillis Time allowed for a whole request, body included; keep
+ *   null or generous when transferring large files
+ * @property socketTimeoutMillis Longest silence allowed between two packets
+ * @property maxConnections Connections open at once, across all hosts
+ * @property maxConnectionsPerHost Connections open at once to the server
+ * @property keepAliveMillis How long an idle connection stays in the pool
+ * @property compressResponses Accept compressed API responses (listings, search results)
+ * @property compressTransfers Also accept compressed file and archive downloads, for
+ *   text-heavy trees behind a compressing proxy
+ */
+@Serializable
+public data class ClientConfig(
+    val connectTimeoutMillis: Long? = DEFAULT_CONNECT_TIMEOUT_MILLIS,
+    val requestTimeoutMillis: Long? = null,
+    val socketTimeoutMillis: Long? = null,
+    val maxConnections: Int? = null,
+    val maxConnectionsPerHost: Int? = null,
+    val keepAliveMillis: Long? = null,
+    val compressResponses: Boolean = true,
+    val compressTransfers: Boolean = false,
+) {
+    init {
+        listOfNotNull(connectTimeoutMillis, requestTimeoutMillis, socketTimeoutMillis, keepAliveMillis).forEach {
+            require(it > 0) { "Timeouts must be positive" }
+        }
+        listOfNotNull(maxConnections, maxConnectionsPerHost).forEach {
+            require(it > 0) { "Connection limits must be positive" }
+        }
+    }
+
+    public companion object {
+        /** Default [connectTimeoutMillis] (30 seconds). */
+        public const val DEFAULT_CONNECT_TIMEOUT_MILLIS: Long = 30_000
+    }
+}
+
+/**
+ * Create an [HttpClient] on this platform's engine, tuned by [config], then
+ * apply [block] for the plugins every client needs.
+ */
+internal expect fun createHttpClient(
+    config: ClientConfig,
+    block: HttpClientConfig<*>.() -> Unit,
+): HttpClient
+
+/** Install [HttpTimeout] if [config] sets any timeout. */
+internal fun HttpClientConfig<*>.installTimeouts(config: ClientConfig) {
+    val timeouts = listOf(config.connectTimeoutMillis, config.requestTimeoutMillis, config.socketTimeoutMillis)
+    if (timeouts.all { it == null }) return
+    install(HttpTimeout) {
+        connectTimeoutMillis = config.connectTimeoutMillis
+        requestTimeoutMillis = config.requestTimeoutMillis
+        socketTimeoutMillis = config.socketTimeoutMillis
+    }
+}
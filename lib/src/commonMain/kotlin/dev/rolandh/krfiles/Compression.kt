@@ -0,0 +1,214 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClientConfig
+import io.ktor.client.plugins.compression.ContentEncoding
+import io.ktor.util.ContentEncoder
+import io.ktor.utils.io.ByteReadChannel
+import io.ktor.utils.io.ByteWriteChannel
+import io.ktor.utils.io.WriterScope
+import io.ktor.utils.io.readAvailable
+import io.ktor.utils.io.writeFully
+import io.ktor.utils.io.writer
+import kotlinx.coroutines.CoroutineScope
+import kotlin.coroutines.CoroutineContext
+import kotlin.time.Duration
+import kotlin.time.TimeSource
+
+/**
+ * Incremental deflate decompressor, the subset of zlib's `inflate` the
+ * response decoder needs. One instance decodes one body; call [end] to free it.
+ */
+internal interface Inflater {
+    /** True once the end of the compressed stream was decoded. */
+    val finished: Boolean
+
+    /** True when all input given to [setInput] has been consumed. */
+    val needsInput: Boolean
+
+    /** Hand over the next compressed bytes; they must stay unchanged until consumed. */
+    fun setInput(
+        buffer: ByteArray,
+        offset: Int,
+        length: Int,
+    )
+
+    /** Decompress into [output]; returns the bytes written, 0 when more input is needed. */
+    fun inflate(output: ByteArray): Int
+
+    fun end()
+}
+
+/**
+ * A platform inflater: zlib-wrapped data (`Content-Encoding: deflate`) with
+ * [zlibHeader], raw deflate data otherwise.
+ */
+internal expect fun platformInflater(zlibHeader: Boolean): Inflater
+
+/**
+ * True when this platform's engine decompresses responses on its own: browsers
+ * and Node's fetch, and URLSession on Darwin. The client then leaves
+ * `Accept-Encoding` to the engine instead of installing [InflatingEncoder].
+ */
+internal expect val engineDecompresses: Boolean
+
+/**
+ * Ask for gzip or deflate compressed responses and decode them as they are
+ * read, recording ratio and time in [metrics]. Does nothing where the engine
+ * already decompresses.
+ */
+internal fun HttpClientConfig<*>.installCompression(metrics: ClientMetrics) {
+    if (engineDecompresses) return
+    install(ContentEncoding) {
+        customEncoder(InflatingEncoder("gzip", metrics))
+        customEncoder(InflatingEncoder("deflate", metrics), quality = 0.9f)
+    }
+}
+
+/**
+ * Decoder for the `gzip` and `deflate` content encodings.
+ *
+ * The body is inflated chunk by chunk into the channel the response is read
+ * from, so JSON decoding and downloads consume it while it arrives. The gzip
+ * trailer's CRC is not checked; the transport already guards against
+ * corruption, and a truncated body still fails.
+ */
+internal class InflatingEncoder(
+    override val name: String,
+    private val metrics: ClientMetrics,
+) : ContentEncoder {
+    override fun decode(
+        source: ByteReadChannel,
+        coroutineContext: CoroutineContext,
+    ): ByteReadChannel =
+        CoroutineScope(coroutineContext).writer { inflate(source) }.channel
+
+    override fun encode(
+        source: ByteReadChannel,
+        coroutineContext: CoroutineContext,
+    ): ByteReadChannel = throw UnsupportedOperationException("Request bodies are sent uncompressed")
+
+    override fun encode(
+        source: ByteWriteChannel,
+        coroutineContext: CoroutineContext,
+    ): ByteWriteChannel = throw UnsupportedOperationException("Request bodies are sent uncompressed")
+
+    private suspend fun WriterScope.inflate(source: ByteReadChannel) {
+        val gzip = name == "gzip"
+        val header = if (gzip) GzipHeader() else null
+        val inflater = platformInflater(zlibHeader = !gzip)
+        val input = ByteArray(FilebrowserClient.DEFAULT_CHUNK_SIZE)
+        val output = ByteArray(FilebrowserClient.DEFAULT_CHUNK_SIZE)
+        var compressed = 0L
+        var decompressed = 0L
+        var cpu = Duration.ZERO
+        try {
+            while (!inflater.finished) {
+                val read = source.readAvailable(input, 0, input.size)
+                if (read < 0) break
+                compressed += read
+                val start = header?.consume(input, 0, read) ?: 0
+                if (header?.complete == false || start == read) continue
+                inflater.setInput(input, start, read - start)
+                // Drain everything this input yields before reading more.
+                while (true) {
+                    val mark = TimeSource.Monotonic.markNow()
+                    val count = inflater.inflate(output)
+                    cpu += mark.elapsedNow()
+                    if (count > 0) {
+                        channel.writeFully(output, 0, count)
+                        decompressed += count
+                    }
+                    if (inflater.finished) break
+                    if (count == 0) {
+                        check(inflater.needsInput) { "Corrupt $name response body" }
+                        break
+                    }
+                }
+                channel.flush()
+            }
+            check(inflater.finished) { "Truncated $name response body" }
+        } finally {
+            inflater.end()
+            metrics.recordCompression(compressed, decompressed, cpu)
+        }
+    }
+}
+
+/**
+ * Incremental parser skipping a gzip member header (RFC 1952): the fixed ten
+ * bytes, then the optional extra field, file name, comment and header CRC.
+ */
+internal class GzipHeader {
+    private enum class State { FIXED, EXTRA_LENGTH, EXTRA, NAME, COMMENT, CRC, DONE }
+
+    private var state = State.FIXED
+    private var count = 0
+    private var flags = 0
+    private var extraLength = 0
+
+    val complete: Boolean
+        get() = state == State.DONE
+
+    /** Consume header bytes from [buffer] between [start] and [end]; returns where the deflate data begins. */
+    fun consume(
+        buffer: ByteArray,
+        start: Int,
+        end: Int,
+    ): Int {
+        var i = start
+        while (i < end && state != State.DONE) {
+            val byte = buffer[i++].toInt() and 0xff
+            when (state) {
+                State.FIXED -> {
+                    when (count) {
+                        0 -> check(byte == 0x1f) { "Not a gzip stream" }
+                        1 -> check(byte == 0x8b) { "Not a gzip stream" }
+                        2 -> check(byte == 8) { "Unsupported gzip compression method $byte" }
+                        3 -> flags = byte
+                    }
+                    if (++count == FIXED_LENGTH) advance()
+                }
+                State.EXTRA_LENGTH -> {
+                    extraLength = extraLength or (byte shl (8 * count))
+                    if (++count == 2) {
+                        if (extraLength == 0) advance() else next(State.EXTRA)
+                    }
+                }
+                State.EXTRA -> if (++count == extraLength) advance()
+                State.NAME, State.COMMENT -> if (byte == 0) advance()
+                State.CRC -> if (++count == 2) advance()
+                State.DONE -> Unit
+            }
+        }
+        return i
+    }
+
+    private fun next(state: State) {
+        this.state = state
+        count = 0
+    }
+
+    /** Move to the next optional field the flags announce, or to [State.DONE]. */
+    private fun advance() {
+        val optional =
+            listOf(
+                State.EXTRA_LENGTH to FLAG_EXTRA,
+                State.NAME to FLAG_NAME,
+                State.COMMENT to FLAG_COMMENT,
+                State.CRC to FLAG_HEADER_CRC,
+            )
+        next(
+            optional
+                .firstOrNull { (field, flag) -> field > state && flags and flag != 0 }
+                ?.first ?: State.DONE,
+        )
+    }
+
+    private companion object {
+        const val FIXED_LENGTH = 10
+        const val FLAG_HEADER_CRC = 2
+        const val FLAG_EXTRA = 4
+        const val FLAG_NAME = 8
+        const val FLAG_COMMENT = 16
+    }
+}
@@ -1,25 +1,54 @@
 package dev.rolandh.krfiles
 
 import io.ktor.client.HttpClient
+import io.ktor.client.HttpClientConfig
 import io.ktor.client.call.body
 import io.ktor.client.plugins.contentnegotiation.ContentNegotiation
 import io.ktor.client.request.HttpRequestBuilder
 import io.ktor.client.request.delete
 import io.ktor.client.request.get
+import io.ktor.client.request.head
 import io.ktor.client.request.header
 import io.ktor.client.request.parameter
 import io.ktor.client.request.patch
 import io.ktor.client.request.post
+import io.ktor.client.request.prepareGet
 import io.ktor.client.request.put
 import io.ktor.client.request.setBody
+import io.ktor.client.statement.bodyAsChannel
+import io.ktor.client.statement.HttpResponse
 import io.ktor.client.statement.bodyAsText
 import io.ktor.http.ContentType
+import io.ktor.http.HttpHeaders
+import io.ktor.http.HttpStatusCode
+import io.ktor.http.contentLength
 import io.ktor.http.contentType
 import io.ktor.http.encodeURLParameter
+import io.ktor.http.content.OutgoingContent
 import io.ktor.http.isSuccess
 import io.ktor.serialization.kotlinx.json.json
+import io.ktor.utils.io.ByteReadChannel
+import io.ktor.utils.io.ByteWriteChannel
 import io.ktor.utils.io.core.Closeable
+import io.ktor.utils.io.readAvailable
+import io.ktor.utils.io.writeFully
+import kotlinx.coroutines.CancellationException
+import kotlinx.coroutines.async
+import kotlinx.coroutines.channels.Channel
+import kotlinx.coroutines.coroutineScope
+import kotlinx.coroutines.delay
+import kotlinx.coroutines.flow.Flow
+import kotlinx.coroutines.flow.FlowCollector
+import kotlinx.coroutines.flow.channelFlow
+import kotlinx.coroutines.flow.flow
+import kotlinx.coroutines.flow.map
+import kotlinx.coroutines.flow.take
+import kotlinx.coroutines.launch
+import kotlinx.coroutines.sync.Mutex
+import kotlinx.coroutines.sync.withLock
 import kotlinx.serialization.json.Json
+import kotlin.concurrent.Volatile
+import kotlin.time.Duration
 
 /**
  * Kotlin Multiplatform client for the Filebrowser API.
@@ -45,16 +74,47 @@ import kotlinx.serialization.json.Json
  * // Download a file
  * val content = client.download("/documents/hello.txt").getOrThrow()
  *
+ * // Stream a large file in chunks instead of holding it in memory
+ * client.download("/backups/disk.img") { buffer, length -> out.write(buffer, 0, length) }
+ *
  * // Don't forget to close
  * client.close()
  * ```
  *
+ * A single instance is safe to use from multiple coroutines and threads concurrently;
+ * requests share the underlying HTTP client and its connection pool.
+ *
+ * Pass [CacheOptions] to serve repeated [getResource] / [listDirectory] calls from
+ * a metadata cache instead of the server, and [ClientConfig] to tune timeouts,
+ * connection pooling and response compression of the default HTTP client.
+ *
+ * Every request is timed per endpoint and phase; read the totals with [stats] or
+ * follow requests one by one with [traceListener].
+ *
+ * Requests run through a scheduler shared by all callers of the instance: API
+ * calls go ahead of file transfers, concurrency backs off while the server
+ * answers slowly or with `429` / `503`, and transfers can be capped in bytes
+ * per second, in total and each. See [SchedulerOptions] and [schedulerStats].
+ *
+ * Lookups and searches that fail on the network or with a transient status
+ * are retried with backoff, and slow ones can be hedged; see [RetryOptions].
+ *
  * @property baseUrl The base URL of the Filebrowser server (e.g., "https://files.example.com")
  * @param httpClient Optional custom HTTP client. If not provided, a default client will be created.
+ *   A given client is copied with [HttpClient.config] to add request metrics.
+ * @param cache Optional metadata cache settings; null (the default) disables caching.
+ * @param config Transport settings for the default HTTP client. Only
+ *   [ClientConfig.compressTransfers] applies if [httpClient] is given.
+ * @param scheduler Concurrency, priority and bandwidth settings for all requests.
+ * @param retry Retry and hedging settings for idempotent lookups and searches.
  */
 public class FilebrowserClient(
     private val baseUrl: String,
     httpClient: HttpClient? = null,
+    cache: CacheOptions? = null,
+    config: ClientConfig = ClientConfig(),
+    scheduler: SchedulerOptions = SchedulerOptions(),
+    retry: RetryOptions = RetryOptions(),
 ) : Closeable {
     private val json =
         Json {
@@ -63,15 +123,72 @@ public class FilebrowserClient(
             encodeDefaults = true
         }
 
+    private val metrics = ClientMetrics()
+
+    private val scheduler = TransferScheduler(scheduler)
+
+    private val retry = RetryController(retry)
+
     private val client: HttpClient =
-        httpClient ?: HttpClient {
+        httpClient?.config { installMetrics() } ?: createHttpClient(config) {
+            installTimeouts(config)
+            installMetrics()
+            if (config.compressResponses) installCompression(metrics)
             install(ContentNegotiation) {
                 json(this@FilebrowserClient.json)
             }
         }
 
+    private val compressTransfers = config.compressTransfers
+
+    private val cache: MetadataCache? = cache?.let { MetadataCache(it, baseUrl.trimEnd('/')) }
+
+    // Volatile so a token set on one thread is seen by requests issued from others.
+    @Volatile
     private var authToken: String? = null
 
+    /**
+     * Hit, miss and eviction counters of the metadata cache, or null if caching is disabled.
+     */
+    public val cacheStats: CacheStats?
+        get() = cache?.stats
+
+    /**
+     * Listener called with a [RequestTrace] as each request finishes; null (the default)
+     * turns tracing off.
+     */
+    public var traceListener: RequestTraceListener?
+        get() = metrics.listener
+        set(value) {
+            metrics.listener = value
+        }
+
+    /**
+     * Request counts, bytes and latencies per endpoint since the client was created
+     * or [resetStats] was last called, the scheduler's current state, and retry counters.
+     */
+    public suspend fun stats(): ClientStats =
+        metrics.snapshot().copy(scheduler = scheduler.snapshot(), retry = retry.snapshot())
+
+    /**
+     * Concurrency limit, queue depth per priority and transfer throughput right now.
+     */
+    public suspend fun schedulerStats(): SchedulerStats = scheduler.snapshot()
+
+    /**
+     * Zero all request metrics.
+     */
+    public suspend fun resetStats() {
+        metrics.reset()
+        scheduler.reset()
+        retry.reset()
+    }
+
+    /** Record time spent encoding a result for the C API. */
+    internal fun recordEncode(duration: Duration) {
+        metrics.recordEncode(duration)
+    }
+
     /**
      * Whether the client is currently authenticated.
      */
@@ -101,7 +218,7 @@ public class FilebrowserClient(
             }
 
             val token = response.bodyAsText()
-            authToken = token
+            switchToken(token)
             token
         }
 
@@ -119,36 +236,82 @@ public class FilebrowserClient(
      * @param token The authentication token
      */
     public fun setToken(token: String) {
-        authToken = token
+        switchToken(token)
     }
 
     /**
      * Log out and clear the authentication token.
      */
     public fun logout() {
-        authToken = null
+        switchToken(null)
     }
 
     /**
      * Get information about a resource (file or directory).
      *
+     * With a metadata cache, a fresh entry is returned without a request and a
+     * stale one is revalidated with the validators the server sent for it.
+     *
      * @param path Path to the resource
      * @return Result containing the resource information
      */
     public suspend fun getResource(path: String): Result<Resource> =
+        runCatching {
+            requireAuth()
+            val key = MetadataCache.keyOf(path)
+            val cached = cache?.get(key)
+            if (cached != null && cache?.isFresh(cached) == true) {
+                cache.recordHit()
+                return@runCatching cached.resource
+            }
+
+            val encodedPath = path.encodeURLPath()
+            retry.call {
+                val response =
+                    client.get("$baseUrl/api/resources$encodedPath") {
+                        authHeader()
+                        cached?.etag?.let { header(HttpHeaders.IfNoneMatch, it) }
+                        cached?.lastModified?.let { header(HttpHeaders.IfModifiedSince, it) }
+                    }
+
+                if (cached != null && response.status == HttpStatusCode.NotModified) {
+                    cache?.revalidated(key, cached)
+                    return@call cached.resource
+                }
+                if (!response.status.isSuccess()) {
+                    throw FilebrowserException(response.status.value, response.bodyAsText())
+                }
+
+                response.body<Resource>().also { resource ->
+                    val headers = response.headers
+                    cache?.put(key, resource, headers[HttpHeaders.ETag], headers[HttpHeaders.LastModified])
+                }
+            }
+        }
+
+    /**
+     * Have the server hash a file and return its SHA-256 as lowercase hex.
+     *
+     * The server reads the whole file to answer, so this costs about as much
+     * disk time there as a download. Never served from the metadata cache.
+     *
+     * @param path Path to the file
+     * @return Result containing the checksum
+     */
+    public suspend fun getChecksum(path: String): Result<String> =
         runCatching {
             requireAuth()
             val encodedPath = path.encodeURLPath()
             val response =
                 client.get("$baseUrl/api/resources$encodedPath") {
                     authHeader()
+                    parameter("checksum", "sha256")
                 }
-
             if (!response.status.isSuccess()) {
                 throw FilebrowserException(response.status.value, response.bodyAsText())
             }
-
-            response.body<Resource>()
+            val resource = response.body<Resource>()
+            checkNotNull(resource.checksums?.sha256) { "Server returned no checksum for $path" }
         }
 
     /**
@@ -159,6 +322,104 @@ public class FilebrowserClient(
      */
     public suspend fun listDirectory(path: String): Result<Resource> = getResource(path)
 
+    /**
+     * Get a resource (or directory listing) as the server's JSON, without decoding it.
+     *
+     * Only the status is checked; the body is returned as-is, so callers with
+     * their own parser skip decoding into [Resource] and encoding it again.
+     * Fields the server omits are not filled in with defaults. With a metadata
+     * cache, this goes through [getResource] and encodes its result instead, as
+     * the cache keeps decoded resources.
+     *
+     * @param path Path to the resource
+     * @return Result containing a [Resource] JSON object
+     */
+    public suspend fun getResourceJson(path: String): Result<String> {
+        if (cache != null) return getResource(path).map { json.encodeToString(Resource.serializer(), it) }
+        return runCatching {
+            requireAuth()
+            val encodedPath = path.encodeURLPath()
+            retry.call {
+                val response =
+                    client.get("$baseUrl/api/resources$encodedPath") {
+                        authHeader()
+                    }
+                if (!response.status.isSuccess()) {
+                    throw FilebrowserException(response.status.value, response.bodyAsText())
+                }
+                response.bodyAsText()
+            }
+        }
+    }
+
+    /**
+     * List a directory as the server's JSON, like [getResourceJson].
+     *
+     * @param path Path to the directory
+     * @return Result containing the directory [Resource] JSON object with items
+     */
+    public suspend fun listDirectoryJson(path: String): Result<String> = getResourceJson(path)
+
+    /**
+     * Stream the entries of a directory as the response arrives.
+     *
+     * Unlike [listDirectory], entries are decoded one at a time while the body is
+     * still being received, so memory stays bounded and the first entry arrives
+     * long before the last, even for directories with millions of entries. The
+     * directory's own fields (counts, sorting) are not reported, and the metadata
+     * cache is neither consulted nor filled.
+     *
+     * The flow is cold: each collection sends a new request. It fails with a
+     * [FilebrowserException] if the server rejects the request, or an
+     * [IllegalStateException] if [path] is not a directory.
+     *
+     * @param path Path to the directory
+     * @return Flow of the directory's entries, in the server's order
+     */
+    public fun listDirectoryStream(path: String): Flow<Resource> =
+        listDirectoryJsonStream(path).map { json.decodeFromString(Resource.serializer(), it) }
+
+    /** [listDirectoryStream] yielding each entry as the server's JSON, undecoded. */
+    internal fun listDirectoryJsonStream(path: String): Flow<String> =
+        flow {
+            val found = emitArray("$baseUrl/api/resources${path.encodeURLPath()}", key = "items") {}
+            check(found) { "$path is not a directory" }
+        }
+
+    /**
+     * GET [url] and emit each object of the JSON array under [key] (or of the
+     * top-level array if null) as it arrives. Returns whether the array was found.
+     */
+    private suspend fun FlowCollector<String>.emitArray(
+        url: String,
+        key: String?,
+        block: HttpRequestBuilder.() -> Unit,
+    ): Boolean {
+        requireAuth()
+        return client
+            .prepareGet(url) {
+                authHeader()
+                block()
+            }.execute { response ->
+                if (!response.status.isSuccess()) {
+                    throw FilebrowserException(response.status.value, response.bodyAsText())
+                }
+
+                val scanner = JsonArrayScanner(key)
+                val channel = response.bodyAsChannel()
+                val buffer = ByteArray(DEFAULT_CHUNK_SIZE)
+                val items = mutableListOf<String>()
+                while (true) {
+                    val read = channel.readAvailable(buffer, 0, buffer.size)
+                    if (read == -1) break
+                    scanner.feed(buffer, read) { items += it }
+                    for (item in items) emit(item)
+                    items.clear()
+                }
+                scanner.found
+            }
+    }
+
     /**
      * Search for files and directories by name.
      *
@@ -173,17 +434,83 @@ public class FilebrowserClient(
         runCatching {
             requireAuth()
             val encodedPath = path.encodeURLPath()
-            val response =
-                client.get("$baseUrl/api/search$encodedPath") {
-                    authHeader()
-                    parameter("query", query)
+            retry.call {
+                val response =
+                    client.get("$baseUrl/api/search$encodedPath") {
+                        authHeader()
+                        parameter("query", query)
+                    }
+
+                if (!response.status.isSuccess()) {
+                    throw FilebrowserException(response.status.value, response.bodyAsText())
                 }
 
-            if (!response.status.isSuccess()) {
-                throw FilebrowserException(response.status.value, response.bodyAsText())
+                response.body<List<SearchResult>>()
             }
+        }
+
+    /**
+     * Stream search results as the response arrives.
+     *
+     * Like [listDirectoryStream], each result is decoded on its own while the
+     * body is still being received, so the first results show up early and
+     * memory stays bounded however many files match. Stopping the collection
+     * (or reaching [limit]) cancels the request and closes its connection, so
+     * the rest of the response is never read.
+     *
+     * @param query Search query
+     * @param path Path to search within (defaults to root)
+     * @param limit Stop after this many results; 0 for all of them
+     * @return Flow of matches, in the server's order
+     */
+    public fun searchStream(
+        query: String,
+        path: String = "/",
+        limit: Int = 0,
+    ): Flow<SearchResult> =
+        searchJsonStream(query, path, limit).map { json.decodeFromString(SearchResult.serializer(), it) }
+
+    /** [searchStream] yielding each result as the server's JSON, undecoded. */
+    internal fun searchJsonStream(
+        query: String,
+        path: String = "/",
+        limit: Int = 0,
+    ): Flow<String> {
+        require(limit >= 0) { "limit must not be negative" }
+        val results =
+            flow {
+                emitArray("$baseUrl/api/search${path.encodeURLPath()}", key = null) { parameter("query", query) }
+            }
+        return if (limit > 0) results.take(limit) else results
+    }
+
+    /**
+     * Search like [search], returning the server's JSON array as-is.
+     *
+     * @param query Search query
+     * @param path Path to search within (defaults to root)
+     * @return Result containing a JSON array of [SearchResult] objects
+     */
+    public suspend fun searchJson(
+        query: String,
+        path: String = "/",
+    ): Result<String> =
+        runCatching {
+            requireAuth()
+            val encodedPath = path.encodeURLPath()
+            retry.call {
+                val response =
+                    client.get("$baseUrl/api/search$encodedPath") {
+                        authHeader()
+                        parameter("query", query)
+                    }
 
-            response.body<List<SearchResult>>()
+                if (!response.status.isSuccess()) {
+                    throw FilebrowserException(response.status.value, response.bodyAsText())
+                }
+
+                response.bodyAsText()
+            }
         }
 
     /**
@@ -217,9 +544,73 @@ public class FilebrowserClient(
                 }.sorted()
         }
 
+    /**
+     * Recursively walk the tree under [root], listing directories in parallel.
+     *
+     * Up to [concurrency] directory listings are in flight at once. Pending
+     * directories wait in a work queue, so memory grows with the number of
+     * queued paths rather than with coroutines. Entries are emitted as soon as
+     * their parent is listed, so order across directories is not deterministic;
+     * each entry's `path` is its full path and `items` is null.
+     *
+     * [filter] prunes the walk: a rejected entry is not emitted and, if it is a
+     * directory, not descended into. To descend everywhere but only keep some
+     * entries, filter the returned flow instead. [descend] is the converse: a
+     * directory it rejects is still emitted, but not listed.
+     *
+     * The flow is cold and fails with the first listing error. Cancelling the
+     * collector stops the crawl.
+     *
+     * @param root Directory to start from (not itself emitted)
+     * @param concurrency Maximum number of listings in flight
+     * @param filter Decides which entries are emitted and descended into
+     * @param descend Decides which emitted directories are listed
+     * @return Flow of every entry below [root]
+     */
+    public fun walk(
+        root: String = "/",
+        concurrency: Int = DEFAULT_WALK_CONCURRENCY,
+        filter: (Resource) -> Boolean = { true },
+        descend: (Resource) -> Boolean = { true },
+    ): Flow<Resource> =
+        channelFlow {
+            require(concurrency > 0) { "concurrency must be positive" }
+            val queue = Channel<String>(Channel.UNLIMITED)
+            val listings = Channel<Pair<String, List<Resource>>>(concurrency)
+            repeat(concurrency) {
+                launch {
+                    for (path in queue) {
+                        val items = listDirectory(path).getOrThrow().items.orEmpty()
+                        listings.send(path to items)
+                    }
+                }
+            }
+
+            // Only this coroutine touches `pending`, so no synchronization is needed.
+            var pending = 1
+            queue.send(root)
+            while (pending > 0) {
+                val (parent, items) = listings.receive()
+                pending--
+                for (item in items) {
+                    val entry = item.copy(path = childPath(parent, item.name), items = null)
+                    if (!filter(entry)) continue
+                    send(entry)
+                    if (entry.isDir && descend(entry)) {
+                        pending++
+                        queue.send(entry.path)
+                    }
+                }
+            }
+            queue.close()
+        }
+
     /**
      * Download a file.
      *
+     * Scheduled as [TransferPriority.NORMAL]. The whole body arrives before
+     * the bandwidth caps are applied, which then delay returning it.
+     *
      * @param path Path to the file
      * @return Result containing the file contents as bytes
      */
@@ -230,18 +621,227 @@ public class FilebrowserClient(
             val response =
                 client.get("$baseUrl/api/raw$encodedPath") {
                     authHeader()
+                    transferEncoding()
+                    priority(TransferPriority.NORMAL)
                 }
 
             if (!response.status.isSuccess()) {
                 throw FilebrowserException(response.status.value, response.bodyAsText())
             }
 
-            response.body<ByteArray>()
+            response.body<ByteArray>().also { scheduler.meter().add(it.size) }
+        }
+
+    /**
+     * Download a file in fixed-size chunks, without buffering it in memory.
+     *
+     * Each chunk is passed to [sink] as soon as it arrives. The buffer is reused
+     * between calls, so the sink must consume or copy the bytes before returning.
+     * Memory use stays at one [chunkSize] buffer regardless of the file size.
+     *
+     * @param path Path to the file
+     * @param chunkSize Size of the read buffer in bytes
+     * @param progress Optional listener notified after every chunk
+     * @param sink Receives each chunk as `(buffer, length)`
+     * @return Result containing the total number of bytes received
+     */
+    public suspend fun download(
+        path: String,
+        chunkSize: Int = DEFAULT_CHUNK_SIZE,
+        progress: TransferProgress? = null,
+        sink: suspend (buffer: ByteArray, length: Int) -> Unit,
+    ): Result<Long> =
+        runCatching {
+            requireAuth()
+            require(chunkSize > 0) { "chunkSize must be positive" }
+            val encodedPath = path.encodeURLPath()
+            client
+                .prepareGet("$baseUrl/api/raw$encodedPath") {
+                    authHeader()
+                    transferEncoding()
+                    priority(TransferPriority.BULK)
+                }.execute { response ->
+                    if (!response.status.isSuccess()) {
+                        throw FilebrowserException(response.status.value, response.bodyAsText())
+                    }
+
+                    val total = response.decodedLength()
+                    copyChannel(response.bodyAsChannel(), total, chunkSize, progress, scheduler.meter(), sink)
+                }
+        }
+
+    /**
+     * Download a directory as a single archive, without buffering it in memory.
+     *
+     * The server builds the archive on the fly, so a tree of many small files
+     * costs one request instead of one per file. Its size is not known in
+     * advance; [progress] receives -1 as the total. Chunks are passed to [sink]
+     * as in [download]. To unpack the archive while it arrives, see [extractArchive].
+     *
+     * @param path Path to the directory (or a single file)
+     * @param format Archive format the server should produce
+     * @param chunkSize Size of the read buffer in bytes
+     * @param progress Optional listener notified after every chunk
+     * @param sink Receives each chunk as `(buffer, length)`
+     * @return Result containing the size of the archive
+     */
+    public suspend fun downloadArchive(
+        path: String,
+        format: ArchiveFormat = ArchiveFormat.TAR_GZ,
+        chunkSize: Int = DEFAULT_CHUNK_SIZE,
+        progress: TransferProgress? = null,
+        sink: suspend (buffer: ByteArray, length: Int) -> Unit,
+    ): Result<Long> =
+        runCatching {
+            require(chunkSize > 0) { "chunkSize must be positive" }
+            openArchive(path, format) { channel, meter -> copyChannel(channel, -1L, chunkSize, progress, meter, sink) }
+        }
+
+    /**
+     * Request [path] as a [format] archive and pass the response body to
+     * [block], with the meter to count the bytes it reads.
+     */
+    internal suspend fun <T> openArchive(
+        path: String,
+        format: ArchiveFormat,
+        block: suspend (ByteReadChannel, TransferMeter) -> T,
+    ): T {
+        requireAuth()
+        val encodedPath = path.encodeURLPath()
+        return client
+            .prepareGet("$baseUrl/api/raw$encodedPath") {
+                authHeader()
+                transferEncoding()
+                parameter("algo", format.algo)
+                priority(TransferPriority.BULK)
+            }.execute { response ->
+                if (!response.status.isSuccess()) {
+                    throw FilebrowserException(response.status.value, response.bodyAsText())
+                }
+                block(response.bodyAsChannel(), scheduler.meter())
+            }
+    }
+
+    /** Pass [channel] to [sink] in [chunkSize] pieces and return the number of bytes copied. */
+    private suspend fun copyChannel(
+        channel: ByteReadChannel,
+        total: Long,
+        chunkSize: Int,
+        progress: TransferProgress?,
+        meter: TransferMeter,
+        sink: suspend (buffer: ByteArray, length: Int) -> Unit,
+    ): Long {
+        val buffer = ByteArray(chunkSize)
+        var received = 0L
+        while (true) {
+            val read = channel.readAvailable(buffer, 0, buffer.size)
+            if (read < 0) break
+            if (read == 0) continue
+            sink(buffer, read)
+            received += read
+            progress?.onProgress(received, total)
+            meter.add(read)
+        }
+        return received
+    }
+
+    /**
+     * Download a file into [sink] with HTTP range requests.
+     *
+     * The transfer starts at [DownloadOptions.offset], so a partial local copy
+     * can be resumed. If the server reports the size, the rest of the file is
+     * split into up to [DownloadOptions.segments] ranges that are fetched in
+     * parallel and written to their own positions. The first range reuses the
+     * initial request, so a single segment costs no extra round trip.
+     *
+     * If the server ignores `Range` and sends the whole file, the download falls
+     * back to one stream written from position 0.
+     *
+     * Resuming assumes the remote file has not changed since the partial copy
+     * was made. Only a change in size is detected.
+     *
+     * With [DownloadOptions.verify], the server's checksum is requested
+     * alongside the download and compared with a hash of the bytes as they are
+     * written, so a corrupt copy fails with [ChecksumMismatchException] without
+     * being read back.
+     *
+     * @param path Path to the file
+     * @param sink Destination; receives [ChunkSink.allocate] once the size is known
+     * @param options Resume offset, segment count and buffer size
+     * @param progress Optional listener; `transferred` includes the resumed offset
+     * @return Result containing the size of the complete file
+     */
+    public suspend fun downloadRanged(
+        path: String,
+        sink: ChunkSink,
+        options: DownloadOptions = DownloadOptions(),
+        progress: TransferProgress? = null,
+    ): Result<Long> =
+        runCatching {
+            requireAuth()
+            require(options.offset >= 0) { "offset must not be negative" }
+            require(options.segments > 0) { "segments must be positive" }
+            require(options.minSegmentSize > 0) { "minSegmentSize must be positive" }
+            require(options.chunkSize > 0) { "chunkSize must be positive" }
+            require(!options.verify || options.offset == 0L) { "verify needs the whole file; offset must be 0" }
+            val url = "$baseUrl/api/raw${path.encodeURLPath()}"
+            val counter = ProgressCounter(progress)
+            // One meter for all segments, so the cap applies to the file as a whole.
+            val meter = scheduler.meter(options.maxBytesPerSecond)
+            coroutineScope {
+                val expected = if (options.verify) async { getChecksum(path).getOrThrow() } else null
+                val digest = if (options.verify) sha256() else null
+                client
+                    .prepareGet(url) {
+                        authHeader()
+                        header(HttpHeaders.Range, "bytes=${options.offset}-")
+                        header(HttpHeaders.AcceptEncoding, "identity")
+                        priority(options.priority)
+                    }.execute { response ->
+                        if (response.status == HttpStatusCode.RequestedRangeNotSatisfiable) {
+                            // Nothing left to fetch, if the local copy is exactly as long as the remote file.
+                            val total = contentRangeTotal(response)
+                            check(total == options.offset) {
+                                "Cannot resume at byte ${options.offset} of a $total-byte file"
+                            }
+                            counter.start(total, total)
+                            return@execute total
+                        }
+                        if (!response.status.isSuccess()) {
+                            throw FilebrowserException(response.status.value, response.bodyAsText())
+                        }
+
+                        // A 200 means the server ignored Range and is sending the whole file.
+                        val ranged = response.status == HttpStatusCode.PartialContent
+                        val start = if (ranged) options.offset else 0L
+                        val total = if (ranged) contentRangeTotal(response) else response.contentLength() ?: -1L
+                        if (total >= 0) sink.allocate(total)
+                        counter.start(start, total)
+
+                        // A digest needs the bytes in order, so verified downloads stay in one stream.
+                        val segments =
+                            if (ranged && digest == null) segmentBounds(start, total, options) else listOf(start to -1L)
+                        for ((from, until) in segments.drop(1)) {
+                            launch { fetchSegment(url, from, until, total, sink, options, counter, meter) }
+                        }
+                        val (from, until) = segments.first()
+                        val end = copyBody(response, from, until, sink, options.chunkSize, counter, meter, digest)
+                        if (total >= 0) total else end
+                    }.also {
+                        if (digest != null && expected != null) {
+                            val actual = digest.hex()
+                            val remote = expected.await()
+                            if (actual != remote) throw ChecksumMismatchException(path, remote, actual)
+                        }
+                    }
+            }
         }
 
     /**
      * Upload a file.
      *
+     * Scheduled as [TransferPriority.NORMAL].
+     *
      * @param path Destination path for the file
      * @param content File contents as bytes
      * @param override Whether to override existing file (default: true)
@@ -252,15 +852,15 @@ public class FilebrowserClient(
         content: ByteArray,
         override: Boolean = true,
     ): Result<Unit> =
-        runCatching {
+        invalidating(path) {
             requireAuth()
             val encodedPath = path.encodeURLPath()
             val response =
                 client.post("$baseUrl/api/resources$encodedPath") {
                     authHeader()
                     parameter("override", override)
-                    contentType(ContentType.Application.OctetStream)
-                    setBody(content)
+                    priority(TransferPriority.NORMAL)
+                    setBody(meteredBody(content, ContentType.Application.OctetStream, scheduler.meter()))
                 }
 
             if (!response.status.isSuccess()) {
@@ -268,6 +868,148 @@ public class FilebrowserClient(
             }
         }
 
+    /**
+     * Upload a file in bounded chunks using Filebrowser's resumable (tus) endpoints.
+     *
+     * The file is created with `POST /api/tus`, then sent as a sequence of `PATCH`
+     * requests. While one chunk is on the wire, up to [UploadOptions.readAhead]
+     * further chunks are read from [source], so disk and network overlap and memory
+     * stays bounded. If a request fails, the upload asks the server for its current
+     * offset (`HEAD`) and resumes from there, up to [UploadOptions.maxRetries] times.
+     *
+     * Filebrowser appends each PATCH at the current end of the file, so chunks of a
+     * single file are sent in order; upload several files at once for more parallelism.
+     *
+     * With [UploadOptions.skipIdentical], nothing is sent when [matchesRemote]
+     * finds the same contents on the server already.
+     *
+     * @param path Destination path for the file
+     * @param size Total size of the file in bytes
+     * @param source Positional reader for the file contents
+     * @param options Chunking and retry settings
+     * @param progress Optional listener notified after every acknowledged chunk
+     * @return Result indicating success or failure
+     */
+    public suspend fun uploadResumable(
+        path: String,
+        size: Long,
+        source: ChunkSource,
+        options: UploadOptions = UploadOptions(),
+        progress: TransferProgress? = null,
+    ): Result<Unit> =
+        invalidating(path) {
+            requireAuth()
+            require(options.chunkSize > 0) { "chunkSize must be positive" }
+            if (options.skipIdentical && matchesRemote(path, size, source).getOrThrow()) {
+                progress?.onProgress(size, size)
+                return@invalidating
+            }
+            val url = "$baseUrl/api/tus${path.encodeURLPath()}"
+
+            val created =
+                client.post(url) {
+                    authHeader()
+                    header(TUS_RESUMABLE, TUS_VERSION)
+                    header(UPLOAD_LENGTH, size)
+                    parameter("override", options.override)
+                }
+            if (!created.status.isSuccess()) {
+                throw FilebrowserException(created.status.value, created.bodyAsText())
+            }
+
+            var offset = 0L
+            var failures = 0
+            while (offset < size) {
+                try {
+                    offset = sendChunks(url, offset, size, source, options, progress)
+                    failures = 0
+                } catch (e: CancellationException) {
+                    throw e
+                } catch (e: Exception) {
+                    if (e is UploadSourceException) throw e
+                    if (e is FilebrowserException && !e.isResumable()) throw e
+                    if (++failures > options.maxRetries) throw e
+                    delay(options.retryDelayMillis * failures)
+                    offset = runCatching { queryUploadOffset(url) }.getOrDefault(offset)
+                }
+            }
+        }
+
+    /**
+     * Send chunks from [start] until the end of the file or until the server's
+     * offset diverges from ours. Returns the last offset acknowledged by the server.
+     */
+    private suspend fun sendChunks(
+        url: String,
+        start: Long,
+        size: Long,
+        source: ChunkSource,
+        options: UploadOptions,
+        progress: TransferProgress?,
+    ): Long =
+        coroutineScope {
+            val chunks = Channel<ByteArray>(capacity = options.readAhead.coerceAtLeast(0))
+            val meter = scheduler.meter(options.maxBytesPerSecond)
+            val reader =
+                launch {
+                    var position = start
+                    while (position < size) {
+                        val length = minOf(options.chunkSize.toLong(), size - position).toInt()
+                        val buffer = ByteArray(length)
+                        val read = source.read(position, buffer, length)
+                        if (read != length) {
+                            throw UploadSourceException("Source ended at byte ${position + read}, expected $size")
+                        }
+                        chunks.send(buffer)
+                        position += length
+                    }
+                    chunks.close()
+                }
+
+            var offset = start
+            for (chunk in chunks) {
+                val response =
+                    client.patch(url) {
+                        authHeader()
+                        header(TUS_RESUMABLE, TUS_VERSION)
+                        header(UPLOAD_OFFSET, offset)
+                        priority(options.priority)
+                        setBody(meteredBody(chunk, TUS_CONTENT_TYPE, meter))
+                    }
+                if (!response.status.isSuccess()) {
+                    throw FilebrowserException(response.status.value, response.bodyAsText())
+                }
+
+                val expected = offset + chunk.size
+                offset = response.uploadOffset() ?: expected
+                progress?.onProgress(offset, size)
+                if (offset != expected) {
+                    // Server kept a different amount than we sent; restart read-ahead from its offset.
+                    reader.cancel()
+                    break
+                }
+            }
+            offset
+        }
+
+    private suspend fun queryUploadOffset(url: String): Long {
+        val response =
+            client.head(url) {
+                authHeader()
+                header(TUS_RESUMABLE, TUS_VERSION)
+            }
+        if (!response.status.isSuccess()) {
+            throw FilebrowserException(response.status.value, "Failed to query upload offset")
+        }
+        return checkNotNull(response.uploadOffset()) { "Server did not report Upload-Offset" }
+    }
+
+    private fun HttpResponse.uploadOffset(): Long? = headers[UPLOAD_OFFSET]?.toLongOrNull()
+
+    /** 409 means our offset disagreed with the server's; 5xx and 429 are transient. */
+    private fun FilebrowserException.isResumable(): Boolean =
+        statusCode == 409 || statusCode == 429 || statusCode >= 500
+
     /**
      * Create a directory.
      *
@@ -275,7 +1017,7 @@ public class FilebrowserClient(
      * @return Result indicating success or failure
      */
     public suspend fun createDirectory(path: String): Result<Unit> =
-        runCatching {
+        invalidating(path) {
             requireAuth()
             val encodedPath = path.encodeURLPath()
             val response =
@@ -295,7 +1037,7 @@ public class FilebrowserClient(
      * @return Result indicating success or failure
      */
     public suspend fun delete(path: String): Result<Unit> =
-        runCatching {
+        invalidating(path) {
             requireAuth()
             val encodedPath = path.encodeURLPath()
             val response =
@@ -321,7 +1063,7 @@ public class FilebrowserClient(
         destination: String,
         override: Boolean = false,
     ): Result<Unit> =
-        runCatching {
+        invalidating(source, destination) {
             requireAuth()
             val encodedSource = source.encodeURLPath()
             val response =
@@ -350,7 +1092,7 @@ public class FilebrowserClient(
         destination: String,
         override: Boolean = false,
     ): Result<Unit> =
-        runCatching {
+        invalidating(destination) {
             requireAuth()
             val encodedSource = source.encodeURLPath()
             val response =
@@ -476,9 +1218,157 @@ public class FilebrowserClient(
      * Close the HTTP client and release resources.
      */
     override fun close() {
+        cache?.flush()
         client.close()
     }
 
+    /**
+     * Save the metadata cache to its [MetadataStore] now rather than on [close].
+     */
+    public fun flushCache() {
+        cache?.flush()
+    }
+
+    /**
+     * Drop every entry from the metadata cache.
+     */
+    public suspend fun clearCache() {
+        cache?.clear()
+    }
+
+    public companion object {
+        /** Default buffer size for streaming transfers (256 KiB). */
+        public const val DEFAULT_CHUNK_SIZE: Int = 256 * 1024
+
+        /** Default PATCH size for resumable uploads (8 MiB). */
+        public const val DEFAULT_UPLOAD_CHUNK_SIZE: Int = 8 * 1024 * 1024
+
+        /** Default number of directory listings [walk] keeps in flight. */
+        public const val DEFAULT_WALK_CONCURRENCY: Int = 16
+
+        /** Default number of file transfers [sync] keeps in flight. */
+        public const val DEFAULT_SYNC_CONCURRENCY: Int = 4
+
+        /** Default smallest range [downloadRanged] fetches as its own segment (8 MiB). */
+        public const val DEFAULT_MIN_SEGMENT_SIZE: Long = 8L * 1024 * 1024
+
+        /** Default number of operations [batch] keeps in flight. */
+        public const val DEFAULT_BATCH_CONCURRENCY: Int = 8
+
+        private const val TUS_RESUMABLE = "Tus-Resumable"
+        private const val TUS_VERSION = "1.0.0"
+        private const val UPLOAD_LENGTH = "Upload-Length"
+        private const val UPLOAD_OFFSET = "Upload-Offset"
+        private val TUS_CONTENT_TYPE = ContentType("application", "offset+octet-stream")
+    }
+
+    /**
+     * Run a mutation, then drop the cached metadata of [paths] whether or not it
+     * succeeded: a failed request may still have changed something on the server.
+     */
+    private suspend inline fun invalidating(
+        vararg paths: String,
+        block: () -> Unit,
+    ): Result<Unit> =
+        runCatching(block).also {
+            cache?.let { cache -> paths.forEach { cache.invalidate(MetadataCache.keyOf(it)) } }
+        }
+
+    /** Fetch bytes [from] until [until] of [url] with a range request and write them to [sink]. */
+    private suspend fun fetchSegment(
+        url: String,
+        from: Long,
+        until: Long,
+        total: Long,
+        sink: ChunkSink,
+        options: DownloadOptions,
+        counter: ProgressCounter,
+        meter: TransferMeter,
+    ) {
+        client
+            .prepareGet(url) {
+                authHeader()
+                header(HttpHeaders.Range, "bytes=$from-${until - 1}")
+                header(HttpHeaders.AcceptEncoding, "identity")
+                priority(options.priority)
+            }.execute { response ->
+                if (response.status != HttpStatusCode.PartialContent) {
+                    throw FilebrowserException(response.status.value, "Range request failed: ${response.bodyAsText()}")
+                }
+                check(contentRangeTotal(response) == total) { "Remote file changed during download" }
+                copyBody(response, from, until, sink, options.chunkSize, counter, meter)
+            }
+    }
+
+    /**
+     * Copy [response]'s body to [sink] from position [from], stopping at [until]
+     * (or the end of the body if -1), and feed it to [digest] if given. Returns
+     * the position after the last byte.
+     */
+    private suspend fun copyBody(
+        response: HttpResponse,
+        from: Long,
+        until: Long,
+        sink: ChunkSink,
+        chunkSize: Int,
+        counter: ProgressCounter,
+        meter: TransferMeter,
+        digest: Digest? = null,
+    ): Long {
+        val channel = response.bodyAsChannel()
+        val buffer = ByteArray(chunkSize)
+        var position = from
+        while (until < 0 || position < until) {
+            val wanted = if (until < 0) buffer.size else minOf(buffer.size.toLong(), until - position).toInt()
+            val read = channel.readAvailable(buffer, 0, wanted)
+            if (read < 0) break
+            if (read == 0) continue
+            sink.write(position, buffer, read)
+            digest?.update(buffer, 0, read)
+            position += read
+            counter.add(read)
+            meter.add(read)
+        }
+        check(until < 0 || position == until) { "Connection closed at byte $position, expected $until" }
+        return position
+    }
+
+    /** Schedule requests, then time them; metrics installed second leave out the wait for a place. */
+    private fun HttpClientConfig<*>.installMetrics() {
+        install(RequestScheduler) { scheduler = this@FilebrowserClient.scheduler }
+        install(RequestMetrics) { metrics = this@FilebrowserClient.metrics }
+    }
+
+    /**
+     * [bytes] as a request body of [type], written in pieces that [meter]
+     * counts, so a capped upload is paced while it is sent.
+     */
+    private fun meteredBody(
+        bytes: ByteArray,
+        type: ContentType,
+        meter: TransferMeter,
+    ): OutgoingContent =
+        object : OutgoingContent.WriteChannelContent() {
+            override val contentLength: Long = bytes.size.toLong()
+            override val contentType: ContentType = type
+
+            override suspend fun writeTo(channel: ByteWriteChannel) {
+                var offset = 0
+                while (offset < bytes.size) {
+                    val end = minOf(bytes.size, offset + DEFAULT_CHUNK_SIZE)
+                    channel.writeFully(bytes, offset, end)
+                    meter.add(end - offset)
+                    offset = end
+                }
+            }
+        }
+
+    /** Replace the token; cached metadata belongs to the user it was fetched for. */
+    private fun switchToken(token: String?) {
+        authToken = token
+        cache?.switchUser(token?.let(MetadataCache::userOf))
+    }
+
     private fun requireAuth() {
         checkNotNull(authToken) { "Not authenticated. Call login() first." }
     }
@@ -487,6 +1377,20 @@ public class FilebrowserClient(
         header("X-Auth", authToken)
     }
 
+    /** File contents travel uncompressed unless [ClientConfig.compressTransfers] is set. */
+    private fun HttpRequestBuilder.transferEncoding() {
+        if (!compressTransfers) header(HttpHeaders.AcceptEncoding, "identity")
+    }
+
+    /** Body size for progress: `Content-Length` counts compressed bytes, so unknown if encoded. */
+    private fun HttpResponse.decodedLength(): Long =
+        if (headers[HttpHeaders.ContentEncoding] == null) contentLength() ?: -1L else -1L
+
+    private fun childPath(
+        parent: String,
+        name: String,
+    ): String = if (parent.endsWith("/")) "$parent$name" else "$parent/$name"
+
     private fun String.encodeURLPath(): String {
         // Ensure path starts with / and encode special characters
         val normalized = if (startsWith("/")) this else "/$this"
@@ -495,3 +1399,53 @@ public class FilebrowserClient(
         }
     }
 }
+
+/** The local side of an upload failed or ran short; retrying won't help. */
+internal class UploadSourceException(
+    message: String,
+) : Exception(message)
+
+/** Adds up bytes from concurrent segments and reports the running total. */
+private class ProgressCounter(
+    private val listener: TransferProgress?,
+) {
+    private val mutex = Mutex()
+    private var transferred = 0L
+    private var total = -1L
+
+    fun start(
+        transferred: Long,
+        total: Long,
+    ) {
+        this.transferred = transferred
+        this.total = total
+        if (transferred > 0) listener?.onProgress(transferred, total)
+    }
+
+    suspend fun add(bytes: Int) {
+        val listener = listener ?: return
+        mutex.withLock {
+            transferred += bytes
+            listener.onProgress(transferred, total)
+        }
+    }
+}
+
+/** Full size from a `Content-Range: bytes a-b/size` header, or -1 if the server didn't say. */
+private fun contentRangeTotal(response: HttpResponse): Long =
+    response.headers[HttpHeaders.ContentRange]
+        ?.substringAfterLast('/')
+        ?.toLongOrNull() ?: -1L
+
+/** Split `[start, total)` into `(from, until)` ranges; one open-ended range if [total] is unknown. */
+private fun segmentBounds(
+    start: Long,
+    total: Long,
+    options: DownloadOptions,
+): List<Pair<Long, Long>> {
+    val remaining = total - start
+    if (total < 0 || remaining <= 0) return listOf(start to total)
+    val count = minOf(options.segments.toLong(), maxOf(1L, remaining / options.minSegmentSize))
+    val size = (remaining + count - 1) / count
+    return (0 until count).map { i -> start + i * size to minOf(total, start + (i + 1) * size) }
+}
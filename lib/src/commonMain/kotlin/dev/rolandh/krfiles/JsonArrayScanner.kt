@@ -0,0 +1,121 @@
+package dev.rolandh.krfiles
+
+/**
+ * Incremental scanner for the array under a top-level [key] of a JSON object,
+ * or for the document itself if [key] is null and it is an array.
+ *
+ * Bytes are fed in as they arrive; each object element of that array is passed
+ * out as text as soon as its closing brace is seen, so only one element is held
+ * at a time. Everything else in the document is skipped without being decoded.
+ * JSON's structural characters are all ASCII, so scanning UTF-8 byte by byte is
+ * safe; elements are decoded to strings only once complete.
+ *
+ * The input is assumed to be well-formed; the elements themselves are parsed
+ * (and validated) by the caller.
+ */
+internal class JsonArrayScanner(
+    key: String?,
+) {
+    private val key = key?.encodeToByteArray()
+
+    // Depth of the array's own brackets: inside the top-level object, or the document itself.
+    private val arrayDepth = if (key == null) 0 else 1
+
+    private var depth = 0
+    private var inString = false
+    private var escaped = false
+
+    // Last string seen directly in the top-level object, truncated past the key length.
+    private val topString = ByteBuilder()
+    private var lastTopString: ByteArray? = null
+    private var keyMatched = false
+
+    private var inArray = false
+    private var element: ByteBuilder? = null
+
+    /** Whether the array under the key was found. */
+    var found: Boolean = false
+        private set
+
+    /** Scan the first [length] bytes of [bytes], calling [onElement] with each completed element. */
+    fun feed(
+        bytes: ByteArray,
+        length: Int,
+        onElement: (String) -> Unit,
+    ) {
+        for (i in 0 until length) {
+            val b = bytes[i]
+            element?.add(b)
+            if (inString) {
+                when {
+                    escaped -> escaped = false
+                    b == BACKSLASH -> escaped = true
+                    b == QUOTE -> {
+                        inString = false
+                        if (depth == 1) lastTopString = topString.toByteArray()
+                    }
+                }
+                if (inString && depth == 1 && key != null && topString.size <= key.size) topString.add(b)
+                continue
+            }
+            when (b) {
+                QUOTE -> {
+                    inString = true
+                    if (depth == 1) topString.clear()
+                }
+                COLON -> if (depth == 1) keyMatched = lastTopString.contentEquals(key)
+                COMMA -> if (depth == 1) keyMatched = false
+                OPEN_BRACKET, OPEN_BRACE -> {
+                    if (depth == arrayDepth && (key == null || keyMatched) && b == OPEN_BRACKET) {
+                        inArray = true
+                        found = true
+                    } else if (inArray && depth == arrayDepth + 1 && b == OPEN_BRACE) {
+                        element = ByteBuilder().apply { add(b) }
+                    }
+                    depth++
+                }
+                CLOSE_BRACKET, CLOSE_BRACE -> {
+                    depth--
+                    val completed = element
+                    if (completed != null && depth == arrayDepth + 1) {
+                        onElement(completed.decode())
+                        element = null
+                    }
+                    if (inArray && depth == arrayDepth) inArray = false
+                }
+            }
+        }
+    }
+
+    private companion object {
+        val QUOTE = '"'.code.toByte()
+        val BACKSLASH = '\\'.code.toByte()
+        val COLON = ':'.code.toByte()
+        val COMMA = ','.code.toByte()
+        val OPEN_BRACKET = '['.code.toByte()
+        val CLOSE_BRACKET = ']'.code.toByte()
+        val OPEN_BRACE = '{'.code.toByte()
+        val CLOSE_BRACE = '}'.code.toByte()
+    }
+}
+
+/** Growable byte buffer. */
+private class ByteBuilder {
+    private var bytes = ByteArray(256)
+
+    var size: Int = 0
+        private set
+
+    fun add(b: Byte) {
+        if (size == bytes.size) bytes = bytes.copyOf(size * 2)
+        bytes[size++] = b
+    }
+
+    fun clear() {
+        size = 0
+    }
+
+    fun toByteArray(): ByteArray = bytes.copyOf(size)
+
+    fun decode(): String = bytes.decodeToString(0, size)
+}
@@ -0,0 +1,280 @@
+package dev.rolandh.krfiles
+
+import kotlinx.coroutines.sync.Mutex
+import kotlinx.coroutines.sync.withLock
+import kotlinx.serialization.Serializable
+import kotlinx.serialization.json.Json
+import kotlinx.serialization.json.jsonObject
+import kotlinx.serialization.json.jsonPrimitive
+import kotlin.concurrent.Volatile
+import kotlin.io.encoding.Base64
+import kotlin.time.Clock
+import kotlin.time.ExperimentalTime
+
+/**
+ * Opt-in cache for [FilebrowserClient.getResource] and [FilebrowserClient.listDirectory].
+ *
+ * Entries younger than [ttlMillis] are served without a request. Older ones are
+ * revalidated with `If-None-Match` / `If-Modified-Since` when the server sent an
+ * `ETag` or `Last-Modified`, and refetched otherwise. The client's own uploads,
+ * deletes, renames, copies and new directories invalidate the affected paths.
+ *
+ * @property maxEntries Paths kept in memory; the least recently used is evicted first
+ * @property ttlMillis How long an entry is served without asking the server
+ * @property store Where entries survive between processes, or null for memory only
+ * @property clock Current time in milliseconds since the epoch
+ */
+@OptIn(ExperimentalTime::class)
+public data class CacheOptions(
+    val maxEntries: Int = 256,
+    val ttlMillis: Long = 30_000,
+    val store: MetadataStore? = null,
+    val clock: () -> Long = { Clock.System.now().toEpochMilliseconds() },
+)
+
+/**
+ * Counters for a client's metadata cache.
+ *
+ * @property hits Lookups served from the cache without a request
+ * @property revalidations Lookups served from the cache after a `304 Not Modified`
+ * @property misses Lookups that fetched a full response
+ * @property evictions Entries dropped to stay within [CacheOptions.maxEntries]
+ * @property size Entries currently cached
+ */
+@Serializable
+public data class CacheStats(
+    val hits: Long = 0,
+    val revalidations: Long = 0,
+    val misses: Long = 0,
+    val evictions: Long = 0,
+    val size: Int = 0,
+)
+
+/**
+ * One cached response.
+ *
+ * @property resource The resource as returned by the server
+ * @property storedAt When it was fetched or last revalidated, in milliseconds since the epoch
+ * @property etag The response's `ETag`, if any
+ * @property lastModified The response's `Last-Modified`, if any
+ */
+@Serializable
+public data class CachedResource(
+    val resource: Resource,
+    val storedAt: Long,
+    val etag: String? = null,
+    val lastModified: String? = null,
+)
+
+/**
+ * Persistent backing for [CacheOptions.store], keyed by server URL and user.
+ *
+ * Entries are only visible to the user who fetched them: `user` is the
+ * username in the token's claims, or a hash of the token if it has none.
+ *
+ * Calls are blocking and rare: the cache loads once on first use after a token
+ * is set, and saves on [FilebrowserClient.flushCache] and [FilebrowserClient.close].
+ */
+public interface MetadataStore {
+    /** Entries saved for [user] on [serverUrl], by path. */
+    public fun load(
+        serverUrl: String,
+        user: String,
+    ): Map<String, CachedResource>
+
+    /** Replace the entries saved for [user] on [serverUrl]. */
+    public fun save(
+        serverUrl: String,
+        user: String,
+        entries: Map<String, CachedResource>,
+    )
+}
+
+/**
+ * Create the platform's default [MetadataStore].
+ *
+ * JVM and Native keep `~/.config/krfiles/metadata.json` next to the auth file;
+ * JS uses localStorage in browsers and memory in Node.
+ */
+public expect fun createPlatformMetadataStore(): MetadataStore
+
+/** LRU of [CachedResource]s by normalized path, guarded by a mutex. */
+internal class MetadataCache(
+    private val options: CacheOptions,
+    private val serverUrl: String,
+) {
+    private val mutex = Mutex()
+
+    // Insertion-ordered; a hit re-inserts the key, so the first key is the least recently used.
+    private val entries = LinkedHashMap<String, CachedResource>()
+    private var loaded = false
+    private var dirty = false
+
+    private var clearPending = false
+
+    // Set without the lock by switchUser(); applied by the next locked operation.
+    @Volatile
+    private var nextUser: String? = null
+
+    // Whose entries are held; null until a token is set, and nothing is loaded before then.
+    private var user: String? = null
+
+    private var hits = 0L
+    private var revalidations = 0L
+    private var misses = 0L
+    private var evictions = 0L
+
+    init {
+        require(options.maxEntries > 0) { "maxEntries must be positive" }
+    }
+
+    val stats: CacheStats
+        get() = CacheStats(hits, revalidations, misses, evictions, entries.size)
+
+    /** The entry for [path], fresh or not, marked as recently used. */
+    suspend fun get(path: String): CachedResource? =
+        mutex.withLock {
+            ensureLoaded()
+            val entry = entries.remove(path) ?: return@withLock null
+            entries[path] = entry
+            entry
+        }
+
+    fun isFresh(entry: CachedResource): Boolean = options.clock() - entry.storedAt < options.ttlMillis
+
+    suspend fun recordHit() {
+        mutex.withLock { hits++ }
+    }
+
+    /** The server confirmed [entry] is current: restart its TTL. */
+    suspend fun revalidated(
+        path: String,
+        entry: CachedResource,
+    ) = mutex.withLock {
+        revalidations++
+        store(path, entry.copy(storedAt = options.clock()))
+    }
+
+    suspend fun put(
+        path: String,
+        resource: Resource,
+        etag: String?,
+        lastModified: String?,
+    ) = mutex.withLock {
+        misses++
+        store(path, CachedResource(resource, options.clock(), etag, lastModified))
+    }
+
+    /** Forget [path], everything below it, and the listing of its parent. */
+    suspend fun invalidate(path: String) =
+        mutex.withLock {
+            ensureLoaded()
+            val prefix = if (path == "/") "/" else "$path/"
+            val stale = entries.keys.filter { it == path || it.startsWith(prefix) } + parentOf(path)
+            for (key in stale) {
+                if (entries.remove(key) != null) dirty = true
+            }
+        }
+
+    suspend fun clear() =
+        mutex.withLock {
+            clearPending = true
+            ensureLoaded()
+        }
+
+    /**
+     * Hold [user]'s entries from now on, or none for null. The previous user's
+     * are saved first if the lock is free, then dropped before the next operation.
+     */
+    fun switchUser(user: String?) {
+        flush()
+        nextUser = user
+    }
+
+    /**
+     * Save to the store if anything changed. Skipped if a lookup holds the lock,
+     * since this runs from non-suspending [FilebrowserClient.close].
+     */
+    fun flush() {
+        val store = options.store ?: return
+        if (!mutex.tryLock()) return
+        try {
+            ensureLoaded()
+            val user = user ?: return
+            if (dirty) store.save(serverUrl, user, entries.toMap())
+            dirty = false
+        } finally {
+            mutex.unlock()
+        }
+    }
+
+    private fun store(
+        path: String,
+        entry: CachedResource,
+    ) {
+        ensureLoaded()
+        entries.remove(path)
+        entries[path] = entry
+        dirty = true
+        while (entries.size > options.maxEntries) {
+            entries.remove(entries.keys.first())
+            evictions++
+        }
+    }
+
+    private fun ensureLoaded() {
+        val next = nextUser
+        if (next != user) {
+            user = next
+            loaded = false
+            dirty = false
+            entries.clear()
+        }
+        if (clearPending) {
+            // Also skips loading: whatever the store holds is just as stale.
+            clearPending = false
+            loaded = true
+            dirty = true
+            entries.clear()
+        }
+        if (loaded) return
+        val user = user ?: return
+        loaded = true
+        val saved = options.store?.let { runCatching { it.load(serverUrl, user) }.getOrNull() } ?: return
+        // Expired entries are only worth keeping if they can be revalidated cheaply.
+        saved
+            .filter { (_, entry) -> isFresh(entry) || entry.etag != null || entry.lastModified != null }
+            .entries
+            .sortedBy { it.value.storedAt }
+            .takeLast(options.maxEntries)
+            .forEach { (path, entry) -> entries[path] = entry }
+    }
+
+    companion object {
+        /** Cache key for [path]: leading slash, no trailing slash except for the root. */
+        fun keyOf(path: String): String = "/" + path.trim('/')
+
+        /**
+         * Who [token] belongs to: the `user.username` claim of a Filebrowser
+         * JWT, so renewed tokens share a cache, or else a hash of the token.
+         * The claims are not verified; the server still checks every request.
+         */
+        fun userOf(token: String): String {
+            val username =
+                runCatching {
+                    val claims =
+                        Base64.UrlSafe
+                            .withPadding(Base64.PaddingOption.ABSENT_OPTIONAL)
+                            .decode(token.split('.')[1])
+                            .decodeToString()
+                    val user = Json.parseToJsonElement(claims).jsonObject.getValue("user")
+                    user.jsonObject.getValue("username").jsonPrimitive.content
+                }.getOrNull()
+            if (username != null) return "user:$username"
+            val bytes = token.encodeToByteArray()
+            return "token:" + sha256().apply { update(bytes, 0, bytes.size) }.hex()
+        }
+
+        private fun parentOf(path: String): String = keyOf(path.substringBeforeLast('/', missingDelimiterValue = ""))
+    }
+}
@@ -0,0 +1,403 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.call.HttpClientCall
+import io.ktor.client.plugins.HttpClientPlugin
+import io.ktor.client.plugins.HttpSend
+import io.ktor.client.plugins.plugin
+import io.ktor.client.request.HttpRequestBuilder
+import io.ktor.client.statement.HttpResponsePipeline
+import io.ktor.http.HttpMethod
+import io.ktor.http.content.OutgoingContent
+import io.ktor.http.contentLength
+import io.ktor.util.AttributeKey
+import io.ktor.util.pipeline.PipelinePhase
+import io.ktor.utils.io.ByteReadChannel
+import kotlinx.coroutines.Job
+import kotlinx.coroutines.channels.Channel
+import kotlinx.coroutines.sync.Mutex
+import kotlinx.coroutines.sync.withLock
+import kotlinx.serialization.Serializable
+import kotlin.concurrent.Volatile
+import kotlin.time.Duration
+import kotlin.time.DurationUnit
+import kotlin.time.TimeSource
+
+/**
+ * Latency distribution of one phase, in milliseconds.
+ *
+ * Percentiles are the upper bound of the bucket they fall in (see
+ * [BUCKET_BOUNDS_MILLIS]), or [maxMillis] for the last, unbounded bucket.
+ *
+ * @property count Samples recorded
+ * @property buckets Samples per bucket, aligned with [BUCKET_BOUNDS_MILLIS] plus one overflow bucket
+ */
+@Serializable
+public data class LatencyHistogram(
+    val count: Long = 0,
+    val totalMillis: Double = 0.0,
+    val maxMillis: Double = 0.0,
+    val p50Millis: Double = 0.0,
+    val p90Millis: Double = 0.0,
+    val p99Millis: Double = 0.0,
+    val buckets: List<Long> = emptyList(),
+) {
+    public val meanMillis: Double
+        get() = if (count == 0L) 0.0 else totalMillis / count
+
+    public companion object {
+        /** Upper bounds of the histogram buckets in milliseconds. */
+        public val BUCKET_BOUNDS_MILLIS: List<Double> =
+            listOf(1.0, 2.0, 5.0, 10.0, 20.0, 50.0, 100.0, 200.0, 500.0, 1000.0, 2000.0, 5000.0, 10000.0, 30000.0)
+    }
+}
+
+/**
+ * Counters and latencies of one endpoint, e.g. `GET /api/resources`.
+ *
+ * A request goes through three phases: [headers] from sending it until the
+ * response headers arrive (connecting, TLS, the upload and the server's time to
+ * first byte), [body] until the response is consumed, and [decode] turning the
+ * body into a typed object. [total] covers the first two.
+ *
+ * @property errors Requests that failed or got a status of 400 or above
+ * @property bytesReceived Bytes announced by `Content-Length`; chunked responses count as 0
+ */
+@Serializable
+public data class EndpointStats(
+    val endpoint: String,
+    val requests: Long = 0,
+    val errors: Long = 0,
+    val bytesSent: Long = 0,
+    val bytesReceived: Long = 0,
+    val headers: LatencyHistogram = LatencyHistogram(),
+    val body: LatencyHistogram = LatencyHistogram(),
+    val total: LatencyHistogram = LatencyHistogram(),
+    val decode: LatencyHistogram = LatencyHistogram(),
+)
+
+/**
+ * Response bodies the client decompressed itself (see [ClientConfig.compressResponses]).
+ *
+ * @property responses Compressed responses decoded
+ * @property compressedBytes Bytes as received on the wire
+ * @property decompressedBytes Bytes after decompression
+ * @property inflateMillis Time spent decompressing, excluding waits for the network
+ */
+@Serializable
+public data class CompressionStats(
+    val responses: Long = 0,
+    val compressedBytes: Long = 0,
+    val decompressedBytes: Long = 0,
+    val inflateMillis: Double = 0.0,
+) {
+    /** How many times larger the bodies were than what was transferred; 0 without compressed responses. */
+    public val ratio: Double
+        get() = if (compressedBytes == 0L) 0.0 else decompressedBytes.toDouble() / compressedBytes
+}
+
+/**
+ * Snapshot of a client's request metrics, from [FilebrowserClient.stats].
+ *
+ * @property endpoints Per-endpoint statistics, sorted by endpoint
+ * @property encode Time spent encoding results as JSON for the C API
+ * @property compression Totals over compressed responses
+ * @property scheduler Concurrency, queues and throughput of the request scheduler
+ * @property retry Retries and hedges of idempotent calls
+ */
+@Serializable
+public data class ClientStats(
+    val endpoints: List<EndpointStats> = emptyList(),
+    val encode: LatencyHistogram = LatencyHistogram(),
+    val compression: CompressionStats = CompressionStats(),
+    val scheduler: SchedulerStats = SchedulerStats(),
+    val retry: RetryStats = RetryStats(),
+)
+
+/**
+ * One finished HTTP request, passed to a [RequestTraceListener].
+ *
+ * @property endpoint Method and API route, as keyed in [ClientStats]
+ * @property path Full request path, still URL-encoded
+ * @property status HTTP status, or 0 if the request failed before a response
+ * @property headersMillis Time until the response headers arrived
+ * @property totalMillis Time until the response was consumed
+ * @property error Failure message, if the request or reading its body failed
+ */
+@Serializable
+public data class RequestTrace(
+    val endpoint: String,
+    val path: String,
+    val status: Int,
+    val bytesSent: Long,
+    val bytesReceived: Long,
+    val headersMillis: Double,
+    val totalMillis: Double,
+    val error: String? = null,
+)
+
+/**
+ * Receives a [RequestTrace] as each request finishes.
+ *
+ * Called from whichever thread completed the request; keep it cheap and don't
+ * call back into the client from it.
+ */
+public fun interface RequestTraceListener {
+    public fun onRequest(trace: RequestTrace)
+}
+
+/** Mutable counterpart of [LatencyHistogram]. */
+private class Histogram {
+    private val buckets = LongArray(LatencyHistogram.BUCKET_BOUNDS_MILLIS.size + 1)
+    private var count = 0L
+    private var total = 0.0
+    private var max = 0.0
+
+    fun add(millis: Double) {
+        val bucket = LatencyHistogram.BUCKET_BOUNDS_MILLIS.indexOfFirst { millis <= it }
+        buckets[if (bucket < 0) buckets.lastIndex else bucket]++
+        count++
+        total += millis
+        max = maxOf(max, millis)
+    }
+
+    private fun percentile(fraction: Double): Double {
+        if (count == 0L) return 0.0
+        val rank = fraction * count
+        var seen = 0L
+        for ((i, n) in buckets.withIndex()) {
+            seen += n
+            if (seen >= rank) return minOf(LatencyHistogram.BUCKET_BOUNDS_MILLIS.getOrNull(i) ?: max, max)
+        }
+        return max
+    }
+
+    fun snapshot(): LatencyHistogram =
+        LatencyHistogram(count, total, max, percentile(0.5), percentile(0.9), percentile(0.99), buckets.toList())
+}
+
+private class EndpointAccumulator(
+    val endpoint: String,
+) {
+    var requests = 0L
+    var errors = 0L
+    var bytesSent = 0L
+    var bytesReceived = 0L
+    val headers = Histogram()
+    val body = Histogram()
+    val total = Histogram()
+    val decode = Histogram()
+
+    fun snapshot(): EndpointStats =
+        EndpointStats(
+            endpoint,
+            requests,
+            errors,
+            bytesSent,
+            bytesReceived,
+            headers.snapshot(),
+            body.snapshot(),
+            total.snapshot(),
+            decode.snapshot(),
+        )
+}
+
+/**
+ * Request metrics of one [FilebrowserClient].
+ *
+ * Samples arrive from Ktor callbacks that can't suspend, so they are queued and
+ * folded into the counters by whoever gets the lock first; [snapshot] folds in
+ * whatever is left.
+ */
+internal class ClientMetrics {
+    @Volatile
+    var listener: RequestTraceListener? = null
+
+    private sealed interface Sample {
+        class Request(
+            val trace: RequestTrace,
+        ) : Sample
+
+        class Decode(
+            val endpoint: String,
+            val millis: Double,
+        ) : Sample
+
+        class Encode(
+            val millis: Double,
+        ) : Sample
+
+        class Compression(
+            val compressedBytes: Long,
+            val decompressedBytes: Long,
+            val millis: Double,
+        ) : Sample
+    }
+
+    private val pending = Channel<Sample>(Channel.UNLIMITED)
+    private val mutex = Mutex()
+    private val endpoints = mutableMapOf<String, EndpointAccumulator>()
+    private var encode = Histogram()
+    private var compression = CompressionStats()
+
+    fun record(trace: RequestTrace) {
+        listener?.onRequest(trace)
+        add(Sample.Request(trace))
+    }
+
+    fun recordDecode(
+        endpoint: String,
+        duration: Duration,
+    ) = add(Sample.Decode(endpoint, duration.toMillis()))
+
+    fun recordEncode(duration: Duration) = add(Sample.Encode(duration.toMillis()))
+
+    fun recordCompression(
+        compressedBytes: Long,
+        decompressedBytes: Long,
+        duration: Duration,
+    ) = add(Sample.Compression(compressedBytes, decompressedBytes, duration.toMillis()))
+
+    suspend fun snapshot(): ClientStats =
+        mutex.withLock {
+            drain()
+            ClientStats(endpoints.values.map { it.snapshot() }.sortedBy { it.endpoint }, encode.snapshot(), compression)
+        }
+
+    suspend fun reset() {
+        mutex.withLock {
+            drain()
+            endpoints.clear()
+            encode = Histogram()
+            compression = CompressionStats()
+        }
+    }
+
+    private fun add(sample: Sample) {
+        pending.trySend(sample)
+        if (!mutex.tryLock()) return
+        try {
+            drain()
+        } finally {
+            mutex.unlock()
+        }
+    }
+
+    private fun drain() {
+        while (true) {
+            when (val sample = pending.tryReceive().getOrNull() ?: return) {
+                is Sample.Request -> {
+                    val trace = sample.trace
+                    endpointOf(trace.endpoint).apply {
+                        requests++
+                        if (trace.error != null || trace.status >= 400) errors++
+                        bytesSent += trace.bytesSent
+                        bytesReceived += trace.bytesReceived
+                        headers.add(trace.headersMillis)
+                        body.add(trace.totalMillis - trace.headersMillis)
+                        total.add(trace.totalMillis)
+                    }
+                }
+                is Sample.Decode -> endpointOf(sample.endpoint).decode.add(sample.millis)
+                is Sample.Encode -> encode.add(sample.millis)
+                is Sample.Compression ->
+                    compression =
+                        compression.copy(
+                            responses = compression.responses + 1,
+                            compressedBytes = compression.compressedBytes + sample.compressedBytes,
+                            decompressedBytes = compression.decompressedBytes + sample.decompressedBytes,
+                            inflateMillis = compression.inflateMillis + sample.millis,
+                        )
+            }
+        }
+    }
+
+    private fun endpointOf(endpoint: String) = endpoints.getOrPut(endpoint) { EndpointAccumulator(endpoint) }
+
+    /** Time [send] and report the request once its response has been consumed. */
+    suspend fun observe(
+        request: HttpRequestBuilder,
+        send: suspend () -> HttpClientCall,
+    ): HttpClientCall {
+        val endpoint = endpointKey(request.method, request.url.encodedPath)
+        val path = request.url.encodedPath
+        val sent = (request.body as? OutgoingContent)?.contentLength ?: 0
+        val start = TimeSource.Monotonic.markNow()
+        val call =
+            try {
+                send()
+            } catch (e: Throwable) {
+                val elapsed = start.elapsedNow().toMillis()
+                record(RequestTrace(endpoint, path, 0, sent, 0, elapsed, elapsed, e.message ?: e.toString()))
+                throw e
+            }
+        val headers = start.elapsedNow().toMillis()
+        val response = call.response
+        val status = response.status.value
+        val received = response.contentLength() ?: 0
+        val finish = { cause: Throwable? ->
+            val total = start.elapsedNow().toMillis()
+            record(RequestTrace(endpoint, path, status, sent, received, headers, total, cause?.message))
+        }
+        val job = response.coroutineContext[Job]
+        if (job == null) finish(null) else job.invokeOnCompletion(finish)
+        return call
+    }
+
+    companion object {
+        /** `GET /api/resources/a/b` → `GET /api/resources`, ignoring any prefix before `/api`. */
+        fun endpointKey(
+            method: HttpMethod,
+            encodedPath: String,
+        ): String {
+            val segments = encodedPath.split('/').filter { it.isNotEmpty() }
+            val api = segments.indexOf("api")
+            val route = if (api >= 0 && api + 1 < segments.size) "/api/${segments[api + 1]}" else encodedPath
+            return "${method.value} $route"
+        }
+
+        private fun Duration.toMillis(): Double = toDouble(DurationUnit.MILLISECONDS)
+    }
+}
+
+/**
+ * Ktor plugin feeding [ClientMetrics]: it times every request sent through
+ * [HttpSend] and the decoding of response bodies.
+ */
+internal class RequestMetrics private constructor(
+    private val metrics: ClientMetrics,
+) {
+    class Config {
+        var metrics: ClientMetrics = ClientMetrics()
+    }
+
+    companion object Plugin : HttpClientPlugin<Config, RequestMetrics> {
+        override val key: AttributeKey<RequestMetrics> = AttributeKey("KrfilesRequestMetrics")
+
+        // Ahead of Transform, so it wraps ContentNegotiation whenever that was installed.
+        private val Decode = PipelinePhase("KrfilesDecode")
+
+        override fun prepare(block: Config.() -> Unit): RequestMetrics = RequestMetrics(Config().apply(block).metrics)
+
+        override fun install(
+            plugin: RequestMetrics,
+            scope: HttpClient,
+        ) {
+            scope.plugin(HttpSend).intercept { request ->
+                plugin.metrics.observe(request) { execute(request) }
+            }
+
+            scope.responsePipeline.insertPhaseBefore(HttpResponsePipeline.Transform, Decode)
+            scope.responsePipeline.intercept(Decode) { (type, _) ->
+                if (type.type == ByteReadChannel::class) return@intercept
+                val start = TimeSource.Monotonic.markNow()
+                proceed()
+                val request = context.request
+                plugin.metrics.recordDecode(
+                    ClientMetrics.endpointKey(request.method, request.url.encodedPath),
+                    start.elapsedNow(),
+                )
+            }
+        }
+    }
+}
@@ -15,6 +15,7 @@ import kotlin.js.JsExport
  * @property isSymlink Whether this is a symbolic link
  * @property type MIME type of the file
  * @property path Full path to the resource
+ * @property checksums Hashes of the file, only when asked for; see [FilebrowserClient.getChecksum]
  */
 @JsExport
 @Serializable
@@ -32,6 +33,20 @@ public data class Resource(
     val numDirs: Int = 0,
     val numFiles: Int = 0,
     val sorting: Sorting? = null,
+    val checksums: Checksums? = null,
+)
+
+/**
+ * File hashes computed by the server, as lowercase hex. Only the requested
+ * algorithm is filled in.
+ */
+@JsExport
+@Serializable
+public data class Checksums(
+    val md5: String? = null,
+    val sha1: String? = null,
+    val sha256: String? = null,
+    val sha512: String? = null,
 )
 
 /**
@@ -0,0 +1,191 @@
+package dev.rolandh.krfiles
+
+import kotlinx.coroutines.CancellationException
+import kotlinx.coroutines.async
+import kotlinx.coroutines.delay
+import kotlinx.coroutines.selects.select
+import kotlinx.coroutines.supervisorScope
+import kotlinx.coroutines.sync.Mutex
+import kotlinx.coroutines.sync.withLock
+import kotlinx.coroutines.withTimeoutOrNull
+import kotlinx.io.IOException
+import kotlinx.serialization.Serializable
+import kotlin.random.Random
+
+/**
+ * Retries and hedging for the idempotent metadata calls:
+ * [FilebrowserClient.getResource], [FilebrowserClient.listDirectory],
+ * [FilebrowserClient.search] and their JSON variants. Streams, transfers and
+ * mutations are never repeated.
+ *
+ * A call that fails on the network, times out, or gets `408`, `429`, `500`,
+ * `502`, `503` or `504` is tried again, up to [maxAttempts] times in all, after
+ * a random delay between 0 and [retryBaseDelayMillis] doubled per attempt
+ * (at most [retryMaxDelayMillis]). Spreading the delays keeps clients that
+ * failed together from retrying together.
+ *
+ * With [hedgeAfterMillis], a call still unanswered after that long is sent a
+ * second time; whichever response arrives first is used and the other request
+ * is cancelled. Set it near the endpoint's p95 latency (see
+ * [EndpointStats.total]) to cut the slow tail for about 5% more requests.
+ *
+ * Every retry and hedge spends one token from a budget that holds at most
+ * [retryBudgetMax] and gains [retryBudgetRatio] per call, so while the server
+ * keeps failing, extra requests stay near that fraction of calls instead of
+ * multiplying the load.
+ *
+ * @property maxAttempts Tries per call, the first included; 1 disables retries
+ * @property retryBaseDelayMillis Upper bound of the first retry's random delay
+ * @property retryMaxDelayMillis Cap on the upper bound as it doubles
+ * @property retryBudgetRatio Tokens each call adds to the budget
+ * @property retryBudgetMax Tokens the budget holds, and starts with
+ * @property hedgeAfterMillis Send a second request after this long; null to never hedge
+ */
+@Serializable
+public data class RetryOptions(
+    val maxAttempts: Int = 3,
+    val retryBaseDelayMillis: Long = 100,
+    val retryMaxDelayMillis: Long = 5_000,
+    val retryBudgetRatio: Double = 0.1,
+    val retryBudgetMax: Double = 10.0,
+    val hedgeAfterMillis: Long? = null,
+) {
+    init {
+        require(maxAttempts > 0) { "maxAttempts must be positive" }
+        require(retryBaseDelayMillis in 1..retryMaxDelayMillis) {
+            "retryBaseDelayMillis must be positive and at most retryMaxDelayMillis"
+        }
+        require(retryBudgetRatio >= 0 && retryBudgetMax >= 0) { "Retry budget must not be negative" }
+        require(hedgeAfterMillis == null || hedgeAfterMillis > 0) { "hedgeAfterMillis must be positive" }
+    }
+}
+
+/**
+ * Counters of [RetryOptions] at work, from [ClientStats.retry].
+ *
+ * @property calls Idempotent calls made
+ * @property retries Requests repeated after a failure
+ * @property hedges Second requests sent for slow calls
+ * @property hedgeWins Hedges that answered before the request they duplicated
+ * @property budgetExhausted Retries and hedges skipped for lack of budget
+ * @property budget Tokens left in the budget
+ */
+@Serializable
+public data class RetryStats(
+    val calls: Long = 0,
+    val retries: Long = 0,
+    val hedges: Long = 0,
+    val hedgeWins: Long = 0,
+    val budgetExhausted: Long = 0,
+    val budget: Double = 0.0,
+)
+
+/** Runs idempotent calls under [RetryOptions] and keeps their [RetryStats]. */
+internal class RetryController(
+    private val options: RetryOptions,
+    private val random: Random = Random.Default,
+) {
+    private val mutex = Mutex()
+    private var budget = options.retryBudgetMax
+    private var stats = RetryStats()
+
+    /** Run [block], retrying and hedging it as [options] allow. */
+    suspend fun <T> call(block: suspend () -> T): T {
+        update {
+            budget = minOf(options.retryBudgetMax, budget + options.retryBudgetRatio)
+            stats = stats.copy(calls = stats.calls + 1)
+        }
+        var attempt = 1
+        while (true) {
+            try {
+                return hedged(block)
+            } catch (e: CancellationException) {
+                throw e
+            } catch (e: Exception) {
+                if (attempt == options.maxAttempts || !e.isRetryable() || !withdraw()) throw e
+                update { stats = stats.copy(retries = stats.retries + 1) }
+                delay(random.nextLong(backoffMillis(attempt) + 1))
+                attempt++
+            }
+        }
+    }
+
+    suspend fun snapshot(): RetryStats = mutex.withLock { stats.copy(budget = budget) }
+
+    suspend fun reset() {
+        update { stats = RetryStats() }
+    }
+
+    /**
+     * [block], plus a second copy of it if the first is still running after
+     * [RetryOptions.hedgeAfterMillis]. The first success wins and cancels the
+     * other; a failure waits for the other and is thrown only if both fail.
+     */
+    private suspend fun <T> hedged(block: suspend () -> T): T {
+        val hedgeAfter = options.hedgeAfterMillis ?: return block()
+        return supervisorScope {
+            val primary = async { block() }
+            withTimeoutOrNull(hedgeAfter) { primary.join() }
+            if (primary.isCompleted || !withdraw()) return@supervisorScope primary.await()
+
+            update { stats = stats.copy(hedges = stats.hedges + 1) }
+            val hedge = async { block() }
+            val first =
+                select {
+                    primary.onJoin { primary }
+                    hedge.onJoin { hedge }
+                }
+            val second = if (first === primary) hedge else primary
+            try {
+                val result = first.await()
+                second.cancel()
+                if (first === hedge) update { stats = stats.copy(hedgeWins = stats.hedgeWins + 1) }
+                return@supervisorScope result
+            } catch (e: CancellationException) {
+                throw e
+            } catch (_: Exception) {
+                // Fall through to whatever the other request brings.
+            }
+            second.await().also {
+                if (second === hedge) update { stats = stats.copy(hedgeWins = stats.hedgeWins + 1) }
+            }
+        }
+    }
+
+    /** Take a token for a retry or hedge; false, and counted, if the budget is spent. */
+    private suspend fun withdraw(): Boolean =
+        mutex.withLock {
+            if (budget >= 1) {
+                budget -= 1
+                true
+            } else {
+                stats = stats.copy(budgetExhausted = stats.budgetExhausted + 1)
+                false
+            }
+        }
+
+    /** Upper bound of the random delay before retry number [attempt]. */
+    private fun backoffMillis(attempt: Int): Long {
+        val doubled = options.retryBaseDelayMillis shl minOf(attempt - 1, MAX_DOUBLINGS)
+        return minOf(options.retryMaxDelayMillis, doubled)
+    }
+
+    private suspend inline fun update(block: () -> Unit) {
+        mutex.withLock { block() }
+    }
+
+    private companion object {
+        // Keeps the shift from overflowing long before the cap matters.
+        const val MAX_DOUBLINGS = 30
+    }
+}
+
+/** Transport failures and statuses that say "try again later" are worth repeating. */
+private fun Exception.isRetryable(): Boolean =
+    when (this) {
+        is FilebrowserException -> statusCode in RETRYABLE_STATUSES
+        is IOException -> true
+        else -> false
+    }
+
+private val RETRYABLE_STATUSES = setOf(408, 429, 500, 502, 503, 504)
@@ -0,0 +1,413 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.plugins.HttpClientPlugin
+import io.ktor.client.plugins.HttpSend
+import io.ktor.client.plugins.plugin
+import io.ktor.client.request.HttpRequestBuilder
+import io.ktor.http.content.OutgoingContent
+import io.ktor.util.AttributeKey
+import kotlinx.coroutines.CancellationException
+import kotlinx.coroutines.CompletableDeferred
+import kotlinx.coroutines.CoroutineStart
+import kotlinx.coroutines.Job
+import kotlinx.coroutines.NonCancellable
+import kotlinx.coroutines.delay
+import kotlinx.coroutines.launch
+import kotlinx.coroutines.sync.Mutex
+import kotlinx.coroutines.sync.withLock
+import kotlinx.coroutines.withContext
+import kotlinx.serialization.Serializable
+import kotlin.time.Duration
+import kotlin.time.Duration.Companion.milliseconds
+import kotlin.time.Duration.Companion.nanoseconds
+import kotlin.time.Duration.Companion.seconds
+import kotlin.time.DurationUnit
+import kotlin.time.TimeSource
+
+/**
+ * Order in which the scheduler admits waiting requests; see [SchedulerOptions].
+ *
+ * API calls (listings, file info, search, auth) are [INTERACTIVE]. In-memory
+ * [FilebrowserClient.download] / [FilebrowserClient.upload] are [NORMAL], and
+ * streamed, ranged, resumable and archive transfers are [BULK] unless their
+ * [DownloadOptions.priority] or [UploadOptions.priority] says otherwise.
+ */
+@Serializable
+public enum class TransferPriority {
+    INTERACTIVE,
+    NORMAL,
+    BULK,
+}
+
+/**
+ * Settings for the scheduler every request of a [FilebrowserClient] goes through.
+ *
+ * Requests run while fewer than the current concurrency limit are in flight;
+ * the rest wait, higher [TransferPriority] first and in arrival order within a
+ * class. [TransferPriority.INTERACTIVE] requests may exceed the limit by
+ * [interactiveReserve], so listings stay responsive while transfers fill it.
+ * A request holds its place until its response body has been read.
+ *
+ * The limit adapts to the server (AIMD): it halves, down to [minConcurrency],
+ * when a response is `429 Too Many Requests` or `503 Service Unavailable`, or
+ * takes longer than [latencyThresholdMillis] to start, and grows by one per
+ * limit's worth of good responses, up to [maxConcurrency], while it is in full
+ * use. Only requests admitted since the last decrease can cause another one.
+ *
+ * Bandwidth caps count response and request bodies of file transfers, not API
+ * calls. A transfer is slowed down when either cap is reached.
+ *
+ * @property maxBytesPerSecond Bandwidth shared by all transfers; 0 for no cap
+ * @property maxTransferBytesPerSecond Bandwidth of each transfer unless its
+ *   options set one; 0 for no cap
+ * @property initialConcurrency Concurrency limit to start from
+ * @property minConcurrency Lowest the limit backs off to
+ * @property maxConcurrency Highest the limit grows to
+ * @property interactiveReserve Extra requests allowed for [TransferPriority.INTERACTIVE]
+ * @property latencyThresholdMillis Time to the response headers, for requests
+ *   without a body, above which the server counts as overloaded
+ */
+@Serializable
+public data class SchedulerOptions(
+    val maxBytesPerSecond: Long = 0,
+    val maxTransferBytesPerSecond: Long = 0,
+    val initialConcurrency: Int = 16,
+    val minConcurrency: Int = 1,
+    val maxConcurrency: Int = 64,
+    val interactiveReserve: Int = 4,
+    val latencyThresholdMillis: Long = 2_000,
+) {
+    init {
+        require(maxBytesPerSecond >= 0 && maxTransferBytesPerSecond >= 0) { "Bandwidth caps must not be negative" }
+        require(minConcurrency in 1..maxConcurrency) { "minConcurrency must be between 1 and maxConcurrency" }
+        require(initialConcurrency > 0) { "initialConcurrency must be positive" }
+        require(interactiveReserve >= 0) { "interactiveReserve must not be negative" }
+        require(latencyThresholdMillis > 0) { "latencyThresholdMillis must be positive" }
+    }
+}
+
+/**
+ * Snapshot of a client's scheduler, from [FilebrowserClient.schedulerStats]
+ * and [ClientStats.scheduler].
+ *
+ * @property concurrencyLimit Requests allowed in flight right now
+ * @property running Requests in flight
+ * @property queuedInteractive Requests waiting in [TransferPriority.INTERACTIVE]
+ * @property queuedNormal Requests waiting in [TransferPriority.NORMAL]
+ * @property queuedBulk Requests waiting in [TransferPriority.BULK]
+ * @property bytesTransferred File bytes sent and received
+ * @property throughputBytesPerSecond File bytes per second over the last few seconds
+ * @property throttledMillis Time transfers were held back by bandwidth caps, summed over transfers
+ * @property congestionSignals Responses that were throttled, unavailable or slow
+ * @property backoffs Times the concurrency limit was decreased
+ */
+@Serializable
+public data class SchedulerStats(
+    val concurrencyLimit: Int = 0,
+    val running: Int = 0,
+    val queuedInteractive: Int = 0,
+    val queuedNormal: Int = 0,
+    val queuedBulk: Int = 0,
+    val bytesTransferred: Long = 0,
+    val throughputBytesPerSecond: Double = 0.0,
+    val throttledMillis: Double = 0.0,
+    val congestionSignals: Long = 0,
+    val backoffs: Long = 0,
+) {
+    /** Requests waiting in all classes. */
+    public val queued: Int
+        get() = queuedInteractive + queuedNormal + queuedBulk
+}
+
+/** Request attribute carrying the [TransferPriority] the scheduler admits it with. */
+internal val TransferPriorityKey: AttributeKey<TransferPriority> = AttributeKey("KrfilesTransferPriority")
+
+/** Schedule this request as [priority] instead of [TransferPriority.INTERACTIVE]. */
+internal fun HttpRequestBuilder.priority(priority: TransferPriority) {
+    attributes.put(TransferPriorityKey, priority)
+}
+
+/**
+ * Admission, adaptive concurrency and bandwidth accounting behind
+ * [SchedulerOptions]. Requests are admitted by [RequestScheduler]; transfers
+ * report their bytes through a [meter].
+ */
+internal class TransferScheduler(
+    private val options: SchedulerOptions,
+    private val timeSource: TimeSource = TimeSource.Monotonic,
+) {
+    /** A place in flight, held until [release]. */
+    class Slot(
+        val priority: TransferPriority,
+        val epoch: Long,
+    )
+
+    private val mutex = Mutex()
+    private val waiting = TransferPriority.entries.associateWith { ArrayDeque<CompletableDeferred<Slot>>() }
+    private var limit = options.initialConcurrency.coerceIn(options.minConcurrency, options.maxConcurrency).toDouble()
+    private var running = 0
+
+    // Bumped on every decrease; responses to requests admitted before it are stale.
+    private var epoch = 0L
+    private var congestionSignals = 0L
+    private var backoffs = 0L
+    private var throttled = Duration.ZERO
+    private val throughput = ThroughputMeter(timeSource)
+    private val global = options.maxBytesPerSecond.takeIf { it > 0 }?.let { RateLimiter(it, timeSource) }
+
+    /** Time to the response headers above which a bodiless request counts as slow. */
+    val latencyThreshold: Duration = options.latencyThresholdMillis.milliseconds
+
+    /** Wait for a place in flight for a [priority] request. */
+    suspend fun acquire(priority: TransferPriority): Slot {
+        val waiter =
+            mutex.withLock {
+                val ahead = waiting.any { (queued, waiters) -> queued <= priority && waiters.isNotEmpty() }
+                if (!ahead && running < capacity(priority)) {
+                    running++
+                    return Slot(priority, epoch)
+                }
+                CompletableDeferred<Slot>().also { waiting.getValue(priority).addLast(it) }
+            }
+        try {
+            return waiter.await()
+        } catch (e: CancellationException) {
+            withContext(NonCancellable) {
+                mutex.withLock {
+                    // Admitted just before the cancellation arrived: give the place back.
+                    if (!waiting.getValue(priority).remove(waiter)) releaseLocked()
+                }
+            }
+            throw e
+        }
+    }
+
+    /** Give back a place taken with [acquire]. */
+    suspend fun release() {
+        mutex.withLock { releaseLocked() }
+    }
+
+    /** Adjust the limit to how the server answered a request admitted with [slot]. */
+    suspend fun onResponse(
+        slot: Slot,
+        congested: Boolean,
+    ) {
+        mutex.withLock {
+            if (congested) {
+                congestionSignals++
+                if (slot.epoch == epoch) {
+                    limit = maxOf(options.minConcurrency.toDouble(), limit * BACKOFF_FACTOR)
+                    epoch++
+                    backoffs++
+                }
+            } else if (running >= limit.toInt()) {
+                limit = minOf(options.maxConcurrency.toDouble(), limit + 1 / limit)
+                admit()
+            }
+        }
+    }
+
+    /** A meter for one transfer, capped at [bytesPerSecond] or, if 0, [SchedulerOptions.maxTransferBytesPerSecond]. */
+    fun meter(bytesPerSecond: Long = 0): TransferMeter {
+        val rate = if (bytesPerSecond > 0) bytesPerSecond else options.maxTransferBytesPerSecond
+        return TransferMeter(this, if (rate > 0) RateLimiter(rate, timeSource) else null)
+    }
+
+    /** Account for [bytes] of a transfer capped by [limiter], and wait until the caps allow more. */
+    suspend fun transferred(
+        bytes: Int,
+        limiter: RateLimiter? = null,
+    ) {
+        val wait = maxOf(global?.reserve(bytes) ?: Duration.ZERO, limiter?.reserve(bytes) ?: Duration.ZERO)
+        mutex.withLock {
+            throughput.add(bytes)
+            throttled += wait
+        }
+        if (wait.isPositive()) delay(wait)
+    }
+
+    suspend fun snapshot(): SchedulerStats =
+        mutex.withLock {
+            SchedulerStats(
+                concurrencyLimit = limit.toInt(),
+                running = running,
+                queuedInteractive = waiting.getValue(TransferPriority.INTERACTIVE).size,
+                queuedNormal = waiting.getValue(TransferPriority.NORMAL).size,
+                queuedBulk = waiting.getValue(TransferPriority.BULK).size,
+                bytesTransferred = throughput.total,
+                throughputBytesPerSecond = throughput.rate(),
+                throttledMillis = throttled.toDouble(DurationUnit.MILLISECONDS),
+                congestionSignals = congestionSignals,
+                backoffs = backoffs,
+            )
+        }
+
+    /** Zero the counters; the limit and the queues are left as they are. */
+    suspend fun reset() {
+        mutex.withLock {
+            congestionSignals = 0
+            backoffs = 0
+            throttled = Duration.ZERO
+            throughput.reset()
+        }
+    }
+
+    private fun capacity(priority: TransferPriority): Int =
+        limit.toInt() + if (priority == TransferPriority.INTERACTIVE) options.interactiveReserve else 0
+
+    private fun releaseLocked() {
+        running--
+        admit()
+    }
+
+    /** Admit waiters in priority order while there is room; a blocked class holds back the ones below. */
+    private fun admit() {
+        for ((priority, waiters) in waiting) {
+            while (waiters.isNotEmpty() && running < capacity(priority)) {
+                running++
+                waiters.removeFirst().complete(Slot(priority, epoch))
+            }
+            if (waiters.isNotEmpty()) return
+        }
+    }
+
+    private companion object {
+        const val BACKOFF_FACTOR = 0.5
+    }
+}
+
+/** Counts the bytes of one transfer for its [TransferScheduler], pacing them to the bandwidth caps. */
+internal class TransferMeter(
+    private val scheduler: TransferScheduler,
+    private val limiter: RateLimiter?,
+) {
+    /** Count [bytes] just sent or received, waiting if they take the transfer over a cap. */
+    suspend fun add(bytes: Int) {
+        scheduler.transferred(bytes, limiter)
+    }
+}
+
+/**
+ * Token bucket pacing one stream of bytes to [bytesPerSecond]. Up to [BURST]
+ * of idle time is credited, so short pauses don't cost throughput.
+ */
+internal class RateLimiter(
+    private val bytesPerSecond: Long,
+    timeSource: TimeSource = TimeSource.Monotonic,
+) {
+    private val mutex = Mutex()
+    private val start = timeSource.markNow()
+
+    // When the bytes reserved so far will have been sent at the capped rate.
+    private var next = Duration.ZERO
+
+    /** Reserve [bytes] and return how long to wait before going on. */
+    suspend fun reserve(bytes: Int): Duration =
+        mutex.withLock {
+            val now = start.elapsedNow()
+            next = maxOf(next, now - BURST) + (bytes * 1e9 / bytesPerSecond).nanoseconds
+            maxOf(Duration.ZERO, next - now)
+        }
+
+    private companion object {
+        val BURST = 100.milliseconds
+    }
+}
+
+/** Bytes per second over a sliding window of one-second buckets. */
+private class ThroughputMeter(
+    timeSource: TimeSource,
+) {
+    private val start = timeSource.markNow()
+    private val buckets = LongArray(WINDOW_SECONDS)
+    private var second = 0L
+
+    var total = 0L
+        private set
+
+    fun add(bytes: Int) {
+        advance()
+        buckets[(second % WINDOW_SECONDS).toInt()] += bytes.toLong()
+        total += bytes
+    }
+
+    fun rate(): Double {
+        val now = advance()
+        // The full seconds in the window plus the part of the current one.
+        val span = minOf(now, (WINDOW_SECONDS - 1).seconds + (now - second.seconds))
+        return if (span.isPositive()) buckets.sum() / span.toDouble(DurationUnit.SECONDS) else 0.0
+    }
+
+    fun reset() {
+        buckets.fill(0)
+        total = 0
+    }
+
+    /** Move to the current second, clearing the buckets of seconds that passed. */
+    private fun advance(): Duration {
+        val now = start.elapsedNow()
+        val current = now.inWholeSeconds
+        for (s in maxOf(second + 1, current - WINDOW_SECONDS + 1)..current) {
+            buckets[(s % WINDOW_SECONDS).toInt()] = 0
+        }
+        second = maxOf(second, current)
+        return now
+    }
+
+    private companion object {
+        const val WINDOW_SECONDS = 5
+    }
+}
+
+/**
+ * Ktor plugin running every request sent through [HttpSend] past a
+ * [TransferScheduler]: it waits for a place, reports how the server answered,
+ * and gives the place back once the response has been consumed.
+ *
+ * Install it before [RequestMetrics], so request timings leave out the wait.
+ */
+internal class RequestScheduler private constructor(
+    private val scheduler: TransferScheduler,
+) {
+    class Config {
+        var scheduler: TransferScheduler = TransferScheduler(SchedulerOptions())
+    }
+
+    companion object Plugin : HttpClientPlugin<Config, RequestScheduler> {
+        override val key: AttributeKey<RequestScheduler> = AttributeKey("KrfilesRequestScheduler")
+
+        override fun prepare(block: Config.() -> Unit): RequestScheduler =
+            RequestScheduler(Config().apply(block).scheduler)
+
+        override fun install(
+            plugin: RequestScheduler,
+            scope: HttpClient,
+        ) {
+            val scheduler = plugin.scheduler
+            scope.plugin(HttpSend).intercept { request ->
+                val priority = request.attributes.getOrNull(TransferPriorityKey) ?: TransferPriority.INTERACTIVE
+                val slot = scheduler.acquire(priority)
+                val start = TimeSource.Monotonic.markNow()
+                val call =
+                    try {
+                        execute(request)
+                    } catch (e: Throwable) {
+                        withContext(NonCancellable) { scheduler.release() }
+                        throw e
+                    }
+                val status = call.response.status.value
+                // Uploads take as long as their body, so only bodiless requests tell about latency.
+                val slow = request.body is OutgoingContent.NoContent && start.elapsedNow() > scheduler.latencyThreshold
+                withContext(NonCancellable) { scheduler.onResponse(slot, status == 429 || status == 503 || slow) }
+                val release = { _: Throwable? ->
+                    scope.launch(start = CoroutineStart.UNDISPATCHED) { scheduler.release() }
+                    Unit
+                }
+                val job = call.response.coroutineContext[Job]
+                if (job == null) release(null) else job.invokeOnCompletion(release)
+                call
+            }
+        }
+    }
+}
@@ -0,0 +1,504 @@
+package dev.rolandh.krfiles
+
+import kotlinx.coroutines.channels.Channel
+import kotlinx.coroutines.coroutineScope
+import kotlinx.coroutines.flow.collect
+import kotlinx.coroutines.launch
+import kotlinx.serialization.SerialName
+import kotlinx.serialization.Serializable
+import kotlinx.serialization.Transient
+import kotlin.time.ExperimentalTime
+import kotlin.time.Instant
+
+/** Which side of a sync is the source of truth. */
+@Serializable
+public enum class SyncDirection {
+    /** Make the remote tree match the local one. */
+    @SerialName("push")
+    PUSH,
+
+    /** Make the local tree match the remote one. */
+    @SerialName("pull")
+    PULL,
+}
+
+/**
+ * A file or directory in a [LocalTree].
+ *
+ * @property path Path relative to the tree root, `/`-separated, without a leading slash
+ * @property isDir Whether this is a directory
+ * @property size Size in bytes (0 for directories)
+ * @property modified Last modification time in seconds since the epoch
+ */
+public data class LocalEntry(
+    val path: String,
+    val isDir: Boolean,
+    val size: Long = 0,
+    val modified: Long = 0,
+)
+
+/**
+ * The local side of a [FilebrowserClient.sync]: a directory tree on this machine.
+ *
+ * All paths are relative to the tree root, as in [LocalEntry.path]. Failures are
+ * reported by throwing.
+ */
+public interface LocalTree {
+    /** Every file and directory below the root. */
+    public fun scan(): List<LocalEntry>
+
+    /** Open the file at [path] and pass it to [block] as a source of its `size` bytes. */
+    public suspend fun <T> read(
+        path: String,
+        block: suspend (source: ChunkSource, size: Long) -> T,
+    ): T
+
+    /**
+     * Replace the file at [path] with the bytes [block] writes to its sink, then
+     * set its modification time to [modified] (seconds since the epoch; 0 if unknown).
+     *
+     * The old file must stay intact if [block] fails.
+     */
+    public suspend fun write(
+        path: String,
+        modified: Long,
+        block: suspend (sink: suspend (buffer: ByteArray, length: Int) -> Unit) -> Unit,
+    )
+
+    /** Create the directory at [path]; its parent already exists. */
+    public fun createDirectory(path: String)
+}
+
+/**
+ * Remote state remembered between syncs, so a push need not list unchanged subtrees.
+ *
+ * A push assumes a directory whose `modified` stamp still matches [directories]
+ * is unchanged, along with everything below it. That is only a guess:
+ * Filebrowser bumps a directory's stamp when entries are added, removed or
+ * renamed directly in it, not for changes further down or for files edited in
+ * place. A push can therefore miss files other clients removed or replaced
+ * below such a directory and leave them missing or stale remotely; sync with
+ * `rescan` to list everything again.
+ *
+ * A pull always lists the whole remote tree, since downloading what changed
+ * is its whole job; it only writes the manifest for the next push.
+ *
+ * @property remoteRoot Remote directory the manifest describes
+ * @property directories Directory path -> `modified` stamp as listed by the server
+ * @property files File path -> last known remote size and modification time
+ */
+@Serializable
+public data class SyncManifest(
+    val remoteRoot: String = "",
+    val directories: Map<String, String> = emptyMap(),
+    val files: Map<String, ManifestFile> = emptyMap(),
+)
+
+/**
+ * Remote file state recorded in a [SyncManifest].
+ *
+ * @property size Size in bytes
+ * @property modified Modification time in seconds since the epoch
+ */
+@Serializable
+public data class ManifestFile(
+    val size: Long,
+    val modified: Long,
+)
+
+/**
+ * Tuning for [FilebrowserClient.sync].
+ *
+ * @property direction Which side wins
+ * @property dryRun Only plan; transfer nothing and leave the manifest as it was
+ * @property rescan List every remote directory on a push, ignoring the manifest; a pull always does
+ * @property concurrency File transfers in flight at once
+ * @property listingConcurrency Directory listings in flight while scanning the remote tree
+ * @property uploadOptions Options for each pushed file
+ */
+public data class SyncOptions(
+    val direction: SyncDirection = SyncDirection.PUSH,
+    val dryRun: Boolean = false,
+    val rescan: Boolean = false,
+    val concurrency: Int = FilebrowserClient.DEFAULT_SYNC_CONCURRENCY,
+    val listingConcurrency: Int = FilebrowserClient.DEFAULT_WALK_CONCURRENCY,
+    val uploadOptions: UploadOptions = UploadOptions(),
+)
+
+/** What a sync does to one path. */
+@Serializable
+public enum class SyncActionKind {
+    /** Create a directory on the destination side. */
+    @SerialName("mkdir")
+    MKDIR,
+
+    /** Push a local file. */
+    @SerialName("upload")
+    UPLOAD,
+
+    /** Pull a remote file. */
+    @SerialName("download")
+    DOWNLOAD,
+}
+
+/**
+ * One step of a sync plan.
+ *
+ * @property kind What to do
+ * @property path Path relative to the sync roots
+ * @property size Bytes to transfer (0 for directories)
+ * @property reason Why: `new`, `size` (sizes differ) or `newer` (source modified later)
+ * @property error Why the step failed, or null if it succeeded or has not run
+ */
+@Serializable
+public data class SyncAction(
+    val kind: SyncActionKind,
+    val path: String,
+    val size: Long = 0,
+    val reason: String = "",
+    val error: String? = null,
+)
+
+/**
+ * Outcome of a [FilebrowserClient.sync].
+ *
+ * @property direction Which side won
+ * @property dryRun Whether [actions] is only the plan
+ * @property actions Every planned step, directories first; after a real run each carries its error, if any
+ * @property unchanged Files already up to date
+ * @property listedDirectories Remote directories listed from the server
+ * @property cachedDirectories Remote directories taken from the manifest instead
+ * @property manifest Remote state to pass to the next sync of the same roots
+ */
+@Serializable
+public data class SyncReport(
+    val direction: SyncDirection,
+    val dryRun: Boolean,
+    val actions: List<SyncAction>,
+    val unchanged: Int,
+    val listedDirectories: Int,
+    val cachedDirectories: Int,
+    @Transient val manifest: SyncManifest = SyncManifest(),
+) {
+    /** Steps that failed. */
+    val failed: List<SyncAction> get() = actions.filter { it.error != null }
+}
+
+/**
+ * Bring [local] and the remote directory [remoteRoot] in line, in [SyncOptions.direction].
+ *
+ * Files are compared by size and modification time (to the second): a file is
+ * transferred if it is missing on the destination, the sizes differ, or the
+ * source copy is newer. Nothing is ever deleted. Pulled files get the remote
+ * modification time, so the next push does not send them back.
+ *
+ * The remote tree is walked with [SyncOptions.listingConcurrency] listings in
+ * flight; a push skips directories [manifest] already knows to be unchanged. Missing
+ * directories are created first, then files are transferred by a pool of
+ * [SyncOptions.concurrency] workers. A failed file does not stop the others; it
+ * is reported in [SyncReport.failed] and [onAction].
+ *
+ * @param local Local side of the sync
+ * @param remoteRoot Remote directory; created by a push if missing
+ * @param options Direction, dry run and tuning
+ * @param manifest Remote state saved by the previous sync of the same roots, if any
+ * @param onAction Called after each step runs (not for dry runs), one at a time
+ * @return Result containing the report and the manifest to save for next time
+ */
+public suspend fun FilebrowserClient.sync(
+    local: LocalTree,
+    remoteRoot: String,
+    options: SyncOptions = SyncOptions(),
+    manifest: SyncManifest? = null,
+    onAction: (SyncAction) -> Unit = {},
+): Result<SyncReport> =
+    runCatching {
+        require(options.concurrency > 0) { "concurrency must be positive" }
+        val root = remoteRoot.trimEnd('/').ifEmpty { "/" }
+        // A matching stamp says nothing about deeper levels, so only a push trusts it.
+        val trusted = options.direction == SyncDirection.PUSH && !options.rescan
+        val known = manifest?.takeIf { it.remoteRoot == root && trusted } ?: SyncManifest(root)
+        val remote = scanRemote(root, options, known)
+        val localEntries = local.scan().associateBy { it.path }
+
+        val plan = planSync(options.direction, localEntries, remote)
+        val sourceFiles =
+            when (options.direction) {
+                SyncDirection.PUSH -> localEntries.values.count { !it.isDir }
+                SyncDirection.PULL -> remote.files.size
+            }
+        val unchanged = sourceFiles - plan.count { it.kind != SyncActionKind.MKDIR }
+        if (options.dryRun) {
+            return@runCatching SyncReport(
+                options.direction,
+                dryRun = true,
+                actions = plan,
+                unchanged = unchanged,
+                listedDirectories = remote.listed,
+                cachedDirectories = remote.cached,
+                manifest = manifest ?: known,
+            )
+        }
+
+        val results = runPlan(local, root, options, remote, plan, onAction)
+        SyncReport(
+            options.direction,
+            dryRun = false,
+            actions = results,
+            unchanged = unchanged,
+            listedDirectories = remote.listed,
+            cachedDirectories = remote.cached,
+            manifest = updatedManifest(root, options.direction, remote, localEntries, results),
+        )
+    }
+
+/** The remote tree relative to the sync root, as listed or recalled from the manifest. */
+private class RemoteState(
+    val exists: Boolean,
+    val directories: MutableMap<String, String>,
+    val files: MutableMap<String, ManifestFile>,
+    val listed: Int,
+    val cached: Int,
+)
+
+private suspend fun FilebrowserClient.scanRemote(
+    root: String,
+    options: SyncOptions,
+    known: SyncManifest,
+): RemoteState {
+    val directories = mutableMapOf<String, String>()
+    val files = mutableMapOf<String, ManifestFile>()
+
+    // Directories whose stamp matches the manifest are emitted but not listed.
+    val unchanged = { entry: Resource -> known.directories[relativePath(root, entry.path)] == entry.modified }
+    val cachedRoots = mutableSetOf<String>()
+    var listed = 1
+    val walked =
+        runCatching {
+            walk(root, options.listingConcurrency, descend = { !unchanged(it) }).collect { entry ->
+                val path = relativePath(root, entry.path)
+                if (entry.isDir) {
+                    directories[path] = entry.modified
+                    if (unchanged(entry)) cachedRoots += path else listed++
+                } else {
+                    files[path] = ManifestFile(entry.size.toLong(), epochSeconds(entry.modified))
+                }
+            }
+        }
+    walked.exceptionOrNull()?.let { error ->
+        // A push creates a missing root; anything else, e.g. a subdirectory vanishing mid-walk, is fatal.
+        val rootMissing =
+            options.direction == SyncDirection.PUSH &&
+                error is FilebrowserException &&
+                error.statusCode == 404 &&
+                (getResource(root).exceptionOrNull() as? FilebrowserException)?.statusCode == 404
+        if (!rootMissing) throw error
+        return RemoteState(exists = false, mutableMapOf(), mutableMapOf(), listed = 0, cached = 0)
+    }
+
+    // Fill in the skipped subtrees from the manifest.
+    var cached = cachedRoots.size
+    if (cachedRoots.isNotEmpty()) {
+        for ((path, stamp) in known.directories) {
+            if (path !in directories && hasAncestorIn(path, cachedRoots)) {
+                directories[path] = stamp
+                cached++
+            }
+        }
+        for ((path, file) in known.files) {
+            if (hasAncestorIn(path, cachedRoots)) files[path] = file
+        }
+    }
+    return RemoteState(exists = true, directories, files, listed, cached)
+}
+
+/** Steps to sync [local] and [remote]: missing directories, parents first, then files. */
+private fun planSync(
+    direction: SyncDirection,
+    local: Map<String, LocalEntry>,
+    remote: RemoteState,
+): List<SyncAction> {
+    val directories = mutableListOf<SyncAction>()
+    val transfers = mutableListOf<SyncAction>()
+    when (direction) {
+        SyncDirection.PUSH -> {
+            if (!remote.exists) directories += SyncAction(SyncActionKind.MKDIR, "", reason = "new")
+            for (entry in local.values) {
+                if (entry.isDir) {
+                    if (entry.path !in remote.directories) {
+                        directories += SyncAction(SyncActionKind.MKDIR, entry.path, reason = "new")
+                    }
+                    continue
+                }
+                val target = remote.files[entry.path]
+                val reason =
+                    when {
+                        target == null -> "new"
+                        target.size != entry.size -> "size"
+                        entry.modified > target.modified -> "newer"
+                        else -> null
+                    }
+                if (reason != null) transfers += SyncAction(SyncActionKind.UPLOAD, entry.path, entry.size, reason)
+            }
+        }
+        SyncDirection.PULL -> {
+            for (path in remote.directories.keys) {
+                if (local[path]?.isDir != true) directories += SyncAction(SyncActionKind.MKDIR, path, reason = "new")
+            }
+            for ((path, file) in remote.files) {
+                val target = local[path]
+                val reason =
+                    when {
+                        target == null || target.isDir -> "new"
+                        target.size != file.size -> "size"
+                        file.modified > target.modified -> "newer"
+                        else -> null
+                    }
+                if (reason != null) transfers += SyncAction(SyncActionKind.DOWNLOAD, path, file.size, reason)
+            }
+        }
+    }
+    // A parent's path is a prefix of its children's, so it sorts first.
+    directories.sortBy { it.path }
+    transfers.sortBy { it.path }
+    return directories + transfers
+}
+
+private suspend fun FilebrowserClient.runPlan(
+    local: LocalTree,
+    root: String,
+    options: SyncOptions,
+    remote: RemoteState,
+    actions: List<SyncAction>,
+    onAction: (SyncAction) -> Unit,
+): List<SyncAction> {
+    val results = mutableListOf<SyncAction>()
+    val (directories, transfers) = actions.partition { it.kind == SyncActionKind.MKDIR }
+
+    // Directories run in order on this coroutine; a failure fails the files below it.
+    for (action in directories) {
+        val result =
+            runCatching {
+                when (options.direction) {
+                    SyncDirection.PUSH -> createDirectory(remotePath(root, action.path)).getOrThrow()
+                    SyncDirection.PULL -> local.createDirectory(action.path)
+                }
+            }
+        results += action.copy(error = result.exceptionOrNull()?.let { it.message ?: it.toString() })
+        onAction(results.last())
+    }
+
+    val queue = Channel<SyncAction>(Channel.UNLIMITED)
+    transfers.forEach { queue.trySend(it) }
+    queue.close()
+    val done = Channel<SyncAction>(Channel.UNLIMITED)
+    coroutineScope {
+        repeat(minOf(options.concurrency, transfers.size)) {
+            launch {
+                for (action in queue) {
+                    val result = transfer(local, root, options, remote, action)
+                    done.send(action.copy(error = result.exceptionOrNull()?.let { it.message ?: it.toString() }))
+                }
+            }
+        }
+        // Only this coroutine touches `results` and calls `onAction`.
+        repeat(transfers.size) {
+            results += done.receive()
+            onAction(results.last())
+        }
+    }
+    return results
+}
+
+private suspend fun FilebrowserClient.transfer(
+    local: LocalTree,
+    root: String,
+    options: SyncOptions,
+    remoteState: RemoteState,
+    action: SyncAction,
+): Result<Unit> {
+    val remote = remotePath(root, action.path)
+    return when (action.kind) {
+        SyncActionKind.UPLOAD ->
+            runCatching {
+                local.read(action.path) { source, size ->
+                    uploadResumable(remote, size, source, options.uploadOptions).getOrThrow()
+                }
+            }
+        SyncActionKind.DOWNLOAD ->
+            runCatching {
+                val modified = remoteState.files.getValue(action.path).modified
+                local.write(action.path, modified) { sink -> download(remote, sink = sink).getOrThrow() }
+            }
+        SyncActionKind.MKDIR -> Result.success(Unit)
+    }
+}
+
+/**
+ * Manifest describing the remote side after [results] ran.
+ *
+ * Directories we changed lose their stamp, so the next sync lists them again
+ * instead of trusting a listing that no longer matches.
+ */
+private fun updatedManifest(
+    root: String,
+    direction: SyncDirection,
+    remote: RemoteState,
+    local: Map<String, LocalEntry>,
+    results: List<SyncAction>,
+): SyncManifest {
+    val directories = remote.directories
+    val files = remote.files
+    // A pull only changes the local side.
+    if (direction == SyncDirection.PUSH) {
+        for (action in results) {
+            directories.remove(parentPath(action.path))
+            when {
+                action.kind == SyncActionKind.MKDIR -> directories.remove(action.path)
+                action.kind == SyncActionKind.UPLOAD && action.error == null -> {
+                    // The server stamps the upload time, which is never older than the local file.
+                    val entry = local.getValue(action.path)
+                    files[action.path] = ManifestFile(entry.size, entry.modified)
+                }
+                action.kind == SyncActionKind.UPLOAD -> files.remove(action.path)
+            }
+        }
+    }
+    return SyncManifest(root, directories.toMap(), files.toMap())
+}
+
+/** [path] relative to [root], without a leading slash; empty for the root itself. */
+private fun relativePath(
+    root: String,
+    path: String,
+): String = path.removePrefix(root).trimStart('/')
+
+private fun remotePath(
+    root: String,
+    path: String,
+): String =
+    when {
+        path.isEmpty() -> root
+        root.endsWith("/") -> "$root$path"
+        else -> "$root/$path"
+    }
+
+private fun parentPath(path: String): String = path.substringBeforeLast('/', missingDelimiterValue = "")
+
+/** Whether any proper ancestor directory of [path] is in [roots]. */
+private fun hasAncestorIn(
+    path: String,
+    roots: Set<String>,
+): Boolean {
+    var parent = path
+    while (parent.contains('/')) {
+        parent = parentPath(parent)
+        if (parent in roots) return true
+    }
+    return false
+}
+
+/** Seconds since the epoch for a Filebrowser timestamp, or 0 if it can't be parsed. */
+@OptIn(ExperimentalTime::class)
+private fun epochSeconds(timestamp: String): Long =
+    runCatching { Instant.parse(timestamp).epochSeconds }.getOrDefault(0)
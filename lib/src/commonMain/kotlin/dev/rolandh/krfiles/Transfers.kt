@@ -0,0 +1,171 @@
+package dev.rolandh.krfiles
+
+import kotlinx.coroutines.channels.ReceiveChannel
+
+/**
+ * Listener notified as a streaming transfer makes progress.
+ *
+ * Called after every chunk, from whichever coroutine performs the transfer.
+ * Implementations should be cheap; throttle any UI updates on the caller side.
+ */
+public fun interface TransferProgress {
+    /**
+     * @param transferred Bytes transferred so far
+     * @param total Total size in bytes, or -1 if the server did not report it
+     */
+    public fun onProgress(
+        transferred: Long,
+        total: Long,
+    )
+}
+
+/**
+ * Random-access source of bytes for chunked uploads.
+ *
+ * Reads are positional so an interrupted upload can resume from whatever offset
+ * the server reports, without re-reading from the start.
+ */
+public fun interface ChunkSource {
+    /**
+     * Read [length] bytes starting at [position] into the start of [buffer].
+     *
+     * @return Number of bytes read; fewer than [length] only at end of source
+     */
+    public suspend fun read(
+        position: Long,
+        buffer: ByteArray,
+        length: Int,
+    ): Int
+}
+
+/** Expose an in-memory byte array as a [ChunkSource]. */
+public fun ByteArray.asChunkSource(): ChunkSource =
+    ChunkSource { position, buffer, length ->
+        if (position >= size) return@ChunkSource 0
+        val start = position.toInt()
+        val count = minOf(length, size - start)
+        copyInto(buffer, 0, start, start + count)
+        count
+    }
+
+/**
+ * [ChunkSource] over chunks arriving in order from a stream, such as JS
+ * `uploadStream` writes or a pipe read by the native exports.
+ *
+ * A resumed upload re-reads from the server's offset, which trails the reader
+ * by at most [window] bytes; that much is kept around after being read.
+ */
+internal class StreamChunkSource(
+    private val chunks: ReceiveChannel<ByteArray>,
+    private val window: Long,
+) : ChunkSource {
+    private val retained = ArrayDeque<ByteArray>()
+    private var retainedStart = 0L
+    private var end = 0L
+
+    override suspend fun read(
+        position: Long,
+        buffer: ByteArray,
+        length: Int,
+    ): Int {
+        check(position >= retainedStart) { "Cannot rewind the upload stream to byte $position" }
+        while (end < position + length) {
+            val next = chunks.receiveCatching()
+            next.exceptionOrNull()?.let { throw it }
+            val chunk = next.getOrNull() ?: break
+            retained.addLast(chunk)
+            end += chunk.size
+        }
+        while (retained.isNotEmpty() && retainedStart + retained.first().size <= position - window) {
+            retainedStart += retained.removeFirst().size
+        }
+
+        var filled = 0
+        var chunkStart = retainedStart
+        for (chunk in retained) {
+            if (filled == length) break
+            val chunkEnd = chunkStart + chunk.size
+            if (chunkEnd > position + filled) {
+                val from = (position + filled - chunkStart).toInt()
+                val count = minOf(chunk.size - from, length - filled)
+                chunk.copyInto(buffer, filled, from, from + count)
+                filled += count
+            }
+            chunkStart = chunkEnd
+        }
+        return filled
+    }
+}
+
+/**
+ * Random-access destination of bytes for ranged downloads.
+ *
+ * Writes are positional so several segments of one file can be written at once,
+ * each to its own region. Writes to different regions may run concurrently.
+ */
+public fun interface ChunkSink {
+    /** Write the first [length] bytes of [buffer] at [position]. */
+    public suspend fun write(
+        position: Long,
+        buffer: ByteArray,
+        length: Int,
+    )
+
+    /**
+     * Called once with the full size of the file, before any write, when the
+     * server reports it. File-backed sinks can preallocate or truncate here.
+     */
+    public suspend fun allocate(size: Long) {}
+}
+
+/**
+ * Tuning for [FilebrowserClient.downloadRanged].
+ *
+ * @property offset Bytes already present at the start of the destination; the
+ *   download resumes from here when the server honours `Range`
+ * @property segments Parallel range requests for the rest of the file
+ * @property minSegmentSize Smallest part worth its own request; smaller files use fewer segments
+ * @property chunkSize Size of each segment's read buffer in bytes
+ * @property verify Hash the file while it arrives and fail unless it matches the
+ *   server's SHA-256. The file is then fetched as one stream from offset 0.
+ * @property priority Class the scheduler queues the range requests in
+ * @property maxBytesPerSecond Bandwidth of this download, all segments together;
+ *   0 for [SchedulerOptions.maxTransferBytesPerSecond]
+ */
+public data class DownloadOptions(
+    val offset: Long = 0,
+    val segments: Int = 1,
+    val minSegmentSize: Long = FilebrowserClient.DEFAULT_MIN_SEGMENT_SIZE,
+    val chunkSize: Int = FilebrowserClient.DEFAULT_CHUNK_SIZE,
+    val verify: Boolean = false,
+    val priority: TransferPriority = TransferPriority.BULK,
+    val maxBytesPerSecond: Long = 0,
+)
+
+/**
+ * Tuning for [FilebrowserClient.uploadResumable].
+ *
+ * Memory use is bounded by `chunkSize * (readAhead + 2)`: the chunk being
+ * sent, [readAhead] chunks queued behind it, and one more being read from the
+ * source while the queue is full.
+ *
+ * @property chunkSize Bytes sent per PATCH request
+ * @property readAhead Chunks queued between the source and the one being sent
+ * @property maxRetries Consecutive failures tolerated before giving up
+ * @property retryDelayMillis Base delay before resuming; grows linearly per failure
+ * @property override Whether to replace an existing remote file
+ * @property skipIdentical Send nothing if the remote file already has the same
+ *   size and SHA-256; see [matchesRemote]
+ * @property priority Class the scheduler queues the chunk requests in
+ * @property maxBytesPerSecond Bandwidth of this upload; 0 for [SchedulerOptions.maxTransferBytesPerSecond]
+ */
+public data class UploadOptions(
+    val chunkSize: Int = FilebrowserClient.DEFAULT_UPLOAD_CHUNK_SIZE,
+    val readAhead: Int = 2,
+    val maxRetries: Int = 5,
+    val retryDelayMillis: Long = 1000,
+    val override: Boolean = true,
+    val skipIdentical: Boolean = false,
+    val priority: TransferPriority = TransferPriority.BULK,
+    val maxBytesPerSecond: Long = 0,
+)
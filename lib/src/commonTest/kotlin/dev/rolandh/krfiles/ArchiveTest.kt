@@ -0,0 +1,181 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.engine.mock.MockEngine
+import io.ktor.client.engine.mock.respond
+import io.ktor.http.HttpStatusCode
+import kotlinx.coroutines.test.runTest
+import kotlin.test.Test
+import kotlin.test.assertContentEquals
+import kotlin.test.assertEquals
+import kotlin.test.assertFailsWith
+import kotlin.test.assertTrue
+
+/**
+ * Tests for [FilebrowserClient.downloadArchive] and [FilebrowserClient.extractArchive].
+ */
+class ArchiveTest {
+    /** [LocalTree] held in memory; extraction only writes. */
+    private class MemoryTree : LocalTree {
+        val dirs = mutableListOf<String>()
+        val files = mutableMapOf<String, Pair<ByteArray, Long>>()
+
+        override fun scan(): List<LocalEntry> = emptyList()
+
+        override suspend fun <T> read(
+            path: String,
+            block: suspend (source: ChunkSource, size: Long) -> T,
+        ): T = error("not readable")
+
+        override suspend fun write(
+            path: String,
+            modified: Long,
+            block: suspend (sink: suspend (buffer: ByteArray, length: Int) -> Unit) -> Unit,
+        ) {
+            var content = ByteArray(0)
+            block { buffer, length -> content += buffer.copyOf(length) }
+            files[path] = content to modified
+        }
+
+        override fun createDirectory(path: String) {
+            dirs += path
+        }
+    }
+
+    private class TarBuilder {
+        private var bytes = ByteArray(0)
+
+        fun entry(
+            name: String,
+            content: ByteArray = ByteArray(0),
+            type: Char = '0',
+            modified: Long = 1_700_000_000,
+        ): TarBuilder {
+            if (name.encodeToByteArray().size > 100) {
+                // GNU long name entry, followed by the entry with a truncated name
+                entry("././@LongLink", name.encodeToByteArray() + 0.toByte(), 'L')
+                return entry(name.takeLast(99), content, type, modified)
+            }
+            val header = ByteArray(512)
+
+            fun field(
+                offset: Int,
+                value: String,
+            ) = value.encodeToByteArray().copyInto(header, offset)
+            field(0, name)
+            field(100, "0000644")
+            field(124, content.size.toString(8).padStart(11, '0'))
+            field(136, modified.toString(8).padStart(11, '0'))
+            field(148, "        ")
+            header[156] = type.code.toByte()
+            field(257, "ustar")
+            field(263, "00")
+            val checksum = header.sumOf { it.toInt() and 0xff }
+            field(148, checksum.toString(8).padStart(6, '0') + "\u0000 ")
+            bytes += header + content + ByteArray((512 - content.size % 512) % 512)
+            return this
+        }
+
+        fun build(): ByteArray = bytes + ByteArray(1024)
+    }
+
+    private fun client(archive: ByteArray): Pair<FilebrowserClient, MutableList<String>> {
+        val requests = mutableListOf<String>()
+        val engine =
+            MockEngine { request ->
+                requests += "${request.url.encodedPath}?${request.url.encodedQuery}"
+                if (request.url.encodedPath.endsWith("/missing")) {
+                    respond("not found", HttpStatusCode.NotFound)
+                } else {
+                    respond(archive, HttpStatusCode.OK)
+                }
+            }
+        val client = FilebrowserClient("http://mock", HttpClient(engine)).also { it.setToken("test-token") }
+        return client to requests
+    }
+
+    private val big = ByteArray(300_000) { (it % 251).toByte() }
+
+    private val archive =
+        TarBuilder()
+            .entry("photos/", type = '5')
+            .entry("photos/a.txt", "hello".encodeToByteArray(), modified = 1_600_000_000)
+            .entry("photos/2024/big.bin", big)
+            .entry("photos/link", type = '2')
+            .entry("photos/logs/debug.log", "x".encodeToByteArray())
+            .entry("photos/deep/" + "n".repeat(120) + ".txt", "long".encodeToByteArray())
+            .build()
+
+    @Test
+    fun testExtractsEntriesRelativeToDirectory() =
+        runTest {
+            val (client, requests) = client(archive)
+            val tree = MemoryTree()
+
+            val report = client.extractArchive("/photos", tree).getOrThrow()
+
+            assertEquals(listOf("/api/raw/photos?algo=tar"), requests)
+            assertEquals("hello", tree.files.getValue("a.txt").first.decodeToString())
+            assertEquals(1_600_000_000L, tree.files.getValue("a.txt").second)
+            assertContentEquals(big, tree.files.getValue("2024/big.bin").first)
+            assertEquals("long", tree.files.getValue("deep/" + "n".repeat(120) + ".txt").first.decodeToString())
+            assertEquals(listOf("2024", "logs", "deep"), tree.dirs)
+            assertEquals(ExtractReport(files = 4, directories = 3, bytes = 300_010, skipped = 1), report)
+            client.close()
+        }
+
+    @Test
+    fun testFilterSelectsEntries() =
+        runTest {
+            val (client, _) = client(archive)
+            val tree = MemoryTree()
+
+            val filter = ArchiveFilter(include = listOf("*.txt", "2024"), exclude = listOf("deep"))
+            val report = client.extractArchive("/photos", tree, filter).getOrThrow()
+
+            assertEquals(setOf("a.txt", "2024/big.bin"), tree.files.keys)
+            assertEquals(3, report.skipped)
+            client.close()
+        }
+
+    @Test
+    fun testRejectsPathsOutsideTarget() =
+        runTest {
+            val (client, _) = client(TarBuilder().entry("../evil.txt", "x".encodeToByteArray()).build())
+            val tree = MemoryTree()
+
+            assertFailsWith<IllegalStateException> { client.extractArchive("/photos", tree).getOrThrow() }
+            assertTrue(tree.files.isEmpty())
+            client.close()
+        }
+
+    @Test
+    fun testRejectsNonTarBody() =
+        runTest {
+            val (client, _) = client(ByteArray(2048) { 'z'.code.toByte() })
+
+            val error = client.extractArchive("/photos", MemoryTree()).exceptionOrNull()
+
+            assertEquals("Corrupt tar header", error?.message)
+            client.close()
+        }
+
+    @Test
+    fun testDownloadArchiveStreamsBody() =
+        runTest {
+            val (client, requests) = client(archive)
+            var received = ByteArray(0)
+
+            val size =
+                client
+                    .downloadArchive("/photos", ArchiveFormat.ZIP, chunkSize = 4096) { buffer, length ->
+                        received += buffer.copyOf(length)
+                    }.getOrThrow()
+
+            assertEquals(archive.size.toLong(), size)
+            assertContentEquals(archive, received)
+            assertEquals(listOf("/api/raw/photos?algo=zip"), requests)
+            assertTrue(client.downloadArchive("/missing") { _, _ -> }.isFailure)
+            client.close()
+        }
+}
@@ -0,0 +1,143 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.engine.mock.MockEngine
+import io.ktor.client.engine.mock.respond
+import io.ktor.http.HttpStatusCode
+import io.ktor.http.decodeURLPart
+import kotlinx.coroutines.sync.Mutex
+import kotlinx.coroutines.sync.withLock
+import kotlinx.coroutines.test.runTest
+import kotlinx.coroutines.yield
+import kotlinx.serialization.decodeFromString
+import kotlinx.serialization.json.Json
+import kotlin.test.Test
+import kotlin.test.assertEquals
+import kotlin.test.assertTrue
+
+/**
+ * Tests for [FilebrowserClient.batch].
+ */
+class BatchTest {
+    /** Server stand-in that records requests and fails paths containing "missing". */
+    private class Server {
+        private val lock = Mutex()
+        val requests = mutableListOf<String>()
+        var inFlight = 0
+        var maxInFlight = 0
+
+        private val engine =
+            MockEngine { request ->
+                val path = request.url.encodedPath.removePrefix("/api/resources").decodeURLPart()
+                val action = request.url.parameters["action"]?.let { " $it ${request.url.parameters["destination"]}" }
+                lock.withLock {
+                    requests += "${request.method.value} $path${action.orEmpty()}"
+                    inFlight++
+                    maxInFlight = maxOf(maxInFlight, inFlight)
+                }
+                // Let the other workers' requests arrive while this one is in flight.
+                yield()
+                lock.withLock { inFlight-- }
+                if ("missing" in path) {
+                    respond("not found", HttpStatusCode.NotFound)
+                } else {
+                    respond("", HttpStatusCode.OK)
+                }
+            }
+
+        fun client(): FilebrowserClient =
+            FilebrowserClient("http://mock", HttpClient(engine)).also { it.setToken("test-token") }
+    }
+
+    @Test
+    fun testRunsEveryOperationKind() =
+        runTest {
+            val server = Server()
+            val client = server.client()
+            val operations =
+                listOf(
+                    BatchOperation(BatchOpKind.MKDIR, "/new"),
+                    BatchOperation(BatchOpKind.RENAME, "/a", "/b"),
+                    BatchOperation(BatchOpKind.COPY, "/b", "/c", override = true),
+                    BatchOperation(BatchOpKind.DELETE, "/old"),
+                )
+
+            val report = client.batch(operations, BatchOptions(concurrency = 1)).getOrThrow()
+
+            assertEquals(4, report.succeeded)
+            assertEquals(listOf(0, 1, 2, 3), report.results.map { it.index })
+            assertEquals(
+                listOf("POST /new/", "PATCH /a rename /b", "PATCH /b copy /c", "DELETE /old"),
+                server.requests,
+            )
+            client.close()
+        }
+
+    @Test
+    fun testFailuresAreReportedPerOperation() =
+        runTest {
+            val server = Server()
+            val client = server.client()
+            val reported = mutableListOf<BatchResult>()
+            val operations =
+                listOf(
+                    BatchOperation(BatchOpKind.DELETE, "/missing"),
+                    BatchOperation(BatchOpKind.RENAME, "/no-destination"),
+                    BatchOperation(BatchOpKind.DELETE, "/ok"),
+                )
+
+            val report = client.batch(operations) { reported += it }.getOrThrow()
+
+            assertEquals(1, report.succeeded)
+            assertEquals(listOf(0, 1), report.failed.map { it.index })
+            assertEquals(404, report.results[0].status)
+            assertEquals("rename needs a destination", report.results[1].error)
+            assertEquals(3, reported.size)
+            client.close()
+        }
+
+    @Test
+    fun testStopOnErrorSkipsRemainingOperations() =
+        runTest {
+            val server = Server()
+            val client = server.client()
+            val operations =
+                listOf(
+                    BatchOperation(BatchOpKind.DELETE, "/one"),
+                    BatchOperation(BatchOpKind.DELETE, "/missing"),
+                    BatchOperation(BatchOpKind.DELETE, "/three"),
+                )
+
+            val report = client.batch(operations, BatchOptions(concurrency = 1, stopOnError = true)).getOrThrow()
+
+            assertEquals(listOf(true, false, false), report.results.map { it.ok })
+            assertTrue(report.results[2].skipped)
+            assertEquals(listOf(1), report.failed.map { it.index })
+            assertEquals(2, server.requests.size)
+            client.close()
+        }
+
+    @Test
+    fun testConcurrencyIsBounded() =
+        runTest {
+            val server = Server()
+            val client = server.client()
+            val operations = List(10) { BatchOperation(BatchOpKind.DELETE, "/file$it") }
+
+            val report = client.batch(operations, BatchOptions(concurrency = 3)).getOrThrow()
+
+            assertEquals(10, report.succeeded)
+            assertEquals(10, server.requests.size)
+            assertTrue(server.maxInFlight in 1..3)
+            client.close()
+        }
+
+    @Test
+    fun testOperationsDecodeFromJson() {
+        val json = Json { ignoreUnknownKeys = true }
+        val operation =
+            json.decodeFromString<BatchOperation>("""{"op":"copy","path":"/a","destination":"/b","override":true}""")
+
+        assertEquals(BatchOperation(BatchOpKind.COPY, "/a", "/b", override = true), operation)
+    }
+}
@@ -0,0 +1,170 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.engine.mock.MockEngine
+import io.ktor.client.engine.mock.respond
+import io.ktor.http.ContentType
+import io.ktor.http.HttpHeaders
+import io.ktor.http.HttpStatusCode
+import io.ktor.http.headersOf
+import kotlinx.coroutines.test.runTest
+import kotlin.test.Test
+import kotlin.test.assertContentEquals
+import kotlin.test.assertEquals
+import kotlin.test.assertFalse
+import kotlin.test.assertIs
+import kotlin.test.assertTrue
+
+/**
+ * Tests for the SHA-256 digest, verified downloads and identical-upload skipping.
+ */
+class ChecksumTest {
+    private val content = ByteArray(1000) { (it % 251).toByte() }
+
+    private fun hashOf(bytes: ByteArray): String = sha256().apply { update(bytes, 0, bytes.size) }.hex()
+
+    /** Serves [content] from `/api/raw` and [checksum] from `/api/resources`; counts tus requests. */
+    private inner class Server(
+        private val checksum: String = hashOf(content),
+        private val exists: Boolean = true,
+    ) {
+        val requests = mutableListOf<String>()
+
+        private val engine =
+            MockEngine { request ->
+                val path = request.url.encodedPath
+                requests += "${request.method.value} $path"
+                val json = headersOf(HttpHeaders.ContentType, ContentType.Application.Json.toString())
+                when {
+                    path.startsWith("/api/raw") -> respond(content, HttpStatusCode.OK)
+                    !exists -> respond("not found", HttpStatusCode.NotFound)
+                    path.startsWith("/api/resources") && request.url.parameters["checksum"] == "sha256" -> {
+                        val body = """{"name":"file.bin","size":1000,"checksums":{"sha256":"$checksum"}}"""
+                        respond(body, headers = json)
+                    }
+                    path.startsWith("/api/resources") -> respond("""{"name":"file.bin","size":1000}""", headers = json)
+                    else -> respond("", HttpStatusCode.NoContent, headersOf("Upload-Offset", "1000"))
+                }
+            }
+
+        fun client(): FilebrowserClient =
+            FilebrowserClient("http://mock", HttpClient(engine)).also { it.setToken("test-token") }
+    }
+
+    private class MemorySink : ChunkSink {
+        var bytes = ByteArray(0)
+
+        override suspend fun write(
+            position: Long,
+            buffer: ByteArray,
+            length: Int,
+        ) {
+            if (position + length > bytes.size) bytes = bytes.copyOf((position + length).toInt())
+            buffer.copyInto(bytes, position.toInt(), 0, length)
+        }
+    }
+
+    @Test
+    fun testSha256KnownVectors() {
+        assertEquals("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", hashOf(ByteArray(0)))
+        assertEquals(
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+            hashOf("abc".encodeToByteArray()),
+        )
+        assertEquals(
+            "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+            hashOf("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq".encodeToByteArray()),
+        )
+    }
+
+    @Test
+    fun testChunkedUpdatesMatchOneShot() {
+        val expected = hashOf(content)
+        for (step in listOf(1, 7, 55, 56, 63, 64, 65, 999)) {
+            val digest = Sha256()
+            content.toList().chunked(step).forEach { digest.update(it.toByteArray(), 0, it.size) }
+            assertEquals(expected, digest.hex(), "step $step")
+        }
+    }
+
+    @Test
+    fun testPlatformDigestMatchesPortableOne() {
+        assertEquals(Sha256().apply { update(content, 0, content.size) }.hex(), hashOf(content))
+    }
+
+    @Test
+    fun testVerifiedDownloadSucceeds() =
+        runTest {
+            val server = Server()
+            val client = server.client()
+            val sink = MemorySink()
+            val options = DownloadOptions(segments = 4, minSegmentSize = 100, verify = true)
+
+            client.downloadRanged("/file.bin", sink, options).getOrThrow()
+
+            assertContentEquals(content, sink.bytes)
+            // One stream, so the hash sees the bytes in order.
+            assertEquals(1, server.requests.count { it.startsWith("GET /api/raw") })
+            client.close()
+        }
+
+    @Test
+    fun testVerifiedDownloadFailsOnMismatch() =
+        runTest {
+            val client = Server(checksum = "0".repeat(64)).client()
+
+            val result = client.downloadRanged("/file.bin", MemorySink(), DownloadOptions(verify = true))
+
+            val mismatch = assertIs<ChecksumMismatchException>(result.exceptionOrNull())
+            assertEquals(hashOf(content), mismatch.actual)
+            client.close()
+        }
+
+    @Test
+    fun testSkipIdenticalSendsNothing() =
+        runTest {
+            val server = Server()
+            val client = server.client()
+            val options = UploadOptions(skipIdentical = true)
+
+            client.uploadResumable("/file.bin", 1000, content.asChunkSource(), options).getOrThrow()
+
+            assertTrue(server.requests.none { it.contains("/api/tus") })
+            client.close()
+        }
+
+    @Test
+    fun testSkipIdenticalUploadsChangedFile() =
+        runTest {
+            val server = Server(checksum = "0".repeat(64))
+            val client = server.client()
+
+            assertFalse(client.matchesRemote("/file.bin", 1000, content.asChunkSource()).getOrThrow())
+            client
+                .uploadResumable("/file.bin", 1000, content.asChunkSource(), UploadOptions(skipIdentical = true))
+                .getOrThrow()
+
+            assertTrue(server.requests.contains("PATCH /api/tus/file.bin"))
+            client.close()
+        }
+
+    @Test
+    fun testMissingRemoteFileDoesNotMatch() =
+        runTest {
+            val client = Server(exists = false).client()
+
+            assertFalse(client.matchesRemote("/file.bin", 1000, content.asChunkSource()).getOrThrow())
+            client.close()
+        }
+
+    @Test
+    fun testSizeMismatchSkipsHashing() =
+        runTest {
+            val server = Server()
+            val client = server.client()
+
+            assertFalse(client.matchesRemote("/file.bin", 999, content.asChunkSource()).getOrThrow())
+            assertEquals(listOf("GET /api/resources/file.bin"), server.requests)
+            client.close()
+        }
+}
@@ -0,0 +1,66 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.engine.mock.MockEngine
+import io.ktor.client.engine.mock.respond
+import io.ktor.client.plugins.HttpRequestTimeoutException
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.delay
+import kotlinx.coroutines.test.runTest
+import kotlinx.coroutines.withContext
+import kotlinx.serialization.decodeFromString
+import kotlinx.serialization.json.Json
+import kotlin.test.Test
+import kotlin.test.assertEquals
+import kotlin.test.assertFailsWith
+import kotlin.test.assertIs
+import kotlin.test.assertNull
+
+/**
+ * Tests for [ClientConfig] and the timeouts it installs.
+ */
+class ClientConfigTest {
+    @Test
+    fun testDefaultsOnlySetConnectTimeout() {
+        val config = ClientConfig()
+
+        assertEquals(ClientConfig.DEFAULT_CONNECT_TIMEOUT_MILLIS, config.connectTimeoutMillis)
+        assertNull(config.requestTimeoutMillis)
+        assertNull(config.socketTimeoutMillis)
+        assertNull(config.maxConnectionsPerHost)
+    }
+
+    @Test
+    fun testRejectsNonPositiveValues() {
+        assertFailsWith<IllegalArgumentException> { ClientConfig(requestTimeoutMillis = 0) }
+        assertFailsWith<IllegalArgumentException> { ClientConfig(maxConnectionsPerHost = -1) }
+    }
+
+    @Test
+    fun testDecodesPartialJson() {
+        val json = Json { ignoreUnknownKeys = true }
+
+        val config = json.decodeFromString<ClientConfig>("""{"requestTimeoutMillis": 5000, "cacheEntries": 10}""")
+
+        assertEquals(ClientConfig(requestTimeoutMillis = 5000), config)
+        assertNull(json.decodeFromString<ClientConfig>("""{"connectTimeoutMillis": null}""").connectTimeoutMillis)
+    }
+
+    @Test
+    fun testRequestTimeoutFailsHungRequest() =
+        runTest {
+            val engine =
+                MockEngine {
+                    delay(10_000)
+                    respond("{}")
+                }
+            val httpClient = HttpClient(engine) { installTimeouts(ClientConfig(requestTimeoutMillis = 100)) }
+            val client = FilebrowserClient("http://mock", httpClient).also { it.setToken("test-token") }
+
+            // Real time: the timeout runs on the engine's dispatcher, not the test scheduler.
+            val result = withContext(Dispatchers.Default) { client.getResource("/slow") }
+
+            assertIs<HttpRequestTimeoutException>(result.exceptionOrNull())
+            client.close()
+        }
+}
@@ -0,0 +1,83 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.engine.mock.MockEngine
+import io.ktor.client.engine.mock.respond
+import io.ktor.http.HttpHeaders
+import kotlinx.coroutines.test.runTest
+import kotlin.test.Test
+import kotlin.test.assertEquals
+import kotlin.test.assertFailsWith
+import kotlin.test.assertFalse
+import kotlin.test.assertNull
+import kotlin.test.assertTrue
+
+/**
+ * Tests for the gzip header parser and the `Accept-Encoding` of downloads.
+ */
+class CompressionTest {
+    private fun bytes(vararg values: Int) = ByteArray(values.size) { values[it].toByte() }
+
+    private val fixed = bytes(0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3)
+
+    @Test
+    fun testSkipsPlainHeader() {
+        val header = GzipHeader()
+        val data = fixed + bytes(0xAA, 0xBB)
+
+        assertEquals(10, header.consume(data, 0, data.size))
+        assertTrue(header.complete)
+    }
+
+    @Test
+    fun testSkipsOptionalFieldsAcrossChunks() {
+        // FEXTRA | FNAME | FCOMMENT | FHCRC
+        val flagged = fixed.copyOf().also { it[3] = (4 or 8 or 16 or 2).toByte() }
+        val data =
+            flagged + bytes(3, 0, 1, 2, 3) + "name.json".encodeToByteArray() + bytes(0) +
+                "comment".encodeToByteArray() + bytes(0) + bytes(0x12, 0x34) + bytes(0xAA)
+        val header = GzipHeader()
+
+        // One byte at a time, as a slow network might deliver it.
+        var offset = 0
+        while (!header.complete) offset = header.consume(data, offset, offset + 1)
+
+        assertEquals(data.size - 1, offset)
+    }
+
+    @Test
+    fun testRejectsNonGzipData() {
+        val data = "{\"items\":[]}".encodeToByteArray()
+
+        assertFailsWith<IllegalStateException> { GzipHeader().consume(data, 0, data.size) }
+    }
+
+    @Test
+    fun testRatio() {
+        assertEquals(0.0, CompressionStats().ratio)
+        assertEquals(4.0, CompressionStats(responses = 1, compressedBytes = 250, decompressedBytes = 1000).ratio)
+    }
+
+    @Test
+    fun testDownloadsAskForIdentityUnlessTransfersCompressed() =
+        runTest {
+            val acceptEncodings = mutableListOf<String?>()
+            val engine =
+                MockEngine { request ->
+                    acceptEncodings += request.headers[HttpHeaders.AcceptEncoding]
+                    respond("content")
+                }
+
+            for (compressTransfers in listOf(false, true)) {
+                val config = ClientConfig(compressTransfers = compressTransfers)
+                val client = FilebrowserClient("http://mock", HttpClient(engine), config = config)
+                client.setToken("test-token")
+                client.download("/file.txt").getOrThrow()
+                client.close()
+            }
+
+            assertEquals("identity", acceptEncodings[0])
+            assertNull(acceptEncodings[1])
+            assertFalse(ClientConfig().compressTransfers)
+        }
+}
@@ -213,6 +213,40 @@ class FilebrowserClientTest {
             client.close()
         }
 
+    @Test
+    fun testGetResourceJsonPassesBodyThrough() =
+        runTest {
+            val body = """{"name":"docs","isDir":true,"path":"/docs","custom":{"kept":true}}"""
+            val client =
+                authenticatedClient { url, _, headers, _ ->
+                    assertEquals("/api/resources/docs", url)
+                    assertEquals("test-token", headers["X-Auth"])
+                    Pair(body, HttpStatusCode.OK)
+                }
+
+            client.login("admin", "password")
+
+            assertEquals(body, client.getResourceJson("/docs").getOrThrow())
+            assertEquals(body, client.listDirectoryJson("/docs").getOrThrow())
+            client.close()
+        }
+
+    @Test
+    fun testGetResourceJsonNotFound() =
+        runTest {
+            val client =
+                authenticatedClient { _, _, _, _ ->
+                    Pair("Not Found", HttpStatusCode.NotFound)
+                }
+
+            client.login("admin", "password")
+            val exception = client.getResourceJson("/nonexistent").exceptionOrNull()
+
+            assertTrue(exception is FilebrowserException)
+            assertEquals(404, exception.statusCode)
+            client.close()
+        }
+
     // --- Download Tests ---
 
     @Test
@@ -247,6 +281,52 @@ class FilebrowserClientTest {
             client.close()
         }
 
+    @Test
+    fun testDownloadStreamsInChunks() =
+        runTest {
+            val content = "0123456789".repeat(1000)
+            val client =
+                authenticatedClient { url, _, _, _ ->
+                    assertTrue(url.contains("/api/raw/"))
+                    Pair(content, HttpStatusCode.OK)
+                }
+
+            client.login("admin", "password")
+            val received = StringBuilder()
+            var largestChunk = 0
+            var lastProgress = 0L
+            val progress = TransferProgress { done, _ -> lastProgress = done }
+            val result =
+                client.download("/big.bin", chunkSize = 1024, progress = progress) { buffer, length ->
+                    largestChunk = maxOf(largestChunk, length)
+                    received.append(buffer.decodeToString(0, length))
+                }
+
+            assertTrue(result.isSuccess)
+            assertEquals(content.length.toLong(), result.getOrThrow())
+            assertEquals(content, received.toString())
+            assertTrue(largestChunk <= 1024)
+            assertEquals(content.length.toLong(), lastProgress)
+            client.close()
+        }
+
+    @Test
+    fun testStreamingDownloadNotFound() =
+        runTest {
+            val client =
+                authenticatedClient { _, _, _, _ ->
+                    Pair("Not Found", HttpStatusCode.NotFound)
+                }
+
+            client.login("admin", "password")
+            var chunks = 0
+            val result = client.download("/missing.bin") { _, _ -> chunks++ }
+
+            assertTrue(result.isFailure)
+            assertEquals(0, chunks)
+            client.close()
+        }
+
     // --- Upload Tests ---
 
     @Test
@@ -383,6 +463,23 @@ class FilebrowserClientTest {
             client.close()
         }
 
+    @Test
+    fun testSearchJsonPassesBodyThrough() =
+        runTest {
+            val body = """[{"path":"/docs/test-file.txt","dir":false}]"""
+            val client =
+                authenticatedClient { url, _, _, params ->
+                    assertEquals("/api/search/docs", url)
+                    assertEquals("test-query", params["query"])
+                    Pair(body, HttpStatusCode.OK)
+                }
+
+            client.login("admin", "password")
+
+            assertEquals(body, client.searchJson("test-query", "/docs").getOrThrow())
+            client.close()
+        }
+
     // --- Completions Tests ---
 
     @Test
@@ -0,0 +1,120 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.engine.mock.MockEngine
+import io.ktor.client.engine.mock.respond
+import io.ktor.http.ContentType
+import io.ktor.http.HttpHeaders
+import io.ktor.http.HttpStatusCode
+import io.ktor.http.headersOf
+import kotlinx.coroutines.flow.first
+import kotlinx.coroutines.flow.toList
+import kotlinx.coroutines.test.runTest
+import kotlin.test.Test
+import kotlin.test.assertEquals
+import kotlin.test.assertFailsWith
+import kotlin.test.assertFalse
+import kotlin.test.assertTrue
+
+/**
+ * Tests for [FilebrowserClient.listDirectoryStream] and the [JsonArrayScanner] behind it.
+ */
+class ListDirectoryStreamTest {
+    private val listing =
+        """
+        {"name":"docs","path":"/docs","isDir":true,"sorting":{"by":"name","asc":true},
+         "items":[
+           {"name":"a \"quoted\" [x]","path":"/docs/a","size":1,"isDir":false},
+           {"name":"sub","path":"/docs/sub","isDir":true,"items":[{"name":"nested"}]},
+           {"name":"é.txt","path":"/docs/é.txt","size":3}
+         ],
+         "numDirs":1,"numFiles":2}
+        """.trimIndent()
+
+    private fun scan(
+        document: String,
+        chunk: Int,
+    ): Pair<List<String>, Boolean> {
+        val scanner = JsonArrayScanner("items")
+        val bytes = document.encodeToByteArray()
+        val elements = mutableListOf<String>()
+        for (start in bytes.indices step chunk) {
+            val piece = bytes.copyOfRange(start, minOf(start + chunk, bytes.size))
+            scanner.feed(piece, piece.size) { elements += it }
+        }
+        return elements to scanner.found
+    }
+
+    @Test
+    fun testScannerYieldsTopLevelElementsAtAnyChunkSize() {
+        val (whole, found) = scan(listing, listing.length * 4)
+        assertTrue(found)
+        assertEquals(3, whole.size)
+        assertTrue(whole[0].startsWith("""{"name":"a \"quoted\" [x]""""))
+        assertTrue(whole[1].endsWith("""[{"name":"nested"}]}"""))
+        for (chunk in listOf(1, 2, 7, 64)) {
+            assertEquals(whole, scan(listing, chunk).first, "chunk size $chunk")
+        }
+    }
+
+    @Test
+    fun testScannerIgnoresKeyOutsideTopLevel() {
+        val (elements, found) = scan("""{"name":"f","meta":{"items":[{"a":1}]},"note":"items"}""", 5)
+        assertFalse(found)
+        assertTrue(elements.isEmpty())
+    }
+
+    private fun client(body: String): FilebrowserClient {
+        val jsonHeaders = headersOf(HttpHeaders.ContentType, ContentType.Application.Json.toString())
+        val engine =
+            MockEngine { request ->
+                if (request.url.encodedPath.endsWith("/missing")) {
+                    respond("not found", HttpStatusCode.NotFound)
+                } else {
+                    respond(body, HttpStatusCode.OK, jsonHeaders)
+                }
+            }
+        return FilebrowserClient("http://mock", HttpClient(engine)).also { it.setToken("test-token") }
+    }
+
+    @Test
+    fun testStreamsEntries() =
+        runTest {
+            val client = client(listing)
+
+            val entries = client.listDirectoryStream("/docs").toList()
+
+            assertEquals(listOf("/docs/a", "/docs/sub", "/docs/é.txt"), entries.map { it.path })
+            assertEquals(listOf(false, true, false), entries.map { it.isDir })
+            assertEquals("""a "quoted" [x]""", entries.first().name)
+            client.close()
+        }
+
+    @Test
+    fun testEmptyDirectory() =
+        runTest {
+            val client = client("""{"name":"empty","path":"/empty","isDir":true,"items":[]}""")
+
+            assertTrue(client.listDirectoryStream("/empty").toList().isEmpty())
+            client.close()
+        }
+
+    @Test
+    fun testFileIsNotADirectory() =
+        runTest {
+            val client = client("""{"name":"f.txt","path":"/f.txt","size":3}""")
+
+            assertFailsWith<IllegalStateException> { client.listDirectoryStream("/f.txt").toList() }
+            client.close()
+        }
+
+    @Test
+    fun testServerErrorFails() =
+        runTest {
+            val client = client(listing)
+
+            val error = assertFailsWith<FilebrowserException> { client.listDirectoryStream("/missing").first() }
+            assertEquals(404, error.statusCode)
+            client.close()
+        }
+}
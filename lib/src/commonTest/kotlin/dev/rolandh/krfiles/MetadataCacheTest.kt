@@ -0,0 +1,259 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.engine.mock.MockEngine
+import io.ktor.client.engine.mock.respond
+import io.ktor.client.plugins.contentnegotiation.ContentNegotiation
+import io.ktor.http.ContentType
+import io.ktor.http.HttpHeaders
+import io.ktor.http.HttpMethod
+import io.ktor.http.HttpStatusCode
+import io.ktor.http.headersOf
+import io.ktor.serialization.kotlinx.json.json
+import kotlinx.coroutines.test.runTest
+import kotlinx.serialization.encodeToString
+import kotlinx.serialization.json.Json
+import kotlin.io.encoding.Base64
+import kotlin.test.Test
+import kotlin.test.assertEquals
+import kotlin.test.assertNull
+
+/**
+ * Tests for the metadata cache behind [FilebrowserClient.getResource].
+ */
+class MetadataCacheTest {
+    private val testJson =
+        Json {
+            ignoreUnknownKeys = true
+            encodeDefaults = true
+        }
+
+    /** Server stand-in that counts requests and answers resource lookups. */
+    private inner class Server(
+        private val etag: String? = null,
+    ) {
+        var now = 0L
+        val requests = mutableListOf<String>()
+        var conditional = 0
+
+        private val engine =
+            MockEngine { request ->
+                val path = request.url.encodedPath.removePrefix("/api/resources")
+                requests += "${request.method.value} $path"
+                val headers =
+                    buildList {
+                        add(HttpHeaders.ContentType to listOf(ContentType.Application.Json.toString()))
+                        etag?.let { add(HttpHeaders.ETag to listOf(it)) }
+                    }
+                when {
+                    request.method != HttpMethod.Get -> respond("", HttpStatusCode.OK)
+                    etag != null && request.headers[HttpHeaders.IfNoneMatch] == etag -> {
+                        conditional++
+                        respond("", HttpStatusCode.NotModified)
+                    }
+                    else -> {
+                        val body = testJson.encodeToString(Resource(path = path, name = path.substringAfterLast('/')))
+                        respond(body, HttpStatusCode.OK, headersOf(*headers.toTypedArray()))
+                    }
+                }
+            }
+
+        fun client(
+            options: CacheOptions = CacheOptions(),
+            token: String = "test-token",
+        ): FilebrowserClient {
+            val httpClient = HttpClient(engine) { install(ContentNegotiation) { json(testJson) } }
+            return FilebrowserClient("http://mock", httpClient, options.copy(clock = { now }))
+                .also { it.setToken(token) }
+        }
+    }
+
+    /** [MetadataStore] held in memory. */
+    private class MemoryStore : MetadataStore {
+        val saved = mutableMapOf<String, Map<String, CachedResource>>()
+
+        override fun load(
+            serverUrl: String,
+            user: String,
+        ): Map<String, CachedResource> = saved["$serverUrl $user"].orEmpty()
+
+        override fun save(
+            serverUrl: String,
+            user: String,
+            entries: Map<String, CachedResource>,
+        ) {
+            saved["$serverUrl $user"] = entries
+        }
+    }
+
+    /** A Filebrowser-style JWT for [username]; the signature is never checked client-side. */
+    private fun jwt(
+        username: String,
+        issuedAt: Long,
+    ): String {
+        val claims = """{"user":{"id":1,"username":"$username"},"iat":$issuedAt}"""
+        val encoded = Base64.UrlSafe.withPadding(Base64.PaddingOption.ABSENT).encode(claims.encodeToByteArray())
+        return "eyJhbGciOiJIUzI1NiJ9.$encoded.signature"
+    }
+
+    @Test
+    fun testFreshEntryIsServedWithoutRequest() =
+        runTest {
+            val server = Server()
+            val client = server.client(CacheOptions(ttlMillis = 1_000))
+
+            client.getResource("/docs").getOrThrow()
+            server.now = 999
+            val again = client.listDirectory("/docs/").getOrThrow()
+
+            assertEquals("/docs", again.path)
+            assertEquals(listOf("GET /docs"), server.requests)
+            assertEquals(CacheStats(hits = 1, misses = 1, size = 1), client.cacheStats)
+            client.close()
+        }
+
+    @Test
+    fun testJsonVariantUsesCache() =
+        runTest {
+            val server = Server()
+            val client = server.client(CacheOptions(ttlMillis = 1_000))
+
+            client.getResource("/docs").getOrThrow()
+            val json = client.getResourceJson("/docs").getOrThrow()
+
+            assertEquals("/docs", testJson.decodeFromString(Resource.serializer(), json).path)
+            assertEquals(listOf("GET /docs"), server.requests)
+            client.close()
+        }
+
+    @Test
+    fun testExpiredEntryIsRefetched() =
+        runTest {
+            val server = Server()
+            val client = server.client(CacheOptions(ttlMillis = 1_000))
+
+            client.getResource("/docs").getOrThrow()
+            server.now = 1_000
+            client.getResource("/docs").getOrThrow()
+
+            assertEquals(2, server.requests.size)
+            assertEquals(2, client.cacheStats?.misses)
+            client.close()
+        }
+
+    @Test
+    fun testExpiredEntryIsRevalidatedWithEtag() =
+        runTest {
+            val server = Server(etag = "\"v1\"")
+            val client = server.client(CacheOptions(ttlMillis = 1_000))
+
+            client.getResource("/docs").getOrThrow()
+            server.now = 5_000
+            val revalidated = client.getResource("/docs").getOrThrow()
+            server.now = 5_500
+            client.getResource("/docs").getOrThrow()
+
+            assertEquals("/docs", revalidated.path)
+            assertEquals(1, server.conditional)
+            assertEquals(2, server.requests.size)
+            assertEquals(CacheStats(hits = 1, revalidations = 1, misses = 1, size = 1), client.cacheStats)
+            client.close()
+        }
+
+    @Test
+    fun testMutationsInvalidatePathAndParent() =
+        runTest {
+            val server = Server()
+            val client = server.client()
+            client.getResource("/docs").getOrThrow()
+            client.getResource("/docs/a.txt").getOrThrow()
+            client.getResource("/other").getOrThrow()
+
+            client.delete("/docs/a.txt").getOrThrow()
+            client.getResource("/docs").getOrThrow()
+            client.getResource("/docs/a.txt").getOrThrow()
+            client.getResource("/other").getOrThrow()
+
+            assertEquals(listOf("GET /docs", "GET /docs/a.txt"), server.requests.drop(4))
+            assertEquals(1, client.cacheStats?.hits)
+            client.close()
+        }
+
+    @Test
+    fun testLeastRecentlyUsedEntryIsEvicted() =
+        runTest {
+            val server = Server()
+            val client = server.client(CacheOptions(maxEntries = 2))
+
+            client.getResource("/a").getOrThrow()
+            client.getResource("/b").getOrThrow()
+            client.getResource("/a").getOrThrow()
+            client.getResource("/c").getOrThrow()
+            client.getResource("/a").getOrThrow()
+            client.getResource("/b").getOrThrow()
+
+            assertEquals(listOf("GET /a", "GET /b", "GET /c", "GET /b"), server.requests)
+            assertEquals(2, client.cacheStats?.evictions)
+            client.close()
+        }
+
+    @Test
+    fun testTokenChangeClearsCache() =
+        runTest {
+            val server = Server()
+            val client = server.client()
+            client.getResource("/docs").getOrThrow()
+
+            client.setToken("other-user")
+            client.getResource("/docs").getOrThrow()
+
+            assertEquals(2, server.requests.size)
+            client.close()
+        }
+
+    @Test
+    fun testStoreCarriesEntriesAcrossClients() =
+        runTest {
+            val server = Server()
+            val store = MemoryStore()
+            val first = server.client(CacheOptions(store = store))
+            first.getResource("/docs").getOrThrow()
+            first.close()
+
+            val second = server.client(CacheOptions(store = store))
+            second.getResource("/docs").getOrThrow()
+
+            assertEquals(listOf("/docs"), store.saved.values.single().keys.toList())
+            assertEquals(1, server.requests.size)
+            second.close()
+        }
+
+    @Test
+    fun testStoreKeepsUsersApart() =
+        runTest {
+            val server = Server()
+            val store = MemoryStore()
+            val alice = server.client(CacheOptions(store = store), jwt("alice", 1))
+            alice.getResource("/docs").getOrThrow()
+            alice.close()
+
+            val bob = server.client(CacheOptions(store = store), jwt("bob", 2))
+            bob.getResource("/docs").getOrThrow()
+            bob.close()
+            // A renewed token for the same user finds its entries.
+            val renewed = server.client(CacheOptions(store = store), jwt("alice", 3))
+            renewed.getResource("/docs").getOrThrow()
+
+            assertEquals(2, server.requests.size)
+            assertEquals(setOf("http://mock user:alice", "http://mock user:bob"), store.saved.keys)
+            renewed.close()
+        }
+
+    @Test
+    fun testCacheIsDisabledByDefault() {
+        val client = FilebrowserClient("http://mock", HttpClient(MockEngine { respond("", HttpStatusCode.OK) }))
+
+        assertNull(client.cacheStats)
+        client.close()
+    }
+}
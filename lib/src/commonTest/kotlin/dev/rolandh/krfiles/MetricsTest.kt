@@ -0,0 +1,134 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.engine.mock.MockEngine
+import io.ktor.client.engine.mock.respond
+import io.ktor.client.plugins.contentnegotiation.ContentNegotiation
+import io.ktor.http.ContentType
+import io.ktor.http.HttpHeaders
+import io.ktor.http.HttpMethod
+import io.ktor.http.HttpStatusCode
+import io.ktor.http.headersOf
+import io.ktor.serialization.kotlinx.json.json
+import kotlinx.coroutines.test.runTest
+import kotlinx.serialization.json.Json
+import kotlin.test.Test
+import kotlin.test.assertEquals
+import kotlin.test.assertTrue
+
+/**
+ * Tests for the request metrics behind [FilebrowserClient.stats].
+ */
+class MetricsTest {
+    private val fileContent = ByteArray(300) { it.toByte() }
+
+    private fun client(): FilebrowserClient {
+        val engine =
+            MockEngine { request ->
+                val path = request.url.encodedPath
+                when {
+                    path.startsWith("/api/raw") ->
+                        respond(fileContent, HttpStatusCode.OK, headersOf(HttpHeaders.ContentLength, "300"))
+                    path.endsWith("/missing") -> respond("not found", HttpStatusCode.NotFound)
+                    else ->
+                        respond(
+                            """{"name":"a","path":"/a"}""",
+                            HttpStatusCode.OK,
+                            headersOf(HttpHeaders.ContentType, ContentType.Application.Json.toString()),
+                        )
+                }
+            }
+        val httpClient =
+            HttpClient(engine) {
+                install(ContentNegotiation) { json(Json { ignoreUnknownKeys = true }) }
+            }
+        return FilebrowserClient("http://mock", httpClient).also { it.setToken("test-token") }
+    }
+
+    @Test
+    fun testCountsRequestsPerEndpoint() =
+        runTest {
+            val client = client()
+
+            client.getResource("/a").getOrThrow()
+            client.getResource("/b/c").getOrThrow()
+            client.download("/file.bin").getOrThrow()
+
+            val stats = client.stats()
+            val resources = stats.endpoints.single { it.endpoint == "GET /api/resources" }
+            val raw = stats.endpoints.single { it.endpoint == "GET /api/raw" }
+            assertEquals(2, resources.requests)
+            assertEquals(2, resources.total.count)
+            assertEquals(2, resources.decode.count)
+            assertEquals(1, raw.requests)
+            assertEquals(300, raw.bytesReceived)
+            assertEquals(0, raw.errors)
+            client.close()
+        }
+
+    @Test
+    fun testCountsErrorResponses() =
+        runTest {
+            val client = client()
+
+            assertTrue(client.getResource("/missing").isFailure)
+
+            val stats = client.stats().endpoints.single()
+            assertEquals(1, stats.requests)
+            assertEquals(1, stats.errors)
+            client.close()
+        }
+
+    @Test
+    fun testTraceListenerSeesEachRequest() =
+        runTest {
+            val client = client()
+            val traces = mutableListOf<RequestTrace>()
+            client.traceListener = RequestTraceListener { traces += it }
+
+            client.getResource("/a").getOrThrow()
+            client.getResource("/missing")
+            client.traceListener = null
+            client.getResource("/a").getOrThrow()
+
+            assertEquals(listOf(200, 404), traces.map { it.status })
+            assertEquals("/api/resources/a", traces.first().path)
+            assertTrue(traces.all { it.totalMillis >= it.headersMillis })
+            client.close()
+        }
+
+    @Test
+    fun testResetStats() =
+        runTest {
+            val client = client()
+            client.getResource("/a").getOrThrow()
+
+            client.resetStats()
+
+            assertTrue(client.stats().endpoints.isEmpty())
+            client.close()
+        }
+
+    @Test
+    fun testHistogramPercentiles() =
+        runTest {
+            val metrics = ClientMetrics()
+            repeat(9) {
+                metrics.record(RequestTrace("GET /api/raw", "/api/raw/f", 200, 0, 0, 3.0, 4.0))
+            }
+            metrics.record(RequestTrace("GET /api/raw", "/api/raw/f", 200, 0, 0, 300.0, 400.0))
+
+            val total = metrics.snapshot().endpoints.single().total
+            assertEquals(10, total.count)
+            assertEquals(5.0, total.p50Millis)
+            assertEquals(400.0, total.p99Millis)
+            assertEquals(400.0, total.maxMillis)
+        }
+
+    @Test
+    fun testEndpointKey() {
+        assertEquals("GET /api/resources", ClientMetrics.endpointKey(HttpMethod.Get, "/api/resources/a/b"))
+        assertEquals("PATCH /api/tus", ClientMetrics.endpointKey(HttpMethod.Patch, "/files/api/tus/x.bin"))
+        assertEquals("POST /other", ClientMetrics.endpointKey(HttpMethod.Post, "/other"))
+    }
+}
@@ -0,0 +1,175 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.engine.mock.MockEngine
+import io.ktor.client.engine.mock.respond
+import io.ktor.http.HttpHeaders
+import io.ktor.http.HttpStatusCode
+import io.ktor.http.headersOf
+import kotlinx.coroutines.test.runTest
+import kotlin.test.Test
+import kotlin.test.assertContentEquals
+import kotlin.test.assertEquals
+import kotlin.test.assertTrue
+
+/**
+ * Tests for [FilebrowserClient.downloadRanged].
+ */
+class RangedDownloadTest {
+    private val content = ByteArray(1000) { (it % 251).toByte() }
+
+    /** Serves [content] from `/api/raw`, honouring `Range` unless [ignoreRange]. */
+    private inner class Server(
+        private val ignoreRange: Boolean = false,
+    ) {
+        val ranges = mutableListOf<String?>()
+
+        private val engine =
+            MockEngine { request ->
+                val range = request.headers[HttpHeaders.Range]
+                ranges += range
+                if (range == null || ignoreRange) {
+                    return@MockEngine respond(content, HttpStatusCode.OK)
+                }
+                val (first, last) = range.removePrefix("bytes=").split('-')
+                val from = first.toInt()
+                val until = if (last.isEmpty()) content.size else last.toInt() + 1
+                if (from >= content.size) {
+                    val headers = headersOf(HttpHeaders.ContentRange, "bytes */${content.size}")
+                    return@MockEngine respond("", HttpStatusCode.RequestedRangeNotSatisfiable, headers)
+                }
+                val headers = headersOf(HttpHeaders.ContentRange, "bytes $from-${until - 1}/${content.size}")
+                respond(content.copyOfRange(from, until), HttpStatusCode.PartialContent, headers)
+            }
+
+        fun client(): FilebrowserClient =
+            FilebrowserClient("http://mock", HttpClient(engine)).also { it.setToken("test-token") }
+    }
+
+    /** [ChunkSink] into a byte array, sized by [allocate]. */
+    private class MemorySink(
+        var bytes: ByteArray = ByteArray(0),
+    ) : ChunkSink {
+        override suspend fun allocate(size: Long) {
+            bytes = bytes.copyOf(size.toInt())
+        }
+
+        override suspend fun write(
+            position: Long,
+            buffer: ByteArray,
+            length: Int,
+        ) {
+            if (position + length > bytes.size) bytes = bytes.copyOf((position + length).toInt())
+            buffer.copyInto(bytes, position.toInt(), 0, length)
+        }
+    }
+
+    @Test
+    fun testSingleStreamDownload() =
+        runTest {
+            val server = Server()
+            val client = server.client()
+            val sink = MemorySink()
+
+            val size = client.downloadRanged("/file.bin", sink).getOrThrow()
+
+            assertEquals(1000, size)
+            assertContentEquals(content, sink.bytes)
+            assertEquals(listOf<String?>("bytes=0-"), server.ranges)
+            client.close()
+        }
+
+    @Test
+    fun testSegmentsAreFetchedInParallelRanges() =
+        runTest {
+            val server = Server()
+            val client = server.client()
+            val sink = MemorySink()
+            val options = DownloadOptions(segments = 4, minSegmentSize = 100, chunkSize = 64)
+
+            client.downloadRanged("/file.bin", sink, options).getOrThrow()
+
+            assertContentEquals(content, sink.bytes)
+            assertEquals(
+                setOf("bytes=0-", "bytes=250-499", "bytes=500-749", "bytes=750-999"),
+                server.ranges.toSet(),
+            )
+            client.close()
+        }
+
+    @Test
+    fun testSmallFilesUseFewerSegments() =
+        runTest {
+            val server = Server()
+            val client = server.client()
+            val sink = MemorySink()
+
+            client.downloadRanged("/file.bin", sink, DownloadOptions(segments = 8, minSegmentSize = 400)).getOrThrow()
+
+            assertContentEquals(content, sink.bytes)
+            assertEquals(listOf<String?>("bytes=0-", "bytes=500-999"), server.ranges)
+            client.close()
+        }
+
+    @Test
+    fun testResumeFetchesOnlyTheRest() =
+        runTest {
+            val server = Server()
+            val client = server.client()
+            val sink = MemorySink(content.copyOf(300))
+            val reported = mutableListOf<Long>()
+
+            client
+                .downloadRanged("/file.bin", sink, DownloadOptions(offset = 300)) { transferred, _ ->
+                    reported += transferred
+                }.getOrThrow()
+
+            assertContentEquals(content, sink.bytes)
+            assertEquals(listOf<String?>("bytes=300-"), server.ranges)
+            assertEquals(300, reported.first())
+            assertEquals(1000, reported.last())
+            client.close()
+        }
+
+    @Test
+    fun testResumeOfCompleteFileTransfersNothing() =
+        runTest {
+            val server = Server()
+            val client = server.client()
+            val sink = MemorySink(content.copyOf())
+
+            val size = client.downloadRanged("/file.bin", sink, DownloadOptions(offset = 1000)).getOrThrow()
+
+            assertEquals(1000, size)
+            assertContentEquals(content, sink.bytes)
+            client.close()
+        }
+
+    @Test
+    fun testFallsBackToWholeFileWhenRangeIsIgnored() =
+        runTest {
+            val server = Server(ignoreRange = true)
+            val client = server.client()
+            val sink = MemorySink(ByteArray(300))
+
+            val options = DownloadOptions(offset = 300, segments = 4, minSegmentSize = 100)
+            val size = client.downloadRanged("/file.bin", sink, options).getOrThrow()
+
+            assertEquals(1000, size)
+            assertContentEquals(content, sink.bytes)
+            assertEquals(1, server.ranges.size)
+            client.close()
+        }
+
+    @Test
+    fun testResumePastEndFails() =
+        runTest {
+            val server = Server()
+            val client = server.client()
+
+            val result = client.downloadRanged("/file.bin", MemorySink(), DownloadOptions(offset = 2000))
+
+            assertTrue(result.exceptionOrNull()?.message.orEmpty().contains("Cannot resume"))
+            client.close()
+        }
+}
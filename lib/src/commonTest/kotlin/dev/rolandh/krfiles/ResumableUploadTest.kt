@@ -0,0 +1,128 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.engine.mock.MockEngine
+import io.ktor.client.engine.mock.respond
+import io.ktor.client.engine.mock.toByteArray
+import io.ktor.http.HttpMethod
+import io.ktor.http.HttpStatusCode
+import io.ktor.http.headersOf
+import kotlinx.coroutines.test.runTest
+import kotlin.test.Test
+import kotlin.test.assertContentEquals
+import kotlin.test.assertEquals
+import kotlin.test.assertTrue
+
+/**
+ * Tests for [FilebrowserClient.uploadResumable] against an in-memory tus endpoint.
+ */
+class ResumableUploadTest {
+    /** Minimal stand-in for Filebrowser's `/api/tus` handler. */
+    private class FakeTusServer(
+        /** PATCH request numbers (1-based) that fail with 500 after storing nothing. */
+        private val failingPatches: Set<Int> = emptySet(),
+    ) {
+        var stored = ByteArray(0)
+        var uploadLength = -1L
+        var patches = 0
+        var heads = 0
+
+        val engine =
+            MockEngine { request ->
+                assertTrue(request.url.encodedPath.startsWith("/api/tus/"))
+                when (request.method) {
+                    HttpMethod.Post -> {
+                        uploadLength = request.headers["Upload-Length"]!!.toLong()
+                        stored = ByteArray(0)
+                        respond("", HttpStatusCode.Created)
+                    }
+                    HttpMethod.Head -> {
+                        heads++
+                        respond("", HttpStatusCode.OK, headersOf("Upload-Offset", stored.size.toString()))
+                    }
+                    HttpMethod.Patch -> {
+                        patches++
+                        val offset = request.headers["Upload-Offset"]!!.toLong()
+                        when {
+                            patches in failingPatches -> respond("boom", HttpStatusCode.InternalServerError)
+                            offset != stored.size.toLong() -> respond("offset mismatch", HttpStatusCode.Conflict)
+                            else -> {
+                                stored += request.body.toByteArray()
+                                val headers = headersOf("Upload-Offset", stored.size.toString())
+                                respond("", HttpStatusCode.NoContent, headers)
+                            }
+                        }
+                    }
+                    else -> respond("", HttpStatusCode.MethodNotAllowed)
+                }
+            }
+
+        fun client(): FilebrowserClient =
+            FilebrowserClient("http://mock", HttpClient(engine)).also { it.setToken("test-token") }
+    }
+
+    private val content = ByteArray(10_000) { (it % 251).toByte() }
+
+    @Test
+    fun testUploadSendsAllChunksInOrder() =
+        runTest {
+            val server = FakeTusServer()
+            val client = server.client()
+            var lastProgress = 0L
+
+            val result =
+                client.uploadResumable(
+                    "/big.bin",
+                    content.size.toLong(),
+                    content.asChunkSource(),
+                    UploadOptions(chunkSize = 1024),
+                    TransferProgress { done, _ -> lastProgress = done },
+                )
+
+            assertTrue(result.isSuccess)
+            assertEquals(content.size.toLong(), server.uploadLength)
+            assertContentEquals(content, server.stored)
+            assertEquals(10, server.patches)
+            assertEquals(content.size.toLong(), lastProgress)
+            client.close()
+        }
+
+    @Test
+    fun testUploadResumesFromServerOffsetAfterFailure() =
+        runTest {
+            val server = FakeTusServer(failingPatches = setOf(3))
+            val client = server.client()
+
+            val result =
+                client.uploadResumable(
+                    "/big.bin",
+                    content.size.toLong(),
+                    content.asChunkSource(),
+                    UploadOptions(chunkSize = 4096, retryDelayMillis = 1),
+                )
+
+            assertTrue(result.isSuccess)
+            assertContentEquals(content, server.stored)
+            assertEquals(1, server.heads)
+            client.close()
+        }
+
+    @Test
+    fun testUploadGivesUpAfterMaxRetries() =
+        runTest {
+            val server = FakeTusServer(failingPatches = (1..10).toSet())
+            val client = server.client()
+
+            val result =
+                client.uploadResumable(
+                    "/big.bin",
+                    content.size.toLong(),
+                    content.asChunkSource(),
+                    UploadOptions(chunkSize = 4096, maxRetries = 2, retryDelayMillis = 1),
+                )
+
+            assertTrue(result.isFailure)
+            assertEquals(3, server.patches)
+            client.close()
+        }
+}
@@ -0,0 +1,136 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.engine.mock.MockEngine
+import io.ktor.client.engine.mock.respond
+import io.ktor.http.HttpStatusCode
+import kotlinx.coroutines.delay
+import kotlinx.coroutines.test.currentTime
+import kotlinx.coroutines.test.runTest
+import kotlin.test.Test
+import kotlin.test.assertEquals
+import kotlin.test.assertFailsWith
+import kotlin.test.assertTrue
+
+/**
+ * Tests for [RetryController] and the retries of a client's lookups.
+ */
+class RetryTest {
+    @Test
+    fun testClientRetriesTransientStatus() =
+        runTest {
+            var calls = 0
+            val engine =
+                MockEngine {
+                    calls++
+                    if (calls < 3) respond("busy", HttpStatusCode.ServiceUnavailable) else respond("""{"name":"a"}""")
+                }
+            val client = FilebrowserClient("http://mock", HttpClient(engine)).also { it.setToken("test-token") }
+
+            assertEquals("""{"name":"a"}""", client.getResourceJson("/a").getOrThrow())
+
+            val stats = client.stats().retry
+            assertEquals(3, calls)
+            assertEquals(1, stats.calls)
+            assertEquals(2, stats.retries)
+            client.close()
+        }
+
+    @Test
+    fun testDoesNotRetryClientErrors() =
+        runTest {
+            var calls = 0
+            val engine =
+                MockEngine {
+                    calls++
+                    respond("not found", HttpStatusCode.NotFound)
+                }
+            val client = FilebrowserClient("http://mock", HttpClient(engine)).also { it.setToken("test-token") }
+
+            assertTrue(client.searchJson("x").isFailure)
+
+            assertEquals(1, calls)
+            assertEquals(0, client.stats().retry.retries)
+            client.close()
+        }
+
+    @Test
+    fun testStopsWhenBudgetIsSpent() =
+        runTest {
+            val retry = RetryController(RetryOptions(maxAttempts = 5, retryBudgetRatio = 0.0, retryBudgetMax = 1.0))
+            var attempts = 0
+
+            assertFailsWith<FilebrowserException> {
+                retry.call {
+                    attempts++
+                    throw FilebrowserException(503, "busy")
+                }
+            }
+
+            // The one token pays for one retry; the next is refused.
+            assertEquals(2, attempts)
+            val stats = retry.snapshot()
+            assertEquals(1, stats.retries)
+            assertEquals(1, stats.budgetExhausted)
+        }
+
+    @Test
+    fun testBackoffStaysWithinCap() =
+        runTest {
+            val options = RetryOptions(maxAttempts = 4, retryBaseDelayMillis = 100, retryMaxDelayMillis = 250)
+            val retry = RetryController(options)
+            var attempts = 0
+
+            val result =
+                retry.call {
+                    if (++attempts < 4) throw FilebrowserException(502, "bad gateway")
+                    "ok"
+                }
+
+            // Delays of at most 100, 200 and 250 ms.
+            assertEquals("ok", result)
+            assertTrue(currentTime <= 550)
+        }
+
+    @Test
+    fun testHedgeAnswersSlowCall() =
+        runTest {
+            val retry = RetryController(RetryOptions(hedgeAfterMillis = 100))
+            var attempts = 0
+
+            val result =
+                retry.call {
+                    if (++attempts == 1) {
+                        delay(10_000)
+                        "slow"
+                    } else {
+                        "fast"
+                    }
+                }
+
+            assertEquals("fast", result)
+            assertEquals(100, currentTime)
+            val stats = retry.snapshot()
+            assertEquals(1, stats.hedges)
+            assertEquals(1, stats.hedgeWins)
+        }
+
+    @Test
+    fun testFastCallIsNotHedged() =
+        runTest {
+            val retry = RetryController(RetryOptions(hedgeAfterMillis = 100))
+            var attempts = 0
+
+            assertEquals("ok", retry.call { "ok".also { attempts++ } })
+
+            assertEquals(1, attempts)
+            assertEquals(0, retry.snapshot().hedges)
+        }
+
+    @Test
+    fun testRejectsInvalidOptions() {
+        assertFailsWith<IllegalArgumentException> { RetryOptions(maxAttempts = 0) }
+        assertFailsWith<IllegalArgumentException> { RetryOptions(retryBaseDelayMillis = 10_000) }
+        assertFailsWith<IllegalArgumentException> { RetryOptions(hedgeAfterMillis = 0) }
+    }
+}
@@ -0,0 +1,148 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.engine.mock.MockEngine
+import io.ktor.client.engine.mock.respond
+import io.ktor.http.HttpHeaders
+import io.ktor.http.HttpStatusCode
+import io.ktor.http.headersOf
+import kotlinx.coroutines.ExperimentalCoroutinesApi
+import kotlinx.coroutines.async
+import kotlinx.coroutines.launch
+import kotlinx.coroutines.test.runCurrent
+import kotlinx.coroutines.test.runTest
+import kotlinx.coroutines.test.testTimeSource
+import kotlin.test.Test
+import kotlin.test.assertEquals
+import kotlin.test.assertTrue
+import kotlin.time.Duration.Companion.seconds
+
+/**
+ * Tests for [TransferScheduler] and the scheduling of a client's requests.
+ */
+@OptIn(ExperimentalCoroutinesApi::class)
+class SchedulerTest {
+    @Test
+    fun testAdmitsHigherPriorityFirst() =
+        runTest {
+            val scheduler = TransferScheduler(SchedulerOptions(initialConcurrency = 1, interactiveReserve = 0))
+            val order = mutableListOf<TransferPriority>()
+            scheduler.acquire(TransferPriority.BULK)
+
+            for (priority in listOf(TransferPriority.BULK, TransferPriority.NORMAL, TransferPriority.INTERACTIVE)) {
+                launch {
+                    scheduler.acquire(priority)
+                    order += priority
+                    scheduler.release()
+                }
+            }
+            runCurrent()
+            assertEquals(3, scheduler.snapshot().queued)
+
+            scheduler.release()
+            runCurrent()
+            assertEquals(
+                listOf(TransferPriority.INTERACTIVE, TransferPriority.NORMAL, TransferPriority.BULK),
+                order,
+            )
+            assertEquals(0, scheduler.snapshot().running)
+        }
+
+    @Test
+    fun testInteractiveUsesReserve() =
+        runTest {
+            val scheduler = TransferScheduler(SchedulerOptions(initialConcurrency = 1, interactiveReserve = 1))
+            scheduler.acquire(TransferPriority.BULK)
+
+            val bulk = async { scheduler.acquire(TransferPriority.BULK) }
+            scheduler.acquire(TransferPriority.INTERACTIVE)
+            runCurrent()
+
+            val stats = scheduler.snapshot()
+            assertEquals(2, stats.running)
+            assertEquals(1, stats.queuedBulk)
+            assertTrue(bulk.isActive)
+            bulk.cancel()
+        }
+
+    @Test
+    fun testBacksOffOncePerRoundAndRecovers() =
+        runTest {
+            val scheduler = TransferScheduler(SchedulerOptions(initialConcurrency = 8, maxConcurrency = 8))
+            val slots = List(8) { scheduler.acquire(TransferPriority.BULK) }
+
+            // All eight were in flight before the first 429, so only one decrease.
+            slots.forEach { scheduler.onResponse(it, congested = true) }
+            assertEquals(4, scheduler.snapshot().concurrencyLimit)
+            assertEquals(1, scheduler.snapshot().backoffs)
+            assertEquals(8, scheduler.snapshot().congestionSignals)
+            repeat(8) { scheduler.release() }
+
+            // Good responses at full use grow the limit by about one per round.
+            repeat(40) {
+                val round = List(scheduler.snapshot().concurrencyLimit) { scheduler.acquire(TransferPriority.BULK) }
+                round.forEach { scheduler.onResponse(it, congested = false) }
+                repeat(round.size) { scheduler.release() }
+            }
+            assertEquals(8, scheduler.snapshot().concurrencyLimit)
+        }
+
+    @Test
+    fun testCapsTransferBandwidth() =
+        runTest {
+            val scheduler = TransferScheduler(SchedulerOptions(maxBytesPerSecond = 1000), testTimeSource)
+            val start = testTimeSource.markNow()
+            val meter = scheduler.meter()
+
+            repeat(5) { meter.add(1000) }
+
+            // Five seconds' worth at 1000 bytes per second, less at most the burst credit.
+            assertTrue(start.elapsedNow() >= 4.seconds)
+            val stats = scheduler.snapshot()
+            assertEquals(5000, stats.bytesTransferred)
+            assertTrue(stats.throttledMillis > 0)
+        }
+
+    @Test
+    fun testPerTransferCapAppliesToEachTransfer() =
+        runTest {
+            val scheduler = TransferScheduler(SchedulerOptions(maxTransferBytesPerSecond = 1000), testTimeSource)
+            val start = testTimeSource.markNow()
+
+            List(4) { launch { scheduler.meter().add(2000) } }.forEach { it.join() }
+
+            // Four transfers of two seconds each, side by side.
+            assertTrue(start.elapsedNow() < 3.seconds)
+        }
+
+    @Test
+    fun testClientReportsCongestionAndBytes() =
+        runTest {
+            var calls = 0
+            val engine =
+                MockEngine { request ->
+                    calls++
+                    when {
+                        request.url.encodedPath.startsWith("/api/raw") ->
+                            respond(ByteArray(300), HttpStatusCode.OK, headersOf(HttpHeaders.ContentLength, "300"))
+                        else -> respond("slow down", HttpStatusCode.TooManyRequests)
+                    }
+                }
+            // Without retries, so the 429 is seen once.
+            val client =
+                FilebrowserClient("http://mock", HttpClient(engine), retry = RetryOptions(maxAttempts = 1))
+                    .also { it.setToken("test-token") }
+
+            assertTrue(client.getResource("/a").isFailure)
+            client.download("/file.bin") { _, _ -> }.getOrThrow()
+
+            val stats = client.stats().scheduler
+            assertEquals(2, calls)
+            assertEquals(1, stats.congestionSignals)
+            assertEquals(1, stats.backoffs)
+            assertEquals(SchedulerOptions().initialConcurrency / 2, stats.concurrencyLimit)
+            assertEquals(300, stats.bytesTransferred)
+            assertEquals(0, stats.queued)
+            client.close()
+        }
+}
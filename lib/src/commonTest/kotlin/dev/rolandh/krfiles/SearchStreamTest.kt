@@ -0,0 +1,110 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.engine.mock.MockEngine
+import io.ktor.client.engine.mock.respond
+import io.ktor.http.ContentType
+import io.ktor.http.HttpHeaders
+import io.ktor.http.HttpStatusCode
+import io.ktor.http.headersOf
+import io.ktor.utils.io.writeStringUtf8
+import io.ktor.utils.io.writer
+import kotlinx.coroutines.CoroutineScope
+import kotlinx.coroutines.currentCoroutineContext
+import kotlinx.coroutines.flow.toList
+import kotlinx.coroutines.test.runTest
+import kotlin.test.Test
+import kotlin.test.assertEquals
+import kotlin.test.assertFailsWith
+import kotlin.test.assertTrue
+
+/**
+ * Tests for [FilebrowserClient.searchStream].
+ */
+class SearchStreamTest {
+    private val jsonHeaders = headersOf(HttpHeaders.ContentType, ContentType.Application.Json.toString())
+
+    private val results =
+        """
+        [{"dir":false,"path":"/docs/a [1].txt"},
+         {"dir":true,"path":"/docs/{sub}"},
+         {"path":"/docs/é.txt"}]
+        """.trimIndent()
+
+    private fun client(engine: MockEngine): FilebrowserClient =
+        FilebrowserClient("http://mock", HttpClient(engine)).also { it.setToken("test-token") }
+
+    @Test
+    fun testScannerReadsTopLevelArray() {
+        val scanner = JsonArrayScanner(null)
+        val elements = mutableListOf<String>()
+        val bytes = results.encodeToByteArray()
+        for (start in bytes.indices step 3) {
+            val piece = bytes.copyOfRange(start, minOf(start + 3, bytes.size))
+            scanner.feed(piece, piece.size) { elements += it }
+        }
+        assertTrue(scanner.found)
+        assertEquals(3, elements.size)
+        assertEquals("""{"dir":true,"path":"/docs/{sub}"}""", elements[1])
+    }
+
+    @Test
+    fun testStreamsResults() =
+        runTest {
+            var query: String? = null
+            val client =
+                client(
+                    MockEngine { request ->
+                        query = request.url.parameters["query"]
+                        respond(results, HttpStatusCode.OK, jsonHeaders)
+                    },
+                )
+
+            val found = client.searchStream("txt", "/docs").toList()
+
+            assertEquals("txt", query)
+            assertEquals(listOf("/docs/a [1].txt", "/docs/{sub}", "/docs/é.txt"), found.map { it.path })
+            assertEquals(listOf(false, true, false), found.map { it.dir })
+            client.close()
+        }
+
+    @Test
+    fun testLimitStopsReadingTheResponse() =
+        runTest {
+            val total = 1_000_000
+            var written = 0
+            val client =
+                client(
+                    MockEngine {
+                        val body =
+                            CoroutineScope(currentCoroutineContext()).writer {
+                                channel.writeStringUtf8("[")
+                                while (written < total) {
+                                    if (written > 0) channel.writeStringUtf8(",")
+                                    channel.writeStringUtf8("""{"path":"/f$written"}""")
+                                    written++
+                                }
+                                channel.writeStringUtf8("]")
+                            }
+                        respond(body.channel, HttpStatusCode.OK, jsonHeaders)
+                    },
+                )
+
+            val found = client.searchStream("f", limit = 5).toList()
+
+            assertEquals((0 until 5).map { "/f$it" }, found.map { it.path })
+            assertTrue(written < total, "response was read to the end")
+            client.close()
+        }
+
+    @Test
+    fun testServerErrorFails() =
+        runTest {
+            val client = client(MockEngine { respond("denied", HttpStatusCode.Forbidden) })
+
+            val error = assertFailsWith<FilebrowserException> { client.searchStream("x").toList() }
+
+            assertEquals(403, error.statusCode)
+            client.close()
+        }
+}
@@ -0,0 +1,70 @@
+package dev.rolandh.krfiles
+
+import kotlinx.coroutines.CoroutineScope
+import kotlinx.coroutines.channels.Channel
+import kotlinx.coroutines.launch
+import kotlinx.coroutines.test.runTest
+import kotlin.test.Test
+import kotlin.test.assertContentEquals
+import kotlin.test.assertEquals
+import kotlin.test.assertFailsWith
+
+/**
+ * Tests for [StreamChunkSource], the reader behind JS `uploadStream` and native uploads from a descriptor.
+ */
+class StreamChunkSourceTest {
+    private val data = ByteArray(100) { it.toByte() }
+
+    /** A source fed [data] in writes of [writeSize] bytes. */
+    private fun CoroutineScope.source(
+        writeSize: Int,
+        window: Long,
+    ): StreamChunkSource {
+        val chunks = Channel<ByteArray>(1)
+        launch {
+            for (start in data.indices step writeSize) {
+                chunks.send(data.copyOfRange(start, minOf(start + writeSize, data.size)))
+            }
+            chunks.close()
+        }
+        return StreamChunkSource(chunks, window)
+    }
+
+    @Test
+    fun readsAcrossWriteBoundaries() =
+        runTest {
+            val source = source(writeSize = 7, window = 0)
+            val buffer = ByteArray(30)
+            val read = mutableListOf<Byte>()
+            var position = 0L
+            while (true) {
+                val count = source.read(position, buffer, buffer.size)
+                read += buffer.take(count)
+                position += count
+                if (count < buffer.size) break
+            }
+            assertContentEquals(data.toList(), read)
+        }
+
+    @Test
+    fun rereadsWithinWindow() =
+        runTest {
+            val source = source(writeSize = 10, window = 40)
+            val buffer = ByteArray(20)
+            source.read(0, buffer, 20)
+            source.read(20, buffer, 20)
+            source.read(40, buffer, 20)
+            assertEquals(20, source.read(20, buffer, 20))
+            assertContentEquals(data.copyOfRange(20, 40), buffer)
+        }
+
+    @Test
+    fun refusesToRewindPastWindow() =
+        runTest {
+            val source = source(writeSize = 10, window = 10)
+            val buffer = ByteArray(20)
+            source.read(0, buffer, 20)
+            source.read(40, buffer, 20)
+            assertFailsWith<IllegalStateException> { source.read(0, buffer, 20) }
+        }
+}
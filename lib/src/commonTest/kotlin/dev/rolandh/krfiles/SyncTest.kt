@@ -0,0 +1,341 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.engine.mock.MockEngine
+import io.ktor.client.engine.mock.respond
+import io.ktor.client.engine.mock.toByteArray
+import io.ktor.client.plugins.contentnegotiation.ContentNegotiation
+import io.ktor.http.ContentType
+import io.ktor.http.HttpHeaders
+import io.ktor.http.HttpMethod
+import io.ktor.http.HttpStatusCode
+import io.ktor.http.decodeURLPart
+import io.ktor.http.headersOf
+import io.ktor.serialization.kotlinx.json.json
+import kotlinx.coroutines.sync.Mutex
+import kotlinx.coroutines.sync.withLock
+import kotlinx.coroutines.test.runTest
+import kotlinx.serialization.encodeToString
+import kotlinx.serialization.json.Json
+import kotlin.test.Test
+import kotlin.test.assertContentEquals
+import kotlin.test.assertEquals
+import kotlin.test.assertFalse
+import kotlin.test.assertTrue
+
+/**
+ * Tests for [FilebrowserClient.sync] against an in-memory server and local tree.
+ */
+class SyncTest {
+    private val testJson =
+        Json {
+            ignoreUnknownKeys = true
+            encodeDefaults = true
+        }
+
+    /** 2024-01-01T00:00:00Z */
+    private val jan1 = 1_704_067_200L
+
+    /** Filebrowser stand-in serving listings, raw downloads, mkdir and tus uploads. */
+    private class FakeServer(
+        val format: Json,
+    ) {
+        private val jsonHeaders = headersOf(HttpHeaders.ContentType, ContentType.Application.Json.toString())
+        private val lock = Mutex()
+
+        /** Directory path -> `modified` stamp. */
+        val dirs = mutableMapOf("/" to "2024-01-01T00:00:00Z")
+
+        /** File path -> content and `modified` stamp. */
+        val files = mutableMapOf<String, Pair<ByteArray, String>>()
+        val listed = mutableListOf<String>()
+        var uploads = 0
+        private val pending = mutableMapOf<String, ByteArray>()
+
+        val engine =
+            MockEngine { request ->
+                val encoded = request.url.encodedPath
+                val route = encoded.substringAfter("/api/").substringBefore('/')
+                val path = encoded.removePrefix("/api/$route").decodeURLPart().trimEnd('/').ifEmpty { "/" }
+                lock.withLock {
+                    when {
+                        route == "resources" && request.method == HttpMethod.Get -> {
+                            val stamp = dirs[path]
+                            val file = files[path]
+                            when {
+                                stamp != null -> {
+                                    listed += path
+                                    val body = format.encodeToString(listing(path, stamp))
+                                    respond(body, HttpStatusCode.OK, jsonHeaders)
+                                }
+                                file != null -> {
+                                    val resource = Resource(path = path, size = file.first.size.toDouble())
+                                    respond(format.encodeToString(resource), HttpStatusCode.OK, jsonHeaders)
+                                }
+                                else -> respond("not found", HttpStatusCode.NotFound)
+                            }
+                        }
+                        route == "resources" && request.method == HttpMethod.Post -> {
+                            dirs[path] = "2024-06-01T00:00:00Z"
+                            respond("", HttpStatusCode.OK)
+                        }
+                        route == "raw" -> respond(files.getValue(path).first, HttpStatusCode.OK)
+                        route == "tus" && request.method == HttpMethod.Post -> {
+                            pending[path] = ByteArray(0)
+                            uploads++
+                            respond("", HttpStatusCode.Created)
+                        }
+                        route == "tus" && request.method == HttpMethod.Patch -> {
+                            val stored = pending.getValue(path) + request.body.toByteArray()
+                            pending[path] = stored
+                            files[path] = stored to "2024-06-01T00:00:00Z"
+                            respond("", HttpStatusCode.NoContent, headersOf("Upload-Offset", stored.size.toString()))
+                        }
+                        else -> respond("", HttpStatusCode.MethodNotAllowed)
+                    }
+                }
+            }
+
+        private fun listing(
+            path: String,
+            stamp: String,
+        ): Resource {
+            val prefix = if (path == "/") "/" else "$path/"
+            fun isChild(other: String) = other.startsWith(prefix) && '/' !in other.removePrefix(prefix)
+            val items =
+                dirs.filterKeys { it != path && isChild(it) }.map { (dir, modified) ->
+                    Resource(name = dir.substringAfterLast('/'), isDir = true, modified = modified)
+                } +
+                    files.filterKeys(::isChild).map { (file, entry) ->
+                        Resource(
+                            name = file.substringAfterLast('/'),
+                            size = entry.first.size.toDouble(),
+                            modified = entry.second,
+                        )
+                    }
+            return Resource(path = path, isDir = true, modified = stamp, items = items)
+        }
+
+        fun client(): FilebrowserClient {
+            val httpClient = HttpClient(engine) { install(ContentNegotiation) { json(format) } }
+            return FilebrowserClient("http://mock", httpClient).also { it.setToken("test-token") }
+        }
+    }
+
+    /** [LocalTree] held in memory. */
+    private class MemoryTree : LocalTree {
+        val dirs = mutableSetOf<String>()
+        val files = mutableMapOf<String, Pair<ByteArray, Long>>()
+
+        override fun scan(): List<LocalEntry> =
+            dirs.map { LocalEntry(it, isDir = true) } +
+                files.map { (path, entry) -> LocalEntry(path, false, entry.first.size.toLong(), entry.second) }
+
+        override suspend fun <T> read(
+            path: String,
+            block: suspend (source: ChunkSource, size: Long) -> T,
+        ): T {
+            val content = files.getValue(path).first
+            return block(content.asChunkSource(), content.size.toLong())
+        }
+
+        override suspend fun write(
+            path: String,
+            modified: Long,
+            block: suspend (sink: suspend (buffer: ByteArray, length: Int) -> Unit) -> Unit,
+        ) {
+            var content = ByteArray(0)
+            block { buffer, length -> content += buffer.copyOf(length) }
+            files[path] = content to modified
+        }
+
+        override fun createDirectory(path: String) {
+            dirs += path
+        }
+    }
+
+    private fun bytes(text: String) = text.encodeToByteArray()
+
+    @Test
+    fun testPushUploadsOnlyChangedFiles() =
+        runTest {
+            val server = FakeServer(testJson)
+            server.dirs["/backup"] = "2024-01-01T00:00:00Z"
+            server.files["/backup/same.txt"] = bytes("same") to "2024-01-02T00:00:00Z"
+            server.files["/backup/resized.txt"] = bytes("old") to "2024-01-02T00:00:00Z"
+            val local = MemoryTree()
+            local.files["same.txt"] = bytes("same") to jan1
+            local.files["resized.txt"] = bytes("longer") to jan1
+            local.dirs += "new"
+            local.files["new/file.txt"] = bytes("hello") to jan1
+            val client = server.client()
+
+            val report = client.sync(local, "/backup").getOrThrow()
+
+            assertEquals(
+                listOf(
+                    SyncAction(SyncActionKind.MKDIR, "new", reason = "new"),
+                    SyncAction(SyncActionKind.UPLOAD, "new/file.txt", 5, "new"),
+                    SyncAction(SyncActionKind.UPLOAD, "resized.txt", 6, "size"),
+                ),
+                report.actions.sortedBy { it.path },
+            )
+            assertEquals(1, report.unchanged)
+            assertTrue("/backup/new" in server.dirs)
+            assertContentEquals(bytes("hello"), server.files.getValue("/backup/new/file.txt").first)
+            assertContentEquals(bytes("longer"), server.files.getValue("/backup/resized.txt").first)
+            client.close()
+        }
+
+    @Test
+    fun testPushUploadsNewerLocalFile() =
+        runTest {
+            val server = FakeServer(testJson)
+            server.files["/notes.txt"] = bytes("v1") to "2024-01-01T00:00:00Z"
+            val local = MemoryTree()
+            local.files["notes.txt"] = bytes("v2") to jan1 + 60
+            val client = server.client()
+
+            val report = client.sync(local, "/").getOrThrow()
+
+            assertEquals(listOf(SyncAction(SyncActionKind.UPLOAD, "notes.txt", 2, "newer")), report.actions)
+            assertContentEquals(bytes("v2"), server.files.getValue("/notes.txt").first)
+            client.close()
+        }
+
+    @Test
+    fun testDryRunOnlyPlans() =
+        runTest {
+            val server = FakeServer(testJson)
+            val local = MemoryTree()
+            local.files["a.txt"] = bytes("a") to jan1
+            val client = server.client()
+            val steps = mutableListOf<SyncAction>()
+
+            val report = client.sync(local, "/", SyncOptions(dryRun = true)) { steps += it }.getOrThrow()
+
+            assertTrue(report.dryRun)
+            assertEquals(listOf(SyncAction(SyncActionKind.UPLOAD, "a.txt", 1, "new")), report.actions)
+            assertTrue(steps.isEmpty())
+            assertEquals(0, server.uploads)
+            assertFalse("/a.txt" in server.files)
+            client.close()
+        }
+
+    @Test
+    fun testManifestSkipsUnchangedDirectories() =
+        runTest {
+            val server = FakeServer(testJson)
+            server.dirs["/docs"] = "2024-01-01T00:00:00Z"
+            server.dirs["/docs/old"] = "2024-01-01T00:00:00Z"
+            server.files["/docs/old/a.txt"] = bytes("a") to "2024-01-01T00:00:00Z"
+            val local = MemoryTree()
+            local.dirs += listOf("docs", "docs/old")
+            local.files["docs/old/a.txt"] = bytes("a") to jan1
+            local.files["b.txt"] = bytes("b") to jan1
+            val client = server.client()
+
+            val first = client.sync(local, "/").getOrThrow()
+            assertEquals(listOf("b.txt"), first.actions.map { it.path })
+            server.listed.clear()
+
+            val second = client.sync(local, "/", manifest = first.manifest).getOrThrow()
+
+            assertTrue(second.actions.isEmpty())
+            assertEquals(2, second.unchanged)
+            assertEquals(listOf("/"), server.listed)
+            assertEquals(2, second.cachedDirectories)
+            client.close()
+        }
+
+    @Test
+    fun testRescanIgnoresManifest() =
+        runTest {
+            val server = FakeServer(testJson)
+            server.dirs["/docs"] = "2024-01-01T00:00:00Z"
+            val client = server.client()
+            val local = MemoryTree()
+            val first = client.sync(local, "/").getOrThrow()
+            server.listed.clear()
+
+            client.sync(local, "/", SyncOptions(rescan = true), first.manifest).getOrThrow()
+
+            assertTrue("/docs" in server.listed)
+            client.close()
+        }
+
+    @Test
+    fun testPullFindsFilesBelowUnchangedDirectories() =
+        runTest {
+            val server = FakeServer(testJson)
+            server.dirs["/a"] = "2024-01-01T00:00:00Z"
+            server.dirs["/a/b"] = "2024-01-01T00:00:00Z"
+            val local = MemoryTree()
+            val client = server.client()
+            val pull = SyncOptions(direction = SyncDirection.PULL)
+            val first = client.sync(local, "/", pull).getOrThrow()
+
+            // Only /a/b's stamp moves; /a still matches the manifest.
+            server.files["/a/b/new.txt"] = bytes("new") to "2024-06-01T00:00:00Z"
+            server.dirs["/a/b"] = "2024-06-01T00:00:00Z"
+            val second = client.sync(local, "/", pull, first.manifest).getOrThrow()
+
+            assertEquals(listOf(SyncAction(SyncActionKind.DOWNLOAD, "a/b/new.txt", 3, "new")), second.actions)
+            assertContentEquals(bytes("new"), local.files.getValue("a/b/new.txt").first)
+            assertEquals(0, second.cachedDirectories)
+            client.close()
+        }
+
+    @Test
+    fun testPullDownloadsWithRemoteModificationTime() =
+        runTest {
+            val server = FakeServer(testJson)
+            server.dirs["/photos"] = "2024-01-01T00:00:00Z"
+            server.files["/photos/cat.jpg"] = bytes("meow") to "2024-01-01T00:00:00Z"
+            val local = MemoryTree()
+            val client = server.client()
+            val pull = SyncOptions(direction = SyncDirection.PULL)
+
+            val first = client.sync(local, "/", pull).getOrThrow()
+
+            assertEquals(
+                listOf(
+                    SyncAction(SyncActionKind.MKDIR, "photos", reason = "new"),
+                    SyncAction(SyncActionKind.DOWNLOAD, "photos/cat.jpg", 4, "new"),
+                ),
+                first.actions,
+            )
+            assertContentEquals(bytes("meow"), local.files.getValue("photos/cat.jpg").first)
+            assertEquals(jan1, local.files.getValue("photos/cat.jpg").second)
+
+            val again = client.sync(local, "/", pull, first.manifest).getOrThrow()
+            assertTrue(again.actions.isEmpty())
+            val push = client.sync(local, "/", manifest = first.manifest).getOrThrow()
+            assertTrue(push.actions.isEmpty())
+            client.close()
+        }
+
+    @Test
+    fun testFailedTransferIsReportedWithoutFailingSync() =
+        runTest {
+            val server = FakeServer(testJson)
+            server.files["/gone.txt"] = bytes("x") to "2024-01-01T00:00:00Z"
+            val local = MemoryTree()
+            val client = server.client()
+            val pull = SyncOptions(direction = SyncDirection.PULL)
+            // Every local write fails.
+            val failing =
+                object : LocalTree by local {
+                    override suspend fun write(
+                        path: String,
+                        modified: Long,
+                        block: suspend (sink: suspend (buffer: ByteArray, length: Int) -> Unit) -> Unit,
+                    ): Unit = error("disk full")
+                }
+
+            val report = client.sync(failing, "/", pull).getOrThrow()
+
+            assertEquals(listOf("disk full"), report.failed.map { it.error })
+            client.close()
+        }
+}
@@ -0,0 +1,134 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.engine.mock.MockEngine
+import io.ktor.client.engine.mock.respond
+import io.ktor.client.plugins.contentnegotiation.ContentNegotiation
+import io.ktor.http.ContentType
+import io.ktor.http.HttpHeaders
+import io.ktor.http.HttpStatusCode
+import io.ktor.http.decodeURLPart
+import io.ktor.http.headersOf
+import io.ktor.serialization.kotlinx.json.json
+import kotlinx.coroutines.delay
+import kotlinx.coroutines.flow.toList
+import kotlinx.coroutines.sync.Mutex
+import kotlinx.coroutines.sync.withLock
+import kotlinx.coroutines.test.runTest
+import kotlinx.serialization.encodeToString
+import kotlinx.serialization.json.Json
+import kotlin.test.Test
+import kotlin.test.assertEquals
+import kotlin.test.assertFalse
+import kotlin.test.assertTrue
+
+/**
+ * Tests for [FilebrowserClient.walk] against an in-memory directory tree.
+ */
+class WalkTest {
+    private val testJson =
+        Json {
+            ignoreUnknownKeys = true
+            encodeDefaults = true
+        }
+
+    /** Directory path -> child names; names ending in "/" are directories. */
+    private val tree =
+        mapOf(
+            "/" to listOf("docs/", "photos/", "readme.txt"),
+            "/docs" to listOf("a.txt", "b.txt", "old/"),
+            "/docs/old" to listOf("c.txt"),
+            "/photos" to listOf("cat.jpg"),
+        )
+
+    private class FakeServer(
+        val tree: Map<String, List<String>>,
+        val format: Json,
+    ) {
+        private val jsonHeaders = headersOf(HttpHeaders.ContentType, ContentType.Application.Json.toString())
+
+        val listed = mutableListOf<String>()
+        var inFlight = 0
+        var maxInFlight = 0
+        private val lock = Mutex()
+
+        val engine =
+            MockEngine { request ->
+                val path =
+                    request.url.encodedPath
+                        .removePrefix("/api/resources")
+                        .decodeURLPart()
+                        .ifEmpty { "/" }
+                lock.withLock {
+                    listed += path
+                    inFlight++
+                    maxInFlight = maxOf(maxInFlight, inFlight)
+                }
+                delay(5)
+                lock.withLock { inFlight-- }
+                val children = tree[path] ?: return@MockEngine respond("not found", HttpStatusCode.NotFound)
+                val items =
+                    children.map { name ->
+                        Resource(name = name.removeSuffix("/"), isDir = name.endsWith("/"), size = 10.0)
+                    }
+                val body = format.encodeToString(Resource(path = path, isDir = true, items = items))
+                respond(body, HttpStatusCode.OK, jsonHeaders)
+            }
+
+        fun client(): FilebrowserClient {
+            val httpClient = HttpClient(engine) { install(ContentNegotiation) { json(format) } }
+            return FilebrowserClient("http://mock", httpClient).also { it.setToken("test-token") }
+        }
+    }
+
+    @Test
+    fun testWalkEmitsEveryEntryWithFullPath() =
+        runTest {
+            val server = FakeServer(tree, testJson)
+            val client = server.client()
+
+            val paths = client.walk("/", concurrency = 2).toList().map { it.path }.toSet()
+
+            val expected =
+                setOf(
+                    "/docs",
+                    "/photos",
+                    "/readme.txt",
+                    "/docs/a.txt",
+                    "/docs/b.txt",
+                    "/docs/old",
+                    "/docs/old/c.txt",
+                    "/photos/cat.jpg",
+                )
+            assertEquals(expected, paths)
+            assertEquals(4, server.listed.size)
+            assertTrue(server.maxInFlight <= 2)
+            client.close()
+        }
+
+    @Test
+    fun testWalkFilterPrunesSubtrees() =
+        runTest {
+            val server = FakeServer(tree, testJson)
+            val client = server.client()
+
+            val entries = client.walk("/", filter = { it.name != "docs" }).toList()
+
+            assertFalse(entries.any { it.path.startsWith("/docs") })
+            assertFalse("/docs" in server.listed)
+            assertEquals(setOf("/photos", "/readme.txt", "/photos/cat.jpg"), entries.map { it.path }.toSet())
+            client.close()
+        }
+
+    @Test
+    fun testWalkFailsOnListingError() =
+        runTest {
+            val broken = tree + ("/" to listOf("missing/"))
+            val client = FakeServer(broken, testJson).client()
+
+            val result = runCatching { client.walk("/").toList() }
+
+            assertTrue(result.isFailure)
+            client.close()
+        }
+}
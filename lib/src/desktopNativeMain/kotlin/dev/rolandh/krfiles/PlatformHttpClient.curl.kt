@@ -0,0 +1,20 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.HttpClientConfig
+import io.ktor.client.engine.curl.Curl
+
+/**
+ * Linux and macOS implementation using the Curl engine.
+ *
+ * libcurl keeps connections alive and reuses them across requests, and
+ * negotiates HTTP/2 over TLS, multiplexing concurrent requests to the server.
+ * The engine exposes no pool limits, so only the connect and request timeouts apply.
+ */
+internal actual fun createHttpClient(
+    config: ClientConfig,
+    block: HttpClientConfig<*>.() -> Unit,
+): HttpClient = HttpClient(Curl, block)
+
+/** The engine leaves libcurl's own decoding off; [installCompression] decodes bodies. */
+internal actual val engineDecompresses: Boolean = false
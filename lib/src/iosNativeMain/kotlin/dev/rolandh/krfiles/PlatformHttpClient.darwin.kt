@@ -0,0 +1,29 @@
+@file:OptIn(ExperimentalForeignApi::class)
+
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.HttpClientConfig
+import io.ktor.client.engine.darwin.Darwin
+import kotlinx.cinterop.ExperimentalForeignApi
+import kotlinx.cinterop.convert
+
+/**
+ * iOS implementation using the Darwin (URLSession) engine, which negotiates
+ * HTTP/2 on its own and limits connections per host.
+ */
+internal actual fun createHttpClient(
+    config: ClientConfig,
+    block: HttpClientConfig<*>.() -> Unit,
+): HttpClient =
+    HttpClient(Darwin) {
+        engine {
+            configureSession {
+                config.maxConnectionsPerHost?.let { HTTPMaximumConnectionsPerHost = it.convert() }
+            }
+        }
+        block()
+    }
+
+/** URLSession sends `Accept-Encoding` and decompresses bodies itself. */
+internal actual val engineDecompresses: Boolean = true
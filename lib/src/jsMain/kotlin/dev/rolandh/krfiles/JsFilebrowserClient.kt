@@ -2,7 +2,13 @@ package dev.rolandh.krfiles
 
 import kotlinx.coroutines.DelicateCoroutinesApi
 import kotlinx.coroutines.GlobalScope
+import kotlinx.coroutines.flow.Flow
+import kotlinx.coroutines.flow.emitAll
+import kotlinx.coroutines.flow.flow
+import kotlinx.coroutines.flow.takeWhile
 import kotlinx.coroutines.promise
+import kotlinx.coroutines.sync.Semaphore
+import kotlinx.coroutines.sync.withPermit
 import kotlin.js.JsExport
 import kotlin.js.Promise
 
@@ -27,13 +33,31 @@ import kotlin.js.Promise
  * ```
  *
  * @param baseUrl The base URL of the Filebrowser server
+ * @param cacheTtlMillis How long `getResource` / `listDirectory` results are reused
+ *   without asking the server; 0 (the default) disables the metadata cache. The
+ *   cache persists in localStorage in browsers.
+ * @param maxConcurrency Most operations run at once; further calls wait for a
+ *   free slot. Transfers and iterators hold theirs until they finish. 0 lifts the limit.
  */
 @JsExport
 @OptIn(DelicateCoroutinesApi::class)
 public class JsFilebrowserClient(
     baseUrl: String,
+    cacheTtlMillis: Int = 0,
+    maxConcurrency: Int = DEFAULT_MAX_CONCURRENCY,
 ) {
-    private val client = FilebrowserClient(baseUrl)
+    private val permits = if (maxConcurrency > 0) Semaphore(maxConcurrency) else null
+
+    private val client =
+        FilebrowserClient(
+            baseUrl,
+            cache =
+                if (cacheTtlMillis > 0) {
+                    CacheOptions(ttlMillis = cacheTtlMillis.toLong(), store = createPlatformMetadataStore())
+                } else {
+                    null
+                },
+        )
 
     /** Whether the client is currently authenticated. */
     public val isAuthenticated: Boolean
@@ -49,7 +73,7 @@ public class JsFilebrowserClient(
     public fun login(
         username: String,
         password: String,
-    ): Promise<String> = GlobalScope.promise { client.login(username, password).getOrThrow() }
+    ): Promise<String> = limited { client.login(username, password).getOrThrow() }
 
     /**
      * Set the authentication token directly, without calling [login].
@@ -74,7 +98,16 @@ public class JsFilebrowserClient(
      * @return Promise resolving to the Resource
      */
     public fun getResource(path: String): Promise<Resource> =
-        GlobalScope.promise { client.getResource(path).getOrThrow() }
+        limited { client.getResource(path).getOrThrow() }
+
+    /**
+     * Have the server hash a file.
+     *
+     * @param path Path to the file
+     * @return Promise resolving to its SHA-256 as lowercase hex
+     */
+    public fun getChecksum(path: String): Promise<String> =
+        limited { client.getChecksum(path).getOrThrow() }
 
     /**
      * List contents of a directory.
@@ -83,7 +116,23 @@ public class JsFilebrowserClient(
      * @return Promise resolving to the directory Resource with items
      */
     public fun listDirectory(path: String): Promise<Resource> =
-        GlobalScope.promise { client.listDirectory(path).getOrThrow() }
+        limited { client.listDirectory(path).getOrThrow() }
+
+    /**
+     * Stream the entries of a directory as an async iterator.
+     *
+     * Entries are decoded while the response is still arriving; see
+     * [FilebrowserClient.listDirectoryStream]. The request starts on the first
+     * `next()`; breaking out of the loop cancels it.
+     *
+     * ```typescript
+     * for await (const entry of client.listDirectoryStream("/")) console.log(entry.name);
+     * ```
+     *
+     * @param path Path to the directory
+     * @return `AsyncIterableIterator<Resource>`
+     */
+    public fun listDirectoryStream(path: String): dynamic = asyncIterator(client.listDirectoryStream(path).limited())
 
     /**
      * Search for files and directories by name.
@@ -96,10 +145,30 @@ public class JsFilebrowserClient(
         query: String,
         path: String = "/",
     ): Promise<Array<SearchResult>> =
-        GlobalScope.promise {
+        limited {
             client.search(query, path).getOrThrow().toTypedArray()
         }
 
+    /**
+     * Stream search results as an async iterator, decoded as they arrive; see
+     * [FilebrowserClient.searchStream]. Breaking out of the loop, or reaching
+     * [limit], cancels the request.
+     *
+     * ```typescript
+     * for await (const hit of client.searchStream("report", "/", 10)) console.log(hit.path);
+     * ```
+     *
+     * @param query Search query
+     * @param path Path to search within (defaults to root)
+     * @param limit Stop after this many results; 0 for all of them
+     * @return `AsyncIterableIterator<SearchResult>`
+     */
+    public fun searchStream(
+        query: String,
+        path: String = "/",
+        limit: Int = 0,
+    ): dynamic = asyncIterator(client.searchStream(query, path, limit).limited())
+
     /**
      * Get path completions for tab-completion.
      *
@@ -107,17 +176,59 @@ public class JsFilebrowserClient(
      * @return Promise resolving to an array of matching paths
      */
     public fun getCompletions(partialPath: String): Promise<Array<String>> =
-        GlobalScope.promise {
+        limited {
             client.getCompletions(partialPath).getOrThrow().toTypedArray()
         }
 
+    /**
+     * Recursively walk the tree under [root], listing directories in parallel.
+     *
+     * Entries arrive through [onEntry] as they are discovered; see [FilebrowserClient.walk].
+     * Return `false` from [onEntry] to stop the walk early.
+     *
+     * @param root Directory to start from (not itself reported)
+     * @param concurrency Maximum number of listings in flight
+     * @param onEntry Called with every entry below [root]
+     * @return Promise resolving to the number of entries reported
+     */
+    public fun walk(
+        root: String,
+        concurrency: Int,
+        onEntry: (Resource) -> Boolean,
+    ): Promise<Int> =
+        limited {
+            var count = 0
+            client
+                .walk(root, concurrency)
+                .takeWhile { onEntry(it) }
+                .collect { count++ }
+            count
+        }
+
+    /**
+     * Walk the tree under [root] as an async iterator, listing up to
+     * [concurrency] directories at once; see [FilebrowserClient.walk].
+     *
+     * ```typescript
+     * for await (const entry of client.walkStream("/photos")) console.log(entry.path);
+     * ```
+     *
+     * @param root Directory to start from (not itself reported)
+     * @param concurrency Maximum number of listings in flight
+     * @return `AsyncIterableIterator<Resource>`
+     */
+    public fun walkStream(
+        root: String,
+        concurrency: Int = FilebrowserClient.DEFAULT_WALK_CONCURRENCY,
+    ): dynamic = asyncIterator(client.walk(root, concurrency).limited())
+
     /**
      * Download a file.
      *
      * @param path Path to the file
      * @return Promise resolving to the file contents as Int8Array
      */
-    public fun download(path: String): Promise<ByteArray> = GlobalScope.promise { client.download(path).getOrThrow() }
+    public fun download(path: String): Promise<ByteArray> = limited { client.download(path).getOrThrow() }
 
     /**
      * Upload a file.
@@ -131,7 +242,65 @@ public class JsFilebrowserClient(
         path: String,
         content: ByteArray,
         override: Boolean = true,
-    ): Promise<Unit> = GlobalScope.promise { client.upload(path, content, override).getOrThrow() }
+    ): Promise<Unit> = limited { client.upload(path, content, override).getOrThrow() }
+
+    /**
+     * Download a file as a WHATWG `ReadableStream<Uint8Array>`, for files too
+     * large to hold in memory.
+     *
+     * Chunks are only fetched while the stream's consumer keeps up: when it
+     * stops reading, the download pauses and the server is throttled by TCP,
+     * so memory stays at a few chunks. Cancelling the stream aborts the
+     * request. In Node, `Readable.fromWeb()` turns it into a stream for `pipeline`.
+     *
+     * ```typescript
+     * await pipeline(Readable.fromWeb(client.downloadStream("/disk.img")), createWriteStream("disk.img"));
+     * ```
+     *
+     * @param path Path to the file
+     * @return `ReadableStream<Uint8Array>`
+     */
+    public fun downloadStream(path: String): dynamic {
+        val chunks =
+            flow {
+                client
+                    .download(path) { buffer, length -> emit(buffer.copyOf(length)) }
+                    .getOrThrow()
+            }
+        return readableStream(chunks.limited())
+    }
+
+    /**
+     * Upload a file from a WHATWG `WritableStream<Uint8Array>`, in resumable
+     * chunks like [FilebrowserClient.uploadResumable].
+     *
+     * The upload starts at once. Each write resolves when the chunk has been
+     * taken in, so a writer that awaits its writes (as `pipeline` does) is held
+     * back to the upload's pace, and memory stays bounded by a few upload
+     * chunks. Closing the stream resolves once the server has the whole file
+     * and rejects if the upload failed. Written chunks must not be modified
+     * afterwards. In Node, `Writable.fromWeb()` makes it a `pipeline` target.
+     *
+     * ```typescript
+     * const size = statSync("disk.img").size;
+     * await pipeline(createReadStream("disk.img"), Writable.fromWeb(client.uploadStream("/disk.img", size)));
+     * ```
+     *
+     * @param path Destination path for the file
+     * @param size Exact number of bytes that will be written
+     * @param override Whether to override an existing file (default: true)
+     * @return `WritableStream<Uint8Array>`
+     */
+    public fun uploadStream(
+        path: String,
+        size: Double,
+        override: Boolean = true,
+    ): dynamic {
+        val options = UploadOptions(override = override)
+        return writableStream(options) { source ->
+            withSlot { client.uploadResumable(path, size.toLong(), source, options).getOrThrow() }
+        }
+    }
 
     /**
      * Create a directory.
@@ -140,7 +309,7 @@ public class JsFilebrowserClient(
      * @return Promise resolving when directory is created
      */
     public fun createDirectory(path: String): Promise<Unit> =
-        GlobalScope.promise { client.createDirectory(path).getOrThrow() }
+        limited { client.createDirectory(path).getOrThrow() }
 
     /**
      * Delete a file or directory.
@@ -148,7 +317,7 @@ public class JsFilebrowserClient(
      * @param path Path to delete
      * @return Promise resolving when deletion completes
      */
-    public fun delete(path: String): Promise<Unit> = GlobalScope.promise { client.delete(path).getOrThrow() }
+    public fun delete(path: String): Promise<Unit> = limited { client.delete(path).getOrThrow() }
 
     /**
      * Rename or move a file/directory.
@@ -162,7 +331,7 @@ public class JsFilebrowserClient(
         source: String,
         destination: String,
         override: Boolean = false,
-    ): Promise<Unit> = GlobalScope.promise { client.rename(source, destination, override).getOrThrow() }
+    ): Promise<Unit> = limited { client.rename(source, destination, override).getOrThrow() }
 
     /**
      * Copy a file or directory.
@@ -176,7 +345,7 @@ public class JsFilebrowserClient(
         source: String,
         destination: String,
         override: Boolean = false,
-    ): Promise<Unit> = GlobalScope.promise { client.copy(source, destination, override).getOrThrow() }
+    ): Promise<Unit> = limited { client.copy(source, destination, override).getOrThrow() }
 
     /**
      * List all users (admin only).
@@ -184,7 +353,7 @@ public class JsFilebrowserClient(
      * @return Promise resolving to an array of User
      */
     public fun listUsers(): Promise<Array<User>> =
-        GlobalScope.promise { client.listUsers().getOrThrow().toTypedArray() }
+        limited { client.listUsers().getOrThrow().toTypedArray() }
 
     /**
      * Get a user by ID (admin only).
@@ -192,7 +361,7 @@ public class JsFilebrowserClient(
      * @param id User ID
      * @return Promise resolving to the User
      */
-    public fun getUser(id: Int): Promise<User> = GlobalScope.promise { client.getUser(id).getOrThrow() }
+    public fun getUser(id: Int): Promise<User> = limited { client.getUser(id).getOrThrow() }
 
     /**
      * Create a new user (admin only).
@@ -201,7 +370,7 @@ public class JsFilebrowserClient(
      * @return Promise resolving when user is created
      */
     public fun createUser(userData: UserData): Promise<Unit> =
-        GlobalScope.promise { client.createUser(userData).getOrThrow() }
+        limited { client.createUser(userData).getOrThrow() }
 
     /**
      * Delete a user (admin only).
@@ -209,10 +378,23 @@ public class JsFilebrowserClient(
      * @param id User ID to delete
      * @return Promise resolving when user is deleted
      */
-    public fun deleteUser(id: Int): Promise<Unit> = GlobalScope.promise { client.deleteUser(id).getOrThrow() }
+    public fun deleteUser(id: Int): Promise<Unit> = limited { client.deleteUser(id).getOrThrow() }
 
     /** Close the HTTP client and release resources. */
     public fun close() {
         client.close()
     }
+
+    /** Run [block] as a promise once a slot under the concurrency limit is free. */
+    private fun <T> limited(block: suspend () -> T): Promise<T> = GlobalScope.promise { withSlot(block) }
+
+    private suspend fun <T> withSlot(block: suspend () -> T): T = permits?.withPermit { block() } ?: block()
+
+    /** Hold a slot under the concurrency limit for as long as this flow is collected. */
+    private fun <T> Flow<T>.limited(): Flow<T> = flow { withSlot { emitAll(this@limited) } }
+
+    public companion object {
+        /** Default number of operations a client runs at once. */
+        public const val DEFAULT_MAX_CONCURRENCY: Int = 16
+    }
 }
@@ -0,0 +1,156 @@
+package dev.rolandh.krfiles
+
+import kotlinx.coroutines.CancellationException
+import kotlinx.coroutines.CoroutineStart
+import kotlinx.coroutines.DelicateCoroutinesApi
+import kotlinx.coroutines.GlobalScope
+import kotlinx.coroutines.async
+import kotlinx.coroutines.channels.Channel
+import kotlinx.coroutines.flow.Flow
+import kotlinx.coroutines.launch
+import kotlinx.coroutines.promise
+import org.khronos.webgl.Int8Array
+import org.khronos.webgl.Uint8Array
+import kotlin.js.Promise
+
+/*
+ * Adapters from Kotlin flows and chunk sources to the JS iteration and stream
+ * protocols used by [JsFilebrowserClient]. Values cross over through bounded
+ * channels, so a slow JS consumer suspends the Kotlin producer instead of
+ * letting values pile up.
+ */
+
+/** Values the streaming iterators fetch ahead of the caller. */
+private const val LISTING_BUFFER = 256
+
+/** Chunks a download stream fetches ahead of its reader. */
+private const val STREAM_BUFFER = 4
+
+/** Values of [flow] pumped into a bounded channel by a job that starts on demand. */
+@OptIn(DelicateCoroutinesApi::class)
+private class Pump<T : Any>(
+    flow: Flow<T>,
+    capacity: Int,
+) {
+    val values = Channel<T>(capacity)
+    val job =
+        GlobalScope.launch(start = CoroutineStart.LAZY) {
+            try {
+                flow.collect { values.send(it) }
+                values.close()
+            } catch (e: Throwable) {
+                values.close(e)
+            }
+        }
+
+    /** The next value, null at the end; rethrows the flow's failure. */
+    suspend fun next(): T? {
+        job.start()
+        val next = values.receiveCatching()
+        next.exceptionOrNull()?.let { throw it }
+        return next.getOrNull()
+    }
+
+    fun cancel() {
+        job.cancel()
+        values.cancel()
+    }
+}
+
+/**
+ * Expose [flow] as a JS `AsyncIterableIterator`. Collection starts on the first
+ * `next()`, runs up to [LISTING_BUFFER] values ahead, and is cancelled by `return()`.
+ */
+@OptIn(DelicateCoroutinesApi::class)
+internal fun <T : Any> asyncIterator(flow: Flow<T>): dynamic {
+    val pump = Pump(flow, LISTING_BUFFER)
+    val iterator: dynamic = js("({})")
+    iterator.next = { GlobalScope.promise { iteratorResult(pump.next()) } }
+    iterator["return"] = {
+        pump.cancel()
+        Promise.resolve(iteratorResult(null))
+    }
+    iterator[js("Symbol.asyncIterator")] = { iterator }
+    return iterator
+}
+
+/** `{ value, done }` as returned by an iterator's `next()`; null marks the end. */
+private fun iteratorResult(value: Any?): dynamic {
+    val result: dynamic = js("({})")
+    result.value = value
+    result.done = value == null
+    return result
+}
+
+/**
+ * Expose a flow of byte chunks as a WHATWG `ReadableStream<Uint8Array>`.
+ *
+ * The stream pulls one chunk whenever its queue is empty, and the flow runs at
+ * most [STREAM_BUFFER] chunks ahead of that, so an idle reader pauses it.
+ */
+@OptIn(DelicateCoroutinesApi::class)
+internal fun readableStream(chunks: Flow<ByteArray>): dynamic {
+    val pump = Pump(chunks, STREAM_BUFFER)
+    val source: dynamic = js("({})")
+    source.pull = { controller: dynamic ->
+        GlobalScope.promise {
+            val chunk = pump.next()
+            if (chunk == null) controller.close() else controller.enqueue(chunk.toUint8Array())
+        }
+    }
+    source.cancel = { _: dynamic -> pump.cancel() }
+    val strategy: dynamic = js("({ highWaterMark: 0 })")
+    return js("new ReadableStream(source, strategy)")
+}
+
+/**
+ * A WHATWG `WritableStream<Uint8Array>` feeding [upload] through a [ChunkSource].
+ *
+ * [upload] starts right away. Each `write()` resolves once [upload] has taken
+ * the chunk, `close()` once [upload] has finished, and both reject with its
+ * error if it fails. `abort()` cancels it.
+ */
+@OptIn(DelicateCoroutinesApi::class)
+internal fun writableStream(
+    options: UploadOptions,
+    upload: suspend (ChunkSource) -> Unit,
+): dynamic {
+    val chunks = Channel<ByteArray>(1)
+    // A retry resumes at most one chunk in flight plus the read-ahead behind the reader.
+    val source = StreamChunkSource(chunks, options.chunkSize.toLong() * (options.readAhead + 2))
+    val job =
+        GlobalScope.async {
+            try {
+                upload(source)
+            } finally {
+                chunks.cancel()
+            }
+        }
+    val sink: dynamic = js("({})")
+    sink.write = { chunk: Uint8Array ->
+        GlobalScope.promise {
+            try {
+                chunks.send(chunk.toByteArray())
+            } catch (e: CancellationException) {
+                // The upload ended early; report why rather than the closed channel.
+                job.await()
+                throw e
+            }
+        }
+    }
+    sink.close = {
+        chunks.close()
+        GlobalScope.promise { job.await() }
+    }
+    sink.abort = { _: dynamic -> job.cancel() }
+    return js("new WritableStream(sink)")
+}
+
+/** View a Kotlin `ByteArray` (an `Int8Array` in JS) as `Uint8Array`, without copying. */
+private fun ByteArray.toUint8Array(): Uint8Array {
+    val bytes = unsafeCast<Int8Array>()
+    return Uint8Array(bytes.buffer, bytes.byteOffset, bytes.length)
+}
+
+/** View a `Uint8Array` as a Kotlin `ByteArray`, without copying. */
+private fun Uint8Array.toByteArray(): ByteArray = Int8Array(buffer, byteOffset, length).unsafeCast<ByteArray>()
@@ -0,0 +1,3 @@
+package dev.rolandh.krfiles
+
+internal actual fun sha256(): Digest = Sha256()
@@ -0,0 +1,17 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.HttpClientConfig
+import io.ktor.client.engine.js.Js
+
+/**
+ * JS implementation using the fetch-based engine. Connections are managed by
+ * the browser or Node.js, so only the request timeout applies.
+ */
+internal actual fun createHttpClient(
+    config: ClientConfig,
+    block: HttpClientConfig<*>.() -> Unit,
+): HttpClient = HttpClient(Js, block)
+
+/** Browsers and Node's fetch negotiate compression and decompress bodies themselves. */
+internal actual val engineDecompresses: Boolean = true
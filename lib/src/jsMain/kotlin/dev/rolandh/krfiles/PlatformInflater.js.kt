@@ -0,0 +1,5 @@
+package dev.rolandh.krfiles
+
+/** Never called: fetch decompresses responses itself (see [engineDecompresses]). */
+internal actual fun platformInflater(zlibHeader: Boolean): Inflater =
+    throw UnsupportedOperationException("fetch decompresses responses itself")
@@ -0,0 +1,61 @@
+package dev.rolandh.krfiles
+
+import kotlinx.browser.localStorage
+import kotlinx.serialization.encodeToString
+import kotlinx.serialization.json.Json
+
+/**
+ * JS implementation of MetadataStore.
+ *
+ * Uses localStorage in browser environments.
+ * Falls back to in-memory storage in Node.js, which only lasts for the process.
+ */
+public actual fun createPlatformMetadataStore(): MetadataStore = JsMetadataStore()
+
+internal class JsMetadataStore : MetadataStore {
+    private val json =
+        Json {
+            ignoreUnknownKeys = true
+        }
+
+    private val storageKey = "krfiles_metadata"
+
+    // In-memory fallback for Node.js where localStorage isn't available
+    private val inMemoryData = mutableMapOf<String, Map<String, CachedResource>>()
+
+    private fun isLocalStorageAvailable(): Boolean =
+        try {
+            js("typeof localStorage !== 'undefined'") as Boolean
+        } catch (e: Exception) {
+            false
+        }
+
+    override fun load(
+        serverUrl: String,
+        user: String,
+    ): Map<String, CachedResource> {
+        if (!isLocalStorageAvailable()) return inMemoryData["$serverUrl $user"].orEmpty()
+        return try {
+            val stored = localStorage.getItem("$storageKey:$serverUrl $user") ?: return emptyMap()
+            json.decodeFromString(stored)
+        } catch (e: Exception) {
+            emptyMap()
+        }
+    }
+
+    override fun save(
+        serverUrl: String,
+        user: String,
+        entries: Map<String, CachedResource>,
+    ) {
+        if (!isLocalStorageAvailable()) {
+            inMemoryData["$serverUrl $user"] = entries
+            return
+        }
+        try {
+            localStorage.setItem("$storageKey:$serverUrl $user", json.encodeToString(entries))
+        } catch (e: Exception) {
+            // Over quota: a cache is not worth failing for.
+        }
+    }
+}
@@ -0,0 +1,148 @@
+package dev.rolandh.krfiles
+
+import kotlinx.benchmark.Benchmark
+import kotlinx.benchmark.BenchmarkMode
+import kotlinx.benchmark.Blackhole
+import kotlinx.benchmark.Mode
+import kotlinx.benchmark.Param
+import kotlinx.benchmark.Scope
+import kotlinx.benchmark.Setup
+import kotlinx.benchmark.State
+import kotlinx.benchmark.TearDown
+import kotlinx.coroutines.runBlocking
+import kotlinx.serialization.json.Json
+
+/*
+ * Throughput benchmarks against the stand-in server in bench/mockserver.py.
+ *
+ * Start the server first (`python3 bench/mockserver.py`), or point
+ * KRFILES_BENCH_URL at one. Scores are operations per second; multiply by
+ * `size` for bytes per second of the transfer benchmarks.
+ */
+
+/** Encoder configured like the native exports' JSON. */
+private val exportJson = Json { encodeDefaults = true }
+
+private val benchUrl: String = System.getenv("KRFILES_BENCH_URL") ?: "http://127.0.0.1:8765"
+
+/** A logged-in client per benchmark state. */
+private fun benchClient(): FilebrowserClient =
+    FilebrowserClient(benchUrl).also { client ->
+        runBlocking { client.login("bench", "bench").getOrThrow() }
+    }
+
+/** Listing and search of directories with [entries] files. */
+@State(Scope.Benchmark)
+@BenchmarkMode(Mode.Throughput)
+public class ListingBenchmark {
+    @Param("1000", "10000", "100000")
+    public var entries: Int = 0
+
+    private lateinit var client: FilebrowserClient
+
+    @Setup
+    public fun setUp() {
+        client = benchClient()
+    }
+
+    @TearDown
+    public fun tearDown() {
+        client.close()
+    }
+
+    @Benchmark
+    public fun listDirectory(blackhole: Blackhole): Unit =
+        runBlocking {
+            blackhole.consume(client.listDirectory("/tree-$entries").getOrThrow())
+        }
+
+    /** What the C API used to do: decode the listing, then encode it again for the caller. */
+    @Benchmark
+    public fun listDirectoryReencoded(blackhole: Blackhole): Unit =
+        runBlocking {
+            val resource = client.listDirectory("/tree-$entries").getOrThrow()
+            blackhole.consume(exportJson.encodeToString(Resource.serializer(), resource))
+        }
+
+    /** The C API's passthrough: the body as the server sent it. */
+    @Benchmark
+    public fun listDirectoryJson(blackhole: Blackhole): Unit =
+        runBlocking {
+            blackhole.consume(client.listDirectoryJson("/tree-$entries").getOrThrow())
+        }
+
+    @Benchmark
+    public fun search(blackhole: Blackhole): Unit =
+        runBlocking {
+            blackhole.consume(client.search("file", "/tree-$entries").getOrThrow())
+        }
+
+    @Benchmark
+    public fun searchJson(blackhole: Blackhole): Unit =
+        runBlocking {
+            blackhole.consume(client.searchJson("file", "/tree-$entries").getOrThrow())
+        }
+}
+
+/** Streaming download and resumable upload of a [size]-byte file. */
+@State(Scope.Benchmark)
+@BenchmarkMode(Mode.Throughput)
+public class TransferBenchmark {
+    @Param("1024", "1048576", "67108864")
+    public var size: Long = 0
+
+    private lateinit var client: FilebrowserClient
+
+    // Synthetic upload content, so large sizes need no memory.
+    private val source = ChunkSource { position, _, length -> minOf(length.toLong(), size - position).toInt() }
+
+    @Setup
+    public fun setUp() {
+        client = benchClient()
+    }
+
+    @TearDown
+    public fun tearDown() {
+        client.close()
+    }
+
+    @Benchmark
+    public fun download(): Long =
+        runBlocking {
+            client.download("/blob-$size.bin") { _, _ -> }.getOrThrow()
+        }
+
+    @Benchmark
+    public fun upload(): Unit =
+        runBlocking {
+            client.uploadResumable("/upload.bin", size, source).getOrThrow()
+        }
+}
+
+/** Small operations issued as one batch of [operations] renames. */
+@State(Scope.Benchmark)
+@BenchmarkMode(Mode.Throughput)
+public class BatchBenchmark {
+    @Param("100", "1000")
+    public var operations: Int = 0
+
+    private lateinit var client: FilebrowserClient
+    private lateinit var batch: List<BatchOperation>
+
+    @Setup
+    public fun setUp() {
+        client = benchClient()
+        batch = List(operations) { BatchOperation(BatchOpKind.RENAME, "/a-$it", destination = "/b-$it") }
+    }
+
+    @TearDown
+    public fun tearDown() {
+        client.close()
+    }
+
+    @Benchmark
+    public fun batch(): BatchReport =
+        runBlocking {
+            client.batch(batch).getOrThrow()
+        }
+}
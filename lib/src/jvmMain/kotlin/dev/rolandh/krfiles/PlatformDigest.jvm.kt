@@ -0,0 +1,16 @@
+package dev.rolandh.krfiles
+
+import java.security.MessageDigest
+
+internal actual fun sha256(): Digest =
+    object : Digest {
+        private val digest = MessageDigest.getInstance("SHA-256")
+
+        override fun update(
+            buffer: ByteArray,
+            offset: Int,
+            length: Int,
+        ) = digest.update(buffer, offset, length)
+
+        override fun hex(): String = digest.digest().joinToString("") { "%02x".format(it) }
+    }
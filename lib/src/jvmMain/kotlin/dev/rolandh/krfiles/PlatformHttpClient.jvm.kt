@@ -0,0 +1,27 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.HttpClientConfig
+import io.ktor.client.engine.cio.CIO
+
+/**
+ * JVM implementation using the CIO engine, which pools HTTP/1.1 connections
+ * per route and applies every [ClientConfig] setting.
+ */
+internal actual fun createHttpClient(
+    config: ClientConfig,
+    block: HttpClientConfig<*>.() -> Unit,
+): HttpClient =
+    HttpClient(CIO) {
+        engine {
+            config.maxConnections?.let { maxConnectionsCount = it }
+            endpoint {
+                config.maxConnectionsPerHost?.let { maxConnectionsPerRoute = it }
+                config.keepAliveMillis?.let { keepAliveTime = it }
+            }
+        }
+        block()
+    }
+
+/** CIO passes bodies through as sent; [installCompression] decodes them. */
+internal actual val engineDecompresses: Boolean = false
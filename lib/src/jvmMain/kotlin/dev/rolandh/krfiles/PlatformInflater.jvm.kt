@@ -0,0 +1,23 @@
+package dev.rolandh.krfiles
+
+/** JVM implementation over [java.util.zip.Inflater], which wraps the JDK's zlib. */
+internal actual fun platformInflater(zlibHeader: Boolean): Inflater =
+    object : Inflater {
+        private val inflater = java.util.zip.Inflater(!zlibHeader)
+
+        override val finished: Boolean
+            get() = inflater.finished()
+
+        override val needsInput: Boolean
+            get() = inflater.needsInput()
+
+        override fun setInput(
+            buffer: ByteArray,
+            offset: Int,
+            length: Int,
+        ) = inflater.setInput(buffer, offset, length)
+
+        override fun inflate(output: ByteArray): Int = inflater.inflate(output)
+
+        override fun end() = inflater.end()
+    }
@@ -0,0 +1,60 @@
+package dev.rolandh.krfiles
+
+import kotlinx.serialization.encodeToString
+import kotlinx.serialization.json.Json
+import java.io.File
+import java.nio.file.Files
+import java.nio.file.StandardCopyOption
+
+/**
+ * JVM implementation of MetadataStore using the file system.
+ *
+ * Stores cached metadata in `~/.config/krfiles/metadata.json`, next to the credentials,
+ * readable only by its owner.
+ */
+public actual fun createPlatformMetadataStore(): MetadataStore = FileMetadataStore()
+
+internal class FileMetadataStore : MetadataStore {
+    private val json =
+        Json {
+            ignoreUnknownKeys = true
+        }
+
+    private val configDir: File by lazy {
+        val userHome = System.getProperty("user.home")
+        File(userHome, ".config/krfiles").also { it.mkdirs() }
+    }
+
+    private val metadataFile: File by lazy {
+        File(configDir, "metadata.json")
+    }
+
+    private fun readData(): Map<String, Map<String, CachedResource>> =
+        try {
+            json.decodeFromString(metadataFile.readText())
+        } catch (e: Exception) {
+            emptyMap()
+        }
+
+    override fun load(
+        serverUrl: String,
+        user: String,
+    ): Map<String, CachedResource> = readData()["$serverUrl $user"].orEmpty()
+
+    override fun save(
+        serverUrl: String,
+        user: String,
+        entries: Map<String, CachedResource>,
+    ) {
+        val data = readData() + ("$serverUrl $user" to entries)
+        // Write a uniquely named file beside the real one and rename it over, so readers never see
+        // half a file. On POSIX systems createTempFile makes it readable only by its owner.
+        val part = Files.createTempFile(configDir.toPath(), "metadata.json.", ".part")
+        try {
+            Files.writeString(part, json.encodeToString(data))
+            Files.move(part, metadataFile.toPath(), StandardCopyOption.REPLACE_EXISTING, StandardCopyOption.ATOMIC_MOVE)
+        } finally {
+            Files.deleteIfExists(part)
+        }
+    }
+}
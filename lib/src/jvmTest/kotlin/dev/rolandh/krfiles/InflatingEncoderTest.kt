@@ -0,0 +1,108 @@
+package dev.rolandh.krfiles
+
+import io.ktor.client.HttpClient
+import io.ktor.client.engine.mock.MockEngine
+import io.ktor.client.engine.mock.respond
+import io.ktor.http.HttpHeaders
+import io.ktor.http.HttpStatusCode
+import io.ktor.http.headersOf
+import kotlinx.coroutines.test.runTest
+import java.io.ByteArrayOutputStream
+import java.util.zip.DeflaterOutputStream
+import java.util.zip.GZIPOutputStream
+import kotlin.test.Test
+import kotlin.test.assertContentEquals
+import kotlin.test.assertEquals
+import kotlin.test.assertTrue
+
+/**
+ * Tests for [InflatingEncoder] against bodies compressed by the JDK.
+ */
+class InflatingEncoderTest {
+    private fun gzip(data: ByteArray) =
+        ByteArrayOutputStream().also { GZIPOutputStream(it).use { out -> out.write(data) } }.toByteArray()
+
+    private fun deflate(data: ByteArray) =
+        ByteArrayOutputStream().also { DeflaterOutputStream(it).use { out -> out.write(data) } }.toByteArray()
+
+    private val listing =
+        (1..5000)
+            .joinToString(",", """{"path":"/big","isDir":true,"items":[""", "]}") {
+                """{"name":"file-$it.txt","path":"/big/file-$it.txt","size":$it,"isDir":false}"""
+            }.encodeToByteArray()
+
+    private fun client(
+        body: ByteArray,
+        encoding: String,
+        metrics: ClientMetrics,
+    ): Pair<FilebrowserClient, MutableList<String?>> {
+        val acceptEncodings = mutableListOf<String?>()
+        val engine =
+            MockEngine { request ->
+                acceptEncodings += request.headers[HttpHeaders.AcceptEncoding]
+                respond(
+                    body,
+                    HttpStatusCode.OK,
+                    headersOf(
+                        HttpHeaders.ContentEncoding to listOf(encoding),
+                        HttpHeaders.ContentType to listOf("application/json"),
+                    ),
+                )
+            }
+        val httpClient = HttpClient(engine) { installCompression(metrics) }
+        val client = FilebrowserClient("http://mock", httpClient).also { it.setToken("test-token") }
+        return client to acceptEncodings
+    }
+
+    @Test
+    fun testDecodesGzipListing() =
+        runTest {
+            val metrics = ClientMetrics()
+            val compressed = gzip(listing)
+            val (client, acceptEncodings) = client(compressed, "gzip", metrics)
+
+            val resource = client.listDirectory("/big").getOrThrow()
+
+            assertEquals(5000, resource.items?.size)
+            assertTrue(acceptEncodings.single()!!.contains("gzip"))
+            val stats = metrics.snapshot().compression
+            assertEquals(1, stats.responses)
+            assertEquals(compressed.size.toLong(), stats.compressedBytes)
+            assertEquals(listing.size.toLong(), stats.decompressedBytes)
+            assertTrue(stats.ratio > 5)
+            client.close()
+        }
+
+    @Test
+    fun testDecodesDeflateIntoStream() =
+        runTest {
+            val (client, _) = client(deflate(listing), "deflate", ClientMetrics())
+
+            val names = mutableListOf<String>()
+            client.listDirectoryStream("/big").collect { names += it.name }
+
+            assertEquals(5000, names.size)
+            assertEquals("file-5000.txt", names.last())
+            client.close()
+        }
+
+    @Test
+    fun testDecodesCompressedDownload() =
+        runTest {
+            val content = ByteArray(200_000) { (it % 7).toByte() }
+            val (client, _) = client(gzip(content), "gzip", ClientMetrics())
+
+            assertContentEquals(content, client.download("/file.bin").getOrThrow())
+            client.close()
+        }
+
+    @Test
+    fun testTruncatedBodyFails() =
+        runTest {
+            val compressed = gzip(listing)
+            val (client, _) = client(compressed.copyOf(compressed.size / 2), "gzip", ClientMetrics())
+
+            assertTrue(client.listDirectory("/big").isFailure)
+            client.close()
+        }
+}
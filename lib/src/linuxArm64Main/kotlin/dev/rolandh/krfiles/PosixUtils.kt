@@ -1,9 +1,17 @@
 package dev.rolandh.krfiles
 
 import kotlinx.cinterop.ExperimentalForeignApi
+import platform.posix.S_IFMT
 import platform.posix.mkdir
+import platform.posix.stat
 
 @OptIn(ExperimentalForeignApi::class)
 internal actual fun ensureDirExists(path: String) {
     mkdir(path, 493u) // 0755
 }
+
+@OptIn(ExperimentalForeignApi::class)
+internal actual fun fileType(st: stat): Int = st.st_mode.toInt() and S_IFMT
+
+@OptIn(ExperimentalForeignApi::class)
+internal actual fun modifiedSeconds(st: stat): Long = st.st_mtim.tv_sec
@@ -0,0 +1,57 @@
+@file:OptIn(ExperimentalForeignApi::class, ExperimentalNativeApi::class)
+
+package dev.rolandh.krfiles
+
+import dev.rolandh.krfiles.libcrypto.krfiles_sha256_final
+import dev.rolandh.krfiles.libcrypto.krfiles_sha256_free
+import dev.rolandh.krfiles.libcrypto.krfiles_sha256_new
+import dev.rolandh.krfiles.libcrypto.krfiles_sha256_update
+import kotlinx.cinterop.COpaquePointer
+import kotlinx.cinterop.ExperimentalForeignApi
+import kotlinx.cinterop.addressOf
+import kotlinx.cinterop.convert
+import kotlinx.cinterop.reinterpret
+import kotlinx.cinterop.usePinned
+import kotlin.experimental.ExperimentalNativeApi
+import kotlin.native.ref.createCleaner
+
+/**
+ * Linux implementation over OpenSSL's libcrypto, which uses the CPU's SHA
+ * extensions where available; [Sha256] if libcrypto can't be loaded.
+ */
+internal actual fun sha256(): Digest = krfiles_sha256_new()?.let(::EvpSha256) ?: Sha256()
+
+private class EvpSha256(
+    private val context: COpaquePointer,
+) : Digest {
+    // Freed when the digest is collected, whether or not hex() was reached.
+    @Suppress("unused")
+    private val cleaner = createCleaner(context) { krfiles_sha256_free(it) }
+
+    override fun update(
+        buffer: ByteArray,
+        offset: Int,
+        length: Int,
+    ) {
+        if (length == 0) return
+        buffer.usePinned { pinned ->
+            check(krfiles_sha256_update(context, pinned.addressOf(offset), length.convert()) == 1) {
+                "EVP_DigestUpdate failed"
+            }
+        }
+    }
+
+    override fun hex(): String {
+        val hash = ByteArray(HASH_SIZE)
+        hash.usePinned { pinned ->
+            check(krfiles_sha256_final(context, pinned.addressOf(0).reinterpret()) == 1) {
+                "EVP_DigestFinal_ex failed"
+            }
+        }
+        return hash.joinToString("") { it.toUByte().toString(16).padStart(2, '0') }
+    }
+
+    private companion object {
+        const val HASH_SIZE = 32
+    }
+}
@@ -0,0 +1,107 @@
+@file:OptIn(ExperimentalForeignApi::class)
+
+package dev.rolandh.krfiles
+
+import kotlinx.cinterop.ExperimentalForeignApi
+import kotlinx.cinterop.addressOf
+import kotlinx.cinterop.alloc
+import kotlinx.cinterop.convert
+import kotlinx.cinterop.memScoped
+import kotlinx.cinterop.ptr
+import kotlinx.cinterop.usePinned
+import kotlinx.coroutines.sync.Mutex
+import kotlinx.coroutines.sync.withLock
+import platform.posix.O_CREAT
+import platform.posix.O_TRUNC
+import platform.posix.O_WRONLY
+import platform.posix.fstat
+import platform.posix.ftruncate
+import platform.posix.pwrite
+import platform.posix.stat
+
+/**
+ * [ChunkSink] backed by a local file descriptor.
+ *
+ * Uses `pwrite` so segments can be written concurrently to their own regions,
+ * and `ftruncate` to size the file up front. It remembers which regions were
+ * written, so a failed download can be cut back to the part that is complete.
+ */
+internal class LocalFileSink private constructor(
+    private val fd: Int,
+    val path: String,
+    /** Size of the file when it was opened. */
+    val initialSize: Long,
+) : ChunkSink {
+    private val mutex = Mutex()
+
+    // End -> start of each written region; sequential writes extend a region in place.
+    private val regions = mutableMapOf<Long, Long>()
+
+    override suspend fun allocate(size: Long) {
+        check(ftruncate(fd, size.convert()) == 0) { "Failed to resize $path to $size bytes" }
+    }
+
+    override suspend fun write(
+        position: Long,
+        buffer: ByteArray,
+        length: Int,
+    ) {
+        var written = 0
+        buffer.usePinned { pinned ->
+            while (written < length) {
+                val remaining = length - written
+                val count = pwrite(fd, pinned.addressOf(written), remaining.convert(), (position + written).convert())
+                check(count > 0) { "Failed to write to $path at offset ${position + written}" }
+                written += count.toInt()
+            }
+        }
+        mutex.withLock {
+            val start = regions.remove(position) ?: position
+            regions[position + length] = start
+        }
+    }
+
+    /** End of the contiguous data written from [from], e.g. to keep only that much on failure. */
+    suspend fun completeUntil(from: Long): Long =
+        mutex.withLock {
+            val starts = regions.entries.associate { (end, start) -> start to end }
+            var end = from
+            while (true) end = starts[end] ?: break
+            end
+        }
+
+    /** Cut the file to [size] bytes. */
+    fun truncate(size: Long) {
+        check(ftruncate(fd, size.convert()) == 0) { "Failed to resize $path to $size bytes" }
+    }
+
+    fun close() {
+        platform.posix.close(fd)
+    }
+
+    companion object {
+        /**
+         * Open [path] for writing, creating it if missing. The existing content is
+         * kept if [keep], for resuming; otherwise the file is emptied.
+         * Returns null if it can't be opened or stat'ed.
+         */
+        fun open(
+            path: String,
+            keep: Boolean,
+        ): LocalFileSink? {
+            val flags = O_WRONLY or O_CREAT or (if (keep) 0 else O_TRUNC)
+            val fd = platform.posix.open(path, flags, 420) // 0644
+            if (fd < 0) return null
+            val size =
+                memScoped {
+                    val st = alloc<stat>()
+                    if (fstat(fd, st.ptr) != 0) null else st.st_size
+                }
+            if (size == null) {
+                platform.posix.close(fd)
+                return null
+            }
+            return LocalFileSink(fd, path, size)
+        }
+    }
+}
@@ -0,0 +1,66 @@
+@file:OptIn(ExperimentalForeignApi::class)
+
+package dev.rolandh.krfiles
+
+import kotlinx.cinterop.ExperimentalForeignApi
+import kotlinx.cinterop.addressOf
+import kotlinx.cinterop.alloc
+import kotlinx.cinterop.convert
+import kotlinx.cinterop.memScoped
+import kotlinx.cinterop.ptr
+import kotlinx.cinterop.usePinned
+import platform.posix.O_RDONLY
+import platform.posix.fstat
+import platform.posix.pread
+import platform.posix.stat
+
+/**
+ * [ChunkSource] backed by a local file descriptor.
+ *
+ * Uses `pread` so reads are positional and never load more than one chunk,
+ * and 64-bit `st_size` so files larger than 2 GB work.
+ */
+internal class LocalFileSource private constructor(
+    private val fd: Int,
+    val size: Long,
+) : ChunkSource {
+    override suspend fun read(
+        position: Long,
+        buffer: ByteArray,
+        length: Int,
+    ): Int {
+        var filled = 0
+        buffer.usePinned { pinned ->
+            while (filled < length) {
+                val remaining = length - filled
+                val read = pread(fd, pinned.addressOf(filled), remaining.convert(), (position + filled).convert())
+                check(read >= 0) { "Failed to read local file at offset ${position + filled}" }
+                if (read == 0L) break
+                filled += read.toInt()
+            }
+        }
+        return filled
+    }
+
+    fun close() {
+        platform.posix.close(fd)
+    }
+
+    companion object {
+        /** Open [path] for reading, or return null if it can't be opened or stat'ed. */
+        fun open(path: String): LocalFileSource? {
+            val fd = platform.posix.open(path, O_RDONLY)
+            if (fd < 0) return null
+            val size =
+                memScoped {
+                    val st = alloc<stat>()
+                    if (fstat(fd, st.ptr) != 0) null else st.st_size
+                }
+            if (size == null) {
+                platform.posix.close(fd)
+                return null
+            }
+            return LocalFileSource(fd, size)
+        }
+    }
+}
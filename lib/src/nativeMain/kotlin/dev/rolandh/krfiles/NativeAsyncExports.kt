@@ -0,0 +1,476 @@
+@file:OptIn(ExperimentalForeignApi::class)
+
+package dev.rolandh.krfiles
+
+import kotlinx.cinterop.ByteVar
+import kotlinx.cinterop.CFunction
+import kotlinx.cinterop.COpaquePointer
+import kotlinx.cinterop.CPointer
+import kotlinx.cinterop.ExperimentalForeignApi
+import kotlinx.cinterop.cstr
+import kotlinx.cinterop.invoke
+import kotlinx.cinterop.memScoped
+import kotlinx.cinterop.reinterpret
+import kotlinx.coroutines.CoroutineName
+import kotlinx.coroutines.CoroutineScope
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.IO
+import kotlinx.coroutines.SupervisorJob
+import kotlinx.coroutines.launch
+
+/**
+ * Non-blocking counterparts of the exports in `NativeExports.kt`.
+ *
+ * The blocking exports park the calling OS thread in [kotlinx.coroutines.runBlocking]
+ * for the whole HTTP round trip. These `native*Async` functions only *submit* the
+ * operation: it is launched on a process-wide coroutine scope and the function
+ * returns immediately. Since Ktor suspends while waiting on the network, a handful
+ * of dispatcher threads can keep thousands of requests in flight.
+ *
+ * ## Completion callback
+ *
+ * Each call takes a C completion callback, passed as an opaque pointer:
+ *
+ * ```c
+ * void (*)(void* user_data, bool ok, const char* result, const char* error)
+ * ```
+ *
+ * It is invoked exactly once, on a library-owned thread, when the operation
+ * finishes. On success `ok` is true and `result` holds the same value the blocking
+ * export would return (token, JSON, or NULL for operations without a result). On
+ * failure `ok` is false and `error` holds the message. Both strings are only valid
+ * for the duration of the callback — copy them if needed.
+ *
+ * A submit function returns false (and sets [nativeGetLastError]) only when the
+ * operation could not be started, e.g. for a null handle; the callback is then
+ * never invoked. Transfer progress callbacks run on the same library thread and
+ * receive the same `user_data`, always before the completion callback.
+ *
+ * Freeing a client with operations in flight is allowed: each still completes
+ * (typically with an error) and gets its callback.
+ */
+
+/** C signature of the completion callback accepted by the async exports. */
+private typealias NativeCompletionCallback =
+    CFunction<(COpaquePointer?, Boolean, CPointer<ByteVar>?, CPointer<ByteVar>?) -> Unit>
+
+/**
+ * Scope for all async operations. [SupervisorJob] keeps one failed operation from
+ * cancelling the others; [Dispatchers.IO] tolerates the blocking file I/O in transfers.
+ */
+internal val asyncScope = CoroutineScope(SupervisorJob() + Dispatchers.IO + CoroutineName("krfiles-async"))
+
+// --- Auth ---
+
+/** Login asynchronously; the callback receives the auth token. */
+public fun nativeLoginAsync(
+    handle: COpaquePointer?,
+    username: String,
+    password: String,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean = submit(handle, callback, userData) { login(username, password) }
+
+// --- Resources (complete with JSON) ---
+
+/** Get resource info asynchronously; the callback receives JSON. */
+public fun nativeGetResourceAsync(
+    handle: COpaquePointer?,
+    path: String,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean = submit(handle, callback, userData) { getResourceJson(path) }
+
+/** List directory contents asynchronously; the callback receives JSON. */
+public fun nativeListDirectoryAsync(
+    handle: COpaquePointer?,
+    path: String,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean = submit(handle, callback, userData) { listDirectoryJson(path) }
+
+/** Search asynchronously; the callback receives a JSON array of results. */
+public fun nativeSearchAsync(
+    handle: COpaquePointer?,
+    query: String,
+    path: String,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean = submit(handle, callback, userData) { searchJson(query, path) }
+
+/**
+ * Stream search results asynchronously. See [nativeSearchStream].
+ *
+ * [onResult] runs on a library thread, one result at a time, and always before
+ * the completion callback, which gets a NULL result. Both receive [userData].
+ */
+public fun nativeSearchStreamAsync(
+    handle: COpaquePointer?,
+    query: String,
+    path: String,
+    maxResults: Int,
+    onResult: COpaquePointer?,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean =
+    submit(handle, callback, userData) {
+        searchToCallback(this, query, path, maxResults, onResult, userData).map { null }
+    }
+
+// --- File Operations (complete with a NULL result) ---
+
+/** Stream a remote file to a local path asynchronously. See [nativeDownloadToFile]. */
+public fun nativeDownloadToFileAsync(
+    handle: COpaquePointer?,
+    remotePath: String,
+    localPath: String,
+    segments: Int,
+    resume: Boolean,
+    progress: COpaquePointer?,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean {
+    val listener = progress?.let { nativeProgress(it, userData) }
+    return submit(handle, callback, userData) {
+        downloadToFile(this, remotePath, localPath, listener, segments, resume).map { null }
+    }
+}
+
+/** Upload a local file in resumable chunks asynchronously. See [nativeUploadFromFile]. */
+public fun nativeUploadFromFileAsync(
+    handle: COpaquePointer?,
+    remotePath: String,
+    localPath: String,
+    override_: Boolean,
+    chunkSize: Int,
+    progress: COpaquePointer?,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean {
+    val listener = progress?.let { nativeProgress(it, userData) }
+    return submit(handle, callback, userData) {
+        uploadFromFile(this, remotePath, localPath, override_, chunkSize, listener).map { null }
+    }
+}
+
+/** Download a remote file as selected by transfer flags asynchronously. See [nativeDownloadFileEx]. */
+public fun nativeDownloadFileExAsync(
+    handle: COpaquePointer?,
+    remotePath: String,
+    localPath: String,
+    segments: Int,
+    flags: Int,
+    progress: COpaquePointer?,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean {
+    val listener = progress?.let { nativeProgress(it, userData) }
+    val resume = flags and TRANSFER_RESUME != 0
+    val verify = flags and TRANSFER_VERIFY != 0
+    return submit(handle, callback, userData) {
+        downloadToFile(this, remotePath, localPath, listener, segments, resume, verify).map { null }
+    }
+}
+
+/** Upload a local file as selected by transfer flags asynchronously. See [nativeUploadFileEx]. */
+public fun nativeUploadFileExAsync(
+    handle: COpaquePointer?,
+    remotePath: String,
+    localPath: String,
+    flags: Int,
+    chunkSize: Int,
+    progress: COpaquePointer?,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean {
+    val listener = progress?.let { nativeProgress(it, userData) }
+    return submit(handle, callback, userData) { uploadFileEx(this, remotePath, localPath, flags, chunkSize, listener) }
+}
+
+/** Hash a remote file asynchronously; the callback receives its SHA-256. */
+public fun nativeChecksumAsync(
+    handle: COpaquePointer?,
+    path: String,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean = submit(handle, callback, userData) { getChecksum(path) }
+
+/** Create a directory asynchronously. */
+public fun nativeCreateDirectoryAsync(
+    handle: COpaquePointer?,
+    path: String,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean = submit(handle, callback, userData) { createDirectory(path).map { null } }
+
+/** Delete a file or directory asynchronously. */
+public fun nativeDeleteAsync(
+    handle: COpaquePointer?,
+    path: String,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean = submit(handle, callback, userData) { delete(path).map { null } }
+
+/** Rename/move a file or directory asynchronously. */
+public fun nativeRenameAsync(
+    handle: COpaquePointer?,
+    source: String,
+    destination: String,
+    override_: Boolean,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean = submit(handle, callback, userData) { rename(source, destination, override_).map { null } }
+
+/** Copy a file or directory asynchronously. */
+public fun nativeCopyAsync(
+    handle: COpaquePointer?,
+    source: String,
+    destination: String,
+    override_: Boolean,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean = submit(handle, callback, userData) { copy(source, destination, override_).map { null } }
+
+// --- In-memory transfers (complete with a NULL result) ---
+
+/**
+ * Download into a caller buffer asynchronously. See [nativeDownloadToBuffer].
+ *
+ * [buffer] and [outLength] must stay valid until the callback runs.
+ */
+public fun nativeDownloadToBufferAsync(
+    handle: COpaquePointer?,
+    remotePath: String,
+    buffer: COpaquePointer?,
+    capacity: Long,
+    outLength: COpaquePointer?,
+    progress: COpaquePointer?,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean {
+    val listener = progress?.let { nativeProgress(it, userData) }
+    return submit(handle, callback, userData) {
+        downloadToBuffer(this, remotePath, buffer, capacity, outLength, listener).map { null }
+    }
+}
+
+/**
+ * Download into library-allocated memory asynchronously. See [nativeDownloadToMemory].
+ *
+ * [outData] and [outLength] are filled in before the callback runs and must stay
+ * valid until then.
+ */
+public fun nativeDownloadToMemoryAsync(
+    handle: COpaquePointer?,
+    remotePath: String,
+    outData: COpaquePointer?,
+    outLength: COpaquePointer?,
+    progress: COpaquePointer?,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean {
+    val listener = progress?.let { nativeProgress(it, userData) }
+    return submit(handle, callback, userData) {
+        downloadToMemory(this, remotePath, outData, outLength, listener).map { null }
+    }
+}
+
+/**
+ * Upload caller memory asynchronously. See [nativeUploadFromBuffer].
+ *
+ * [data] must stay valid until the callback runs.
+ */
+public fun nativeUploadFromBufferAsync(
+    handle: COpaquePointer?,
+    remotePath: String,
+    data: COpaquePointer?,
+    length: Long,
+    override_: Boolean,
+    chunkSize: Int,
+    progress: COpaquePointer?,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean {
+    val listener = progress?.let { nativeProgress(it, userData) }
+    return submit(handle, callback, userData) {
+        uploadFromBuffer(this, remotePath, data, length, override_, chunkSize, listener).map { null }
+    }
+}
+
+// --- Descriptor transfers ---
+
+/**
+ * Download to an open descriptor asynchronously. See [nativeDownloadToFd].
+ *
+ * [fd] must stay open until the callback runs.
+ */
+public fun nativeDownloadToFdAsync(
+    handle: COpaquePointer?,
+    remotePath: String,
+    fd: Int,
+    progress: COpaquePointer?,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean {
+    val listener = progress?.let { nativeProgress(it, userData) }
+    return submit(handle, callback, userData) {
+        downloadToFd(this, remotePath, fd, listener).map { null }
+    }
+}
+
+/**
+ * Upload from an open descriptor asynchronously. See [nativeUploadFromFd].
+ *
+ * [fd] must stay open until the callback runs.
+ */
+public fun nativeUploadFromFdAsync(
+    handle: COpaquePointer?,
+    remotePath: String,
+    fd: Int,
+    size: Long,
+    override_: Boolean,
+    chunkSize: Int,
+    progress: COpaquePointer?,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean {
+    val listener = progress?.let { nativeProgress(it, userData) }
+    return submit(handle, callback, userData) {
+        uploadFromFd(this, remotePath, fd, size, override_, chunkSize, listener).map { null }
+    }
+}
+
+// --- Tree walking ---
+
+/**
+ * Walk a tree asynchronously. See [nativeWalk].
+ *
+ * [onEntry] runs on a library thread, one entry at a time, and always before the
+ * completion callback. Both receive [userData].
+ */
+public fun nativeWalkAsync(
+    handle: COpaquePointer?,
+    root: String,
+    concurrency: Int,
+    onEntry: COpaquePointer?,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean =
+    submit(handle, callback, userData) {
+        walkToCallback(this, root, concurrency, onEntry, userData).map { null }
+    }
+
+// --- Directory sync ---
+
+/**
+ * Sync directories asynchronously; the callback receives the report JSON. See [nativeSync].
+ *
+ * [onAction] runs on a library thread, one step at a time, and always before the
+ * completion callback. Both receive [userData].
+ */
+public fun nativeSyncAsync(
+    handle: COpaquePointer?,
+    localRoot: String,
+    remoteRoot: String,
+    flags: Int,
+    concurrency: Int,
+    onAction: COpaquePointer?,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean =
+    submit(handle, callback, userData) {
+        syncDirectory(this, localRoot, remoteRoot, flags, concurrency, onAction, userData)
+    }
+
+// --- Directory archives ---
+
+/** Download a directory archive into a file asynchronously. See [nativeDownloadArchive]. */
+public fun nativeDownloadArchiveAsync(
+    handle: COpaquePointer?,
+    remotePath: String,
+    localPath: String,
+    format: String,
+    progress: COpaquePointer?,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean {
+    val listener = progress?.let { nativeProgress(it, userData) }
+    return submit(handle, callback, userData) {
+        downloadArchiveToFile(this, remotePath, localPath, format, listener).map { null }
+    }
+}
+
+/**
+ * Unpack a directory archive asynchronously; the callback receives the report
+ * JSON. See [nativeExtractArchive].
+ */
+public fun nativeExtractArchiveAsync(
+    handle: COpaquePointer?,
+    remotePath: String,
+    localDir: String,
+    filterJson: String?,
+    progress: COpaquePointer?,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean {
+    val listener = progress?.let { nativeProgress(it, userData) }
+    return submit(handle, callback, userData) {
+        extractArchiveToDirectory(this, remotePath, localDir, filterJson, listener)
+    }
+}
+
+// --- Batch operations ---
+
+/**
+ * Run a batch of operations asynchronously; the callback receives the report JSON.
+ * See [nativeBatch].
+ *
+ * [onResult] runs on a library thread, one result at a time, and always before the
+ * completion callback. Both receive [userData].
+ */
+public fun nativeBatchAsync(
+    handle: COpaquePointer?,
+    operationsJson: String,
+    concurrency: Int,
+    stopOnError: Boolean,
+    onResult: COpaquePointer?,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean =
+    submit(handle, callback, userData) {
+        batchToCallback(this, operationsJson, concurrency, stopOnError, onResult, userData)
+    }
+
+// --- Internal helpers ---
+
+/**
+ * Launch [operation] on [asyncScope] and report its outcome through [callback].
+ *
+ * Returns false without launching if the handle or callback is null.
+ */
+private fun submit(
+    handle: COpaquePointer?,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+    operation: suspend FilebrowserClient.() -> Result<String?>,
+): Boolean {
+    val client = clientOf(handle) ?: return false
+    if (callback == null) {
+        lastError = "Completion callback is null"
+        return false
+    }
+    val complete = callback.reinterpret<NativeCompletionCallback>()
+    asyncScope.launch {
+        // A throwing operation must still complete, or the caller would wait forever
+        val result = runCatching { client.operation() }.getOrElse { Result.failure(it) }
+        // memScoped frees the C string copies once the callback returns
+        memScoped {
+            result.fold(
+                onSuccess = { value -> complete(userData, true, value?.cstr?.ptr, null) },
+                onFailure = { e -> complete(userData, false, null, (e.message ?: "Unknown error").cstr.ptr) },
+            )
+        }
+    }
+    lastError = null
+    return true
+}
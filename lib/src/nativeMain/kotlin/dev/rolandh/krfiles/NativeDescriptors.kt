@@ -0,0 +1,127 @@
+@file:OptIn(ExperimentalForeignApi::class)
+
+package dev.rolandh.krfiles
+
+import kotlinx.cinterop.ExperimentalForeignApi
+import kotlinx.cinterop.addressOf
+import kotlinx.cinterop.convert
+import kotlinx.cinterop.usePinned
+import kotlinx.coroutines.async
+import kotlinx.coroutines.channels.Channel
+import kotlinx.coroutines.channels.SendChannel
+import platform.posix.EINTR
+import platform.posix.errno
+
+/*
+ * Descriptor transfers for the `*Fd` exports, e.g. a CLI's stdin and stdout.
+ *
+ * The descriptor may be a pipe, so it is only read or written sequentially, and
+ * it stays open: it belongs to the caller. Neither direction holds the whole file
+ * in memory; a download writes each chunk as it arrives, and an upload keeps no
+ * more than the tus read-ahead window of [UploadOptions].
+ */
+
+/** Download [remotePath] to [fd], writing each chunk as it arrives. */
+internal suspend fun downloadToFd(
+    client: FilebrowserClient,
+    remotePath: String,
+    fd: Int,
+    listener: TransferProgress?,
+): Result<Unit> {
+    if (fd < 0) return Result.failure(IllegalArgumentException("Invalid descriptor: $fd"))
+    return client.download(remotePath, progress = listener) { chunk, count -> writeFully(fd, chunk, count) }.map { }
+}
+
+/**
+ * Upload exactly [size] bytes read from [fd] to [remotePath] via tus; a [chunkSize]
+ * of 0 selects the default.
+ *
+ * Fails if [fd] ends before [size] bytes, and also if it has more: the first
+ * [size] bytes are uploaded by then, but the rest would be silently lost.
+ */
+internal suspend fun uploadFromFd(
+    client: FilebrowserClient,
+    remotePath: String,
+    fd: Int,
+    size: Long,
+    override_: Boolean,
+    chunkSize: Int,
+    listener: TransferProgress?,
+): Result<Unit> {
+    if (fd < 0 || size < 0) {
+        return Result.failure(IllegalArgumentException("Invalid descriptor: fd=$fd, size=$size"))
+    }
+    val options = uploadOptions(override_, chunkSize)
+    val chunks = Channel<ByteArray>(1)
+    // Not a child of the upload: a read blocked on an idle pipe must not hold up reporting its failure.
+    val reader = asyncScope.async { readChunks(fd, size, options.chunkSize, chunks) }
+    // A retry resumes at most one chunk in flight plus the read-ahead behind the reader.
+    val source = StreamChunkSource(chunks, options.chunkSize.toLong() * (options.readAhead + 2))
+    val result = client.uploadResumable(remotePath, size, source, options, listener)
+    if (result.isFailure) {
+        reader.cancel()
+        return result
+    }
+    return runCatching { reader.await() }
+}
+
+/** Send [size] bytes from [fd] to [chunks] in pieces of [chunkSize], then check that [fd] has ended. */
+private suspend fun readChunks(
+    fd: Int,
+    size: Long,
+    chunkSize: Int,
+    chunks: SendChannel<ByteArray>,
+) {
+    try {
+        var position = 0L
+        while (position < size) {
+            val buffer = ByteArray(minOf(chunkSize.toLong(), size - position).toInt())
+            val count = readFully(fd, buffer)
+            if (count > 0) chunks.send(if (count == buffer.size) buffer else buffer.copyOf(count))
+            position += count
+            if (count < buffer.size) break
+        }
+        if (position == size && readFully(fd, ByteArray(1)) > 0) {
+            throw UploadSourceException("Input is longer than $size bytes; only the first $size were uploaded")
+        }
+        chunks.close()
+    } catch (e: Exception) {
+        chunks.close(e)
+        throw e
+    }
+}
+
+/** Read from [fd] until [buffer] is full or the input ends; returns the bytes read. */
+private fun readFully(
+    fd: Int,
+    buffer: ByteArray,
+): Int {
+    var filled = 0
+    buffer.usePinned { pinned ->
+        while (filled < buffer.size) {
+            val read = platform.posix.read(fd, pinned.addressOf(filled), (buffer.size - filled).convert())
+            if (read < 0 && errno == EINTR) continue
+            if (read < 0) throw UploadSourceException("Failed to read descriptor $fd after $filled bytes")
+            if (read == 0L) break
+            filled += read.toInt()
+        }
+    }
+    return filled
+}
+
+/** Write the first [length] bytes of [buffer] to [fd]. */
+private fun writeFully(
+    fd: Int,
+    buffer: ByteArray,
+    length: Int,
+) {
+    var written = 0
+    buffer.usePinned { pinned ->
+        while (written < length) {
+            val count = platform.posix.write(fd, pinned.addressOf(written), (length - written).convert())
+            if (count < 0 && errno == EINTR) continue
+            check(count > 0) { "Failed to write to descriptor $fd" }
+            written += count.toInt()
+        }
+    }
+}
@@ -3,23 +3,32 @@
 package dev.rolandh.krfiles
 
 import kotlinx.cinterop.ByteVar
+import kotlinx.cinterop.CFunction
+import kotlinx.cinterop.COpaquePointer
 import kotlinx.cinterop.CPointer
 import kotlinx.cinterop.ExperimentalForeignApi
+import kotlinx.cinterop.StableRef
 import kotlinx.cinterop.addressOf
-import kotlinx.cinterop.allocArray
+import kotlinx.cinterop.asStableRef
+import kotlinx.cinterop.cstr
+import kotlinx.cinterop.invoke
 import kotlinx.cinterop.memScoped
-import kotlinx.cinterop.readBytes
+import kotlinx.cinterop.reinterpret
 import kotlinx.cinterop.usePinned
+import kotlinx.coroutines.flow.collect
+import kotlinx.coroutines.flow.takeWhile
 import kotlinx.coroutines.runBlocking
+import kotlinx.serialization.Serializable
+import kotlinx.serialization.decodeFromString
 import kotlinx.serialization.encodeToString
 import kotlinx.serialization.json.Json
 import platform.posix.FILE
 import platform.posix.fclose
 import platform.posix.fopen
-import platform.posix.fread
-import platform.posix.fseek
-import platform.posix.ftell
 import platform.posix.fwrite
+import platform.posix.remove
+import kotlin.native.concurrent.ThreadLocal
+import kotlin.time.TimeSource
 
 /**
  * C-exported wrapper functions for FFI consumers (Rust CLI).
@@ -55,55 +64,221 @@ import platform.posix.fwrite
  * a similar JSON bridge for years.
  *
  * Additionally, Kotlin `suspend` functions cannot be exported through C interop at
- * all. These wrappers use [runBlocking] to call them synchronously. The Rust side
- * compensates by calling these blocking functions from [tokio::task::spawn_blocking].
+ * all. These wrappers use [runBlocking] to call them synchronously. Callers that
+ * can't afford a parked thread per request use the `native*Async` variants in
+ * `NativeAsyncExports.kt`, which complete through a C callback instead.
+ *
+ * ## Handles and threads
+ *
+ * Each client is an opaque handle created by [nativeClientNew] (a [StableRef] to a
+ * [FilebrowserClient]) and released with [nativeClientFree]. Every call takes the
+ * handle, so one process can talk to several servers at once.
+ *
+ * All calls are safe to make concurrently, on the same handle or different ones:
+ * each call runs its own [runBlocking] on the calling thread, and the Ktor client
+ * underneath is thread-safe. The error message is thread-local — after a call
+ * fails, [nativeGetLastError] on the *same thread* returns its message.
+ * A handle must not be used after, or concurrently with, [nativeClientFree].
  *
  * ## File transfers
  *
- * Rather than passing raw byte arrays across the FFI boundary (which would require
- * manual buffer management), file transfers go through the filesystem:
- * - [nativeDownloadToFile]: Kotlin downloads and writes to a local path
- * - [nativeUploadFromFile]: Kotlin reads from a local path and uploads
+ * File transfers can go through the filesystem:
+ * - [nativeDownloadToFile]: Kotlin streams the download to a local path in chunks
+ * - [nativeUploadFromFile]: Kotlin reads from a local path in chunks and uploads via tus
+ *
+ * or through memory, for in-process pipelines that shouldn't touch the disk:
+ * - [nativeDownloadToBuffer]: into a caller-provided buffer of fixed capacity
+ * - [nativeDownloadToMemory]: into a buffer the library allocates and the caller frees
+ * - [nativeUploadFromBuffer]: from caller memory, borrowed for the duration of the call
+ *
+ * or through a descriptor such as a pipe, read or written in order and never closed:
+ * - [nativeDownloadToFd]: each chunk is written to the descriptor as it arrives
+ * - [nativeUploadFromFd]: a stated number of bytes is read from the descriptor as the upload needs them
+ *
+ * [nativeSync] transfers whole trees, only sending what changed since the last sync.
+ * [nativeBatch] runs many deletes, renames, copies and mkdirs in one call.
+ *
+ * ## Memory ownership
+ *
+ * Every `String` returned by an export is allocated by Kotlin/Native and must be
+ * released by the caller (`krfiles_free_string` in the C API). Buffers returned by
+ * [nativeDownloadToMemory] are `malloc`'d and released with `krfiles_free`.
+ * Caller-provided buffers are never retained after the call completes.
+ *
+ * Transfer functions accept an optional C progress callback
+ * `void (*)(int64_t transferred, int64_t total, void* user_data)`, passed as an
+ * opaque pointer because Kotlin/Native cannot export function pointer types.
  */
 
-private var globalClient: FilebrowserClient? = null
-private var lastError: String? = null
+/** Error from the most recent failed call on the current thread. */
+@ThreadLocal
+internal var lastError: String? = null
 
-private val exportJson =
+internal val exportJson =
     Json {
         ignoreUnknownKeys = true
         isLenient = true
         encodeDefaults = true
     }
 
+/** Encode [value] with [exportJson], counting the time in the client's `encode` stats. */
+internal inline fun <reified T> FilebrowserClient.encodeTimed(value: T): String {
+    val start = TimeSource.Monotonic.markNow()
+    return exportJson.encodeToString(value).also { recordEncode(start.elapsedNow()) }
+}
+
 // --- Lifecycle ---
 
-/** Create a new client for the given server URL. Closes any previous client. */
-public fun nativeCreateClient(baseUrl: String) {
-    globalClient?.close()
-    globalClient = FilebrowserClient(baseUrl)
+/** Create a new client for the given server URL and return its handle. */
+public fun nativeClientNew(baseUrl: String): COpaquePointer {
     lastError = null
+    return StableRef.create(FilebrowserClient(baseUrl)).asCPointer()
 }
 
-/** Destroy the client and free resources. */
-public fun nativeDestroyClient() {
-    globalClient?.close()
-    globalClient = null
+/**
+ * Create a client with a metadata cache of [maxEntries] paths, each served for
+ * [ttlMillis] before it is revalidated. With [persistent], the cache is loaded from
+ * and saved to the platform store, so it carries over between processes.
+ */
+public fun nativeClientNewCached(
+    baseUrl: String,
+    maxEntries: Int,
+    ttlMillis: Long,
+    persistent: Boolean,
+): COpaquePointer? {
+    if (maxEntries <= 0 || ttlMillis < 0) {
+        lastError = "maxEntries must be positive and ttlMillis non-negative"
+        return null
+    }
     lastError = null
+    val options =
+        CacheOptions(
+            maxEntries = maxEntries,
+            ttlMillis = ttlMillis,
+            store = if (persistent) createPlatformMetadataStore() else null,
+        )
+    return StableRef.create(FilebrowserClient(baseUrl, cache = options)).asCPointer()
+}
+
+/** Metadata cache settings read by [nativeClientNewEx] alongside the [ClientConfig] fields. */
+@Serializable
+private data class NativeCacheConfig(
+    val cacheEntries: Int = 0,
+    val cacheTtlMillis: Long = 0,
+    val persistentCache: Boolean = false,
+)
+
+/**
+ * Create a client configured by [configJson], a JSON object holding any
+ * [ClientConfig], [SchedulerOptions] and [RetryOptions] fields plus `cacheEntries`,
+ * `cacheTtlMillis` and `persistentCache` (as in [nativeClientNewCached]), for
+ * example `{"connectTimeoutMillis": 5000, "maxBytesPerSecond": 10485760}`.
+ * Missing fields keep their defaults; the cache is off unless `cacheEntries` is positive.
+ */
+public fun nativeClientNewEx(
+    baseUrl: String,
+    configJson: String?,
+): COpaquePointer? {
+    val json = configJson ?: "{}"
+    val parsed =
+        runCatching {
+            Triple(
+                exportJson.decodeFromString<ClientConfig>(json),
+                exportJson.decodeFromString<SchedulerOptions>(json),
+                exportJson.decodeFromString<NativeCacheConfig>(json),
+            ) to exportJson.decodeFromString<RetryOptions>(json)
+        }
+    val (options, retry) =
+        parsed.getOrElse {
+            lastError = "Invalid client config: ${it.message}"
+            return null
+        }
+    val (config, scheduler, cacheConfig) = options
+    if (cacheConfig.cacheEntries < 0 || cacheConfig.cacheTtlMillis < 0) {
+        lastError = "cacheEntries and cacheTtlMillis must be non-negative"
+        return null
+    }
+    lastError = null
+    val cache =
+        if (cacheConfig.cacheEntries == 0) {
+            null
+        } else {
+            CacheOptions(
+                maxEntries = cacheConfig.cacheEntries,
+                ttlMillis = cacheConfig.cacheTtlMillis,
+                store = if (cacheConfig.persistentCache) createPlatformMetadataStore() else null,
+            )
+        }
+    val client =
+        FilebrowserClient(baseUrl, cache = cache, config = config, scheduler = scheduler, retry = retry)
+    return StableRef.create(client).asCPointer()
+}
+
+/** Get the metadata cache counters as JSON, or null if the client has no cache. */
+public fun nativeCacheStats(handle: COpaquePointer?): String? {
+    val client = clientOf(handle) ?: return null
+    lastError = null
+    return client.cacheStats?.let { exportJson.encodeToString(it) }
+}
+
+/** Get the request metrics as a ClientStats JSON object, or null if [handle] is null. */
+public fun nativeGetStats(handle: COpaquePointer?): String? =
+    runBlocking {
+        val client = clientOf(handle) ?: return@runBlocking null
+        lastError = null
+        exportJson.encodeToString(client.stats())
+    }
+
+/** Zero the request metrics. Returns false if [handle] is null. */
+public fun nativeResetStats(handle: COpaquePointer?): Boolean =
+    runBlocking {
+        val client = clientOf(handle) ?: return@runBlocking false
+        lastError = null
+        client.resetStats()
+        true
+    }
+
+/**
+ * Call [callback] with a RequestTrace JSON object as each request on [handle]
+ * finishes, from the thread that completed it. A null [callback] stops tracing.
+ * [userData] is passed back untouched; it must stay valid while tracing is on.
+ */
+public fun nativeSetTraceCallback(
+    handle: COpaquePointer?,
+    callback: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean {
+    val client = clientOf(handle) ?: return false
+    lastError = null
+    val trace = callback?.reinterpret<NativeTraceCallback>()
+    client.traceListener =
+        trace?.let {
+            RequestTraceListener { event -> memScoped { it(userData, exportJson.encodeToString(event).cstr.ptr) } }
+        }
+    return true
 }
 
-/** Get the last error message, or null if no error. */
+/** Close the client behind [handle] and release the handle. Null is ignored. */
+public fun nativeClientFree(handle: COpaquePointer?) {
+    if (handle == null) return
+    val ref = handle.asStableRef<FilebrowserClient>()
+    ref.get().close()
+    ref.dispose()
+}
+
+/** Get the last error message on the calling thread, or null if no error. */
 public fun nativeGetLastError(): String? = lastError
 
 // --- Auth ---
 
 /** Login and return the auth token, or null on failure (check [nativeGetLastError]). */
 public fun nativeLogin(
+    handle: COpaquePointer?,
     username: String,
     password: String,
 ): String? =
     runBlocking {
-        val client = requireClient() ?: return@runBlocking null
+        val client = clientOf(handle) ?: return@runBlocking null
         client.login(username, password).fold(
             onSuccess = { token ->
                 lastError = null
@@ -117,32 +292,41 @@ public fun nativeLogin(
     }
 
 /** Set the auth token directly (e.g. restored from storage). */
-public fun nativeSetToken(token: String): Boolean {
-    val client = requireClient() ?: return false
+public fun nativeSetToken(
+    handle: COpaquePointer?,
+    token: String,
+): Boolean {
+    val client = clientOf(handle) ?: return false
     client.setToken(token)
     return true
 }
 
 /** Log out and clear the auth token. */
-public fun nativeLogout(): Boolean {
-    val client = requireClient() ?: return false
+public fun nativeLogout(handle: COpaquePointer?): Boolean {
+    val client = clientOf(handle) ?: return false
     client.logout()
     return true
 }
 
 /** Check if the client is authenticated. */
-public fun nativeIsAuthenticated(): Boolean = globalClient?.isAuthenticated ?: false
+public fun nativeIsAuthenticated(handle: COpaquePointer?): Boolean = clientOf(handle)?.isAuthenticated ?: false
 
 // --- Resources (return JSON) ---
+//
+// These hand over the server's response body as-is (see FilebrowserClient.getResourceJson),
+// skipping a decode and re-encode that FFI callers would only undo with their own parser.
 
 /** Get resource info as JSON, or null on failure. */
-public fun nativeGetResource(path: String): String? =
+public fun nativeGetResource(
+    handle: COpaquePointer?,
+    path: String,
+): String? =
     runBlocking {
-        val client = requireClient() ?: return@runBlocking null
-        client.getResource(path).fold(
-            onSuccess = { resource ->
+        val client = clientOf(handle) ?: return@runBlocking null
+        client.getResourceJson(path).fold(
+            onSuccess = { json ->
                 lastError = null
-                exportJson.encodeToString(resource)
+                json
             },
             onFailure = { e ->
                 lastError = e.message
@@ -152,13 +336,16 @@ public fun nativeGetResource(path: String): String? =
     }
 
 /** List directory contents as JSON, or null on failure. */
-public fun nativeListDirectory(path: String): String? =
+public fun nativeListDirectory(
+    handle: COpaquePointer?,
+    path: String,
+): String? =
     runBlocking {
-        val client = requireClient() ?: return@runBlocking null
-        client.listDirectory(path).fold(
-            onSuccess = { resource ->
+        val client = clientOf(handle) ?: return@runBlocking null
+        client.listDirectoryJson(path).fold(
+            onSuccess = { json ->
                 lastError = null
-                exportJson.encodeToString(resource)
+                json
             },
             onFailure = { e ->
                 lastError = e.message
@@ -169,15 +356,16 @@ public fun nativeListDirectory(path: String): String? =
 
 /** Search for files, returns JSON array of results, or null on failure. */
 public fun nativeSearch(
+    handle: COpaquePointer?,
     query: String,
     path: String,
 ): String? =
     runBlocking {
-        val client = requireClient() ?: return@runBlocking null
-        client.search(query, path).fold(
-            onSuccess = { results ->
+        val client = clientOf(handle) ?: return@runBlocking null
+        client.searchJson(query, path).fold(
+            onSuccess = { json ->
                 lastError = null
-                exportJson.encodeToString(results)
+                json
             },
             onFailure = { e ->
                 lastError = e.message
@@ -186,18 +374,66 @@ public fun nativeSearch(
         )
     }
 
+/**
+ * Search for files, passing each result to [onResult] as soon as it is decoded.
+ * Returns true once the search completes.
+ *
+ * [onResult] is a C callback `bool (*)(void* user_data, const char* result_json)`
+ * invoked with one SearchResult object at a time; the JSON is only valid during
+ * the call. After [maxResults] results (0 for no limit), or when the callback
+ * returns false, the request is cancelled; that still counts as success.
+ */
+public fun nativeSearchStream(
+    handle: COpaquePointer?,
+    query: String,
+    path: String,
+    maxResults: Int,
+    onResult: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean =
+    runBlocking {
+        val client = clientOf(handle) ?: return@runBlocking false
+        searchToCallback(client, query, path, maxResults, onResult, userData).fold(
+            onSuccess = {
+                lastError = null
+                true
+            },
+            onFailure = { e ->
+                lastError = e.message
+                false
+            },
+        )
+    }
+
 // --- File Operations ---
 
-/** Download a remote file and save to a local path. Returns true on success. */
+/**
+ * Download a remote file and stream it to a local path. Returns true on success.
+ *
+ * Chunks are written as they arrive, so memory use is flat regardless of file size.
+ * A partially written file is removed on failure.
+ *
+ * With [segments] > 1 the file is preallocated and fetched as that many parallel
+ * range requests. With [resume], an existing local file is continued from its
+ * current size and, on failure, kept up to its last complete byte for the next
+ * attempt. Either falls back to a single stream if the server ignores `Range`.
+ */
 public fun nativeDownloadToFile(
+    handle: COpaquePointer?,
     remotePath: String,
     localPath: String,
+    segments: Int,
+    resume: Boolean,
+    progress: COpaquePointer?,
+    userData: COpaquePointer?,
 ): Boolean =
     runBlocking {
-        val client = requireClient() ?: return@runBlocking false
-        client.download(remotePath).fold(
-            onSuccess = { bytes ->
-                writeLocalFile(localPath, bytes)
+        val client = clientOf(handle) ?: return@runBlocking false
+        val listener = progress?.let { nativeProgress(it, userData) }
+        downloadToFile(client, remotePath, localPath, listener, segments, resume).fold(
+            onSuccess = {
+                lastError = null
+                true
             },
             onFailure = { e ->
                 lastError = e.message
@@ -206,20 +442,59 @@ public fun nativeDownloadToFile(
         )
     }
 
-/** Upload a local file to a remote path. Returns true on success. */
+/**
+ * Upload a local file to a remote path in resumable chunks. Returns true on success.
+ *
+ * The file is read with positional reads in [chunkSize] pieces (pass 0 for the
+ * default), so memory stays flat and files over 2 GB work.
+ */
 public fun nativeUploadFromFile(
+    handle: COpaquePointer?,
     remotePath: String,
     localPath: String,
     override_: Boolean,
+    chunkSize: Int,
+    progress: COpaquePointer?,
+    userData: COpaquePointer?,
 ): Boolean =
     runBlocking {
-        val client = requireClient() ?: return@runBlocking false
-        val bytes = readLocalFile(localPath)
-        if (bytes == null) {
-            lastError = "Failed to read local file: $localPath"
-            return@runBlocking false
-        }
-        client.upload(remotePath, bytes, override_).fold(
+        val client = clientOf(handle) ?: return@runBlocking false
+        val listener = progress?.let { nativeProgress(it, userData) }
+        uploadFromFile(client, remotePath, localPath, override_, chunkSize, listener).fold(
+            onSuccess = {
+                lastError = null
+                true
+            },
+            onFailure = { e ->
+                lastError = e.message
+                false
+            },
+        )
+    }
+
+/**
+ * Download a remote file to a local path as selected by [flags]. Returns true on success.
+ *
+ * [flags] is a bitmask: 1 resumes an existing local file as in [nativeDownloadToFile],
+ * 2 verifies the file against the server's SHA-256. A fresh download is hashed as
+ * it is written and fetched as one stream, whatever [segments] says; a resumed
+ * one is hashed from disk once complete. A file that fails verification is removed.
+ */
+public fun nativeDownloadFileEx(
+    handle: COpaquePointer?,
+    remotePath: String,
+    localPath: String,
+    segments: Int,
+    flags: Int,
+    progress: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean =
+    runBlocking {
+        val client = clientOf(handle) ?: return@runBlocking false
+        val listener = progress?.let { nativeProgress(it, userData) }
+        val resume = flags and TRANSFER_RESUME != 0
+        val verify = flags and TRANSFER_VERIFY != 0
+        downloadToFile(client, remotePath, localPath, listener, segments, resume, verify).fold(
             onSuccess = {
                 lastError = null
                 true
@@ -231,10 +506,63 @@ public fun nativeUploadFromFile(
         )
     }
 
+/**
+ * Upload a local file in resumable chunks as selected by [flags]. Returns
+ * `{"skipped": bool}`, or null on failure.
+ *
+ * [flags] is a bitmask: 4 replaces an existing remote file, 8 skips the upload
+ * when the remote file has the same size and SHA-256 as the local one.
+ */
+public fun nativeUploadFileEx(
+    handle: COpaquePointer?,
+    remotePath: String,
+    localPath: String,
+    flags: Int,
+    chunkSize: Int,
+    progress: COpaquePointer?,
+    userData: COpaquePointer?,
+): String? =
+    runBlocking {
+        val client = clientOf(handle) ?: return@runBlocking null
+        val listener = progress?.let { nativeProgress(it, userData) }
+        uploadFileEx(client, remotePath, localPath, flags, chunkSize, listener).fold(
+            onSuccess = { outcome ->
+                lastError = null
+                outcome
+            },
+            onFailure = { e ->
+                lastError = e.message
+                null
+            },
+        )
+    }
+
+/** Have the server hash [path]; returns its SHA-256 as hex, or null on failure. */
+public fun nativeChecksum(
+    handle: COpaquePointer?,
+    path: String,
+): String? =
+    runBlocking {
+        val client = clientOf(handle) ?: return@runBlocking null
+        client.getChecksum(path).fold(
+            onSuccess = { checksum ->
+                lastError = null
+                checksum
+            },
+            onFailure = { e ->
+                lastError = e.message
+                null
+            },
+        )
+    }
+
 /** Create a directory. Returns true on success. */
-public fun nativeCreateDirectory(path: String): Boolean =
+public fun nativeCreateDirectory(
+    handle: COpaquePointer?,
+    path: String,
+): Boolean =
     runBlocking {
-        val client = requireClient() ?: return@runBlocking false
+        val client = clientOf(handle) ?: return@runBlocking false
         client.createDirectory(path).fold(
             onSuccess = {
                 lastError = null
@@ -248,9 +576,12 @@ public fun nativeCreateDirectory(path: String): Boolean =
     }
 
 /** Delete a file or directory. Returns true on success. */
-public fun nativeDelete(path: String): Boolean =
+public fun nativeDelete(
+    handle: COpaquePointer?,
+    path: String,
+): Boolean =
     runBlocking {
-        val client = requireClient() ?: return@runBlocking false
+        val client = clientOf(handle) ?: return@runBlocking false
         client.delete(path).fold(
             onSuccess = {
                 lastError = null
@@ -265,12 +596,13 @@ public fun nativeDelete(path: String): Boolean =
 
 /** Rename/move a file or directory. Returns true on success. */
 public fun nativeRename(
+    handle: COpaquePointer?,
     source: String,
     destination: String,
     override_: Boolean,
 ): Boolean =
     runBlocking {
-        val client = requireClient() ?: return@runBlocking false
+        val client = clientOf(handle) ?: return@runBlocking false
         client.rename(source, destination, override_).fold(
             onSuccess = {
                 lastError = null
@@ -285,12 +617,13 @@ public fun nativeRename(
 
 /** Copy a file or directory. Returns true on success. */
 public fun nativeCopy(
+    handle: COpaquePointer?,
     source: String,
     destination: String,
     override_: Boolean,
 ): Boolean =
     runBlocking {
-        val client = requireClient() ?: return@runBlocking false
+        val client = clientOf(handle) ?: return@runBlocking false
         client.copy(source, destination, override_).fold(
             onSuccess = {
                 lastError = null
@@ -303,52 +636,632 @@ public fun nativeCopy(
         )
     }
 
+// --- In-memory transfers ---
+
+/**
+ * Download a remote file into a caller-provided [buffer] of [capacity] bytes.
+ *
+ * [outLength] (`int64_t*`) receives the number of bytes written, or -1 if the file
+ * did not fit, in which case the call fails.
+ */
+public fun nativeDownloadToBuffer(
+    handle: COpaquePointer?,
+    remotePath: String,
+    buffer: COpaquePointer?,
+    capacity: Long,
+    outLength: COpaquePointer?,
+    progress: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean =
+    runBlocking {
+        val client = clientOf(handle) ?: return@runBlocking false
+        val listener = progress?.let { nativeProgress(it, userData) }
+        downloadToBuffer(client, remotePath, buffer, capacity, outLength, listener).fold(
+            onSuccess = {
+                lastError = null
+                true
+            },
+            onFailure = { e ->
+                lastError = e.message
+                false
+            },
+        )
+    }
+
+/**
+ * Download a remote file into memory allocated by the library.
+ *
+ * On success [outData] (`void**`) receives the buffer and [outLength] (`int64_t*`)
+ * its size. The caller owns the buffer and releases it with `krfiles_free`.
+ */
+public fun nativeDownloadToMemory(
+    handle: COpaquePointer?,
+    remotePath: String,
+    outData: COpaquePointer?,
+    outLength: COpaquePointer?,
+    progress: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean =
+    runBlocking {
+        val client = clientOf(handle) ?: return@runBlocking false
+        val listener = progress?.let { nativeProgress(it, userData) }
+        downloadToMemory(client, remotePath, outData, outLength, listener).fold(
+            onSuccess = {
+                lastError = null
+                true
+            },
+            onFailure = { e ->
+                lastError = e.message
+                false
+            },
+        )
+    }
+
+/**
+ * Upload [length] bytes of caller memory at [data] in resumable chunks.
+ *
+ * The memory is only read during the call and never retained.
+ */
+public fun nativeUploadFromBuffer(
+    handle: COpaquePointer?,
+    remotePath: String,
+    data: COpaquePointer?,
+    length: Long,
+    override_: Boolean,
+    chunkSize: Int,
+    progress: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean =
+    runBlocking {
+        val client = clientOf(handle) ?: return@runBlocking false
+        val listener = progress?.let { nativeProgress(it, userData) }
+        uploadFromBuffer(client, remotePath, data, length, override_, chunkSize, listener).fold(
+            onSuccess = {
+                lastError = null
+                true
+            },
+            onFailure = { e ->
+                lastError = e.message
+                false
+            },
+        )
+    }
+
+// --- Descriptor transfers ---
+
+/**
+ * Download a remote file to the open descriptor [fd], e.g. stdout.
+ *
+ * Chunks are written in order as they arrive; the descriptor is not closed.
+ */
+public fun nativeDownloadToFd(
+    handle: COpaquePointer?,
+    remotePath: String,
+    fd: Int,
+    progress: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean =
+    runBlocking {
+        val client = clientOf(handle) ?: return@runBlocking false
+        val listener = progress?.let { nativeProgress(it, userData) }
+        downloadToFd(client, remotePath, fd, listener).fold(
+            onSuccess = {
+                lastError = null
+                true
+            },
+            onFailure = { e ->
+                lastError = e.message
+                false
+            },
+        )
+    }
+
+/**
+ * Upload exactly [size] bytes read from the open descriptor [fd], e.g. stdin, in
+ * resumable chunks.
+ *
+ * Only the tus read-ahead is held in memory. Fails if the input is shorter or
+ * longer than [size]; the descriptor is not closed.
+ */
+public fun nativeUploadFromFd(
+    handle: COpaquePointer?,
+    remotePath: String,
+    fd: Int,
+    size: Long,
+    override_: Boolean,
+    chunkSize: Int,
+    progress: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean =
+    runBlocking {
+        val client = clientOf(handle) ?: return@runBlocking false
+        val listener = progress?.let { nativeProgress(it, userData) }
+        uploadFromFd(client, remotePath, fd, size, override_, chunkSize, listener).fold(
+            onSuccess = {
+                lastError = null
+                true
+            },
+            onFailure = { e ->
+                lastError = e.message
+                false
+            },
+        )
+    }
+
+// --- Tree walking ---
+
+/**
+ * Recursively walk the tree under [root], listing up to [concurrency] directories
+ * in parallel (0 selects the default). Returns true once the walk completes.
+ *
+ * [onEntry] is a C callback `bool (*)(void* user_data, const char* entry_json)`
+ * invoked for every entry, one at a time; the JSON is only valid during the call.
+ * Returning false stops the walk early, which still counts as success.
+ */
+public fun nativeWalk(
+    handle: COpaquePointer?,
+    root: String,
+    concurrency: Int,
+    onEntry: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean =
+    runBlocking {
+        val client = clientOf(handle) ?: return@runBlocking false
+        walkToCallback(client, root, concurrency, onEntry, userData).fold(
+            onSuccess = {
+                lastError = null
+                true
+            },
+            onFailure = { e ->
+                lastError = e.message
+                false
+            },
+        )
+    }
+
+// --- Directory sync ---
+
+/**
+ * Sync the local directory [localRoot] with the remote directory [remoteRoot] and
+ * return the report as JSON, or null on failure.
+ *
+ * [flags] is a bitmask: 1 pulls instead of pushing, 2 only plans (dry run), 4
+ * ignores the manifest and lists every remote directory. Up to [concurrency]
+ * files are transferred at once (0 selects the default).
+ *
+ * [onAction] is an optional C callback `void (*)(void* user_data, const char* action_json)`
+ * invoked after each step, one at a time; the JSON is only valid during the call.
+ * A failed step is reported there and in the result, and does not fail the sync.
+ */
+public fun nativeSync(
+    handle: COpaquePointer?,
+    localRoot: String,
+    remoteRoot: String,
+    flags: Int,
+    concurrency: Int,
+    onAction: COpaquePointer?,
+    userData: COpaquePointer?,
+): String? =
+    runBlocking {
+        val client = clientOf(handle) ?: return@runBlocking null
+        syncDirectory(client, localRoot, remoteRoot, flags, concurrency, onAction, userData).fold(
+            onSuccess = { report ->
+                lastError = null
+                report
+            },
+            onFailure = { e ->
+                lastError = e.message
+                null
+            },
+        )
+    }
+
+// --- Directory archives ---
+
+/**
+ * Download [remotePath] as one archive into the file [localPath]. Returns true on success.
+ *
+ * [format] is `zip`, `tar` or `targz`. The archive is written as it arrives and
+ * removed again if the download fails.
+ */
+public fun nativeDownloadArchive(
+    handle: COpaquePointer?,
+    remotePath: String,
+    localPath: String,
+    format: String,
+    progress: COpaquePointer?,
+    userData: COpaquePointer?,
+): Boolean =
+    runBlocking {
+        val client = clientOf(handle) ?: return@runBlocking false
+        val listener = progress?.let { nativeProgress(it, userData) }
+        downloadArchiveToFile(client, remotePath, localPath, format, listener).fold(
+            onSuccess = {
+                lastError = null
+                true
+            },
+            onFailure = { e ->
+                lastError = e.message
+                false
+            },
+        )
+    }
+
+/**
+ * Download the directory [remotePath] as a tar archive and unpack it into
+ * [localDir] while it arrives; returns the ExtractReport JSON, or null on failure.
+ *
+ * [filterJson] is an optional ArchiveFilter object, e.g.
+ * `{"include": ["*.jpg"], "exclude": ["thumbs"]}`; null extracts everything.
+ * See [FilebrowserClient.extractArchive].
+ */
+public fun nativeExtractArchive(
+    handle: COpaquePointer?,
+    remotePath: String,
+    localDir: String,
+    filterJson: String?,
+    progress: COpaquePointer?,
+    userData: COpaquePointer?,
+): String? =
+    runBlocking {
+        val client = clientOf(handle) ?: return@runBlocking null
+        val listener = progress?.let { nativeProgress(it, userData) }
+        extractArchiveToDirectory(client, remotePath, localDir, filterJson, listener).fold(
+            onSuccess = { report ->
+                lastError = null
+                report
+            },
+            onFailure = { e ->
+                lastError = e.message
+                null
+            },
+        )
+    }
+
+// --- Batch operations ---
+
+/**
+ * Run a batch of operations and return the report as JSON, or null if the batch
+ * could not start (malformed JSON, invalid arguments).
+ *
+ * [operationsJson] is a JSON array of BatchOperation objects such as
+ * `{"op":"rename","path":"/a","destination":"/b"}`. Up to [concurrency]
+ * operations run at once (0 selects the default); with [stopOnError], operations
+ * not started when one fails are skipped. A failed operation does not fail the
+ * call: the report holds one BatchResult per operation, in order.
+ *
+ * [onResult] is an optional C callback `void (*)(void* user_data, const char* result_json)`
+ * invoked as each operation finishes, one at a time; the JSON is only valid during the call.
+ */
+public fun nativeBatch(
+    handle: COpaquePointer?,
+    operationsJson: String,
+    concurrency: Int,
+    stopOnError: Boolean,
+    onResult: COpaquePointer?,
+    userData: COpaquePointer?,
+): String? =
+    runBlocking {
+        val client = clientOf(handle) ?: return@runBlocking null
+        batchToCallback(client, operationsJson, concurrency, stopOnError, onResult, userData).fold(
+            onSuccess = { report ->
+                lastError = null
+                report
+            },
+            onFailure = { e ->
+                lastError = e.message
+                null
+            },
+        )
+    }
+
 // --- Internal helpers ---
 
-private fun requireClient(): FilebrowserClient? {
-    val client = globalClient
-    if (client == null) {
-        lastError = "Client not initialized. Call nativeCreateClient() first."
+// Flag bits of the transfer `flags` arguments, mirrored in krfiles.h.
+internal const val TRANSFER_RESUME = 1
+internal const val TRANSFER_VERIFY = 2
+internal const val TRANSFER_OVERRIDE = 4
+internal const val TRANSFER_SKIP_IDENTICAL = 8
+
+/** Resolve a handle to its client, recording an error for null handles. */
+internal fun clientOf(handle: COpaquePointer?): FilebrowserClient? {
+    if (handle == null) {
+        lastError = "Client handle is null. Call nativeClientNew() first."
+        return null
     }
-    return client
+    return handle.asStableRef<FilebrowserClient>().get()
+}
+
+/** Stream [remotePath] into [localPath], removing the partial file on failure. */
+internal suspend fun downloadToFile(
+    client: FilebrowserClient,
+    remotePath: String,
+    localPath: String,
+    listener: TransferProgress?,
+    segments: Int = 1,
+    resume: Boolean = false,
+    verify: Boolean = false,
+): Result<Unit> {
+    if (segments > 1 || resume || verify) {
+        return downloadRangedToFile(client, remotePath, localPath, listener, segments, resume, verify)
+    }
+    val file: CPointer<FILE> =
+        fopen(localPath, "wb")
+            ?: return Result.failure(IllegalStateException("Failed to open file for writing: $localPath"))
+    val result =
+        try {
+            client.download(remotePath, progress = listener) { buffer, length ->
+                writeChunk(file, localPath, buffer, length)
+            }
+        } finally {
+            fclose(file)
+        }
+    if (result.isFailure) remove(localPath)
+    return result.map { }
+}
+
+/**
+ * Download [remotePath] into [localPath] with range requests, in up to [segments]
+ * parallel parts. With [resume], an existing file is continued from its current
+ * size, and on failure the file is cut back to its complete prefix so the next
+ * attempt can resume; without it, the file is replaced and removed on failure.
+ *
+ * With [verify], a download from the start is hashed as it arrives; a resumed
+ * one has no hash of its existing prefix, so the finished file is hashed from
+ * disk instead. A file whose checksum does not match is removed either way.
+ */
+private suspend fun downloadRangedToFile(
+    client: FilebrowserClient,
+    remotePath: String,
+    localPath: String,
+    listener: TransferProgress?,
+    segments: Int,
+    resume: Boolean,
+    verify: Boolean,
+): Result<Unit> {
+    val sink =
+        LocalFileSink.open(localPath, keep = resume)
+            ?: return Result.failure(IllegalStateException("Failed to open file for writing: $localPath"))
+    val offset = if (resume) sink.initialSize else 0L
+    val options = DownloadOptions(offset = offset, segments = maxOf(segments, 1), verify = verify && offset == 0L)
+    var result =
+        try {
+            client
+                .downloadRanged(remotePath, sink, options, listener)
+                // Also drops stale bytes past the end if the server resent the whole file.
+                .mapCatching { size -> sink.truncate(size) }
+                .onFailure { e ->
+                    if (resume && e !is ChecksumMismatchException) {
+                        runCatching { sink.truncate(sink.completeUntil(offset)) }
+                    }
+                }
+        } finally {
+            sink.close()
+        }
+    if (verify && !options.verify) result = result.mapCatching { verifyLocalFile(client, remotePath, localPath) }
+    if (result.isFailure && (!resume || result.exceptionOrNull() is ChecksumMismatchException)) remove(localPath)
+    return result
+}
+
+/** Compare the SHA-256 of [localPath] with the server's for [remotePath]. */
+private suspend fun verifyLocalFile(
+    client: FilebrowserClient,
+    remotePath: String,
+    localPath: String,
+) {
+    val source = checkNotNull(LocalFileSource.open(localPath)) { "Failed to read local file: $localPath" }
+    val actual =
+        try {
+            hashSource(source, source.size)
+        } finally {
+            source.close()
+        }
+    val expected = client.getChecksum(remotePath).getOrThrow()
+    if (actual != expected) throw ChecksumMismatchException(remotePath, expected, actual)
 }
 
-private fun readLocalFile(path: String): ByteArray? {
-    val file: CPointer<FILE>? = fopen(path, "rb")
-    if (file == null) return null
+/**
+ * Upload [localPath] to [remotePath] via tus; a [chunkSize] of 0 selects the default.
+ * With [skipIdentical], nothing is sent if the remote file already matches, and
+ * the result is true.
+ */
+internal suspend fun uploadFromFile(
+    client: FilebrowserClient,
+    remotePath: String,
+    localPath: String,
+    override_: Boolean,
+    chunkSize: Int,
+    listener: TransferProgress?,
+    skipIdentical: Boolean = false,
+): Result<Boolean> {
+    val source =
+        LocalFileSource.open(localPath)
+            ?: return Result.failure(IllegalStateException("Failed to read local file: $localPath"))
     return try {
-        fseek(file, 0, platform.posix.SEEK_END)
-        val size = ftell(file).toInt()
-        fseek(file, 0, platform.posix.SEEK_SET)
-        if (size <= 0) return ByteArray(0)
-        memScoped {
-            val buffer = allocArray<ByteVar>(size)
-            val read = fread(buffer, 1u, size.toULong(), file)
-            buffer.readBytes(read.toInt())
+        if (skipIdentical) {
+            val identical = client.matchesRemote(remotePath, source.size, source)
+            if (identical.getOrElse { return Result.failure(it) }) {
+                listener?.onProgress(source.size, source.size)
+                return Result.success(true)
+            }
         }
+        client
+            .uploadResumable(remotePath, source.size, source, uploadOptions(override_, chunkSize), listener)
+            .map { false }
     } finally {
-        fclose(file)
+        source.close()
     }
 }
 
-private fun writeLocalFile(
+/** [uploadFromFile] with its options taken from C transfer [flags]; returns the outcome as JSON. */
+internal suspend fun uploadFileEx(
+    client: FilebrowserClient,
+    remotePath: String,
+    localPath: String,
+    flags: Int,
+    chunkSize: Int,
+    listener: TransferProgress?,
+): Result<String> {
+    val override = flags and TRANSFER_OVERRIDE != 0
+    val skipIdentical = flags and TRANSFER_SKIP_IDENTICAL != 0
+    return uploadFromFile(client, remotePath, localPath, override, chunkSize, listener, skipIdentical)
+        .map { skipped -> exportJson.encodeToString(UploadOutcome(skipped)) }
+}
+
+/** Result of [nativeUploadFileEx]. */
+@Serializable
+private data class UploadOutcome(
+    val skipped: Boolean,
+)
+
+/** Feed every entry of a [FilebrowserClient.walk] to a C callback until it returns false. */
+internal suspend fun walkToCallback(
+    client: FilebrowserClient,
+    root: String,
+    concurrency: Int,
+    onEntry: COpaquePointer?,
+    userData: COpaquePointer?,
+): Result<Unit> =
+    runCatching {
+        val callback = checkNotNull(onEntry) { "Entry callback is null" }.reinterpret<NativeWalkCallback>()
+        val parallelism = if (concurrency > 0) concurrency else FilebrowserClient.DEFAULT_WALK_CONCURRENCY
+        client
+            .walk(root, parallelism)
+            .takeWhile { entry ->
+                // memScoped frees the C copy of the JSON once the callback returns
+                memScoped { callback(userData, client.encodeTimed(entry).cstr.ptr) }
+            }.collect()
+    }
+
+/** Feed search results to a C callback until it returns false or [maxResults] were sent. */
+internal suspend fun searchToCallback(
+    client: FilebrowserClient,
+    query: String,
     path: String,
-    data: ByteArray,
-): Boolean {
-    val file: CPointer<FILE>? = fopen(path, "wb")
-    if (file == null) {
-        lastError = "Failed to open file for writing: $path"
-        return false
+    maxResults: Int,
+    onResult: COpaquePointer?,
+    userData: COpaquePointer?,
+): Result<Unit> =
+    runCatching {
+        val callback = checkNotNull(onResult) { "Result callback is null" }.reinterpret<NativeWalkCallback>()
+        client
+            .searchJsonStream(query, path, maxOf(maxResults, 0))
+            .takeWhile { result ->
+                // memScoped frees the C copy of the JSON once the callback returns
+                memScoped { callback(userData, result.cstr.ptr) }
+            }.collect()
     }
-    return try {
-        // usePinned pins the ByteArray in memory so the GC won't move it
-        // while the C function (fwrite) is reading from it
-        data.usePinned { pinned ->
-            fwrite(pinned.addressOf(0), 1u, data.size.toULong(), file)
+
+/** Download [remotePath] as a [format] archive into [localPath], removing the file on failure. */
+internal suspend fun downloadArchiveToFile(
+    client: FilebrowserClient,
+    remotePath: String,
+    localPath: String,
+    format: String,
+    listener: TransferProgress?,
+): Result<Unit> {
+    val archiveFormat =
+        ArchiveFormat.entries.firstOrNull { it.algo == format }
+            ?: return Result.failure(IllegalArgumentException("Unknown archive format: $format"))
+    val file: CPointer<FILE> =
+        fopen(localPath, "wb")
+            ?: return Result.failure(IllegalStateException("Failed to open file for writing: $localPath"))
+    val result =
+        try {
+            client.downloadArchive(remotePath, archiveFormat, progress = listener) { buffer, length ->
+                writeChunk(file, localPath, buffer, length)
+            }
+        } finally {
+            fclose(file)
         }
-        lastError = null
-        true
-    } finally {
-        fclose(file)
+    if (result.isFailure) remove(localPath)
+    return result.map { }
+}
+
+/** Unpack [remotePath] into [localDir], creating it if needed, and return the report as JSON. */
+internal suspend fun extractArchiveToDirectory(
+    client: FilebrowserClient,
+    remotePath: String,
+    localDir: String,
+    filterJson: String?,
+    listener: TransferProgress?,
+): Result<String> =
+    runCatching {
+        val filter = filterJson?.let { exportJson.decodeFromString<ArchiveFilter>(it) } ?: ArchiveFilter()
+        ensureDirExists(localDir)
+        val report = client.extractArchive(remotePath, PosixLocalTree(localDir), filter, listener).getOrThrow()
+        client.encodeTimed(report)
+    }
+
+/** Decode [operationsJson], run the batch, and return the report as JSON. */
+internal suspend fun batchToCallback(
+    client: FilebrowserClient,
+    operationsJson: String,
+    concurrency: Int,
+    stopOnError: Boolean,
+    onResult: COpaquePointer?,
+    userData: COpaquePointer?,
+): Result<String> =
+    runCatching {
+        val operations = exportJson.decodeFromString<List<BatchOperation>>(operationsJson)
+        val options =
+            BatchOptions(
+                concurrency = if (concurrency > 0) concurrency else FilebrowserClient.DEFAULT_BATCH_CONCURRENCY,
+                stopOnError = stopOnError,
+            )
+        val callback = onResult?.reinterpret<NativeBatchCallback>()
+        val report =
+            client
+                .batch(operations, options) { result ->
+                    // memScoped frees the C copy of the JSON once the callback returns
+                    callback?.let { memScoped { it(userData, client.encodeTimed(result).cstr.ptr) } }
+                }.getOrThrow()
+        client.encodeTimed(report)
     }
+
+/** Upload options for the native exports; a [chunkSize] of 0 selects the default. */
+internal fun uploadOptions(
+    override_: Boolean,
+    chunkSize: Int,
+): UploadOptions =
+    UploadOptions(
+        chunkSize = if (chunkSize > 0) chunkSize else FilebrowserClient.DEFAULT_UPLOAD_CHUNK_SIZE,
+        override = override_,
+    )
+
+/** Write one chunk to an open file, failing loudly on a short write (e.g. disk full). */
+internal fun writeChunk(
+    file: CPointer<FILE>,
+    path: String,
+    buffer: ByteArray,
+    length: Int,
+) {
+    // usePinned pins the ByteArray in memory so the GC won't move it
+    // while the C function (fwrite) is reading from it
+    val written =
+        buffer.usePinned { pinned ->
+            fwrite(pinned.addressOf(0), 1u, length.toULong(), file)
+        }
+    check(written == length.toULong()) { "Failed to write to $path" }
+}
+
+/** C signature of the progress callback accepted by the transfer exports. */
+private typealias NativeProgressCallback = CFunction<(Long, Long, COpaquePointer?) -> Unit>
+
+/** C signature of the per-entry callback accepted by the walk and search stream exports. */
+private typealias NativeWalkCallback = CFunction<(COpaquePointer?, CPointer<ByteVar>?) -> Boolean>
+
+/** C signature of the per-request callback accepted by [nativeSetTraceCallback]. */
+private typealias NativeTraceCallback = CFunction<(COpaquePointer?, CPointer<ByteVar>?) -> Unit>
+
+/** C signature of the per-result callback accepted by the batch exports. */
+private typealias NativeBatchCallback = CFunction<(COpaquePointer?, CPointer<ByteVar>?) -> Unit>
+
+/** Adapt a C progress callback pointer to a [TransferProgress] listener. */
+internal fun nativeProgress(
+    callback: COpaquePointer,
+    userData: COpaquePointer?,
+): TransferProgress {
+    val function = callback.reinterpret<NativeProgressCallback>()
+    return TransferProgress { transferred, total -> function(transferred, total, userData) }
 }
@@ -0,0 +1,84 @@
+@file:OptIn(ExperimentalForeignApi::class)
+
+package dev.rolandh.krfiles
+
+import kotlinx.cinterop.COpaquePointer
+import kotlinx.cinterop.ExperimentalForeignApi
+import kotlinx.cinterop.StableRef
+import kotlinx.cinterop.asStableRef
+import kotlinx.coroutines.CancellationException
+import kotlinx.coroutines.Job
+import kotlinx.coroutines.channels.Channel
+import kotlinx.coroutines.launch
+import kotlinx.coroutines.runBlocking
+
+/*
+ * Streaming directory listings for the `nativeList*` exports: an iterator over
+ * [FilebrowserClient.listDirectoryStream] that C callers pull one entry at a time.
+ * Entries are handed over as the server's JSON, without decoding them.
+ */
+
+/** Entries decoded ahead of the caller; bounds memory for huge directories. */
+private const val LISTING_BUFFER = 256
+
+/** State behind a listing handle: entries fetched in the background, ready to be taken. */
+private class NativeListing(
+    val entries: Channel<String>,
+    val job: Job,
+)
+
+/**
+ * Start listing [path] and return an iterator handle for [nativeListNext], or
+ * null if [handle] is null. The request runs in the background; errors are
+ * reported by [nativeListNext]. Release the handle with [nativeListClose].
+ */
+public fun nativeListOpen(
+    handle: COpaquePointer?,
+    path: String,
+): COpaquePointer? {
+    val client = clientOf(handle) ?: return null
+    lastError = null
+    val entries = Channel<String>(LISTING_BUFFER)
+    val job =
+        asyncScope.launch {
+            try {
+                client.listDirectoryJsonStream(path).collect { entries.send(it) }
+                entries.close()
+            } catch (e: CancellationException) {
+                entries.cancel(e)
+                throw e
+            } catch (e: Exception) {
+                entries.close(e)
+            }
+        }
+    return StableRef.create(NativeListing(entries, job)).asCPointer()
+}
+
+/**
+ * Wait for the next entry of a listing and return it as Resource JSON.
+ *
+ * Returns null once the listing is exhausted, with no error set, or when it
+ * failed, with the message available from [nativeGetLastError].
+ */
+public fun nativeListNext(listing: COpaquePointer?): String? {
+    if (listing == null) {
+        lastError = "Listing handle is null. Call nativeListOpen() first."
+        return null
+    }
+    val state = listing.asStableRef<NativeListing>().get()
+    val result = runBlocking { state.entries.receiveCatching() }
+    result.getOrNull()?.let { entry ->
+        lastError = null
+        return entry
+    }
+    lastError = result.exceptionOrNull()?.let { it.message ?: it.toString() }
+    return null
+}
+
+/** Stop a listing, cancelling its request if still running, and release the handle. Null is ignored. */
+public fun nativeListClose(listing: COpaquePointer?) {
+    if (listing == null) return
+    val ref = listing.asStableRef<NativeListing>()
+    ref.get().job.cancel()
+    ref.dispose()
+}
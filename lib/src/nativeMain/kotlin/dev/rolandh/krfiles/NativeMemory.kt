@@ -0,0 +1,174 @@
+@file:OptIn(ExperimentalForeignApi::class)
+
+package dev.rolandh.krfiles
+
+import kotlinx.cinterop.ByteVar
+import kotlinx.cinterop.COpaquePointer
+import kotlinx.cinterop.COpaquePointerVar
+import kotlinx.cinterop.CPointer
+import kotlinx.cinterop.ExperimentalForeignApi
+import kotlinx.cinterop.LongVar
+import kotlinx.cinterop.addressOf
+import kotlinx.cinterop.convert
+import kotlinx.cinterop.plus
+import kotlinx.cinterop.reinterpret
+import kotlinx.cinterop.set
+import kotlinx.cinterop.usePinned
+import platform.posix.free
+import platform.posix.memcpy
+import platform.posix.realloc
+
+/*
+ * Caller-memory transfers for the `*Buffer` / `*Memory` exports.
+ *
+ * Ownership rules, mirrored in krfiles.h:
+ * - Caller-provided buffers are only borrowed for the duration of the operation.
+ * - Memory the library allocates for a result is allocated with `malloc` and
+ *   belongs to the caller, who releases it with `krfiles_free`.
+ */
+
+/** [ChunkSource] reading from caller-owned memory at [data] of [size] bytes. */
+internal class PointerChunkSource(
+    private val data: CPointer<ByteVar>,
+    val size: Long,
+) : ChunkSource {
+    override suspend fun read(
+        position: Long,
+        buffer: ByteArray,
+        length: Int,
+    ): Int {
+        if (position >= size) return 0
+        val count = minOf(length.toLong(), size - position).toInt()
+        buffer.usePinned { pinned ->
+            memcpy(pinned.addressOf(0), data + position, count.convert())
+        }
+        return count
+    }
+}
+
+/**
+ * Download sink that copies chunks into native memory.
+ *
+ * With a [fixed] caller buffer, writing past [capacity] fails. Otherwise the sink
+ * owns a `malloc`'d buffer that grows geometrically; hand it over with [release]
+ * or free it with [discard].
+ */
+internal class NativeByteSink private constructor(
+    private var data: CPointer<ByteVar>?,
+    private var capacity: Long,
+    private val fixed: Boolean,
+) {
+    /** Bytes written so far. */
+    var length: Long = 0
+        private set
+
+    fun append(
+        buffer: ByteArray,
+        count: Int,
+    ) {
+        val needed = length + count
+        if (needed > capacity) grow(needed)
+        buffer.usePinned { pinned ->
+            memcpy(data + length, pinned.addressOf(0), count.convert())
+        }
+        length = needed
+    }
+
+    /** Give up ownership of the buffer; the caller must `krfiles_free` it. */
+    fun release(): CPointer<ByteVar>? = data.also { data = null }
+
+    /** Free a library-owned buffer after a failed download. */
+    fun discard() {
+        if (!fixed) free(data)
+        data = null
+    }
+
+    private fun grow(needed: Long) {
+        check(!fixed) { "Buffer too small: capacity is $capacity bytes" }
+        var newCapacity = maxOf(capacity, INITIAL_CAPACITY)
+        while (newCapacity < needed) newCapacity *= 2
+        val grown =
+            checkNotNull(realloc(data, newCapacity.convert())) { "Out of memory allocating $newCapacity bytes" }
+        data = grown.reinterpret()
+        capacity = newCapacity
+    }
+
+    companion object {
+        private const val INITIAL_CAPACITY = 64L * 1024
+
+        /** Sink writing into caller-owned memory. */
+        fun borrowed(
+            buffer: COpaquePointer,
+            capacity: Long,
+        ): NativeByteSink = NativeByteSink(buffer.reinterpret(), capacity, fixed = true)
+
+        /** Sink that allocates and grows its own buffer. */
+        fun growable(): NativeByteSink = NativeByteSink(null, 0, fixed = false)
+    }
+}
+
+/**
+ * Download [remotePath] into the caller's [buffer] of [capacity] bytes.
+ *
+ * [outLength] receives the number of bytes written, or -1 if the file did not fit.
+ */
+internal suspend fun downloadToBuffer(
+    client: FilebrowserClient,
+    remotePath: String,
+    buffer: COpaquePointer?,
+    capacity: Long,
+    outLength: COpaquePointer?,
+    listener: TransferProgress?,
+): Result<Unit> {
+    if (buffer == null || outLength == null || capacity < 0) {
+        return Result.failure(IllegalArgumentException("Buffer and length pointers must not be null"))
+    }
+    val sink = NativeByteSink.borrowed(buffer, capacity)
+    val result = client.download(remotePath, progress = listener) { chunk, count -> sink.append(chunk, count) }
+    outLength.reinterpret<LongVar>()[0] = if (result.isSuccess) sink.length else -1
+    return result.map { }
+}
+
+/**
+ * Download [remotePath] into memory the library allocates.
+ *
+ * On success [outData] receives a `malloc`'d pointer (null for an empty file) that
+ * the caller releases with `krfiles_free`, and [outLength] its size.
+ */
+internal suspend fun downloadToMemory(
+    client: FilebrowserClient,
+    remotePath: String,
+    outData: COpaquePointer?,
+    outLength: COpaquePointer?,
+    listener: TransferProgress?,
+): Result<Unit> {
+    if (outData == null || outLength == null) {
+        return Result.failure(IllegalArgumentException("Output pointers must not be null"))
+    }
+    val sink = NativeByteSink.growable()
+    val result = client.download(remotePath, progress = listener) { chunk, count -> sink.append(chunk, count) }
+    if (result.isFailure) {
+        sink.discard()
+        return result.map { }
+    }
+    outLength.reinterpret<LongVar>()[0] = sink.length
+    outData.reinterpret<COpaquePointerVar>()[0] = sink.release()
+    return Result.success(Unit)
+}
+
+/** Upload [length] bytes at [data] to [remotePath] via tus; a [chunkSize] of 0 selects the default. */
+internal suspend fun uploadFromBuffer(
+    client: FilebrowserClient,
+    remotePath: String,
+    data: COpaquePointer?,
+    length: Long,
+    override_: Boolean,
+    chunkSize: Int,
+    listener: TransferProgress?,
+): Result<Unit> {
+    if (length < 0 || (data == null && length > 0)) {
+        return Result.failure(IllegalArgumentException("Invalid buffer: data=$data, length=$length"))
+    }
+    val source = data?.let { PointerChunkSource(it.reinterpret(), length) } ?: ByteArray(0).asChunkSource()
+    return client.uploadResumable(remotePath, length, source, uploadOptions(override_, chunkSize), listener)
+}
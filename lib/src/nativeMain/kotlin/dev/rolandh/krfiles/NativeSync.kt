@@ -0,0 +1,214 @@
+@file:OptIn(ExperimentalForeignApi::class)
+
+package dev.rolandh.krfiles
+
+import kotlinx.cinterop.ByteVar
+import kotlinx.cinterop.CFunction
+import kotlinx.cinterop.COpaquePointer
+import kotlinx.cinterop.CPointer
+import kotlinx.cinterop.ExperimentalForeignApi
+import kotlinx.cinterop.alloc
+import kotlinx.cinterop.cstr
+import kotlinx.cinterop.invoke
+import kotlinx.cinterop.memScoped
+import kotlinx.cinterop.pointed
+import kotlinx.cinterop.ptr
+import kotlinx.cinterop.reinterpret
+import kotlinx.cinterop.toKString
+import kotlinx.serialization.decodeFromString
+import kotlinx.serialization.encodeToString
+import platform.posix.S_IFDIR
+import platform.posix.S_IFREG
+import platform.posix.closedir
+import platform.posix.fclose
+import platform.posix.fopen
+import platform.posix.opendir
+import platform.posix.readdir
+import platform.posix.remove
+import platform.posix.rename
+import platform.posix.stat
+import platform.posix.utime
+import platform.posix.utimbuf
+
+/*
+ * Directory sync for the `nativeSync*` exports: a POSIX [LocalTree] plus the
+ * manifest file that lets [FilebrowserClient.sync] skip unchanged subtrees.
+ */
+
+/** Manifest file kept at the top of the local tree; never synced itself. */
+internal const val SYNC_MANIFEST_NAME = ".krfiles-sync.json"
+
+/** Suffix of files being pulled; renamed into place once complete. */
+private const val PART_SUFFIX = ".krfiles-part"
+
+// Flag bits of the `flags` argument, mirrored in krfiles.h.
+private const val SYNC_PULL = 1
+private const val SYNC_DRY_RUN = 2
+private const val SYNC_RESCAN = 4
+
+/** [LocalTree] over the directory at [root], via POSIX calls. Symlinks are followed. */
+internal class PosixLocalTree(
+    private val root: String,
+) : LocalTree {
+    override fun scan(): List<LocalEntry> {
+        val entries = mutableListOf<LocalEntry>()
+        val pending = ArrayDeque(listOf(""))
+        while (pending.isNotEmpty()) {
+            val dir = pending.removeLast()
+            for (name in listNames(absolute(dir))) {
+                val path = if (dir.isEmpty()) name else "$dir/$name"
+                if (path == SYNC_MANIFEST_NAME || name.endsWith(PART_SUFFIX)) continue
+                // Vanished since readdir, or neither a file nor a directory (sockets, FIFOs).
+                val entry = statEntry(path) ?: continue
+                entries += entry
+                if (entry.isDir) pending += path
+            }
+        }
+        return entries
+    }
+
+    override suspend fun <T> read(
+        path: String,
+        block: suspend (source: ChunkSource, size: Long) -> T,
+    ): T {
+        val source = checkNotNull(LocalFileSource.open(absolute(path))) { "Failed to read local file: $path" }
+        return try {
+            block(source, source.size)
+        } finally {
+            source.close()
+        }
+    }
+
+    override suspend fun write(
+        path: String,
+        modified: Long,
+        block: suspend (sink: suspend (buffer: ByteArray, length: Int) -> Unit) -> Unit,
+    ) {
+        val target = absolute(path)
+        val part = "$target$PART_SUFFIX"
+        val file = checkNotNull(fopen(part, "wb")) { "Failed to open file for writing: $part" }
+        try {
+            try {
+                block { buffer, length -> writeChunk(file, part, buffer, length) }
+            } finally {
+                fclose(file)
+            }
+            check(rename(part, target) == 0) { "Failed to move $part into place" }
+        } catch (e: Throwable) {
+            remove(part)
+            throw e
+        }
+        if (modified > 0) setModified(target, modified)
+    }
+
+    override fun createDirectory(path: String) {
+        ensureDirExists(absolute(path))
+    }
+
+    private fun absolute(path: String): String = if (path.isEmpty()) root else "$root/$path"
+
+    private fun listNames(dir: String): List<String> {
+        val stream = checkNotNull(opendir(dir)) { "Failed to read local directory: $dir" }
+        try {
+            val names = mutableListOf<String>()
+            while (true) {
+                val name = readdir(stream)?.pointed?.d_name?.toKString() ?: break
+                if (name != "." && name != "..") names += name
+            }
+            return names
+        } finally {
+            closedir(stream)
+        }
+    }
+
+    private fun statEntry(path: String): LocalEntry? =
+        memScoped {
+            val st = alloc<stat>()
+            if (stat(absolute(path), st.ptr) != 0) return null
+            when (fileType(st)) {
+                S_IFDIR -> LocalEntry(path, isDir = true, modified = modifiedSeconds(st))
+                S_IFREG -> LocalEntry(path, isDir = false, size = st.st_size, modified = modifiedSeconds(st))
+                else -> null
+            }
+        }
+
+    private fun setModified(
+        path: String,
+        seconds: Long,
+    ) {
+        memScoped {
+            val times = alloc<utimbuf>()
+            times.actime = seconds
+            times.modtime = seconds
+            utime(path, times.ptr)
+        }
+    }
+}
+
+/**
+ * Sync [localRoot] with [remoteRoot] as selected by [flags] and return the report as JSON.
+ *
+ * The manifest is read from and, unless this is a dry run, saved to
+ * [SYNC_MANIFEST_NAME] in [localRoot]. A missing or unreadable manifest just means
+ * every remote directory gets listed.
+ */
+internal suspend fun syncDirectory(
+    client: FilebrowserClient,
+    localRoot: String,
+    remoteRoot: String,
+    flags: Int,
+    concurrency: Int,
+    onAction: COpaquePointer?,
+    userData: COpaquePointer?,
+): Result<String> =
+    runCatching {
+        val options =
+            SyncOptions(
+                direction = if (flags and SYNC_PULL != 0) SyncDirection.PULL else SyncDirection.PUSH,
+                dryRun = flags and SYNC_DRY_RUN != 0,
+                rescan = flags and SYNC_RESCAN != 0,
+                concurrency = if (concurrency > 0) concurrency else FilebrowserClient.DEFAULT_SYNC_CONCURRENCY,
+            )
+        if (options.direction == SyncDirection.PULL && !options.dryRun) ensureDirExists(localRoot)
+        val manifestPath = "$localRoot/$SYNC_MANIFEST_NAME"
+        val manifest = readManifest(manifestPath)
+        val callback = onAction?.reinterpret<NativeSyncCallback>()
+        val report =
+            client
+                .sync(PosixLocalTree(localRoot), remoteRoot, options, manifest) { action ->
+                    // memScoped frees the C copy of the JSON once the callback returns
+                    callback?.let { memScoped { it(userData, exportJson.encodeToString(action).cstr.ptr) } }
+                }.getOrThrow()
+        if (!report.dryRun) writeManifest(manifestPath, report.manifest)
+        exportJson.encodeToString(report)
+    }
+
+private suspend fun readManifest(path: String): SyncManifest? {
+    val source = LocalFileSource.open(path) ?: return null
+    return try {
+        val bytes = ByteArray(source.size.toInt())
+        source.read(0, bytes, bytes.size)
+        runCatching { exportJson.decodeFromString<SyncManifest>(bytes.decodeToString()) }.getOrNull()
+    } finally {
+        source.close()
+    }
+}
+
+/** Write the manifest next to its final name first, so a crash never leaves half a file. */
+private fun writeManifest(
+    path: String,
+    manifest: SyncManifest,
+) {
+    val part = "$path$PART_SUFFIX"
+    val bytes = exportJson.encodeToString(manifest).encodeToByteArray()
+    val file = checkNotNull(fopen(part, "wb")) { "Failed to write sync manifest: $part" }
+    try {
+        writeChunk(file, part, bytes, bytes.size)
+    } finally {
+        fclose(file)
+    }
+    check(rename(part, path) == 0) { "Failed to write sync manifest: $path" }
+}
+
+/** C signature of the per-action callback accepted by the sync exports. */
+private typealias NativeSyncCallback = CFunction<(COpaquePointer?, CPointer<ByteVar>?) -> Unit>
@@ -0,0 +1,88 @@
+@file:OptIn(ExperimentalForeignApi::class)
+
+package dev.rolandh.krfiles
+
+import kotlinx.cinterop.ExperimentalForeignApi
+import kotlinx.cinterop.Pinned
+import kotlinx.cinterop.UByteVar
+import kotlinx.cinterop.addressOf
+import kotlinx.cinterop.alloc
+import kotlinx.cinterop.convert
+import kotlinx.cinterop.free
+import kotlinx.cinterop.nativeHeap
+import kotlinx.cinterop.pin
+import kotlinx.cinterop.ptr
+import kotlinx.cinterop.reinterpret
+import kotlinx.cinterop.sizeOf
+import kotlinx.cinterop.toKString
+import kotlinx.cinterop.usePinned
+import platform.zlib.MAX_WBITS
+import platform.zlib.Z_BUF_ERROR
+import platform.zlib.Z_NO_FLUSH
+import platform.zlib.Z_OK
+import platform.zlib.Z_STREAM_END
+import platform.zlib.inflate
+import platform.zlib.inflateEnd
+import platform.zlib.inflateInit2_
+import platform.zlib.zlibVersion
+import platform.zlib.z_stream
+
+/** Native implementation over the system zlib. */
+internal actual fun platformInflater(zlibHeader: Boolean): Inflater = ZlibInflater(zlibHeader)
+
+private class ZlibInflater(
+    zlibHeader: Boolean,
+) : Inflater {
+    private val stream = nativeHeap.alloc<z_stream>()
+
+    // zlib reads the input in place until it is consumed, so it stays pinned until replaced.
+    private var input: Pinned<ByteArray>? = null
+
+    override var finished = false
+        private set
+
+    override val needsInput: Boolean
+        get() = stream.avail_in == 0u
+
+    init {
+        val windowBits = if (zlibHeader) MAX_WBITS else -MAX_WBITS
+        val result = inflateInit2_(stream.ptr, windowBits, zlibVersion()?.toKString(), sizeOf<z_stream>().convert())
+        if (result != Z_OK) {
+            nativeHeap.free(stream)
+            error("zlib initialisation failed ($result)")
+        }
+    }
+
+    override fun setInput(
+        buffer: ByteArray,
+        offset: Int,
+        length: Int,
+    ) {
+        input?.unpin()
+        val pinned = buffer.pin()
+        input = pinned
+        stream.next_in = pinned.addressOf(offset).reinterpret<UByteVar>()
+        stream.avail_in = length.convert()
+    }
+
+    override fun inflate(output: ByteArray): Int {
+        if (finished) return 0
+        return output.usePinned { pinned ->
+            stream.next_out = pinned.addressOf(0).reinterpret()
+            stream.avail_out = output.size.convert()
+            when (val result = inflate(stream.ptr, Z_NO_FLUSH)) {
+                Z_STREAM_END -> finished = true
+                Z_OK, Z_BUF_ERROR -> Unit
+                else -> error("Corrupt compressed body: ${stream.msg?.toKString() ?: "zlib error $result"}")
+            }
+            output.size - stream.avail_out.toInt()
+        }
+    }
+
+    override fun end() {
+        input?.unpin()
+        input = null
+        inflateEnd(stream.ptr)
+        nativeHeap.free(stream)
+    }
+}
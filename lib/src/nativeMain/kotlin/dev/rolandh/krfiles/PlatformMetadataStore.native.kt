@@ -0,0 +1,117 @@
+package dev.rolandh.krfiles
+
+import kotlinx.cinterop.ByteVar
+import kotlinx.cinterop.CPointer
+import kotlinx.cinterop.ExperimentalForeignApi
+import kotlinx.cinterop.addressOf
+import kotlinx.cinterop.allocArray
+import kotlinx.cinterop.convert
+import kotlinx.cinterop.memScoped
+import kotlinx.cinterop.toKString
+import kotlinx.cinterop.usePinned
+import kotlinx.serialization.encodeToString
+import kotlinx.serialization.json.Json
+import platform.posix.FILE
+import platform.posix.O_CREAT
+import platform.posix.O_EXCL
+import platform.posix.O_WRONLY
+import platform.posix.close
+import platform.posix.fclose
+import platform.posix.fgets
+import platform.posix.fopen
+import platform.posix.getenv
+import platform.posix.getpid
+import platform.posix.open
+import platform.posix.remove
+import platform.posix.rename
+import platform.posix.write
+import kotlin.random.Random
+
+/**
+ * Native implementation of MetadataStore using the file system.
+ *
+ * Stores cached metadata in `~/.config/krfiles/metadata.json`, next to the credentials,
+ * readable only by its owner.
+ */
+public actual fun createPlatformMetadataStore(): MetadataStore = NativeMetadataStore()
+
+@OptIn(ExperimentalForeignApi::class)
+internal class NativeMetadataStore : MetadataStore {
+    private val json =
+        Json {
+            ignoreUnknownKeys = true
+        }
+
+    private val configDir: String by lazy {
+        val home = getenv("HOME")?.toKString() ?: "/tmp"
+        "$home/.config/krfiles"
+    }
+
+    private val metadataFilePath: String by lazy {
+        "$configDir/metadata.json"
+    }
+
+    private fun readData(): Map<String, Map<String, CachedResource>> {
+        val file: CPointer<FILE> = fopen(metadataFilePath, "r") ?: return emptyMap()
+        val content =
+            try {
+                memScoped {
+                    val buffer = StringBuilder()
+                    val chunk = allocArray<ByteVar>(64 * 1024)
+                    while (fgets(chunk, 64 * 1024, file) != null) {
+                        buffer.append(chunk.toKString())
+                    }
+                    buffer.toString()
+                }
+            } finally {
+                fclose(file)
+            }
+        return try {
+            json.decodeFromString(content)
+        } catch (e: Exception) {
+            emptyMap()
+        }
+    }
+
+    override fun load(
+        serverUrl: String,
+        user: String,
+    ): Map<String, CachedResource> = readData()["$serverUrl $user"].orEmpty()
+
+    override fun save(
+        serverUrl: String,
+        user: String,
+        entries: Map<String, CachedResource>,
+    ) {
+        ensureDirExists(configDir)
+        val data = readData() + ("$serverUrl $user" to entries)
+        val bytes = json.encodeToString(data).encodeToByteArray()
+        // Write a file only the owner can read beside the real one and rename it over, so
+        // readers never see half a file. The name is unique so concurrent writers don't interleave.
+        val part = "$metadataFilePath.${getpid()}-${Random.nextLong().toULong().toString(16)}.part"
+        val fd = open(part, O_WRONLY or O_CREAT or O_EXCL, 384) // 0600
+        if (fd < 0) return
+        val written =
+            try {
+                writeFully(fd, bytes)
+            } finally {
+                close(fd)
+            }
+        if (!written || rename(part, metadataFilePath) != 0) remove(part)
+    }
+
+    private fun writeFully(
+        fd: Int,
+        bytes: ByteArray,
+    ): Boolean {
+        var offset = 0
+        bytes.usePinned { pinned ->
+            while (offset < bytes.size) {
+                val count = write(fd, pinned.addressOf(offset), (bytes.size - offset).convert())
+                if (count <= 0) return false
+                offset += count.toInt()
+            }
+        }
+        return true
+    }
+}
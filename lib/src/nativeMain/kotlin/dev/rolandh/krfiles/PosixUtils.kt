@@ -1,4 +1,15 @@
 package dev.rolandh.krfiles
 
+import kotlinx.cinterop.ExperimentalForeignApi
+import platform.posix.stat
+
 /** Create a directory if it doesn't exist. Platform-specific because mode_t widths vary. */
 internal expect fun ensureDirExists(path: String)
+
+/** The `S_IFMT` bits of [st], e.g. `S_IFDIR`. Platform-specific because mode_t widths vary. */
+@OptIn(ExperimentalForeignApi::class)
+internal expect fun fileType(st: stat): Int
+
+/** Modification time of [st] in seconds since the epoch. The field is named differently on Darwin. */
+@OptIn(ExperimentalForeignApi::class)
+internal expect fun modifiedSeconds(st: stat): Long